@@ -0,0 +1,85 @@
+#include <streams.h>
+
+#include "PS3EyeCameraClock.h"
+
+PS3EyeCameraClock::PS3EyeCameraClock(LPUNKNOWN pUnk, HRESULT *phr) :
+	CBaseReferenceClock(NAME("PS3 Eye camera clock"), pUnk, phr),
+	_cadence(UNITS / 30),
+	_rate(1.0),
+	_anchored(false),
+	_anchorEpoch(0),
+	_anchorFrame(0),
+	_anchorTime(0)
+{
+	_baseQpc = QpcTime();
+	_base = _baseQpc;
+}
+
+LONGLONG PS3EyeCameraClock::QpcTime()
+{
+	static LARGE_INTEGER frequency = {};
+	if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	// Split so the multiplication cannot overflow after a long uptime
+	return now.QuadPart / frequency.QuadPart * UNITS +
+		now.QuadPart % frequency.QuadPart * UNITS / frequency.QuadPart;
+}
+
+REFERENCE_TIME PS3EyeCameraClock::ClockAt(LONGLONG qpc) const
+{
+	return _base + (REFERENCE_TIME)((qpc - _baseQpc) * _rate);
+}
+
+void PS3EyeCameraClock::SetRate(double rate)
+{
+	const LONGLONG now = QpcTime();
+	_base = ClockAt(now);
+	_baseQpc = now;
+	_rate = rate;
+}
+
+REFERENCE_TIME PS3EyeCameraClock::GetPrivateTime()
+{
+	CAutoLock lock(this);
+	return ClockAt(QpcTime());
+}
+
+void PS3EyeCameraClock::StartStream(REFERENCE_TIME nominalPeriod)
+{
+	CAutoLock lock(this);
+	_cadence.Reset(nominalPeriod);
+	_anchored = false;
+	SetRate(1.0);
+}
+
+LONGLONG PS3EyeCameraClock::AddFrame(LONGLONG arrival, uint64_t *frame)
+{
+	CAutoLock lock(this);
+	*frame = _cadence.AddFrame(arrival);
+	const LONGLONG nominal = _cadence.NominalPeriod();
+	if (!_cadence.Locked()) {
+		// The driver hands out a frame about one period after the sensor finished it
+		return arrival - nominal;
+	}
+
+	const LONGLONG fitted = _cadence.FrameTime(*frame);
+	if (!_anchored || _cadence.Epoch() != _anchorEpoch) {
+		// Frame numbers of a new lock may be offset from the old ones; take the
+		// phase from here
+		_anchored = true;
+		_anchorEpoch = _cadence.Epoch();
+		_anchorFrame = *frame;
+		_anchorTime = ClockAt(fitted);
+	}
+
+	// Where the frame count says the clock should be at this frame, and where it is
+	const REFERENCE_TIME ideal = _anchorTime + (REFERENCE_TIME)(*frame - _anchorFrame) * nominal;
+	const double error = (double)(ideal - ClockAt(fitted));
+	double slew = error / SLEW_TIME;
+	const double maxSlew = MAX_SLEW_PPM / 1e6;
+	slew = slew > maxSlew ? maxSlew : slew < -maxSlew ? -maxSlew : slew;
+	SetRate(nominal / _cadence.Period() + slew);
+
+	return fitted - (LONGLONG)_cadence.Period();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "../MediaFoundationSource/PS3EyeFrameCadence.h"
+
+// Reference clock that runs at the camera's frame rate rather than the host's.
+// The filter exposes it, so a graph can slave to the camera: one nominal frame
+// period of clock time passes per frame the sensor delivers, and renderers and
+// muxers stop accumulating drift against the video over long recordings.
+//
+// The push pin feeds it the arrival time of every frame. A regression over the
+// recent arrivals (PS3EyeFrameCadence) gives the camera's true period; the clock
+// runs at nominal / true period relative to QueryPerformanceCounter, plus a slew
+// of at most MAX_SLEW_PPM that pulls its phase onto the frame count. Every
+// correction starts from the current clock value, so the clock never jumps.
+// Until a stream has locked it runs at the rate of QueryPerformanceCounter.
+class PS3EyeCameraClock : public CBaseReferenceClock
+{
+public:
+	PS3EyeCameraClock(LPUNKNOWN pUnk, HRESULT *phr);
+
+	// A stream starts with frames of nominalPeriod (100ns)
+	void StartStream(REFERENCE_TIME nominalPeriod);
+
+	// A frame came out of the driver at arrival (QpcTime()). Returns when the
+	// sensor finished it, in the same time base, with the arrival jitter removed;
+	// frame receives its number, counting the frames lost since the last one.
+	LONGLONG AddFrame(LONGLONG arrival, uint64_t *frame);
+
+	REFERENCE_TIME GetPrivateTime();
+
+	// QueryPerformanceCounter in 100ns units
+	static LONGLONG QpcTime();
+
+private:
+	static const int MAX_SLEW_PPM = 500;
+	static const LONGLONG SLEW_TIME = 10000000; // Phase errors are pulled in over 1 s
+
+	REFERENCE_TIME ClockAt(LONGLONG qpc) const;
+	void SetRate(double rate);
+
+	PS3EyeFrameCadence _cadence;
+
+	// Clock time is _base + (qpc - _baseQpc) * _rate
+	REFERENCE_TIME _base;
+	LONGLONG _baseQpc;
+	double _rate;
+
+	// Clock time of frame _anchorFrame, for the phase; set when a cadence locks
+	bool _anchored;
+	uint32_t _anchorEpoch;
+	uint64_t _anchorFrame;
+	REFERENCE_TIME _anchorTime;
+};
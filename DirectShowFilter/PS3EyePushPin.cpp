@@ -2,24 +2,114 @@
 #include <strsafe.h>
 #include "ps3eye.h"
 #include "PS3EyeSourceFilter.h"
-
-PS3EyePushPin::PS3EyePushPin(HRESULT *phr, CSource *pFilter, ps3eye::PS3EYECam::PS3EYERef device) :
-	CSourceStream(NAME("PS3 Eye Source"), phr, pFilter, L"Out"),
-	_device(device)
+#include "PS3EyeCameraClock.h"
+#include "../MediaFoundationSource/PS3EyeBayer.h"
+#include "../MediaFoundationSource/PS3EyeFrameRates.h"
+#include "../MediaFoundationSource/PS3EyeWorkerPool.h"
+
+// Raw GRBG Bayer, the sensor's own data at 8 bits per pixel
+#define FOURCC_GRBG MAKEFOURCC('G', 'R', 'B', 'G')
+#define FOURCC_NV12 MAKEFOURCC('N', 'V', '1', '2')
+#define FOURCC_I420 MAKEFOURCC('I', '4', '2', '0')
+#define FOURCC_YUY2 MAKEFOURCC('Y', 'U', 'Y', '2')
+// 8-bit grey, full range; GREY is the same layout under another name
+#define FOURCC_Y800 MAKEFOURCC('Y', '8', '0', '0')
+#define FOURCC_GREY MAKEFOURCC('G', 'R', 'E', 'Y')
+
+// Output formats, most preferred first; each is offered in every mode. The YUV
+// ones come first so encoders and legacy YUY2 consumers get their input
+// without a colour converter (and at 1.5 or 2 bytes per pixel instead of 4).
+// Grey follows RGB32, so nothing that also takes colour ends up with it by
+// accident; trackers ask for it by subtype.
+static const struct {
+	DWORD compression;
+	WORD bitCount;
+} OUTPUT_FORMATS[] = {
+	{ FOURCC_NV12, 12 },
+	{ FOURCC_I420, 12 },
+	{ FOURCC_YUY2, 16 },
+	{ BI_RGB, 32 },
+	{ FOURCC_Y800, 8 },
+	{ FOURCC_GRBG, 8 },
+};
+static const int FORMAT_COUNT = sizeof(OUTPUT_FORMATS) / sizeof(OUTPUT_FORMATS[0]);
+
+// Modes: every rate the driver supports at 640x480, then at 320x240 (up to 187 fps).
+// Each size starts at the default 30 fps, which apps tend to pick first; the
+// other rates follow fastest first.
+static const int MODE_COUNT = PS3EYE_VGA_FRAME_RATE_COUNT + PS3EYE_QVGA_FRAME_RATE_COUNT;
+
+static void GetMode(int mode, LONG *width, LONG *height, uint32_t *fps)
 {
-	LPVOID refClock;
-	HRESULT r = CoCreateInstance(CLSID_SystemClock, NULL, CLSCTX_INPROC_SERVER, IID_IReferenceClock, &refClock);
-	if ((SUCCEEDED(r))) {
-		_refClock = (IReferenceClock *)refClock;
+	const uint32_t *rates = PS3EYE_VGA_FRAME_RATES;
+	int count = PS3EYE_VGA_FRAME_RATE_COUNT;
+	*width = 640;
+	*height = 480;
+	if (mode >= count) {
+		mode -= count;
+		rates = PS3EYE_QVGA_FRAME_RATES;
+		count = PS3EYE_QVGA_FRAME_RATE_COUNT;
+		*width = 320;
+		*height = 240;
 	}
-	else {
-		OutputDebugString(L"PS3EyePushPin: failed to create reference clock\n");
-		_refClock = NULL;
+	*fps = PS3EYE_DEFAULT_FRAME_RATE;
+	for (int i = 0; i < count && mode > 0; i++) {
+		if (rates[i] == PS3EYE_DEFAULT_FRAME_RATE) continue;
+		*fps = rates[i];
+		mode--;
+	}
+}
+
+// The driver rate a media type asks for; CheckMediaType has made sure there is one
+static uint32_t MediaTypeFrameRate(const VIDEOINFOHEADER *pvi)
+{
+	return PS3EyeMatchFrameRate(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight, pvi->AvgTimePerFrame);
+}
+
+static GUID FormatSubtype(DWORD compression)
+{
+	return compression == BI_RGB ? MEDIASUBTYPE_RGB32 : (GUID)FOURCCMap(compression);
+}
+
+// Aliases accepted for an OUTPUT_FORMATS entry, mapped to its compression
+static DWORD CanonicalCompression(DWORD compression)
+{
+	return compression == FOURCC_GREY ? FOURCC_Y800 : compression;
+}
+
+// Index into OUTPUT_FORMATS, or -1
+static int FindOutputFormat(const CMediaType *pMediaType)
+{
+	GUID subtype = *pMediaType->Subtype();
+	if (subtype == FOURCCMap(FOURCC_GREY)) subtype = FOURCCMap(FOURCC_Y800);
+	for (int i = 0; i < FORMAT_COUNT; i++) {
+		if (subtype == FormatSubtype(OUTPUT_FORMATS[i].compression)) return i;
 	}
+	return -1;
+}
+
+static bool IsRawType(const CMediaType *pMediaType)
+{
+	return *pMediaType->Subtype() == FOURCCMap(FOURCC_GRBG);
+}
+
+PS3EyePushPin::PS3EyePushPin(HRESULT *phr, CSource *pFilter, ps3eye::PS3EYECam::PS3EYERef device, PS3EyeCameraClock *clock) :
+	CSourceStream(NAME("PS3 Eye Source"), phr, pFilter, L"Out"),
+	_device(device),
+	_clock(clock),
+	_skipper(UNITS / PS3EYE_DEFAULT_FRAME_RATE),
+	_capturing(false),
+	_live(false),
+	_nextPlaceholder(0),
+	_lastCameraFrame(0),
+	_streamOffset(0),
+	_maxStreamOffset(0)
+{
+	ZeroMemory(_droppedHistory, sizeof(_droppedHistory));
+	ResetStats(0);
 }
 
 PS3EyePushPin::~PS3EyePushPin() {
-	if(_refClock != NULL) _refClock->Release();
 }
 
 HRESULT PS3EyePushPin::CheckMediaType(const CMediaType *pMediaType)
@@ -27,17 +117,16 @@ HRESULT PS3EyePushPin::CheckMediaType(const CMediaType *pMediaType)
 	CheckPointer(pMediaType, E_POINTER);
 
 	if (pMediaType->IsValid() && *pMediaType->Type() == MEDIATYPE_Video &&
-		pMediaType->Subtype() != NULL && *pMediaType->Subtype() == MEDIASUBTYPE_RGB32) {
+		pMediaType->Subtype() != NULL && FindOutputFormat(pMediaType) >= 0) {
 		if (*pMediaType->FormatType() == FORMAT_VideoInfo &&
 			pMediaType->Format() != NULL && pMediaType->FormatLength() > 0) {
 			VIDEOINFOHEADER *pvi = (VIDEOINFOHEADER*)pMediaType->Format();
-			if ((pvi->bmiHeader.biWidth == 640 && pvi->bmiHeader.biHeight == 480) ||
-				(pvi->bmiHeader.biWidth == 320 && pvi->bmiHeader.biHeight == 240)) {
-				if (pvi->bmiHeader.biBitCount == 32 && pvi->bmiHeader.biCompression == BI_RGB
+			int format = FindOutputFormat(pMediaType);
+			if (PS3EyeIsSensorSize(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight)) {
+				if (pvi->bmiHeader.biBitCount == OUTPUT_FORMATS[format].bitCount && CanonicalCompression(pvi->bmiHeader.biCompression) == OUTPUT_FORMATS[format].compression
 					&& pvi->bmiHeader.biPlanes == 1) {
-					int minTime = 10000000 / 70;
-					int maxTime = 10000000 / 2;
-					if (pvi->AvgTimePerFrame >= minTime && pvi->AvgTimePerFrame <= maxTime) {
+					// Only rates in the driver's table; it would silently round anything else down
+					if (MediaTypeFrameRate(pvi) != 0) {
 						return S_OK;
 					}
 				}
@@ -62,34 +151,25 @@ HRESULT PS3EyePushPin::GetMediaType(int iPosition, CMediaType *pMediaType) {
 }
 
 HRESULT PS3EyePushPin::_GetMediaType(int iPosition, CMediaType *pMediaType) {
-	if (iPosition < 0 || iPosition >= 6) return E_UNEXPECTED;
+	if (iPosition < 0 || iPosition >= FORMAT_COUNT * MODE_COUNT) return E_UNEXPECTED;
 	CheckPointer(pMediaType, E_POINTER);
 
+	// All modes in each format in turn, in OUTPUT_FORMATS order
+	int format = iPosition / MODE_COUNT;
+	iPosition %= MODE_COUNT;
+
 	VIDEOINFOHEADER *pvi = (VIDEOINFOHEADER*)pMediaType->AllocFormatBuffer(sizeof(VIDEOINFOHEADER));
 	if (pvi == 0)
 		return(E_OUTOFMEMORY);
 	ZeroMemory(pvi, pMediaType->cbFormat);
 
 
-	int fps = 10;
-	if (iPosition / 3 == 0) {
-		// 640x480, {30, 60, 15} fps
-		pvi->bmiHeader.biWidth = 640;
-		pvi->bmiHeader.biHeight = 480;
-		fps = iPosition == 2 ? 15 : 30 * (iPosition+1);
-	}
-	else  {
-		// 320x240, {30, 60, 15} fps
-		pvi->bmiHeader.biWidth = 320;
-		pvi->bmiHeader.biHeight = 240;
-
-		fps = iPosition == 5 ? 15 : 30 * (iPosition-2);
-	}
+	uint32_t fps;
+	GetMode(iPosition, &pvi->bmiHeader.biWidth, &pvi->bmiHeader.biHeight, &fps);
+	pvi->AvgTimePerFrame = PS3EyeFrameInterval(fps);
 
-	pvi->AvgTimePerFrame = 10000000 / fps;
-
-	pvi->bmiHeader.biBitCount = 32;
-	pvi->bmiHeader.biCompression = BI_RGB;
+	pvi->bmiHeader.biBitCount = OUTPUT_FORMATS[format].bitCount;
+	pvi->bmiHeader.biCompression = OUTPUT_FORMATS[format].compression;
 	pvi->bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
 	pvi->bmiHeader.biPlanes = 1;
 	pvi->bmiHeader.biSizeImage = GetBitmapSize(&pvi->bmiHeader);
@@ -120,11 +200,9 @@ HRESULT PS3EyePushPin::DecideBufferSize(IMemAllocator *pAlloc, ALLOCATOR_PROPERT
 
 	VIDEOINFOHEADER *pvi = (VIDEOINFOHEADER*)m_mt.Format();
 
-	// Ensure a minimum number of buffers
-	if (pRequest->cBuffers == 0)
-	{
-		pRequest->cBuffers = 2;
-	}
+	// The capture thread rides out downstream stalls on its own; more buffers than one
+	// filling and one downstream would only queue frames up and add latency
+	pRequest->cBuffers = 2;
 	pRequest->cbBuffer = pvi->bmiHeader.biSizeImage;
 
 	ALLOCATOR_PROPERTIES Actual;
@@ -143,81 +221,250 @@ HRESULT PS3EyePushPin::DecideBufferSize(IMemAllocator *pAlloc, ALLOCATOR_PROPERT
 	return S_OK;
 }
 
-HRESULT PS3EyePushPin::OnThreadStartPlay()
+HRESULT PS3EyePushPin::OnThreadCreate()
 {
-	if (_refClock != NULL) _refClock->GetTime(&_startTime);
+	VIDEOINFOHEADER *pvi = (VIDEOINFOHEADER*)m_mt.Format();
+	uint32_t width = pvi->bmiHeader.biWidth;
+	uint32_t height = pvi->bmiHeader.biHeight;
+	_clock->StartStream(pvi->AvgTimePerFrame);
+	// Until frames are measured, assume the frame the driver holds back
+	ResetStats(pvi->AvgTimePerFrame);
+	_mailbox.Open(width * height);
+	_skipper.Reset(pvi->AvgTimePerFrame);
+	if (!IsRawType(&m_mt)) {
+		_pool = PS3EyeWorkerPool::Shared();
+	}
+
+	// Shown while there is no camera: a black frame, converted once from an all-zero mosaic
+	// so it is black in every output format
+	std::vector<BYTE> blank(width * height, 0);
+	_placeholder.resize(pvi->bmiHeader.biSizeImage);
+	ConvertFrame(blank.data(), _placeholder.data());
+	_nextPlaceholder = PS3EyeCameraClock::QpcTime();
+	_lastCameraFrame = _nextPlaceholder;
+
+	// Open the camera now if there is one, so a camera that is there streams from the
+	// first sample; otherwise the capture thread keeps looking for one
+	_capturing = true;
+	OpenDevice(width, height, MediaTypeFrameRate(pvi));
+	_captureThread = std::thread(&PS3EyePushPin::CaptureLoop, this, width, height, MediaTypeFrameRate(pvi));
 	return S_OK;
 }
 
-HRESULT PS3EyePushPin::OnThreadCreate()
+HRESULT PS3EyePushPin::OnThreadDestroy()
 {
-	VIDEOINFOHEADER *pvi = (VIDEOINFOHEADER*)m_mt.Format();
-	int fps = 10000000 / ((int)pvi->AvgTimePerFrame);
-	OutputDebugString(L"initing device\n");
-	if (_device.use_count() > 0) {
-		bool didInit = _device->init(pvi->bmiHeader.biWidth, pvi->bmiHeader.biHeight, fps, ps3eye::PS3EYECam::EOutputFormat::BGRA);
-		if (didInit) {
-			OutputDebugString(L"starting device\n");
-			_device->setFlip(false, true);
-			_device->setAutogain(true);
-			_device->setAutoWhiteBalance(true);
-			_device->start();
-			OutputDebugString(L"done\n");
-			return S_OK;
+	// The capture thread never calls getFrame itself and waits on _reader for at most
+	// CAPTURE_WAIT_MS, so it sees _capturing drop and the join is bounded. Only then is
+	// the device stopped, from here, with nothing else using it.
+	_capturing = false;
+	if (_captureThread.joinable()) {
+		_captureThread.join();
+		WCHAR message[128];
+		StringCchPrintf(message, 128, L"PS3EyePushPin: %llu frames skipped while downstream lagged, %llu for quality\n",
+			_mailbox.Skipped(), _skipper.Skipped());
+		OutputDebugString(message);
+	}
+	if (_live) {
+		// A streaming camera hands over a frame within a period
+		VIDEOINFOHEADER *pvi = (VIDEOINFOHEADER*)m_mt.Format();
+		StopDevice((DWORD)(2 * pvi->AvgTimePerFrame / 10000) + CAPTURE_WAIT_MS);
+	}
+	_mailbox.Close();
+	_pool.reset();
+	return S_OK;
+}
+
+bool PS3EyePushPin::OpenDevice(uint32_t width, uint32_t height, uint32_t fps)
+{
+	// A reader StopDevice gave up on still holds its camera, USB interface and all: open
+	// nothing until that thread is out of getFrame and joined
+	if (!_reader.Stop(0)) return false;
+
+	std::vector<ps3eye::PS3EYECam::PS3EYERef> candidates;
+	if (_device.use_count() != 0) {
+		candidates.push_back(_device);
+	}
+	else {
+		// Hot-plug: the first camera that inits. Freshly enumerated devices never report
+		// streaming, even one another filter is streaming from; init fails on those.
+		candidates = ps3eye::PS3EYECam::getDevices(true);
+	}
+
+	ps3eye::PS3EYECam::PS3EYERef device;
+	for (size_t i = 0; i < candidates.size() && device.use_count() == 0; i++) {
+		OutputDebugString(L"initing device\n");
+		// raw Bayer: FillBuffer converts with the SIMD kernels, much faster than the driver's own conversion
+		if (candidates[i]->init(width, height, (uint16_t)fps, ps3eye::PS3EYECam::EOutputFormat::Bayer)) {
+			device = candidates[i];
 		}
 		else {
 			OutputDebugString(L"failed to init device\n");
-			return E_FAIL;
 		}
 	}
-	else {
-		// no device found but we'll render a blank frame so press on
-		return S_OK;
+	if (device.use_count() == 0) return false;
+	OutputDebugString(L"starting device\n");
+	device->setAutogain(true);
+	device->setAutoWhiteBalance(true);
+	_device = device;
+	_device->start();
+	// The reader holds its own reference, so a thread left blocked in getFrame never
+	// outlives the device
+	if (!_reader.Start([device](uint8_t *buffer) {
+		device->getFrame(buffer);
+		return (int64_t)PS3EyeCameraClock::QpcTime();
+	}, width * height)) {
+		_device->stop();
+		return false;
 	}
+	_lastCameraFrame = PS3EyeCameraClock::QpcTime();
+	_live = true;
+	OutputDebugString(L"done\n");
+	return true;
 }
 
-HRESULT PS3EyePushPin::OnThreadDestroy()
+void PS3EyePushPin::StopDevice(DWORD timeoutMs)
 {
-	if (_device.use_count() > 0) {
+	// getFrame only returns with a frame, and stop() cancels the transfers without waking
+	// it: stopping the device first would leave the reader blocked for good
+	if (_reader.Stop(timeoutMs)) {
 		_device->stop();
 	}
-	return S_OK;
+	else {
+		// Left streaming with the reader, so a stall that clears lets it out of getFrame;
+		// it then drops the device, which stops and releases it. OpenDevice joins it then.
+		OutputDebugString(L"PS3EyePushPin: camera sent nothing, closed until the reader returns\n");
+		_device.reset();
+	}
+	_live = false;
+}
+
+void PS3EyePushPin::CaptureLoop(uint32_t width, uint32_t height, uint32_t fps)
+{
+	while (_capturing) {
+		if (!_live) {
+			if (OpenDevice(width, height, fps)) continue;
+			// Look again a while later, without holding up a stop for long
+			for (int waited = 0; waited < HOTPLUG_POLL_MS && _capturing; waited += 100) {
+				Sleep(100);
+			}
+			continue;
+		}
+		int64_t arrival;
+		if (_reader.Take(_mailbox.BeginWrite(), CAPTURE_WAIT_MS, &arrival) != PS3EyeFrameReader::Result::Frame) {
+			// Silent this long, the camera has gone (unplugged, or its bus reset): give it
+			// up and look for it again like any other
+			if (PS3EyeCameraClock::QpcTime() - _lastCameraFrame > HOTPLUG_POLL_MS * 10000LL) {
+				StopDevice(CAPTURE_WAIT_MS);
+			}
+			continue;
+		}
+		_lastCameraFrame = arrival;
+		uint64_t frame;
+		LONGLONG captured = _clock->AddFrame(arrival, &frame);
+		_mailbox.EndWrite(frame, captured);
+	}
+}
+
+void PS3EyePushPin::ConvertFrame(const BYTE *raw, BYTE *pData)
+{
+	VIDEOINFOHEADER *pvi = (VIDEOINFOHEADER*)m_mt.Format();
+	uint32_t width = pvi->bmiHeader.biWidth;
+	uint32_t height = pvi->bmiHeader.biHeight;
+	DWORD compression = CanonicalCompression(pvi->bmiHeader.biCompression);
+	if (compression == FOURCC_GRBG) {
+		memcpy(pData, raw, width * height);
+	}
+	else if (compression == FOURCC_NV12 || compression == FOURCC_I420 || compression == FOURCC_YUY2) {
+		// YUV is top-down, like the sensor
+		PS3EyeYuvFormat format = compression == FOURCC_NV12 ? PS3EyeYuvFormat::NV12 :
+			compression == FOURCC_I420 ? PS3EyeYuvFormat::I420 : PS3EyeYuvFormat::YUY2;
+		PS3EyeDemosaicYuvParallel(_pool.get(), PS3EyeYuvFrameJob(raw, width, pData, width, height, format));
+	}
+	else if (compression == FOURCC_Y800) {
+		// Luma straight from the mosaic, top-down like YUV
+		PS3EyeGreyJob job = { raw, width, pData, width, width, height };
+		PS3EyeBayerToGreyParallel(_pool.get(), job);
+	}
+	else {
+		// RGB32 is a bottom-up DIB: flip while demosaicing (raw stays in sensor order)
+		PS3EyeBayerJob job = { raw, width, pData, width * 4, width, height, PS3EyeBayerFormat::BGRA, true, false };
+		PS3EyeDemosaicParallel(_pool.get(), job);
+	}
+}
+
+HRESULT PS3EyePushPin::NextFrame(PS3EyeFrameMailbox::Frame *latest)
+{
+	VIDEOINFOHEADER *pvi = (VIDEOINFOHEADER*)m_mt.Format();
+	for (;;) {
+		// Stop waits for this thread to come back from FillBuffer; waits below are short
+		// enough to notice it promptly
+		if (CheckRequest(NULL)) {
+			return E_ABORT;
+		}
+		DWORD timeout = CAPTURE_WAIT_MS;
+		LONGLONG now = PS3EyeCameraClock::QpcTime();
+		if (!_live || now - _lastCameraFrame > PLACEHOLDER_AFTER_PERIODS * pvi->AvgTimePerFrame) {
+			// No camera, or one that stopped sending: a placeholder every frame period, on
+			// the same schedule a camera would keep
+			if (now >= _nextPlaceholder) {
+				// After a downstream stall, carry on from now rather than catch up in a burst
+				if (now - _nextPlaceholder > pvi->AvgTimePerFrame) _nextPlaceholder = now;
+				latest->data = _placeholder.data();
+				latest->number = _framesDelivered == 0 ? 0 : _lastFrame + 1;
+				latest->time = _nextPlaceholder;
+				latest->skipped = 0;
+				_nextPlaceholder += pvi->AvgTimePerFrame;
+				return S_FALSE;
+			}
+			timeout = min(timeout, (DWORD)((_nextPlaceholder - now + 9999) / 10000));
+		}
+		// A camera that turns up meanwhile takes over from the placeholder straight away
+		if (_mailbox.Take(latest, timeout)) {
+			if (_skipper.Deliver()) return S_OK;
+		}
+	}
 }
 
 HRESULT PS3EyePushPin::FillBuffer(IMediaSample *pSample)
 {
 	BYTE *pData;
-	long cbData;
 
 	CheckPointer(pSample, E_POINTER);
 
 	pSample->GetPointer(&pData);
-	cbData = pSample->GetSize();
 
 	// Check that we're still using video
 	ASSERT(m_mt.formattype == FORMAT_VideoInfo);
 
-	if (_device.use_count() > 0) {
-		_device->getFrame(pData);
+	VIDEOINFOHEADER *pvi = (VIDEOINFOHEADER*)m_mt.Format();
+	PS3EyeFrameMailbox::Frame latest;
+	HRESULT hr = NextFrame(&latest);
+	if (hr == E_ABORT) {
+		return S_FALSE;
+	}
+	else if (hr == S_OK) {
+		ConvertFrame(latest.data, pData);
 	}
 	else {
-		// TODO: fill with error message image
-		for (int i = 0; i < cbData; ++i) pData[i] = 0;
+		memcpy(pData, latest.data, _placeholder.size());
 	}
 
-	if (_refClock != NULL) {
-		VIDEOINFOHEADER *pvi = (VIDEOINFOHEADER*)m_mt.Format();
-		REFERENCE_TIME t;
-		_refClock->GetTime(&t);
-		REFERENCE_TIME rtStart = t - _startTime - pvi->AvgTimePerFrame; // compensate for frame buffer in PS3EYECam
-		//REFERENCE_TIME rtStart = t - _startTime; // compensate for frame buffer in PS3EYECam
+	// Stamp the frame with when the sensor captured it, on the graph's clock
+	// (the camera's own, unless the graph picked another): stream time now,
+	// less how long ago that was
+	CRefTime now;
+	if (SUCCEEDED(m_pFilter->StreamTime(now))) {
+		REFERENCE_TIME rtStart = now - (PS3EyeCameraClock::QpcTime() - latest.time) + _streamOffset;
 		REFERENCE_TIME rtStop = rtStart + pvi->AvgTimePerFrame;
 
 		pSample->SetTime(&rtStart, &rtStop);
-		// Set TRUE on every sample for uncompressed frames
-		pSample->SetSyncPoint(TRUE);
 	}
+	// Set TRUE on every sample for uncompressed frames
+	pSample->SetSyncPoint(TRUE);
+	// Frames skipped or lost since the last sample break the stream
+	pSample->SetDiscontinuity(_framesDelivered > 0 && latest.number != _lastFrame + 1);
 
+	RecordFrame(latest.number, pvi->bmiHeader.biSizeImage, PS3EyeCameraClock::QpcTime() - latest.time);
 	return S_OK;
 }
 
@@ -333,7 +580,7 @@ HRESULT __stdcall PS3EyePushPin::GetNumberOfCapabilities(int * piCount, int * pi
 {
 	CheckPointer(piCount, E_POINTER);
 	CheckPointer(piSize, E_POINTER);
-	*piCount = 6;
+	*piCount = FORMAT_COUNT * MODE_COUNT;
 	*piSize = sizeof(VIDEO_STREAM_CONFIG_CAPS);
 	return S_OK;
 }
@@ -367,10 +614,127 @@ HRESULT __stdcall PS3EyePushPin::GetStreamCaps(int iIndex, AM_MEDIA_TYPE ** ppmt
 		cc->StretchTapsY = 0;
 		cc->ShrinkTapsX = 0;
 		cc->ShrinkTapsY = 0;
-		cc->MinFrameInterval = 10000000 / 60;
-		cc->MaxFrameInterval = 10000000 / 2;
+		// One rate per capability, so apps list exactly the rates the driver can set
+		cc->MinFrameInterval = pvi->AvgTimePerFrame;
+		cc->MaxFrameInterval = pvi->AvgTimePerFrame;
 		cc->MinBitsPerSecond = 0;
 		cc->MaxBitsPerSecond = (LONG)1000000000000;
 	}
 	return hr;
 }
+
+void PS3EyePushPin::ResetStats(REFERENCE_TIME latency)
+{
+	CAutoLock lock(&_statsLock);
+	_framesDelivered = 0;
+	_framesDropped = 0;
+	_bytesDelivered = 0;
+	_lastFrame = 0;
+	_latency = latency;
+}
+
+void PS3EyePushPin::RecordFrame(uint64_t frame, long size, REFERENCE_TIME latency)
+{
+	CAutoLock lock(&_statsLock);
+	if (_framesDelivered > 0) {
+		for (uint64_t dropped = _lastFrame + 1; dropped < frame; dropped++) {
+			_droppedHistory[_framesDropped % DROPPED_HISTORY] = (long)dropped;
+			_framesDropped++;
+		}
+	}
+	_lastFrame = frame;
+	_framesDelivered++;
+	_bytesDelivered += size;
+	// Smoothed over about 16 frames, so one late wake-up does not move it
+	_latency += (latency - _latency) / 16;
+}
+
+HRESULT __stdcall PS3EyePushPin::GetNumDropped(long * plDropped)
+{
+	CheckPointer(plDropped, E_POINTER);
+	CAutoLock lock(&_statsLock);
+	*plDropped = _framesDropped;
+	return S_OK;
+}
+
+HRESULT __stdcall PS3EyePushPin::GetNumNotDropped(long * plNotDropped)
+{
+	CheckPointer(plNotDropped, E_POINTER);
+	CAutoLock lock(&_statsLock);
+	*plNotDropped = _framesDelivered;
+	return S_OK;
+}
+
+HRESULT __stdcall PS3EyePushPin::GetDroppedInfo(long lSize, long * plArray, long * plNumCopied)
+{
+	CheckPointer(plArray, E_POINTER);
+	CheckPointer(plNumCopied, E_POINTER);
+	if (lSize <= 0) return E_INVALIDARG;
+	CAutoLock lock(&_statsLock);
+	// The most recent drops still in the history, oldest first
+	long count = min(lSize, min(_framesDropped, (long)DROPPED_HISTORY));
+	for (long i = 0; i < count; i++) {
+		plArray[i] = _droppedHistory[(_framesDropped - count + i) % DROPPED_HISTORY];
+	}
+	*plNumCopied = count;
+	return S_OK;
+}
+
+HRESULT __stdcall PS3EyePushPin::GetAverageFrameSize(long * plAverageSize)
+{
+	CheckPointer(plAverageSize, E_POINTER);
+	CAutoLock lock(&_statsLock);
+	*plAverageSize = _framesDelivered > 0 ? (long)(_bytesDelivered / _framesDelivered) : 0;
+	return S_OK;
+}
+
+HRESULT __stdcall PS3EyePushPin::GetLatency(REFERENCE_TIME * prtLatency)
+{
+	CheckPointer(prtLatency, E_POINTER);
+	CAutoLock lock(&_statsLock);
+	*prtLatency = _latency;
+	return S_OK;
+}
+
+HRESULT __stdcall PS3EyePushPin::GetPushSourceFlags(ULONG * pFlags)
+{
+	CheckPointer(pFlags, E_POINTER);
+	// Time stamps are stream times on the graph clock, which the graph may slave to our clock
+	*pFlags = 0;
+	return S_OK;
+}
+
+HRESULT __stdcall PS3EyePushPin::SetPushSourceFlags(ULONG Flags)
+{
+	return E_NOTIMPL;
+}
+
+HRESULT __stdcall PS3EyePushPin::SetStreamOffset(REFERENCE_TIME rtOffset)
+{
+	CAutoLock lock(m_pFilter->pStateLock());
+	_streamOffset = rtOffset;
+	return S_OK;
+}
+
+HRESULT __stdcall PS3EyePushPin::GetStreamOffset(REFERENCE_TIME * prtOffset)
+{
+	CheckPointer(prtOffset, E_POINTER);
+	CAutoLock lock(m_pFilter->pStateLock());
+	*prtOffset = _streamOffset;
+	return S_OK;
+}
+
+HRESULT __stdcall PS3EyePushPin::GetMaxStreamOffset(REFERENCE_TIME * prtMaxOffset)
+{
+	CheckPointer(prtMaxOffset, E_POINTER);
+	CAutoLock lock(m_pFilter->pStateLock());
+	*prtMaxOffset = _maxStreamOffset;
+	return S_OK;
+}
+
+HRESULT __stdcall PS3EyePushPin::SetMaxStreamOffset(REFERENCE_TIME rtMaxOffset)
+{
+	CAutoLock lock(m_pFilter->pStateLock());
+	_maxStreamOffset = rtMaxOffset;
+	return S_OK;
+}
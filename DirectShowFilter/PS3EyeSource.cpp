@@ -4,19 +4,22 @@
 #include "ps3eye.h"
 #include "PS3EyeSourceFilter.h"
 #include "PS3EyeGuids.h"
+#include "PS3EyeCameraClock.h"
 
 PS3EyeSource::PS3EyeSource(IUnknown *pUnk, HRESULT *phr) 
 	: CSource(NAME("PS3EyeSource"), pUnk, CLSID_PS3EyeSource),
-	_pin(NULL)
+	_pin(NULL),
+	_clock(NULL)
 {
 	const std::vector<ps3eye::PS3EYECam::PS3EYERef> &devices = ps3eye::PS3EYECam::getDevices(true);
 	ps3eye::PS3EYECam::PS3EYERef dev;
 	if (devices.size() > 0) {
 		dev = devices[0];
 	}
-	_pin = new PS3EyePushPin(phr, this, dev);
+	_clock = new PS3EyeCameraClock(GetOwner(), phr);
+	_pin = new PS3EyePushPin(phr, this, dev, _clock);
 	if (phr) {
-		if (_pin == NULL)
+		if (_pin == NULL || _clock == NULL)
 			*phr = E_OUTOFMEMORY;
 		else
 			*phr = S_OK;
@@ -25,6 +28,15 @@ PS3EyeSource::PS3EyeSource(IUnknown *pUnk, HRESULT *phr)
 
 PS3EyeSource::~PS3EyeSource() {
 	if(_pin != NULL) delete _pin;
+	if(_clock != NULL) delete _clock;
+}
+
+STDMETHODIMP PS3EyeSource::NonDelegatingQueryInterface(REFIID riid, void **ppv)
+{
+	if (riid == IID_IReferenceClock && _clock != NULL) {
+		return _clock->NonDelegatingQueryInterface(riid, ppv);
+	}
+	return CSource::NonDelegatingQueryInterface(riid, ppv);
 }
 
 CUnknown * WINAPI PS3EyeSource::CreateInstance(IUnknown * pUnk, HRESULT * phr)
@@ -1,21 +1,70 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../MediaFoundationSource/PS3EyeFrameMailbox.h"
+#include "../MediaFoundationSource/PS3EyeFrameReader.h"
+
 // Filter name strings
 #define g_ps3PS3EyeSource    L"PS3 Eye Universal"
 
 class PS3EyePushPin;
+class PS3EyeWorkerPool;
+class PS3EyeCameraClock;
 
-class PS3EyePushPin : public CSourceStream, public IKsPropertySet, public IAMStreamConfig
+class PS3EyePushPin : public CSourceStream, public IKsPropertySet, public IAMStreamConfig, public IAMDroppedFrames, public IAMPushSource
 {
 protected:
 	ps3eye::PS3EYECam::PS3EYERef _device;
 	CMediaType _currentMediaType;
 	HRESULT _GetMediaType(int iPosition, CMediaType *pMediaType);
-	REFERENCE_TIME _startTime;
-	IReferenceClock *_refClock;
+	PS3EyeCameraClock *_clock; // owned by the filter; paced by the frames this pin delivers
+	PS3EyeFrameMailbox _mailbox; // freshest raw frame from the capture thread, converted to RGB32, YUV or grey in FillBuffer
+	PS3EyeFrameSkipper _skipper; // frames downstream asked us to skip through quality messages
+	PS3EyeFrameReader _reader; // calls _device->getFrame, which has no timeout, on a thread of its own
+	std::thread _captureThread; // drains _reader into _mailbox, so frames never queue up while downstream lags
+	std::atomic<bool> _capturing;
+	std::atomic<bool> _live; // _device is streaming; until then FillBuffer delivers _placeholder
+	std::shared_ptr<PS3EyeWorkerPool> _pool; // converts in stripes, shared with every other camera in the process
+	std::vector<BYTE> _placeholder; // blank frame in the output format, delivered while there is no camera
+	LONGLONG _nextPlaceholder; // QPC time the next placeholder is due
+	std::atomic<LONGLONG> _lastCameraFrame; // QPC time the capture thread last got a frame, or opened the camera
+	static const int PLACEHOLDER_AFTER_PERIODS = 4; // frame periods without a camera frame before the placeholder stands in
+	static const int HOTPLUG_POLL_MS = 1000; // how often the capture thread looks for a camera
+	static const DWORD CAPTURE_WAIT_MS = 100; // longest the capture thread waits on _reader before checking _capturing
+	// Opens _device, or the first camera that inits if there was none, and starts it streaming
+	bool OpenDevice(uint32_t width, uint32_t height, uint32_t fps);
+	// Stops _reader, then _device once nothing is in getFrame; a camera that sends nothing
+	// for timeoutMs is left to the reader instead, and OpenDevice fails until it lets go
+	void StopDevice(DWORD timeoutMs);
+	void CaptureLoop(uint32_t width, uint32_t height, uint32_t fps);
+	// Converts a raw frame to the output format
+	void ConvertFrame(const BYTE *raw, BYTE *pData);
+	// Waits for the next frame to deliver: S_OK with a camera frame, S_FALSE with the
+	// placeholder while no camera is streaming or the one streaming has gone quiet,
+	// E_ABORT as soon as the streaming thread has a command waiting (the graph stopping)
+	HRESULT NextFrame(PS3EyeFrameMailbox::Frame *latest);
+
+	// Delivery statistics for IAMDroppedFrames and IAMPushSource, written by the streaming
+	// thread and read by the application under _statsLock
+	static const int DROPPED_HISTORY = 64;
+	CCritSec _statsLock;
+	long _framesDelivered;
+	long _framesDropped; // frames the camera counted that never reached a sample
+	LONGLONG _bytesDelivered;
+	uint64_t _lastFrame; // camera frame number of the last sample
+	long _droppedHistory[DROPPED_HISTORY]; // frame numbers of the most recent drops, a ring
+	REFERENCE_TIME _latency; // capture to delivery, smoothed
+	REFERENCE_TIME _streamOffset;
+	REFERENCE_TIME _maxStreamOffset;
+	void ResetStats(REFERENCE_TIME latency);
+	void RecordFrame(uint64_t frame, long size, REFERENCE_TIME latency);
 
 public:
-	PS3EyePushPin(HRESULT *phr, CSource *pFilter, ps3eye::PS3EYECam::PS3EYERef device);
+	PS3EyePushPin(HRESULT *phr, CSource *pFilter, ps3eye::PS3EYECam::PS3EYERef device, PS3EyeCameraClock *clock);
 	~PS3EyePushPin();
 
 	DECLARE_IUNKNOWN
@@ -29,6 +78,12 @@ public:
 		else if (riid == IID_IAMStreamConfig) {
 			return GetInterface((IAMStreamConfig*)this, ppv);
 		}
+		else if (riid == IID_IAMDroppedFrames) {
+			return GetInterface((IAMDroppedFrames*)this, ppv);
+		}
+		else if (riid == IID_IAMPushSource || riid == IID_IAMLatency) {
+			return GetInterface((IAMPushSource*)this, ppv);
+		}
 		return CSourceStream::NonDelegatingQueryInterface(riid, ppv);
 	}
 
@@ -36,19 +91,21 @@ public:
 	HRESULT GetMediaType(int iPosition, CMediaType *pMediaType);
 	HRESULT DecideBufferSize(IMemAllocator *pAlloc, ALLOCATOR_PROPERTIES *pRequest);
 	
-	HRESULT OnThreadStartPlay();
 	HRESULT OnThreadCreate();
 	HRESULT OnThreadDestroy();
 	HRESULT FillBuffer(IMediaSample *pSample);
 	void FillError(BYTE *pData);
 
 	// Quality control
-	// Not implemented because we aren't going in real time.
-	// If the file-writing filter slows the graph down, we just do nothing, which means
-	// wait until we're unblocked. No frames are ever dropped.
+	// Latency stays bounded without it: while downstream blocks us the capture thread
+	// keeps replacing the waiting frame, so the next sample is always the freshest one.
+	// A late renderer gets the frames it is behind by skipped, and a flooded one every
+	// frame it cannot keep up with. Skipped frames show up in IAMDroppedFrames, and the
+	// sample after them is a discontinuity.
 	STDMETHODIMP Notify(IBaseFilter *pSelf, Quality q)
 	{
-		return E_FAIL;
+		_skipper.Notify(q.Late, (uint32_t)max(q.Proportion, 0L));
+		return S_OK;
 	}
 
 
@@ -69,6 +126,37 @@ public:
 
 	virtual HRESULT __stdcall GetStreamCaps(int iIndex, AM_MEDIA_TYPE ** ppmt, BYTE * pSCC) override;
 
+
+	// Inherited via IAMDroppedFrames
+	// A frame counts as dropped when the camera's frame count skips it: lost on USB, or
+	// overwritten in the driver while downstream held every sample
+	virtual HRESULT __stdcall GetNumDropped(long * plDropped) override;
+
+	virtual HRESULT __stdcall GetNumNotDropped(long * plNotDropped) override;
+
+	virtual HRESULT __stdcall GetDroppedInfo(long lSize, long * plArray, long * plNumCopied) override;
+
+	virtual HRESULT __stdcall GetAverageFrameSize(long * plAverageSize) override;
+
+
+	// Inherited via IAMLatency
+	// Measured from the sensor finishing a frame to the sample leaving FillBuffer
+	virtual HRESULT __stdcall GetLatency(REFERENCE_TIME * prtLatency) override;
+
+
+	// Inherited via IAMPushSource
+	virtual HRESULT __stdcall GetPushSourceFlags(ULONG * pFlags) override;
+
+	virtual HRESULT __stdcall SetPushSourceFlags(ULONG Flags) override;
+
+	virtual HRESULT __stdcall SetStreamOffset(REFERENCE_TIME rtOffset) override;
+
+	virtual HRESULT __stdcall GetStreamOffset(REFERENCE_TIME * prtOffset) override;
+
+	virtual HRESULT __stdcall GetMaxStreamOffset(REFERENCE_TIME * prtMaxOffset) override;
+
+	virtual HRESULT __stdcall SetMaxStreamOffset(REFERENCE_TIME rtMaxOffset) override;
+
 };
 
 class PS3EyeSource : public CSource
@@ -78,7 +166,11 @@ private:
 	~PS3EyeSource();
 
 	PS3EyePushPin *_pin;
+	PS3EyeCameraClock *_clock;
 
 public:
 	static CUnknown * WINAPI CreateInstance(IUnknown *pUnk, HRESULT *phr);
+
+	// Offers the camera clock, so the graph can run at the camera's pace
+	STDMETHODIMP NonDelegatingQueryInterface(REFIID riid, void **ppv);
 };
\ No newline at end of file
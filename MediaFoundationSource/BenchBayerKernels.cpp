@@ -0,0 +1,227 @@
+// BenchBayerKernels.cpp - Per-frame cost of each Bayer kernel
+// Converts a random raw frame at 640x480 and 320x240 to every output format
+// (RGB layouts, NV12, I420, YUY2 and grey, plus BGR and grey binned to half
+// size, marked /2) with each kernel the CPU supports and reports the median
+// ns per frame and the speedup over the scalar reference. Then, with the
+// best kernel, compares the fused flip and mirror against the old path of
+// demosaicing to a scratch frame and flipping and mirroring it in separate
+// passes.
+//   g++ -std=c++14 -O2 -c -mavx2 PS3EyeBayerAVX2.cpp
+//   g++ -std=c++14 -O2 BenchBayerKernels.cpp PS3EyeBayer.cpp
+//      PS3EyeBayerSSE2.cpp PS3EyeBayerNEON.cpp PS3EyeBayerAVX2.o
+//      -o BenchBayerKernels
+//   cl /EHsc /O2 BenchBayerKernels.cpp PS3EyeBayer.cpp PS3EyeBayerSSE2.cpp
+//      PS3EyeBayerNEON.cpp PS3EyeBayerAVX2.cpp
+//   (compile PS3EyeBayerAVX2.cpp with /arch:AVX2, e.g. as a separate /c step)
+// Usage: BenchBayerKernels [iterations=200]
+
+#include "PS3EyeBayer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const PS3EyeBayerFormat FORMATS[] = {
+    PS3EyeBayerFormat::RGB, PS3EyeBayerFormat::BGR, PS3EyeBayerFormat::RGBA,
+    PS3EyeBayerFormat::BGRA};
+static const char *FORMAT_NAMES[] = {"RGB", "BGR", "RGBA", "BGRA"};
+
+static const PS3EyeSimd KERNELS[] = {PS3EyeSimd::Scalar, PS3EyeSimd::SSE2,
+                                     PS3EyeSimd::AVX2, PS3EyeSimd::NEON};
+
+// Median ns per call of convert
+template <class Convert>
+static double Measure(Convert convert, int iterations) {
+  std::vector<double> samples;
+  samples.reserve(iterations);
+  for (int i = 0; i < iterations; i++) {
+    auto start = Clock::now();
+    convert();
+    auto end = Clock::now();
+    samples.push_back(
+        std::chrono::duration<double, std::nano>(end - start).count());
+  }
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+static double Measure(PS3EyeSimd simd, const PS3EyeBayerJob &job,
+                      int iterations) {
+  return Measure([&] { PS3EyeDemosaicRows(simd, job, 0, job.height); },
+                 iterations);
+}
+
+// Demosaic into scratch, then a row pass for the flip and a pixel pass for
+// the mirror
+static void MultiPass(const PS3EyeBayerJob &job, std::vector<uint8_t> *scratch,
+                      std::vector<uint8_t> *flipped) {
+  const uint32_t bpp = PS3EyeBayerBytesPerPixel(job.format);
+  PS3EyeBayerJob plain = job;
+  plain.dst = scratch->data();
+  plain.flipVertical = plain.mirror = false;
+  PS3EyeDemosaic(plain);
+
+  const uint8_t *src = scratch->data();
+  if (job.flipVertical) {
+    for (uint32_t y = 0; y < job.height; y++) {
+      memcpy(flipped->data() + static_cast<size_t>(y) * job.dstStride,
+             scratch->data() +
+                 static_cast<size_t>(job.height - 1 - y) * job.dstStride,
+             job.width * bpp);
+    }
+    src = flipped->data();
+  }
+
+  for (uint32_t y = 0; y < job.height; y++) {
+    const uint8_t *in = src + static_cast<size_t>(y) * job.dstStride;
+    uint8_t *out = job.dst + static_cast<size_t>(y) * job.dstStride;
+    if (!job.mirror) {
+      memcpy(out, in, job.width * bpp);
+      continue;
+    }
+    for (uint32_t x = 0; x < job.width; x++)
+      memcpy(out + (job.width - 1 - x) * bpp, in + x * bpp, bpp);
+  }
+}
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 200;
+  if (iterations < 1)
+    iterations = 1;
+
+  printf("Best kernel: %s\n", PS3EyeSimdName(PS3EyeBestSimd()));
+  printf("%-8s %-6s %-7s %12s %8s\n", "size", "fmt", "kernel", "ns/frame",
+         "speedup");
+
+  std::mt19937 rng(1);
+  const uint32_t sizes[][2] = {{640, 480}, {320, 240}};
+  for (const auto &size : sizes) {
+    const uint32_t width = size[0], height = size[1];
+    std::vector<uint8_t> bayer(static_cast<size_t>(width) * height);
+    for (uint8_t &byte : bayer)
+      byte = static_cast<uint8_t>(rng());
+    std::vector<uint8_t> dst(static_cast<size_t>(width) * height * 4);
+
+    for (size_t f = 0; f < sizeof(FORMATS) / sizeof(FORMATS[0]); f++) {
+      PS3EyeBayerJob job = {bayer.data(), width,  dst.data(),
+                            width * PS3EyeBayerBytesPerPixel(FORMATS[f]),
+                            width,        height, FORMATS[f],
+                            false,        false};
+      double scalar = 0;
+      for (PS3EyeSimd simd : KERNELS) {
+        if (!PS3EyeSimdSupported(simd))
+          continue;
+        Measure(simd, job, 5); // warm up
+        double ns = Measure(simd, job, iterations);
+        if (simd == PS3EyeSimd::Scalar)
+          scalar = ns;
+        char name[16];
+        snprintf(name, sizeof(name), "%ux%u", width, height);
+        printf("%-8s %-6s %-7s %12.0f %7.1fx\n", name, FORMAT_NAMES[f],
+               PS3EyeSimdName(simd), ns, scalar / ns);
+      }
+    }
+
+    const PS3EyeYuvFormat yuvFormats[] = {
+        PS3EyeYuvFormat::NV12, PS3EyeYuvFormat::I420, PS3EyeYuvFormat::YUY2};
+    const char *yuvNames[] = {"NV12", "I420", "YUY2"};
+    for (int f = 0; f < 3; f++) {
+      const PS3EyeYuvJob job = PS3EyeYuvFrameJob(bayer.data(), width,
+                                                 dst.data(), width, height,
+                                                 yuvFormats[f]);
+      double scalar = 0;
+      for (PS3EyeSimd simd : KERNELS) {
+        if (!PS3EyeSimdSupported(simd))
+          continue;
+        auto convert = [&] { PS3EyeDemosaicYuvRows(simd, job, 0, height); };
+        Measure(convert, 5); // warm up
+        double ns = Measure(convert, iterations);
+        if (simd == PS3EyeSimd::Scalar)
+          scalar = ns;
+        char name[16];
+        snprintf(name, sizeof(name), "%ux%u", width, height);
+        printf("%-8s %-6s %-7s %12.0f %7.1fx\n", name, yuvNames[f],
+               PS3EyeSimdName(simd), ns, scalar / ns);
+      }
+    }
+
+    const PS3EyeGreyJob greyJob = {bayer.data(), width, dst.data(),
+                                   width,        width, height};
+    double scalar = 0;
+    for (PS3EyeSimd simd : KERNELS) {
+      if (!PS3EyeSimdSupported(simd))
+        continue;
+      auto convert = [&] { PS3EyeBayerToGreyRows(simd, greyJob, 0, height); };
+      Measure(convert, 5); // warm up
+      double ns = Measure(convert, iterations);
+      if (simd == PS3EyeSimd::Scalar)
+        scalar = ns;
+      char name[16];
+      snprintf(name, sizeof(name), "%ux%u", width, height);
+      printf("%-8s %-6s %-7s %12.0f %7.1fx\n", name, "Y800",
+             PS3EyeSimdName(simd), ns, scalar / ns);
+    }
+
+    const PS3EyeBayerJob binJob = {bayer.data(),  width, dst.data(),
+                                   width / 2 * 3, width, height,
+                                   PS3EyeBayerFormat::BGR, false, false};
+    for (int grey = 0; grey < 2; grey++) {
+      for (PS3EyeSimd simd : KERNELS) {
+        if (!PS3EyeSimdSupported(simd))
+          continue;
+        auto convert = [&] {
+          if (grey)
+            PS3EyeBinGreyRows(simd, greyJob, 0, height / 2);
+          else
+            PS3EyeBinRows(simd, binJob, 0, height / 2);
+        };
+        Measure(convert, 5); // warm up
+        double ns = Measure(convert, iterations);
+        if (simd == PS3EyeSimd::Scalar)
+          scalar = ns;
+        char name[16];
+        snprintf(name, sizeof(name), "%ux%u", width, height);
+        printf("%-8s %-6s %-7s %12.0f %7.1fx\n", name,
+               grey ? "Y800/2" : "BGR/2", PS3EyeSimdName(simd), ns,
+               scalar / ns);
+      }
+    }
+  }
+
+  printf("\nFused vs separate flip/mirror passes (%s, 640x480)\n",
+         PS3EyeSimdName(PS3EyeBestSimd()));
+  printf("%-5s %-12s %12s %12s %8s\n", "fmt", "orientation", "multi-pass",
+         "fused", "speedup");
+  const uint32_t width = 640, height = 480;
+  std::vector<uint8_t> bayer(static_cast<size_t>(width) * height);
+  for (uint8_t &byte : bayer)
+    byte = static_cast<uint8_t>(rng());
+  std::vector<uint8_t> dst(static_cast<size_t>(width) * height * 4);
+  std::vector<uint8_t> scratch(dst.size()), flipped(dst.size());
+  const bool orientations[][2] = {{true, false}, {true, true}};
+  const char *orientationNames[] = {"flip", "flip+mirror"};
+  for (size_t f = 0; f < sizeof(FORMATS) / sizeof(FORMATS[0]); f++) {
+    for (size_t o = 0; o < 2; o++) {
+      PS3EyeBayerJob job = {
+          bayer.data(), width,  dst.data(),
+          width * PS3EyeBayerBytesPerPixel(FORMATS[f]),
+          width,        height, FORMATS[f],
+          orientations[o][0],   orientations[o][1]};
+      auto multiPass = [&] { MultiPass(job, &scratch, &flipped); };
+      auto fused = [&] { PS3EyeDemosaic(job); };
+      Measure(multiPass, 5);
+      Measure(fused, 5);
+      double multiNs = Measure(multiPass, iterations);
+      double fusedNs = Measure(fused, iterations);
+      printf("%-5s %-12s %12.0f %12.0f %7.1fx\n", FORMAT_NAMES[f],
+             orientationNames[o], multiNs, fusedNs, multiNs / fusedNs);
+    }
+  }
+  return 0;
+}
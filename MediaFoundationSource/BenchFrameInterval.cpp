@@ -0,0 +1,357 @@
+// BenchFrameInterval.cpp - End-to-end frame rate of the PS3 Eye DirectShow
+// source in every mode it advertises. For each capability of the output pin
+// (IAMStreamConfig) at or above a minimum rate, it builds source -> Sample
+// Grabber -> Null Renderer with no reference clock, so nothing downstream
+// paces the stream, selects the mode with SetFormat, runs for a few seconds
+// and records when each sample reaches the grabber. Reports the rate
+// delivered against the nominal one, the median, 99th percentile and worst
+// interval between samples, and samples that came more than 1.5 intervals
+// after the previous one (a frame lost on the way). A mode fails if it
+// delivers less than 97% of its rate; the exit code is the number of failed
+// modes. Needs a camera and the filter registered (regsvr32).
+//   cl /EHsc /O2 BenchFrameInterval.cpp
+// Usage: BenchFrameInterval [seconds=5] [subtype=Y800] [minFps=60]
+//   subtype: NV12, I420, YUY2, RGB32, Y800 or GRBG; minFps 0 runs every mode
+
+#include <dshow.h>
+#include <windows.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#pragma comment(lib, "strmiids.lib")
+#pragma comment(lib, "ole32.lib")
+
+// {b9acdae7-cee5-4394-b10d-38edb00cdb54}, DirectShowFilter/PS3EyeGuids.h
+static const GUID CLSID_PS3EyeSource = {
+    0xb9acdae7,
+    0xcee5,
+    0x4394,
+    {0xb1, 0x0d, 0x38, 0xed, 0xb0, 0x0c, 0xdb, 0x54}};
+
+// Sample Grabber and Null Renderer (qedit.dll). qedit.h is no longer in the
+// Windows SDK, so the two interfaces used are declared here.
+static const GUID CLSID_SampleGrabberFilter = {
+    0xc1f400a0,
+    0x3f08,
+    0x11d3,
+    {0x9f, 0x0b, 0x00, 0x60, 0x08, 0x03, 0x9e, 0x37}};
+static const GUID CLSID_NullRendererFilter = {
+    0xc1f400a4,
+    0x3f08,
+    0x11d3,
+    {0x9f, 0x0b, 0x00, 0x60, 0x08, 0x03, 0x9e, 0x37}};
+static const GUID IID_ISampleGrabberCB = {
+    0x0579154a,
+    0x2b53,
+    0x4994,
+    {0xb0, 0xd0, 0xe7, 0x73, 0x14, 0x8e, 0xff, 0x85}};
+static const GUID IID_ISampleGrabber = {
+    0x6b652fff,
+    0x11fe,
+    0x4fce,
+    {0x92, 0xad, 0x02, 0x66, 0xb5, 0xd7, 0xc7, 0x8f}};
+
+struct ISampleGrabberCB : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE SampleCB(double time,
+                                             IMediaSample *sample) = 0;
+  virtual HRESULT STDMETHODCALLTYPE BufferCB(double time, BYTE *buffer,
+                                             long length) = 0;
+};
+
+struct ISampleGrabber : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE SetOneShot(BOOL oneShot) = 0;
+  virtual HRESULT STDMETHODCALLTYPE
+  SetMediaType(const AM_MEDIA_TYPE *type) = 0;
+  virtual HRESULT STDMETHODCALLTYPE
+  GetConnectedMediaType(AM_MEDIA_TYPE *type) = 0;
+  virtual HRESULT STDMETHODCALLTYPE SetBufferSamples(BOOL buffer) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetCurrentBuffer(long *size,
+                                                     long *buffer) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetCurrentSample(IMediaSample **sample) = 0;
+  virtual HRESULT STDMETHODCALLTYPE SetCallback(ISampleGrabberCB *callback,
+                                                long whichMethod) = 0;
+};
+
+static const struct {
+  const char *name;
+  DWORD compression;
+} SUBTYPES[] = {
+    {"NV12", MAKEFOURCC('N', 'V', '1', '2')},
+    {"I420", MAKEFOURCC('I', '4', '2', '0')},
+    {"YUY2", MAKEFOURCC('Y', 'U', 'Y', '2')},
+    {"RGB32", BI_RGB},
+    {"Y800", MAKEFOURCC('Y', '8', '0', '0')},
+    {"GRBG", MAKEFOURCC('G', 'R', 'B', 'G')},
+};
+
+// Arrival time of every sample, on the streaming thread; read once stopped
+class ArrivalRecorder : public ISampleGrabberCB {
+public:
+  explicit ArrivalRecorder(size_t capacity) { m_arrivals.reserve(capacity); }
+
+  STDMETHODIMP_(ULONG) AddRef() override { return 2; }
+  STDMETHODIMP_(ULONG) Release() override { return 1; }
+  STDMETHODIMP QueryInterface(REFIID riid, void **ppv) override {
+    if (riid == IID_IUnknown || riid == IID_ISampleGrabberCB) {
+      *ppv = static_cast<ISampleGrabberCB *>(this);
+      return S_OK;
+    }
+    *ppv = NULL;
+    return E_NOINTERFACE;
+  }
+
+  STDMETHODIMP SampleCB(double, IMediaSample *) override {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    if (m_arrivals.size() < m_arrivals.capacity())
+      m_arrivals.push_back(now.QuadPart);
+    return S_OK;
+  }
+  STDMETHODIMP BufferCB(double, BYTE *, long) override { return S_OK; }
+
+  const std::vector<LONGLONG> &Arrivals() const { return m_arrivals; }
+
+private:
+  std::vector<LONGLONG> m_arrivals; // QueryPerformanceCounter ticks
+};
+
+static IPin *FindPin(IBaseFilter *filter, PIN_DIRECTION direction) {
+  IEnumPins *pins = NULL;
+  if (FAILED(filter->EnumPins(&pins)))
+    return NULL;
+  IPin *pin = NULL;
+  while (pins->Next(1, &pin, NULL) == S_OK) {
+    PIN_DIRECTION pinDirection;
+    pin->QueryDirection(&pinDirection);
+    if (pinDirection == direction)
+      break;
+    pin->Release();
+    pin = NULL;
+  }
+  pins->Release();
+  return pin;
+}
+
+static void FreeMediaType(AM_MEDIA_TYPE *type) {
+  if (type->cbFormat)
+    CoTaskMemFree(type->pbFormat);
+  if (type->pUnk)
+    type->pUnk->Release();
+  CoTaskMemFree(type);
+}
+
+struct ModeResult {
+  bool ran = false;
+  double fps = 0;      // Delivered
+  double median = 0;   // Intervals, ms
+  double p99 = 0;
+  double worst = 0;
+  size_t late = 0;     // Intervals over 1.5x nominal
+  size_t samples = 0;
+};
+
+// Streams one capability of a fresh source for the given time
+static ModeResult RunMode(int capability, double seconds, double nominalFps) {
+  ModeResult result;
+  IGraphBuilder *graph = NULL;
+  IBaseFilter *source = NULL, *grabber = NULL, *renderer = NULL;
+  CoCreateInstance(CLSID_FilterGraph, NULL, CLSCTX_INPROC_SERVER,
+                   IID_IGraphBuilder, (void **)&graph);
+  CoCreateInstance(CLSID_PS3EyeSource, NULL, CLSCTX_INPROC_SERVER,
+                   IID_IBaseFilter, (void **)&source);
+  CoCreateInstance(CLSID_SampleGrabberFilter, NULL, CLSCTX_INPROC_SERVER,
+                   IID_IBaseFilter, (void **)&grabber);
+  CoCreateInstance(CLSID_NullRendererFilter, NULL, CLSCTX_INPROC_SERVER,
+                   IID_IBaseFilter, (void **)&renderer);
+  if (!graph || !source || !grabber || !renderer) {
+    printf("cannot create the graph (filter registered? qedit.dll?)\n");
+    if (graph)
+      graph->Release();
+    if (source)
+      source->Release();
+    if (grabber)
+      grabber->Release();
+    if (renderer)
+      renderer->Release();
+    return result;
+  }
+  graph->AddFilter(source, L"PS3 Eye");
+  graph->AddFilter(grabber, L"Grabber");
+  graph->AddFilter(renderer, L"Null");
+
+  // Room for twice the nominal sample count; more would be a bug of its own
+  ArrivalRecorder recorder(static_cast<size_t>(seconds * nominalFps * 2) + 16);
+  ISampleGrabber *sampleGrabber = NULL;
+  grabber->QueryInterface(IID_ISampleGrabber, (void **)&sampleGrabber);
+  sampleGrabber->SetBufferSamples(FALSE);
+  sampleGrabber->SetCallback(&recorder, 0);
+
+  IPin *sourceOut = FindPin(source, PINDIR_OUTPUT);
+  IPin *grabberIn = FindPin(grabber, PINDIR_INPUT);
+  IPin *grabberOut = FindPin(grabber, PINDIR_OUTPUT);
+  IPin *rendererIn = FindPin(renderer, PINDIR_INPUT);
+
+  IAMStreamConfig *config = NULL;
+  sourceOut->QueryInterface(IID_IAMStreamConfig, (void **)&config);
+  AM_MEDIA_TYPE *type = NULL;
+  VIDEO_STREAM_CONFIG_CAPS caps;
+  HRESULT hr = config->GetStreamCaps(capability, &type, (BYTE *)&caps);
+  if (SUCCEEDED(hr)) {
+    hr = config->SetFormat(type);
+    FreeMediaType(type);
+  }
+  if (SUCCEEDED(hr))
+    hr = graph->ConnectDirect(sourceOut, grabberIn, NULL);
+  if (SUCCEEDED(hr))
+    hr = graph->ConnectDirect(grabberOut, rendererIn, NULL);
+
+  // No reference clock: the renderer passes every sample on arrival
+  IMediaFilter *mediaFilter = NULL;
+  graph->QueryInterface(IID_IMediaFilter, (void **)&mediaFilter);
+  if (SUCCEEDED(hr))
+    hr = mediaFilter->SetSyncSource(NULL);
+
+  IMediaControl *control = NULL;
+  graph->QueryInterface(IID_IMediaControl, (void **)&control);
+  if (SUCCEEDED(hr))
+    hr = control->Run();
+  if (SUCCEEDED(hr)) {
+    Sleep(static_cast<DWORD>(seconds * 1000));
+    control->Stop();
+  } else {
+    printf("cannot run (hr=0x%08X) ", static_cast<unsigned>(hr));
+  }
+
+  control->Release();
+  mediaFilter->Release();
+  config->Release();
+  rendererIn->Release();
+  grabberOut->Release();
+  grabberIn->Release();
+  sourceOut->Release();
+  sampleGrabber->SetCallback(NULL, 0);
+  sampleGrabber->Release();
+  renderer->Release();
+  grabber->Release();
+  source->Release();
+  graph->Release();
+  if (FAILED(hr))
+    return result;
+
+  // Skip the first half second: the sensor settles and the driver's queue
+  // fills after start
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  const double ticksPerMs = frequency.QuadPart / 1000.0;
+  const std::vector<LONGLONG> &arrivals = recorder.Arrivals();
+  size_t first = 0;
+  while (first < arrivals.size() &&
+         (arrivals[first] - arrivals[0]) / ticksPerMs < 500)
+    first++;
+  result.ran = true;
+  result.samples = arrivals.size();
+  if (arrivals.size() < first + 2)
+    return result;
+
+  std::vector<double> intervals;
+  for (size_t i = first + 1; i < arrivals.size(); i++)
+    intervals.push_back((arrivals[i] - arrivals[i - 1]) / ticksPerMs);
+  const double nominalMs = 1000.0 / nominalFps;
+  for (double interval : intervals) {
+    if (interval > 1.5 * nominalMs)
+      result.late++;
+  }
+  const double spanMs = (arrivals.back() - arrivals[first]) / ticksPerMs;
+  result.fps = intervals.size() * 1000.0 / spanMs;
+  std::sort(intervals.begin(), intervals.end());
+  result.median = intervals[intervals.size() / 2];
+  result.p99 = intervals[intervals.size() * 99 / 100];
+  result.worst = intervals.back();
+  return result;
+}
+
+int main(int argc, char **argv) {
+  const double seconds = argc > 1 ? atof(argv[1]) : 5;
+  const char *subtypeName = argc > 2 ? argv[2] : "Y800";
+  const double minFps = argc > 3 ? atof(argv[3]) : 60;
+  DWORD compression = 0;
+  bool known = false;
+  for (const auto &subtype : SUBTYPES) {
+    if (_stricmp(subtype.name, subtypeName) == 0) {
+      compression = subtype.compression;
+      known = true;
+    }
+  }
+  if (!known || seconds < 1) {
+    printf("Usage: BenchFrameInterval [seconds=5] "
+           "[NV12|I420|YUY2|RGB32|Y800|GRBG] [minFps=60]\n");
+    return 1;
+  }
+
+  if (FAILED(CoInitializeEx(NULL, COINIT_MULTITHREADED))) {
+    printf("CoInitialize failed\n");
+    return 1;
+  }
+
+  // The capabilities, from a source that is released before any mode runs
+  IBaseFilter *source = NULL;
+  HRESULT hr = CoCreateInstance(CLSID_PS3EyeSource, NULL,
+                                CLSCTX_INPROC_SERVER, IID_IBaseFilter,
+                                (void **)&source);
+  if (FAILED(hr)) {
+    printf("Cannot create the PS3 Eye source (hr=0x%08X); registered?\n",
+           static_cast<unsigned>(hr));
+    CoUninitialize();
+    return 1;
+  }
+  IPin *out = FindPin(source, PINDIR_OUTPUT);
+  IAMStreamConfig *config = NULL;
+  out->QueryInterface(IID_IAMStreamConfig, (void **)&config);
+  int count = 0, size = 0;
+  config->GetNumberOfCapabilities(&count, &size);
+
+  struct Mode {
+    int capability;
+    LONG width, height;
+    double fps;
+  };
+  std::vector<Mode> modes;
+  for (int i = 0; i < count; i++) {
+    AM_MEDIA_TYPE *type = NULL;
+    VIDEO_STREAM_CONFIG_CAPS caps;
+    if (FAILED(config->GetStreamCaps(i, &type, (BYTE *)&caps)))
+      continue;
+    const VIDEOINFOHEADER *vih = (const VIDEOINFOHEADER *)type->pbFormat;
+    const double fps = 10000000.0 / vih->AvgTimePerFrame;
+    if (vih->bmiHeader.biCompression == compression && fps >= minFps)
+      modes.push_back({i, vih->bmiHeader.biWidth, vih->bmiHeader.biHeight,
+                       fps});
+    FreeMediaType(type);
+  }
+  config->Release();
+  out->Release();
+  source->Release();
+
+  printf("%d capabilities, %zu %s modes at %.0f fps or more, %.0f s each\n",
+         count, modes.size(), subtypeName, minFps, seconds);
+  printf("%-8s %7s %9s %8s %8s %8s %6s %s\n", "size", "nominal", "delivered",
+         "median", "p99", "worst", "late", "result");
+  int failed = 0;
+  for (const Mode &mode : modes) {
+    ModeResult result = RunMode(mode.capability, seconds, mode.fps);
+    char name[16];
+    sprintf_s(name, "%ldx%ld", mode.width, mode.height);
+    const bool pass = result.ran && result.fps >= 0.97 * mode.fps;
+    failed += pass ? 0 : 1;
+    printf("%-8s %7.1f %9.1f %8.2f %8.2f %8.2f %6zu %s\n", name, mode.fps,
+           result.fps, result.median, result.p99, result.worst, result.late,
+           pass ? "PASS" : "FAIL");
+  }
+
+  CoUninitialize();
+  return failed;
+}
@@ -0,0 +1,164 @@
+// BenchFrameJitter.cpp - Jitter histogram of the frame timestamps a channel
+// publishes. Reads every frame of a channel for a while and bins how far each
+// frame interval is from whole frame periods, for the arrival times the
+// backend stamped (metadata.arrivalTime) and for the capture times clients
+// stamp their samples with (the frame timestamp, fitted by the cadence).
+// The capture times should sit within a few microseconds of the period;
+// the arrival column shows the scheduling jitter taken out of them.
+//   g++ -std=c++17 -O2 -pthread BenchFrameJitter.cpp PS3EyeCaptureChannel.cpp
+//      PS3EyeFrameCadence.cpp PS3EyeSyntheticCamera.cpp
+//      PS3EyeSharedMemory.cpp PS3EyeChannelDirectory.cpp PS3EyeIpcPosix.cpp
+//      -lrt -o BenchFrameJitter
+//   cl /EHsc /O2 /std:c++17 BenchFrameJitter.cpp PS3EyeCaptureChannel.cpp
+//      PS3EyeFrameCadence.cpp PS3EyeSyntheticCamera.cpp
+//      PS3EyeSharedMemory.cpp PS3EyeChannelDirectory.cpp PS3EyeIpcWin32.cpp
+//      advapi32.lib
+// Usage: BenchFrameJitter [seconds=10] [fps=30] [channel=synthetic]
+//                         [jitterUs=0]
+// channel is a device id served by the capture service, "default" for the
+// default channel, or "synthetic" for an in-process synthetic camera, whose
+// frames are then handed over up to jitterUs late.
+
+#include "PS3EyeCaptureChannel.h"
+#include "PS3EyeSharedMemory.h"
+#include "PS3EyeSyntheticCamera.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Upper bounds of the histogram bins, us; the last bin takes the rest
+static const double BIN_LIMITS[] = {5, 10, 25, 50, 100, 250, 500, 1000, 2000,
+                                    5000};
+static const size_t BIN_COUNT = sizeof(BIN_LIMITS) / sizeof(BIN_LIMITS[0]) + 1;
+
+struct JitterStats {
+  std::vector<double> errors; // |interval - periods * nominal|, us
+  uint64_t bins[BIN_COUNT] = {};
+
+  void Add(double error) {
+    error = error < 0 ? -error : error;
+    errors.push_back(error);
+    size_t bin = 0;
+    while (bin < BIN_COUNT - 1 && error >= BIN_LIMITS[bin])
+      bin++;
+    bins[bin]++;
+  }
+
+  double Percentile(double p) {
+    if (errors.empty())
+      return 0;
+    std::sort(errors.begin(), errors.end());
+    return errors[std::min(errors.size() - 1,
+                           static_cast<size_t>(errors.size() * p))];
+  }
+};
+
+int main(int argc, char *argv[]) {
+  const int durationSecs = argc > 1 ? atoi(argv[1]) : 10;
+  const uint32_t fps = argc > 2 ? atoi(argv[2]) : 30;
+  const char *channelName = argc > 3 ? argv[3] : "synthetic";
+  const uint32_t jitterUs = argc > 4 ? atoi(argv[4]) : 0;
+  if (durationSecs <= 0 || fps == 0) {
+    printf("Usage: BenchFrameJitter [seconds=10] [fps=30] "
+           "[channel=synthetic] [jitterUs=0]\n");
+    return 1;
+  }
+  const double period = 1e7 / fps; // 100ns
+
+  std::unique_ptr<PS3EyeCaptureChannel> channel;
+  PS3EyeSharedMemoryClient client;
+  bool connected;
+  if (strcmp(channelName, "synthetic") == 0) {
+    std::unique_ptr<PS3EyeSyntheticCamera> camera(
+        new PS3EyeSyntheticCamera("synthetic-jitter"));
+    PS3EyeSyntheticProfile profile;
+    profile.jitterUs = jitterUs;
+    camera->SetProfile(profile);
+    channel.reset(
+        new PS3EyeCaptureChannel(std::move(camera), "PS3EyeJitterBench"));
+    PS3EyeCaptureOptions options;
+    options.fps = fps;
+    if (!channel->Start(options)) {
+      printf("Failed to start synthetic channel\n");
+      return 1;
+    }
+    connected = client.Connect("PS3EyeJitterBench");
+  } else if (strcmp(channelName, "default") == 0) {
+    connected = client.Connect();
+  } else {
+    connected = client.ConnectDevice(channelName);
+  }
+  if (!connected) {
+    printf("Failed to connect to channel %s\n", channelName);
+    return 1;
+  }
+
+  printf("Frame jitter: %s at %u fps for %d s\n", channelName, fps,
+         durationSecs);
+
+  JitterStats arrival, capture;
+  uint64_t frames = 0, dropped = 0;
+  uint64_t lastArrival = 0, lastCapture = 0;
+  const uint64_t end = PS3EyeTransportTime() + durationSecs * 10000000ULL;
+  while (PS3EyeTransportTime() < end) {
+    if (!client.WaitForFrame(100))
+      continue;
+    PS3EyeFrameView frame;
+    if (!client.AcquireFrame(&frame))
+      continue;
+    const uint64_t arrivalTime = frame.metadata.arrivalTime;
+    const uint64_t captureTime = frame.timestamp;
+    const uint32_t lost = frame.metadata.droppedFrames;
+    client.ReleaseFrame(&frame);
+
+    // Frames lost in the service are whole periods, not jitter
+    if (frames > 0) {
+      const double expected = (1.0 + lost) * period;
+      const int64_t arrivalInterval =
+          static_cast<int64_t>(arrivalTime - lastArrival);
+      const int64_t captureInterval =
+          static_cast<int64_t>(captureTime - lastCapture);
+      arrival.Add((arrivalInterval - expected) / 10.0);
+      capture.Add((captureInterval - expected) / 10.0);
+      dropped += lost;
+    }
+    lastArrival = arrivalTime;
+    lastCapture = captureTime;
+    frames++;
+  }
+
+  if (channel)
+    channel->Stop();
+  if (frames < 2) {
+    printf("No frames received\n");
+    return 1;
+  }
+
+  printf("%llu frames, %llu lost in the service\n\n",
+         static_cast<unsigned long long>(frames),
+         static_cast<unsigned long long>(dropped));
+  printf("%14s %10s %10s\n", "|error|", "arrival", "capture");
+  for (size_t bin = 0; bin < BIN_COUNT; bin++) {
+    char label[32];
+    if (bin < BIN_COUNT - 1)
+      snprintf(label, sizeof(label), "< %.0f us", BIN_LIMITS[bin]);
+    else
+      snprintf(label, sizeof(label), ">= %.0f us", BIN_LIMITS[bin - 1]);
+    printf("%14s %10llu %10llu\n", label,
+           static_cast<unsigned long long>(arrival.bins[bin]),
+           static_cast<unsigned long long>(capture.bins[bin]));
+  }
+  printf("\n%14s %8.0fus %8.0fus\n", "p50", arrival.Percentile(0.5),
+         capture.Percentile(0.5));
+  printf("%14s %8.0fus %8.0fus\n", "p99", arrival.Percentile(0.99),
+         capture.Percentile(0.99));
+  printf("%14s %8.0fus %8.0fus\n", "max", arrival.Percentile(1.0),
+         capture.Percentile(1.0));
+  return 0;
+}
@@ -0,0 +1,135 @@
+// BenchFrameTransport.cpp - Copy-count / latency benchmark for the frame ring
+// Compares the two ways a consumer can get a frame out of the ring into its
+// own sample buffer (e.g. an IMFMediaBuffer):
+//   copy:    ReadLatest() into a staging buffer, then copy into the sample
+//   acquire: Acquire() the slot, copy once into the sample, Release()
+// Platform-neutral:
+//   g++ -std=c++17 -O2 -pthread BenchFrameTransport.cpp -o BenchFrameTransport
+// Usage: BenchFrameTransport [fps=60] [seconds=5] [frameBytes=921600]
+
+#include "PS3EyeFrameRing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static uint64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+struct Result {
+  uint64_t frames = 0;
+  uint64_t bytesCopied = 0;
+  std::vector<uint64_t> latencyNs; // publish -> frame in sample buffer
+  std::vector<uint64_t> consumeNs; // time spent getting the frame out
+};
+
+static void Report(const char *name, Result &r, uint32_t frameSize) {
+  if (r.frames == 0) {
+    printf("%-8s no frames\n", name);
+    return;
+  }
+  std::sort(r.latencyNs.begin(), r.latencyNs.end());
+  std::sort(r.consumeNs.begin(), r.consumeNs.end());
+  auto pct = [](const std::vector<uint64_t> &v, double p) {
+    return v[std::min(v.size() - 1, static_cast<size_t>(v.size() * p))] /
+           1000.0;
+  };
+  printf("%-8s %6llu frames  %.2f copies/frame  consume p50 %7.1f us  "
+         "latency p50 %7.1f us  p99 %7.1f us\n",
+         name, (unsigned long long)r.frames,
+         static_cast<double>(r.bytesCopied) / r.frames / frameSize,
+         pct(r.consumeNs, 0.5), pct(r.latencyNs, 0.5),
+         pct(r.latencyNs, 0.99));
+}
+
+int main(int argc, char *argv[]) {
+  const int fps = argc > 1 ? atoi(argv[1]) : 60;
+  const int durationSecs = argc > 2 ? atoi(argv[2]) : 5;
+  const uint32_t frameSize =
+      argc > 3 ? static_cast<uint32_t>(atoi(argv[3])) : 640 * 480 * 3;
+
+  const uint32_t dataOffset = static_cast<uint32_t>(
+      PS3EyeAlignUp(sizeof(PS3EyeRingControl), PS3EYE_PAGE_SIZE));
+  const uint64_t totalSize = dataOffset + PS3EyeFrameRing::DataSize(frameSize);
+  std::vector<uint8_t> storage(totalSize + PS3EYE_PAGE_SIZE);
+  uint8_t *base = reinterpret_cast<uint8_t *>(PS3EyeAlignUp(
+      reinterpret_cast<uintptr_t>(storage.data()), PS3EYE_PAGE_SIZE));
+  PS3EyeRingControl *control = new (base) PS3EyeRingControl();
+
+  PS3EyeFrameRing writerRing;
+  writerRing.Attach(control, base);
+  writerRing.Initialize(dataOffset, frameSize);
+
+  std::atomic<bool> running(true);
+  std::vector<uint8_t> source(frameSize, 0x5a);
+  std::thread writer([&]() {
+    const auto period = std::chrono::nanoseconds(1000000000LL / fps);
+    auto next = Clock::now();
+    while (running) {
+      writerRing.Publish(source.data(), frameSize, NowNs());
+      next += period;
+      std::this_thread::sleep_until(next);
+    }
+  });
+
+  Result copyResult, acquireResult;
+  std::vector<uint8_t> staging(frameSize), sample(frameSize);
+  PS3EyeFrameRing ring;
+  ring.Attach(control, base);
+
+  // Alternate between the two modes so both see the same conditions
+  uint64_t last = 0;
+  const auto end = Clock::now() + std::chrono::seconds(durationSecs);
+  for (int mode = 0; Clock::now() < end; mode ^= 1) {
+    const auto phaseEnd = Clock::now() + std::chrono::milliseconds(500);
+    while (Clock::now() < phaseEnd) {
+      uint64_t start = NowNs();
+      uint64_t frameNumber = 0, timestamp = 0;
+      Result &r = mode == 0 ? copyResult : acquireResult;
+      if (mode == 0) {
+        if (ring.ReadLatest(staging.data(), frameSize, last, &frameNumber,
+                            &timestamp) != PS3EyeRingReadResult::Ok) {
+          std::this_thread::yield();
+          continue;
+        }
+        memcpy(sample.data(), staging.data(), frameSize);
+        r.bytesCopied += 2ull * frameSize;
+      } else {
+        PS3EyeRingView view;
+        if (ring.Acquire(last, &view) != PS3EyeRingReadResult::Ok) {
+          std::this_thread::yield();
+          continue;
+        }
+        memcpy(sample.data(), view.data, view.dataSize);
+        ring.Release(view);
+        frameNumber = view.frameNumber;
+        timestamp = view.timestamp;
+        r.bytesCopied += frameSize;
+      }
+      uint64_t done = NowNs();
+      last = frameNumber;
+      r.frames++;
+      r.consumeNs.push_back(done - start);
+      r.latencyNs.push_back(done - timestamp);
+    }
+  }
+  running = false;
+  writer.join();
+
+  printf("Frame ring transport: %u byte frames at %d fps\n", frameSize, fps);
+  printf("(the writer's own copy into the ring is not counted)\n");
+  Report("copy", copyResult, frameSize);
+  Report("acquire", acquireResult, frameSize);
+  printf("Writer dropped %llu frames on pinned slots\n",
+         (unsigned long long)ring.DroppedFrames());
+  return 0;
+}
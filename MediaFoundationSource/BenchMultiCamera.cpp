@@ -0,0 +1,156 @@
+// BenchMultiCamera.cpp - Scaling benchmark for the multi-camera capture
+// service. For 1..N synthetic cameras it runs one PS3EyeCaptureChannel per
+// camera, as the service does, plus one reader per channel that finds its
+// camera through the channel directory. Reports per camera count the frame
+// rate every channel delivered and the frame arrival-to-reader latency; with
+// no contention between channels both stay flat as cameras are added.
+//   g++ -std=c++17 -O2 -pthread BenchMultiCamera.cpp PS3EyeCaptureChannel.cpp
+//      PS3EyeFrameCadence.cpp PS3EyeChannelDirectory.cpp
+//      PS3EyeSyntheticCamera.cpp PS3EyeSharedMemory.cpp PS3EyeIpcPosix.cpp
+//      -lrt -o BenchMultiCamera
+//   cl /EHsc /O2 /std:c++17 BenchMultiCamera.cpp PS3EyeCaptureChannel.cpp
+//      PS3EyeFrameCadence.cpp PS3EyeChannelDirectory.cpp
+//      PS3EyeSyntheticCamera.cpp PS3EyeSharedMemory.cpp PS3EyeIpcWin32.cpp
+//      advapi32.lib
+// Usage: BenchMultiCamera [cameras=4] [fps=60] [seconds=3]
+
+#include "PS3EyeCaptureChannel.h"
+#include "PS3EyeChannelDirectory.h"
+#include "PS3EyeSharedMemory.h"
+#include "PS3EyeSyntheticCamera.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ReaderStats {
+  uint64_t frames = 0;
+  std::vector<uint64_t> latency; // Arrival to frame in hand, 100ns
+};
+
+static void RunReader(std::string deviceId, const std::atomic<bool> *stop,
+                      ReaderStats *stats) {
+  PS3EyeSharedMemoryClient client;
+  while (!client.ConnectDevice(deviceId.c_str())) {
+    if (stop->load())
+      return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  while (!stop->load(std::memory_order_relaxed)) {
+    if (!client.WaitForFrame(100))
+      continue;
+    PS3EyeFrameView frame;
+    if (!client.AcquireFrame(&frame))
+      continue;
+    stats->latency.push_back(PS3EyeTransportTime() -
+                             frame.metadata.arrivalTime);
+    stats->frames++;
+    client.ReleaseFrame(&frame);
+  }
+}
+
+// Returns the lowest per-channel frame rate
+static double RunCameras(uint32_t cameraCount, uint32_t fps,
+                         int durationSecs) {
+  PS3EyeChannelDirectory directory;
+  if (!directory.Create()) {
+    printf("Failed to create channel directory\n");
+    return 0;
+  }
+
+  std::vector<std::unique_ptr<PS3EyeCaptureChannel>> channels;
+  PS3EyeCameraList cameras = PS3EyeEnumerateSyntheticCameras(cameraCount);
+  for (auto &camera : cameras) {
+    char name[PS3EYE_NAME_SIZE];
+    PS3EyeChannelName(camera->GetDeviceId(), channels.empty(), name,
+                      sizeof(name));
+    std::unique_ptr<PS3EyeCaptureChannel> channel(
+        new PS3EyeCaptureChannel(std::move(camera), name));
+    PS3EyeCaptureOptions options;
+    options.fps = fps;
+    if (!channel->Start(options)) {
+      printf("Failed to start channel %s\n", name);
+      return 0;
+    }
+    directory.SetChannel(static_cast<uint32_t>(channels.size()),
+                         channel->GetDeviceId(), channel->GetName());
+    channels.push_back(std::move(channel));
+  }
+
+  std::atomic<bool> stop(false);
+  std::vector<ReaderStats> stats(cameraCount);
+  std::vector<std::thread> readers;
+  for (uint32_t i = 0; i < cameraCount; i++)
+    readers.emplace_back(RunReader, std::string(channels[i]->GetDeviceId()),
+                         &stop, &stats[i]);
+
+  // Channels start streaming once their reader connects; measure after that
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  std::vector<uint64_t> startCounts(cameraCount);
+  for (uint32_t i = 0; i < cameraCount; i++)
+    startCounts[i] = channels[i]->GetFrameCount();
+  const uint64_t start = PS3EyeTransportTime();
+  std::this_thread::sleep_for(std::chrono::seconds(durationSecs));
+  const double secs = (PS3EyeTransportTime() - start) / 1e7;
+
+  double minFps = 1e9, totalFps = 0;
+  std::vector<uint64_t> latency;
+  for (uint32_t i = 0; i < cameraCount; i++) {
+    double channelFps =
+        (channels[i]->GetFrameCount() - startCounts[i]) / secs;
+    minFps = std::min(minFps, channelFps);
+    totalFps += channelFps;
+  }
+
+  stop = true;
+  for (auto &reader : readers)
+    reader.join();
+  for (size_t i = 0; i < channels.size(); i++) {
+    directory.ClearChannel(static_cast<uint32_t>(i));
+    channels[i]->Stop();
+  }
+
+  for (const ReaderStats &s : stats)
+    latency.insert(latency.end(), s.latency.begin(), s.latency.end());
+  std::sort(latency.begin(), latency.end());
+  auto pct = [&](double p) {
+    if (latency.empty())
+      return 0.0;
+    size_t i =
+        std::min(latency.size() - 1, static_cast<size_t>(latency.size() * p));
+    return latency[i] / 10.0; // 100ns -> us
+  };
+
+  printf("%7u %10.1f %10.1f %9.0f%% %8.0fus %8.0fus\n", cameraCount, minFps,
+         totalFps, 100.0 * totalFps / (cameraCount * fps), pct(0.5),
+         pct(0.99));
+  return minFps;
+}
+
+int main(int argc, char *argv[]) {
+  const uint32_t maxCameras = std::min<uint32_t>(
+      argc > 1 ? atoi(argv[1]) : 4, PS3EYE_MAX_CHANNELS);
+  const uint32_t fps = argc > 2 ? atoi(argv[2]) : 60;
+  const int durationSecs = argc > 3 ? atoi(argv[3]) : 3;
+
+  printf("%u fps synthetic cameras, %d s per run\n", fps, durationSecs);
+  printf("%7s %10s %10s %10s %10s %10s\n", "Cameras", "Min fps", "Total fps",
+         "Linear", "Lat p50", "Lat p99");
+
+  bool ok = true;
+  for (uint32_t cameras = 1; cameras <= maxCameras; cameras++) {
+    // Every channel must keep up with its camera
+    if (RunCameras(cameras, fps, durationSecs) < fps * 0.95)
+      ok = false;
+  }
+
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
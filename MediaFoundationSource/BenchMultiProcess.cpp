@@ -0,0 +1,180 @@
+// BenchMultiProcess.cpp - Multi-process throughput / latency benchmark for the
+// shared memory transport on POSIX systems. The parent runs a
+// PS3EyeSharedMemoryServer, forks N reader processes that each connect with a
+// PS3EyeSharedMemoryClient, and reports per reader the frames received,
+// frames skipped, bytes copied and publish-to-frame-in-hand latency.
+//   g++ -std=c++17 -O2 -pthread BenchMultiProcess.cpp PS3EyeSharedMemory.cpp
+//      PS3EyeChannelDirectory.cpp PS3EyeIpcPosix.cpp -lrt -o BenchMultiProcess
+// Usage: BenchMultiProcess [readers=4] [fps=60] [seconds=5] [copy|acquire]
+//   fps 0 publishes as fast as possible (throughput); readers in copy mode
+//   ReadFrame() into a private buffer, in acquire mode they pin the slot and
+//   copy once out of it.
+
+#include "PS3EyeSharedMemory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Per-reader results, written by the child into an anonymous shared mapping
+struct ReaderResult {
+  std::atomic<uint32_t> connected;
+  uint64_t frames;
+  uint64_t skipped;
+  uint64_t bytes;
+  double p50Us, p99Us, maxUs;
+};
+
+struct BenchShared {
+  std::atomic<uint32_t> stop;
+  ReaderResult readers[PS3EYE_MAX_CLIENTS];
+};
+
+static void RunReader(BenchShared *shared, int index, bool copyMode) {
+  ReaderResult &result = shared->readers[index];
+  PS3EyeSharedMemoryClient client;
+  while (!client.Connect()) {
+    if (shared->stop.load())
+      return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  result.connected.store(1);
+
+  std::vector<uint8_t> buffer(PS3EYE_FRAME_SIZE);
+  std::vector<uint64_t> latency;
+  latency.reserve(1 << 16);
+  uint64_t last = 0;
+  while (!shared->stop.load(std::memory_order_relaxed)) {
+    if (!client.WaitForFrame(100))
+      continue;
+
+    uint64_t frameNumber = 0, timestamp = 0;
+    if (copyMode) {
+      if (!client.ReadFrame(buffer.data(), PS3EYE_FRAME_SIZE, &frameNumber,
+                            &timestamp))
+        continue;
+    } else {
+      PS3EyeFrameView frame;
+      if (!client.AcquireFrame(&frame))
+        continue;
+      memcpy(buffer.data(), frame.data, frame.dataSize);
+      frameNumber = frame.frameNumber;
+      timestamp = frame.timestamp;
+      client.ReleaseFrame(&frame);
+    }
+
+    latency.push_back(PS3EyeTransportTime() - timestamp);
+    if (last != 0 && frameNumber > last + 1)
+      result.skipped += frameNumber - last - 1;
+    last = frameNumber;
+    result.frames++;
+    result.bytes += PS3EYE_FRAME_SIZE;
+  }
+
+  if (!latency.empty()) {
+    std::sort(latency.begin(), latency.end());
+    auto pct = [&](double p) {
+      size_t i = std::min(latency.size() - 1,
+                          static_cast<size_t>(latency.size() * p));
+      return latency[i] / 10.0; // 100ns -> us
+    };
+    result.p50Us = pct(0.5);
+    result.p99Us = pct(0.99);
+    result.maxUs = pct(1.0);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const int readerCount = std::min(argc > 1 ? atoi(argv[1]) : 4,
+                                   static_cast<int>(PS3EYE_MAX_CLIENTS));
+  const int fps = argc > 2 ? atoi(argv[2]) : 60;
+  const int durationSecs = argc > 3 ? atoi(argv[3]) : 5;
+  const bool copyMode = argc > 4 && strcmp(argv[4], "copy") == 0;
+
+  void *mapping = mmap(nullptr, sizeof(BenchShared), PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  BenchShared *shared = new (mapping) BenchShared();
+
+  PS3EyeSharedMemoryServer server;
+  if (!server.Create()) {
+    printf("Failed to create shared memory\n");
+    return 1;
+  }
+
+  std::vector<pid_t> children;
+  for (int r = 0; r < readerCount; r++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      RunReader(shared, r, copyMode);
+      _exit(0); // Skip destructors; the server object belongs to the parent
+    }
+    if (pid > 0)
+      children.push_back(pid);
+  }
+
+  // Wait for every reader to register before the first frame
+  const auto connectDeadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  for (int r = 0; r < readerCount; r++) {
+    while (!shared->readers[r].connected.load() &&
+           std::chrono::steady_clock::now() < connectDeadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  std::vector<uint8_t> frame(PS3EYE_FRAME_SIZE, 0x80);
+  const uint64_t period = fps > 0 ? 10000000ULL / fps : 0;
+  const uint64_t start = PS3EyeTransportTime();
+  const uint64_t end = start + durationSecs * 10000000ULL;
+  uint64_t published = 0;
+  for (uint64_t next = start; PS3EyeTransportTime() < end; next += period) {
+    while (PS3EyeTransportTime() < next)
+      std::this_thread::yield();
+    if (server.WriteFrame(frame.data(), PS3EYE_FRAME_SIZE,
+                          PS3EyeTransportTime()))
+      published++;
+  }
+  const double secs = (PS3EyeTransportTime() - start) / 1e7;
+
+  // Let readers drain the last frame
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  shared->stop.store(1);
+  for (pid_t pid : children)
+    waitpid(pid, nullptr, 0);
+
+  printf("%s mode: published %llu frames in %.1f s (%.0f fps), %llu dropped "
+         "on pinned slots, %d reader processes\n",
+         copyMode ? "copy" : "acquire", (unsigned long long)published, secs,
+         published / secs, (unsigned long long)server.GetDroppedFrames(),
+         readerCount);
+  printf("%-6s %8s %8s %9s %10s %10s %10s\n", "Reader", "Frames", "Skipped",
+         "GB/s", "Lat p50", "Lat p99", "Lat max");
+  bool ok = true;
+  for (int r = 0; r < readerCount; r++) {
+    const ReaderResult &result = shared->readers[r];
+    if (!result.connected.load()) {
+      printf("%-6d failed to connect\n", r);
+      ok = false;
+      continue;
+    }
+    printf("%-6d %8llu %8llu %9.2f %8.0fus %8.0fus %8.0fus\n", r,
+           (unsigned long long)result.frames,
+           (unsigned long long)result.skipped, result.bytes / secs / 1e9,
+           result.p50Us, result.p99Us, result.maxUs);
+  }
+
+  server.Close();
+  munmap(mapping, sizeof(BenchShared));
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+// BenchSlotAlignment.cpp - Copy bandwidth of frame slots by alignment
+// Compares reading frames out of a ring laid out like protocol v1 (pixel data
+// at offset 72, right after the packed header) with the current layout (every
+// slot page-aligned). Two readers are measured:
+//   memcpy: slot -> page-aligned sample buffer
+//   simd:   16-byte loads over the slot (aligned loads where the layout
+//           allows, unaligned loads otherwise), as a converter would do
+// Platform-neutral:
+//   g++ -std=c++17 -O2 BenchSlotAlignment.cpp -o BenchSlotAlignment
+// Usage: BenchSlotAlignment [iterations=2000] [frameBytes=921600]
+
+#include "PS3EyeFrameRing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define BENCH_HAVE_SSE2 1
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static uint8_t *AlignPage(std::vector<uint8_t> &buffer) {
+  return reinterpret_cast<uint8_t *>(PS3EyeAlignUp(
+      reinterpret_cast<uintptr_t>(buffer.data()), PS3EYE_PAGE_SIZE));
+}
+
+// Sum the frame 16 bytes at a time so the loads cannot be optimized away
+static uint32_t SimdRead(const uint8_t *data, uint32_t size, bool aligned) {
+#ifdef BENCH_HAVE_SSE2
+  __m128i acc = _mm_setzero_si128();
+  uint32_t i = 0;
+  if (aligned) {
+    for (; i + 16 <= size; i += 16)
+      acc = _mm_add_epi32(
+          acc, _mm_load_si128(reinterpret_cast<const __m128i *>(data + i)));
+  } else {
+    for (; i + 16 <= size; i += 16)
+      acc = _mm_add_epi32(
+          acc, _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)));
+  }
+  return static_cast<uint32_t>(_mm_cvtsi128_si32(acc));
+#else
+  (void)aligned;
+  uint32_t acc = 0;
+  for (uint32_t i = 0; i + 4 <= size; i += 4) {
+    uint32_t v;
+    memcpy(&v, data + i, 4);
+    acc += v;
+  }
+  return acc;
+#endif
+}
+
+// Median GB/s over all iterations, rotating through the ring's slots so the
+// source is not always hot in cache
+template <typename Fn>
+static double Measure(int iterations, uint32_t frameSize, Fn &&readSlot) {
+  std::vector<double> rates;
+  rates.reserve(iterations);
+  for (int i = 0; i < iterations; i++) {
+    auto start = Clock::now();
+    readSlot(i % PS3EYE_RING_SLOT_COUNT);
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    rates.push_back(frameSize / secs / 1e9);
+  }
+  std::sort(rates.begin(), rates.end());
+  return rates[rates.size() / 2];
+}
+
+int main(int argc, char *argv[]) {
+  const int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+  const uint32_t frameSize =
+      argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 640 * 480 * 3;
+  const uint32_t slotSize =
+      static_cast<uint32_t>(PS3EyeAlignUp(frameSize, PS3EYE_PAGE_SIZE));
+
+  struct Layout {
+    const char *name;
+    uint32_t offset; // Of the first slot from a page-aligned mapping base
+    bool aligned;
+  };
+  const Layout layouts[] = {{"v1 (offset 72)", 72, false},
+                            {"page-aligned", 0, true}};
+
+  std::vector<uint8_t> ring(
+      PS3EYE_RING_SLOT_COUNT * slotSize + 2 * PS3EYE_PAGE_SIZE, 0x5a);
+  std::vector<uint8_t> sample(frameSize + PS3EYE_PAGE_SIZE);
+  uint8_t *ringBase = AlignPage(ring);
+  uint8_t *dest = AlignPage(sample);
+
+  printf("Slot read bandwidth, %u byte frames, %u slots, median of %d\n",
+         frameSize, PS3EYE_RING_SLOT_COUNT, iterations);
+  printf("%-16s %12s %12s\n", "Layout", "memcpy GB/s", "simd GB/s");
+  volatile uint32_t sink = 0;
+  for (const Layout &layout : layouts) {
+    uint8_t *first = ringBase + layout.offset;
+    double copyRate = Measure(iterations, frameSize, [&](uint32_t slot) {
+      memcpy(dest, first + slot * slotSize, frameSize);
+    });
+    double simdRate = Measure(iterations, frameSize, [&](uint32_t slot) {
+      sink = sink +
+             SimdRead(first + slot * slotSize, frameSize, layout.aligned);
+    });
+    printf("%-16s %12.2f %12.2f\n", layout.name, copyRate, simdRate);
+  }
+  return 0;
+}
@@ -0,0 +1,146 @@
+// BenchWorkerPool.cpp - Scaling of the striped Bayer conversions over the
+// worker pool. For pools of 0..N workers it reports the median time per
+// 640x480 frame of one camera (BGR24 flipped for a DIB, NV12 and grey) and
+// the speedup over converting on the calling thread alone; then, with the
+// same pools, the total frame rate of several cameras converting BGR24 at
+// once, each on its own thread as the capture channels do, where the stealing
+// keeps every worker busy whichever camera delivered last.
+//   g++ -std=c++14 -O2 -c -mavx2 PS3EyeBayerAVX2.cpp
+//   g++ -std=c++14 -O2 -pthread BenchWorkerPool.cpp PS3EyeWorkerPool.cpp
+//      PS3EyeBayer.cpp PS3EyeBayerSSE2.cpp PS3EyeBayerNEON.cpp
+//      PS3EyeBayerAVX2.o -o BenchWorkerPool
+//   cl /EHsc /O2 BenchWorkerPool.cpp PS3EyeWorkerPool.cpp PS3EyeBayer.cpp
+//      PS3EyeBayerSSE2.cpp PS3EyeBayerNEON.cpp PS3EyeBayerAVX2.cpp
+//   (compile PS3EyeBayerAVX2.cpp with /arch:AVX2, e.g. as a separate /c step)
+// Usage: BenchWorkerPool [workers=cores-1] [cameras=4] [iterations=200]
+
+#include "PS3EyeWorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const uint32_t WIDTH = 640, HEIGHT = 480;
+
+// Median ns per call of convert
+template <class Convert>
+static double Measure(Convert convert, int iterations) {
+  std::vector<double> samples;
+  samples.reserve(iterations);
+  for (int i = 0; i < iterations; i++) {
+    auto start = Clock::now();
+    convert();
+    auto end = Clock::now();
+    samples.push_back(
+        std::chrono::duration<double, std::nano>(end - start).count());
+  }
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+struct Camera {
+  std::vector<uint8_t> bayer;
+  std::vector<uint8_t> dst;
+};
+
+static Camera RandomCamera(std::mt19937 &rng) {
+  Camera camera;
+  camera.bayer.resize(static_cast<size_t>(WIDTH) * HEIGHT);
+  for (uint8_t &byte : camera.bayer)
+    byte = static_cast<uint8_t>(rng());
+  camera.dst.resize(static_cast<size_t>(WIDTH) * HEIGHT * 3);
+  return camera;
+}
+
+static PS3EyeBayerJob BgrJob(Camera &camera) {
+  PS3EyeBayerJob job = {camera.bayer.data(),    WIDTH,  camera.dst.data(),
+                        WIDTH * 3,              WIDTH,  HEIGHT,
+                        PS3EyeBayerFormat::BGR, true, false};
+  return job;
+}
+
+// Frames per second of all cameras together, each converting iterations
+// frames on its own thread
+static double CamerasFps(PS3EyeWorkerPool *pool, std::vector<Camera> *cameras,
+                         int iterations) {
+  std::vector<std::thread> threads;
+  auto start = Clock::now();
+  for (Camera &camera : *cameras) {
+    threads.emplace_back([pool, &camera, iterations] {
+      const PS3EyeBayerJob job = BgrJob(camera);
+      for (int i = 0; i < iterations; i++)
+        PS3EyeDemosaicParallel(pool, job);
+    });
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+  const double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  return cameras->size() * iterations / seconds;
+}
+
+int main(int argc, char **argv) {
+  const unsigned cores = std::thread::hardware_concurrency();
+  int maxWorkers = argc > 1 ? atoi(argv[1]) : (cores > 1 ? cores - 1 : 0);
+  int cameraCount = argc > 2 ? atoi(argv[2]) : 4;
+  int iterations = argc > 3 ? atoi(argv[3]) : 200;
+  if (maxWorkers < 0)
+    maxWorkers = 0;
+  if (cameraCount < 1)
+    cameraCount = 1;
+  if (iterations < 1)
+    iterations = 1;
+
+  printf("Kernel %s, %u cores, %ux%u\n", PS3EyeSimdName(PS3EyeBestSimd()),
+         cores, WIDTH, HEIGHT);
+
+  std::mt19937 rng(1);
+  Camera camera = RandomCamera(rng);
+  const PS3EyeBayerJob bgr = BgrJob(camera);
+  const PS3EyeYuvJob nv12 = PS3EyeYuvFrameJob(
+      camera.bayer.data(), WIDTH, camera.dst.data(), WIDTH, HEIGHT,
+      PS3EyeYuvFormat::NV12);
+  const PS3EyeGreyJob grey = {camera.bayer.data(), WIDTH, camera.dst.data(),
+                              WIDTH,               WIDTH, HEIGHT};
+
+  printf("\nOne camera, ns/frame\n");
+  printf("%-8s %10s %7s %10s %7s %10s %7s\n", "workers", "BGR24", "speedup",
+         "NV12", "speedup", "Y800", "speedup");
+  double base[3] = {};
+  for (int workers = 0; workers <= maxWorkers; workers++) {
+    PS3EyeWorkerPool pool(workers);
+    const auto convertBgr = [&] { PS3EyeDemosaicParallel(&pool, bgr); };
+    const auto convertNv12 = [&] { PS3EyeDemosaicYuvParallel(&pool, nv12); };
+    const auto convertGrey = [&] { PS3EyeBayerToGreyParallel(&pool, grey); };
+    Measure(convertBgr, 5); // warm up
+    const double ns[3] = {Measure(convertBgr, iterations),
+                          Measure(convertNv12, iterations),
+                          Measure(convertGrey, iterations)};
+    if (workers == 0)
+      std::copy(ns, ns + 3, base);
+    printf("%-8d %10.0f %6.1fx %10.0f %6.1fx %10.0f %6.1fx\n", workers, ns[0],
+           base[0] / ns[0], ns[1], base[1] / ns[1], ns[2], base[2] / ns[2]);
+  }
+
+  printf("\n%d cameras at once, BGR24\n", cameraCount);
+  printf("%-8s %12s %8s\n", "workers", "frames/s", "speedup");
+  std::vector<Camera> cameras;
+  for (int c = 0; c < cameraCount; c++)
+    cameras.push_back(RandomCamera(rng));
+  double baseFps = 0;
+  for (int workers = 0; workers <= maxWorkers; workers++) {
+    PS3EyeWorkerPool pool(workers);
+    CamerasFps(&pool, &cameras, 5); // warm up
+    const double fps = CamerasFps(&pool, &cameras, iterations);
+    if (workers == 0)
+      baseFps = fps;
+    printf("%-8d %12.0f %7.1fx\n", workers, fps, fps / baseFps);
+  }
+  return 0;
+}
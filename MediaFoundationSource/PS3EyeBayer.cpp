@@ -0,0 +1,408 @@
+// PS3EyeBayer.cpp
+// Scalar reference kernel and runtime kernel selection
+
+#include "PS3EyeBayer.h"
+#include "PS3EyeBayerKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) ||            \
+    defined(__i386__)
+#define PS3EYE_BAYER_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(_M_ARM64) || defined(__aarch64__) || defined(__ARM_NEON)
+#define PS3EYE_BAYER_NEON 1
+#endif
+
+uint32_t PS3EyeBayerBytesPerPixel(PS3EyeBayerFormat format) {
+  switch (format) {
+  case PS3EyeBayerFormat::RGB:
+  case PS3EyeBayerFormat::BGR:
+    return 3;
+  case PS3EyeBayerFormat::RGBA:
+  case PS3EyeBayerFormat::BGRA:
+    return 4;
+  }
+  return 0;
+}
+
+const char *PS3EyeSimdName(PS3EyeSimd simd) {
+  switch (simd) {
+  case PS3EyeSimd::Scalar:
+    return "Scalar";
+  case PS3EyeSimd::SSE2:
+    return "SSE2";
+  case PS3EyeSimd::AVX2:
+    return "AVX2";
+  case PS3EyeSimd::NEON:
+    return "NEON";
+  }
+  return "?";
+}
+
+//------------------------------------------------------------------------------
+// CPU detection
+//------------------------------------------------------------------------------
+
+#ifdef PS3EYE_BAYER_X86
+static void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+  for (int i = 0; i < 4; i++)
+    regs[i] = static_cast<uint32_t>(info[i]);
+#else
+  regs[0] = regs[1] = regs[2] = regs[3] = 0;
+  __get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+}
+
+static uint64_t Xgetbv0() {
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  uint32_t eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+static bool CpuHasSSE2() {
+  uint32_t regs[4];
+  Cpuid(1, 0, regs);
+  return (regs[3] & (1u << 26)) != 0;
+}
+
+static bool CpuHasAVX2() {
+  uint32_t regs[4];
+  Cpuid(0, 0, regs);
+  if (regs[0] < 7)
+    return false;
+
+  // The OS must save YMM state too (OSXSAVE set and XCR0 has SSE + AVX)
+  Cpuid(1, 0, regs);
+  const uint32_t osxsave = 1u << 27, avx = 1u << 28;
+  if ((regs[2] & (osxsave | avx)) != (osxsave | avx))
+    return false;
+  if ((Xgetbv0() & 6) != 6)
+    return false;
+
+  Cpuid(7, 0, regs);
+  return (regs[1] & (1u << 5)) != 0;
+}
+#endif
+
+bool PS3EyeSimdSupported(PS3EyeSimd simd) {
+  switch (simd) {
+  case PS3EyeSimd::Scalar:
+    return true;
+#ifdef PS3EYE_BAYER_X86
+  case PS3EyeSimd::SSE2: {
+    static const bool supported = CpuHasSSE2();
+    return supported;
+  }
+  case PS3EyeSimd::AVX2: {
+    static const bool supported = CpuHasAVX2();
+    return supported;
+  }
+#endif
+#ifdef PS3EYE_BAYER_NEON
+  case PS3EyeSimd::NEON:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+PS3EyeSimd PS3EyeBestSimd() {
+  static const PS3EyeSimd best = [] {
+    const PS3EyeSimd order[] = {PS3EyeSimd::AVX2, PS3EyeSimd::SSE2,
+                                PS3EyeSimd::NEON};
+    for (PS3EyeSimd simd : order) {
+      if (PS3EyeSimdSupported(simd))
+        return simd;
+    }
+    return PS3EyeSimd::Scalar;
+  }();
+  return best;
+}
+
+//------------------------------------------------------------------------------
+// Kernels
+//------------------------------------------------------------------------------
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void DemosaicRowsScalar(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                               uint32_t rowEnd) {
+  for (uint32_t y = rowBegin; y < rowEnd; y++) {
+    const uint8_t *above, *row, *below;
+    PS3EyeBayerRows(job, y, &above, &row, &below);
+    PS3EyeDemosaicSpan<Format, Mirror>(job, above, row, below, (y & 1) != 0,
+                                       PS3EyeBayerDstRow(job, y), 0,
+                                       job.width);
+  }
+}
+
+void PS3EyeDemosaicRows(PS3EyeSimd simd, const PS3EyeBayerJob &job,
+                        uint32_t rowBegin, uint32_t rowEnd) {
+  if (job.width < 2 || job.height < 2 || rowEnd > job.height)
+    return;
+
+  if (!PS3EyeSimdSupported(simd))
+    simd = PS3EyeSimd::Scalar;
+  switch (simd) {
+#ifdef PS3EYE_BAYER_X86
+  case PS3EyeSimd::SSE2:
+    PS3EyeDemosaicRowsSSE2(job, rowBegin, rowEnd);
+    break;
+  case PS3EyeSimd::AVX2:
+    PS3EyeDemosaicRowsAVX2(job, rowBegin, rowEnd);
+    break;
+#endif
+#ifdef PS3EYE_BAYER_NEON
+  case PS3EyeSimd::NEON:
+    PS3EyeDemosaicRowsNEON(job, rowBegin, rowEnd);
+    break;
+#endif
+  default:
+    PS3EYE_BAYER_DISPATCH(DemosaicRowsScalar, job, rowBegin, rowEnd);
+    break;
+  }
+}
+
+void PS3EyeDemosaic(const PS3EyeBayerJob &job) {
+  PS3EyeDemosaicRows(PS3EyeBestSimd(), job, 0, job.height);
+}
+
+//------------------------------------------------------------------------------
+// YUV
+//------------------------------------------------------------------------------
+
+uint32_t PS3EyeYuvFrameSize(PS3EyeYuvFormat format, uint32_t width,
+                            uint32_t height) {
+  if (format == PS3EyeYuvFormat::YUY2)
+    return width * height * 2;
+  return width * height + width * height / 2; // 12 bits per pixel
+}
+
+PS3EyeYuvJob PS3EyeYuvFrameJob(const uint8_t *bayer, uint32_t bayerStride,
+                               uint8_t *dst, uint32_t width, uint32_t height,
+                               PS3EyeYuvFormat format) {
+  PS3EyeYuvJob job = {};
+  job.bayer = bayer;
+  job.bayerStride = bayerStride;
+  job.y = dst;
+  job.yStride = width;
+  if (format == PS3EyeYuvFormat::YUY2) {
+    job.yStride = width * 2;
+  } else if (format == PS3EyeYuvFormat::I420) {
+    job.u = dst + static_cast<size_t>(width) * height;
+    job.uvStride = width / 2;
+    job.v = job.u + static_cast<size_t>(job.uvStride) * (height / 2);
+  } else {
+    job.u = dst + static_cast<size_t>(width) * height;
+    job.uvStride = width;
+  }
+  job.width = width;
+  job.height = height;
+  job.format = format;
+  return job;
+}
+
+template <PS3EyeYuvFormat Format>
+static void DemosaicYuvRowsScalar(const PS3EyeYuvJob &job, uint32_t rowBegin,
+                                  uint32_t rowEnd) {
+  const PS3EyeBayerJob raw = PS3EyeYuvRawJob(job);
+  for (uint32_t y = rowBegin; y < rowEnd; y++) {
+    const uint8_t *above, *row, *below;
+    PS3EyeBayerRows(raw, y, &above, &row, &below);
+    PS3EyeLumaSpan(raw, above, row, below, (y & 1) != 0,
+                   job.y + static_cast<size_t>(y) * job.yStride, 0, job.width);
+    if (y & 1)
+      continue;
+    const size_t chromaRow = static_cast<size_t>(y / 2) * job.uvStride;
+    PS3EyeChromaSpan<Format>(
+        row, below, job.u + chromaRow,
+        Format == PS3EyeYuvFormat::I420 ? job.v + chromaRow : nullptr, 0,
+        job.width);
+  }
+}
+
+static void DemosaicYuy2RowsScalar(const PS3EyeYuvJob &job, uint32_t rowBegin,
+                                   uint32_t rowEnd) {
+  const PS3EyeBayerJob raw = PS3EyeYuvRawJob(job);
+  for (uint32_t y = rowBegin; y < rowEnd; y++) {
+    const uint8_t *above, *row, *below;
+    PS3EyeBayerRows(raw, y, &above, &row, &below);
+    PS3EyeYuy2Span(raw, above, row, below, (y & 1) != 0,
+                   job.y + static_cast<size_t>(y) * job.yStride, 0, job.width);
+  }
+}
+
+void PS3EyeDemosaicYuvRows(PS3EyeSimd simd, const PS3EyeYuvJob &job,
+                           uint32_t rowBegin, uint32_t rowEnd) {
+  if (job.width < 2 || job.height < 2 || rowEnd > job.height ||
+      (rowBegin & 1) || (rowEnd & 1))
+    return;
+
+  if (!PS3EyeSimdSupported(simd))
+    simd = PS3EyeSimd::Scalar;
+  switch (simd) {
+#ifdef PS3EYE_BAYER_X86
+  case PS3EyeSimd::SSE2:
+    PS3EyeDemosaicYuvRowsSSE2(job, rowBegin, rowEnd);
+    break;
+  case PS3EyeSimd::AVX2:
+    PS3EyeDemosaicYuvRowsAVX2(job, rowBegin, rowEnd);
+    break;
+#endif
+#ifdef PS3EYE_BAYER_NEON
+  case PS3EyeSimd::NEON:
+    PS3EyeDemosaicYuvRowsNEON(job, rowBegin, rowEnd);
+    break;
+#endif
+  default:
+    if (job.format == PS3EyeYuvFormat::NV12)
+      DemosaicYuvRowsScalar<PS3EyeYuvFormat::NV12>(job, rowBegin, rowEnd);
+    else if (job.format == PS3EyeYuvFormat::I420)
+      DemosaicYuvRowsScalar<PS3EyeYuvFormat::I420>(job, rowBegin, rowEnd);
+    else
+      DemosaicYuy2RowsScalar(job, rowBegin, rowEnd);
+    break;
+  }
+}
+
+void PS3EyeDemosaicYuv(const PS3EyeYuvJob &job) {
+  PS3EyeDemosaicYuvRows(PS3EyeBestSimd(), job, 0, job.height);
+}
+
+//------------------------------------------------------------------------------
+// Grey
+//------------------------------------------------------------------------------
+
+void PS3EyeBayerToGreyRows(PS3EyeSimd simd, const PS3EyeGreyJob &job,
+                           uint32_t rowBegin, uint32_t rowEnd) {
+  if (job.width < 2 || job.height < 2 || rowEnd > job.height)
+    return;
+
+  if (!PS3EyeSimdSupported(simd))
+    simd = PS3EyeSimd::Scalar;
+  switch (simd) {
+#ifdef PS3EYE_BAYER_X86
+  case PS3EyeSimd::SSE2:
+    PS3EyeBayerToGreyRowsSSE2(job, rowBegin, rowEnd);
+    break;
+  case PS3EyeSimd::AVX2:
+    PS3EyeBayerToGreyRowsAVX2(job, rowBegin, rowEnd);
+    break;
+#endif
+#ifdef PS3EYE_BAYER_NEON
+  case PS3EyeSimd::NEON:
+    PS3EyeBayerToGreyRowsNEON(job, rowBegin, rowEnd);
+    break;
+#endif
+  default: {
+    const PS3EyeBayerJob raw = PS3EyeGreyRawJob(job);
+    for (uint32_t y = rowBegin; y < rowEnd; y++) {
+      const uint8_t *above, *row, *below;
+      PS3EyeBayerRows(raw, y, &above, &row, &below);
+      PS3EyeGreySpan(raw, above, row, below, (y & 1) != 0,
+                     job.dst + static_cast<size_t>(y) * job.dstStride, 0,
+                     job.width);
+    }
+    break;
+  }
+  }
+}
+
+void PS3EyeBayerToGrey(const PS3EyeGreyJob &job) {
+  PS3EyeBayerToGreyRows(PS3EyeBestSimd(), job, 0, job.height);
+}
+
+//------------------------------------------------------------------------------
+// Binning
+//------------------------------------------------------------------------------
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void BinRowsScalar(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                          uint32_t rowEnd) {
+  for (uint32_t y = rowBegin; y < rowEnd; y++) {
+    const uint8_t *even =
+        job.bayer + static_cast<size_t>(2 * y) * job.bayerStride;
+    PS3EyeBinSpan<Format, Mirror>(job, even, even + job.bayerStride,
+                                  PS3EyeBinDstRow(job, y), 0, job.width / 2);
+  }
+}
+
+void PS3EyeBinRows(PS3EyeSimd simd, const PS3EyeBayerJob &job,
+                   uint32_t rowBegin, uint32_t rowEnd) {
+  if (job.width < 2 || job.height < 2 || rowEnd > job.height / 2)
+    return;
+
+  if (!PS3EyeSimdSupported(simd))
+    simd = PS3EyeSimd::Scalar;
+  switch (simd) {
+#ifdef PS3EYE_BAYER_X86
+  case PS3EyeSimd::SSE2:
+    PS3EyeBinRowsSSE2(job, rowBegin, rowEnd);
+    break;
+  case PS3EyeSimd::AVX2:
+    PS3EyeBinRowsAVX2(job, rowBegin, rowEnd);
+    break;
+#endif
+#ifdef PS3EYE_BAYER_NEON
+  case PS3EyeSimd::NEON:
+    PS3EyeBinRowsNEON(job, rowBegin, rowEnd);
+    break;
+#endif
+  default:
+    PS3EYE_BAYER_DISPATCH(BinRowsScalar, job, rowBegin, rowEnd);
+    break;
+  }
+}
+
+void PS3EyeBin(const PS3EyeBayerJob &job) {
+  PS3EyeBinRows(PS3EyeBestSimd(), job, 0, job.height / 2);
+}
+
+void PS3EyeBinGreyRows(PS3EyeSimd simd, const PS3EyeGreyJob &job,
+                       uint32_t rowBegin, uint32_t rowEnd) {
+  if (job.width < 2 || job.height < 2 || rowEnd > job.height / 2)
+    return;
+
+  if (!PS3EyeSimdSupported(simd))
+    simd = PS3EyeSimd::Scalar;
+  switch (simd) {
+#ifdef PS3EYE_BAYER_X86
+  case PS3EyeSimd::SSE2:
+    PS3EyeBinGreyRowsSSE2(job, rowBegin, rowEnd);
+    break;
+  case PS3EyeSimd::AVX2:
+    PS3EyeBinGreyRowsAVX2(job, rowBegin, rowEnd);
+    break;
+#endif
+#ifdef PS3EYE_BAYER_NEON
+  case PS3EyeSimd::NEON:
+    PS3EyeBinGreyRowsNEON(job, rowBegin, rowEnd);
+    break;
+#endif
+  default:
+    for (uint32_t y = rowBegin; y < rowEnd; y++) {
+      const uint8_t *even =
+          job.bayer + static_cast<size_t>(2 * y) * job.bayerStride;
+      PS3EyeBinGreySpan(even, even + job.bayerStride,
+                        job.dst + static_cast<size_t>(y) * job.dstStride, 0,
+                        job.width / 2);
+    }
+    break;
+  }
+}
+
+void PS3EyeBinGrey(const PS3EyeGreyJob &job) {
+  PS3EyeBinGreyRows(PS3EyeBestSimd(), job, 0, job.height / 2);
+}
@@ -0,0 +1,168 @@
+// PS3EyeBayer.h
+// Bayer to RGB conversion for raw PS3 Eye frames. The OV7725 delivers GRBG
+// (first row G R G R ..., second row B G B G ...); every output pixel is a
+// bilinear interpolation of its 3x3 neighbourhood, with the frame edges
+// mirrored (reflect-101, so the mirrored neighbours keep their colour).
+// Kernels: a scalar reference plus SSE2, AVX2 and NEON versions that match it
+// bit for bit, picked once at runtime from what the CPU supports. Vertical
+// flip and horizontal mirror are applied in the same pass, so converting a
+// frame for a bottom-up DIB touches each output byte once.
+//
+// The same kernels also write YUV (BT.601, limited range) for consumers that
+// would otherwise convert RGB back to YUV themselves. Luma comes from the
+// interpolated RGB of each pixel. 4:2:0 chroma comes straight from the raw
+// 2x2 quad it covers (R, the mean of the two G, B), which is exactly the
+// footprint of one chroma sample; 4:2:2 chroma from the mean interpolated RGB
+// of its pixel pair.
+//
+// Grey for luma-only consumers skips the demosaic altogether: see
+// PS3EyeBayerToGrey. So does half-resolution output: see PS3EyeBin.
+
+#pragma once
+
+#include <cstdint>
+
+// Output pixel layouts, named in memory byte order
+enum class PS3EyeBayerFormat : uint32_t {
+  RGB,  // 3 bytes R, G, B (driver EOutputFormat::RGB)
+  BGR,  // 3 bytes B, G, R (Windows RGB24)
+  RGBA, // 4 bytes R, G, B, 255
+  BGRA, // 4 bytes B, G, R, 255 (Windows RGB32)
+};
+
+enum class PS3EyeSimd : uint32_t {
+  Scalar,
+  SSE2,
+  AVX2,
+  NEON,
+};
+
+// One conversion. Width and height must be even and at least 2.
+struct PS3EyeBayerJob {
+  const uint8_t *bayer; // Top row of the raw frame, 1 byte per pixel
+  uint32_t bayerStride; // Bytes per raw row
+  uint8_t *dst;         // First row of the output in memory
+  uint32_t dstStride;   // Bytes per output row
+  uint32_t width;
+  uint32_t height;
+  PS3EyeBayerFormat format;
+  bool flipVertical; // Write rows bottom-up (raw row y to output row h-1-y)
+  bool mirror;       // Write each row right to left
+};
+
+uint32_t PS3EyeBayerBytesPerPixel(PS3EyeBayerFormat format);
+
+// Fastest kernel the CPU (and OS) supports; detected on first use
+PS3EyeSimd PS3EyeBestSimd();
+
+// Whether the kernel is compiled in and runnable on this CPU
+bool PS3EyeSimdSupported(PS3EyeSimd simd);
+
+const char *PS3EyeSimdName(PS3EyeSimd simd);
+
+// Convert a whole frame with the fastest kernel
+void PS3EyeDemosaic(const PS3EyeBayerJob &job);
+
+// Convert raw rows [rowBegin, rowEnd) with a given kernel (with flipVertical
+// they land at the mirrored output rows). Falls back to the scalar reference
+// if the kernel is not supported.
+void PS3EyeDemosaicRows(PS3EyeSimd simd, const PS3EyeBayerJob &job,
+                        uint32_t rowBegin, uint32_t rowEnd);
+
+//------------------------------------------------------------------------------
+// YUV output
+//------------------------------------------------------------------------------
+
+enum class PS3EyeYuvFormat : uint32_t {
+  NV12, // Y plane, then one plane of interleaved U, V at half resolution
+  I420, // Y plane, then U and V planes at half resolution
+  YUY2, // Packed 4:2:2, Y0 U Y1 V per pixel pair, all in the y plane
+};
+
+// One conversion to YUV, top-down. Width and height must be even and at
+// least 2. YUY2 uses y and yStride only.
+struct PS3EyeYuvJob {
+  const uint8_t *bayer; // Top row of the raw frame, 1 byte per pixel
+  uint32_t bayerStride; // Bytes per raw row
+  uint8_t *y;           // Luma plane, width x height
+  uint32_t yStride;
+  uint8_t *u; // NV12: the UV plane (width bytes per row); I420: U plane
+  uint8_t *v; // I420: V plane; unused for NV12
+  uint32_t uvStride; // Bytes per row of the chroma plane(s)
+  uint32_t width;
+  uint32_t height;
+  PS3EyeYuvFormat format;
+};
+
+// Bytes of a frame with tightly packed planes, one after another
+uint32_t PS3EyeYuvFrameSize(PS3EyeYuvFormat format, uint32_t width,
+                            uint32_t height);
+
+// Job writing such a frame to dst
+PS3EyeYuvJob PS3EyeYuvFrameJob(const uint8_t *bayer, uint32_t bayerStride,
+                               uint8_t *dst, uint32_t width, uint32_t height,
+                               PS3EyeYuvFormat format);
+
+// Convert a whole frame with the fastest kernel
+void PS3EyeDemosaicYuv(const PS3EyeYuvJob &job);
+
+// Convert raw rows [rowBegin, rowEnd) with a given kernel; both must be even,
+// since each chroma row comes from a pair of raw rows. Falls back to the
+// scalar reference if the kernel is not supported.
+void PS3EyeDemosaicYuvRows(PS3EyeSimd simd, const PS3EyeYuvJob &job,
+                           uint32_t rowBegin, uint32_t rowEnd);
+
+//------------------------------------------------------------------------------
+// Grey output
+//------------------------------------------------------------------------------
+
+// One conversion to 8-bit grey, top-down. Width and height must be even and
+// at least 2.
+struct PS3EyeGreyJob {
+  const uint8_t *bayer; // Top row of the raw frame, 1 byte per pixel
+  uint32_t bayerStride; // Bytes per raw row
+  uint8_t *dst;         // Top row of the output, 1 byte per pixel
+  uint32_t dstStride;   // Bytes per output row
+  uint32_t width;
+  uint32_t height;
+};
+
+// Grey straight from the mosaic, full range: each pixel is the [1 2 1] x
+// [1 2 1] / 16 blur of its 3x3 neighbourhood. On a Bayer mosaic that weighs
+// R, G and B 1/4, 1/2, 1/4 at every site, so unlike the demosaic there is
+// nothing to decide per site, just one separable filter.
+void PS3EyeBayerToGrey(const PS3EyeGreyJob &job);
+
+// Convert raw rows [rowBegin, rowEnd) with a given kernel. Falls back to the
+// scalar reference if the kernel is not supported.
+void PS3EyeBayerToGreyRows(PS3EyeSimd simd, const PS3EyeGreyJob &job,
+                           uint32_t rowBegin, uint32_t rowEnd);
+
+//------------------------------------------------------------------------------
+// Binned output
+//------------------------------------------------------------------------------
+
+// Half resolution straight from the mosaic: each 2x2 quad (G R / B G)
+// becomes one pixel, with the quad's R and B and the mean of its two G. Every
+// output colour is then measured rather than interpolated, so a 320x240
+// frame binned from a 640x480 capture is less noisy than the sensor's own
+// QVGA mode or a scaled-down demosaic, and cheaper than either conversion.
+//
+// The job describes the raw frame as for PS3EyeDemosaic; dst and dstStride
+// describe the width / 2 x height / 2 output, and flipVertical and mirror
+// apply to it.
+void PS3EyeBin(const PS3EyeBayerJob &job);
+
+// Bin output rows [rowBegin, rowEnd) (raw rows 2 * rowBegin to 2 * rowEnd)
+// with a given kernel. Falls back to the scalar reference if the kernel is
+// not supported.
+void PS3EyeBinRows(PS3EyeSimd simd, const PS3EyeBayerJob &job,
+                   uint32_t rowBegin, uint32_t rowEnd);
+
+// Grey at half resolution: the mean of each quad, which weighs R, G and B
+// like PS3EyeBayerToGrey. The job describes the raw frame; dst and dstStride
+// describe the width / 2 x height / 2 output.
+void PS3EyeBinGrey(const PS3EyeGreyJob &job);
+
+void PS3EyeBinGreyRows(PS3EyeSimd simd, const PS3EyeGreyJob &job,
+                       uint32_t rowBegin, uint32_t rowEnd);
@@ -0,0 +1,411 @@
+// PS3EyeBayerAVX2.cpp
+// AVX2 Bayer kernel, 32 pixels per step. Built with AVX2 code generation
+// (/arch:AVX2, -mavx2); only called once cpuid has confirmed AVX2.
+
+#include "PS3EyeBayerKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) ||            \
+    defined(__i386__)
+
+#include <immintrin.h>
+
+static const uint32_t BLOCK = 32;
+
+// (a + b + c + d + 2) >> 2 per byte, in 16 bits so it rounds exactly like
+// the reference. Unpack and pack both work within 128-bit lanes, so the
+// bytes come back in order.
+static inline __m256i Avg4(__m256i a, __m256i b, __m256i c, __m256i d) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i two = _mm256_set1_epi16(2);
+  __m256i lo = _mm256_add_epi16(
+      _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero),
+                       _mm256_unpacklo_epi8(b, zero)),
+      _mm256_add_epi16(_mm256_unpacklo_epi8(c, zero),
+                       _mm256_unpacklo_epi8(d, zero)));
+  __m256i hi = _mm256_add_epi16(
+      _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero),
+                       _mm256_unpackhi_epi8(b, zero)),
+      _mm256_add_epi16(_mm256_unpackhi_epi8(c, zero),
+                       _mm256_unpackhi_epi8(d, zero)));
+  lo = _mm256_srli_epi16(_mm256_add_epi16(lo, two), 2);
+  hi = _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2);
+  return _mm256_packus_epi16(lo, hi);
+}
+
+// Even pixels from even, odd pixels from odd
+static inline __m256i Select(__m256i even, __m256i odd) {
+  const __m256i mask = _mm256_set1_epi16(0x00FF);
+  return _mm256_blendv_epi8(odd, even, mask);
+}
+
+static inline __m256i Load(const uint8_t *p) {
+  return _mm256_loadu_si256((const __m256i *)p);
+}
+
+// R, G, B of pixels [x, x + 32), x even
+static inline void Interpolate(const uint8_t *a, const uint8_t *c,
+                               const uint8_t *b, uint32_t x, bool oddRow,
+                               __m256i *red, __m256i *green, __m256i *blue) {
+  const __m256i al = Load(a + x - 1), a0 = Load(a + x), ar = Load(a + x + 1);
+  const __m256i cl = Load(c + x - 1), c0 = Load(c + x), cr = Load(c + x + 1);
+  const __m256i bl = Load(b + x - 1), b0 = Load(b + x), br = Load(b + x + 1);
+
+  const __m256i sides = _mm256_avg_epu8(cl, cr);
+  const __m256i vertical = _mm256_avg_epu8(a0, b0);
+  const __m256i cross = Avg4(a0, b0, cl, cr);
+  const __m256i diagonal = Avg4(al, ar, bl, br);
+
+  if (!oddRow) { // G R
+    *red = Select(sides, c0);
+    *green = Select(c0, cross);
+    *blue = Select(vertical, diagonal);
+  } else { // B G
+    *red = Select(diagonal, vertical);
+    *green = Select(cross, c0);
+    *blue = Select(c0, sides);
+  }
+}
+
+// 32 pixels of c0, c1, c2, 255 in memory order, 8 per vector
+static inline void Interleave4(__m256i c0, __m256i c1, __m256i c2,
+                               __m256i out[4]) {
+  const __m256i alpha = _mm256_set1_epi8(-1);
+  const __m256i lo01 = _mm256_unpacklo_epi8(c0, c1); // 0-7 | 16-23
+  const __m256i hi01 = _mm256_unpackhi_epi8(c0, c1); // 8-15 | 24-31
+  const __m256i lo2a = _mm256_unpacklo_epi8(c2, alpha);
+  const __m256i hi2a = _mm256_unpackhi_epi8(c2, alpha);
+  const __m256i p0 = _mm256_unpacklo_epi16(lo01, lo2a); // 0-3 | 16-19
+  const __m256i p1 = _mm256_unpackhi_epi16(lo01, lo2a); // 4-7 | 20-23
+  const __m256i p2 = _mm256_unpacklo_epi16(hi01, hi2a); // 8-11 | 24-27
+  const __m256i p3 = _mm256_unpackhi_epi16(hi01, hi2a); // 12-15 | 28-31
+  out[0] = _mm256_permute2x128_si256(p0, p1, 0x20);
+  out[1] = _mm256_permute2x128_si256(p2, p3, 0x20);
+  out[2] = _mm256_permute2x128_si256(p0, p1, 0x31);
+  out[3] = _mm256_permute2x128_si256(p2, p3, 0x31);
+}
+
+// Bytes in reverse order
+static inline __m256i Reverse(__m256i v) {
+  const __m256i reverse = _mm256_setr_epi8(
+      15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, //
+      15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+  return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, reverse),
+                                  _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+template <PS3EyeBayerFormat Format>
+static inline void Store(uint8_t *dst, __m256i red, __m256i green,
+                         __m256i blue) {
+  typedef PS3EyeBayerLayout<Format> Layout;
+  __m256i pixels[4];
+  Interleave4(Layout::redFirst ? red : blue, green,
+              Layout::redFirst ? blue : red, pixels);
+
+  if (Layout::bytesPerPixel == 4) {
+    for (int i = 0; i < 4; i++)
+      _mm256_storeu_si256((__m256i *)(dst + i * 32), pixels[i]);
+    return;
+  }
+
+  // Drop the alpha bytes within each lane (4 pixels -> 12 bytes), then store
+  // the lanes 12 bytes apart. Each 16-byte store's last 4 bytes are
+  // overwritten by the next one; the final store spills 4 bytes into the
+  // next pixels, which are written afterwards.
+  const __m256i pack = _mm256_setr_epi8(
+      0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, //
+      0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  for (int i = 0; i < 4; i++) {
+    const __m256i packed = _mm256_shuffle_epi8(pixels[i], pack);
+    _mm_storeu_si128((__m128i *)(dst + i * 24),
+                     _mm256_castsi256_si128(packed));
+    _mm_storeu_si128((__m128i *)(dst + i * 24 + 12),
+                     _mm256_extracti128_si256(packed, 1));
+  }
+}
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void Block(const PS3EyeBayerJob &job, const uint8_t *a,
+                  const uint8_t *c, const uint8_t *b, bool oddRow,
+                  uint8_t *dst, uint32_t x) {
+  const uint32_t bpp = PS3EyeBayerLayout<Format>::bytesPerPixel;
+  __m256i red, green, blue;
+  Interpolate(a, c, b, x, oddRow, &red, &green, &blue);
+  if (Mirror) {
+    Store<Format>(dst + (job.width - x - BLOCK) * bpp, Reverse(red),
+                  Reverse(green), Reverse(blue));
+  } else {
+    Store<Format>(dst + x * bpp, red, green, blue);
+  }
+}
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void Rows(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                 uint32_t rowEnd) {
+  PS3EyeDemosaicBlockRows<BLOCK, Format, Mirror, Block<Format, Mirror>>(
+      job, rowBegin, rowEnd);
+}
+
+void PS3EyeDemosaicRowsAVX2(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                            uint32_t rowEnd) {
+  PS3EYE_BAYER_DISPATCH(Rows, job, rowBegin, rowEnd);
+  // Avoid AVX-SSE transition penalties in the caller
+  _mm256_zeroupper();
+}
+
+//------------------------------------------------------------------------------
+// YUV
+//------------------------------------------------------------------------------
+
+static const uint32_t CHROMA_BLOCK = 64;
+
+// BT.601 luma of 32 pixels, as PS3EyeLuma. Unpack and pack stay within
+// lanes, so the bytes come back in order.
+static inline __m256i Luma(__m256i red, __m256i green, __m256i blue) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i kr = _mm256_set1_epi16(66), kg = _mm256_set1_epi16(129);
+  const __m256i kb = _mm256_set1_epi16(25), half = _mm256_set1_epi16(128);
+  __m256i lo = _mm256_add_epi16(
+      _mm256_add_epi16(
+          _mm256_mullo_epi16(_mm256_unpacklo_epi8(red, zero), kr),
+          _mm256_mullo_epi16(_mm256_unpacklo_epi8(green, zero), kg)),
+      _mm256_add_epi16(
+          _mm256_mullo_epi16(_mm256_unpacklo_epi8(blue, zero), kb), half));
+  __m256i hi = _mm256_add_epi16(
+      _mm256_add_epi16(
+          _mm256_mullo_epi16(_mm256_unpackhi_epi8(red, zero), kr),
+          _mm256_mullo_epi16(_mm256_unpackhi_epi8(green, zero), kg)),
+      _mm256_add_epi16(
+          _mm256_mullo_epi16(_mm256_unpackhi_epi8(blue, zero), kb), half));
+  const __m256i y = _mm256_packus_epi16(_mm256_srli_epi16(lo, 8),
+                                        _mm256_srli_epi16(hi, 8));
+  return _mm256_add_epi8(y, _mm256_set1_epi8(16));
+}
+
+static void LumaBlock(const PS3EyeBayerJob &job, const uint8_t *a,
+                      const uint8_t *c, const uint8_t *b, bool oddRow,
+                      uint8_t *dst, uint32_t x) {
+  (void)job;
+  __m256i red, green, blue;
+  Interpolate(a, c, b, x, oddRow, &red, &green, &blue);
+  _mm256_storeu_si256((__m256i *)(dst + x), Luma(red, green, blue));
+}
+
+// U and V of 16 colours, one per 16-bit lane, as PS3EyeChromaU/V. The
+// products wrap, but the sums end up in 0..65535.
+static inline void ChromaOf(__m256i red, __m256i green, __m256i blue,
+                            __m256i *u, __m256i *v) {
+  const __m256i bias = _mm256_set1_epi16(static_cast<short>(32896));
+  *u = _mm256_srli_epi16(
+      _mm256_add_epi16(
+          _mm256_add_epi16(_mm256_mullo_epi16(blue, _mm256_set1_epi16(112)),
+                           bias),
+          _mm256_add_epi16(_mm256_mullo_epi16(red, _mm256_set1_epi16(-38)),
+                           _mm256_mullo_epi16(green, _mm256_set1_epi16(-74)))),
+      8);
+  *v = _mm256_srli_epi16(
+      _mm256_add_epi16(
+          _mm256_add_epi16(_mm256_mullo_epi16(red, _mm256_set1_epi16(112)),
+                           bias),
+          _mm256_add_epi16(_mm256_mullo_epi16(green, _mm256_set1_epi16(-94)),
+                           _mm256_mullo_epi16(blue, _mm256_set1_epi16(-18)))),
+      8);
+}
+
+// U and V of the 16 quads in 32 raw columns
+static inline void Chroma(const uint8_t *even, const uint8_t *odd, __m256i *u,
+                          __m256i *v) {
+  const __m256i low = _mm256_set1_epi16(0x00FF);
+  const __m256i gr = Load(even), bg = Load(odd);
+  const __m256i green =
+      _mm256_avg_epu16(_mm256_and_si256(gr, low), _mm256_srli_epi16(bg, 8));
+  ChromaOf(_mm256_srli_epi16(gr, 8), green, _mm256_and_si256(bg, low), u, v);
+}
+
+// 32 bytes from the 16-bit lanes of lo then hi, in order
+static inline __m256i Pack(__m256i lo, __m256i hi) {
+  return _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi),
+                                  _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+template <PS3EyeYuvFormat Format>
+static void ChromaBlock(const uint8_t *even, const uint8_t *odd, uint8_t *u,
+                        uint8_t *v, uint32_t x) {
+  __m256i u0, v0, u1, v1;
+  Chroma(even + x, odd + x, &u0, &v0);
+  Chroma(even + x + 32, odd + x + 32, &u1, &v1);
+  if (Format == PS3EyeYuvFormat::NV12) {
+    // U in the low byte of each lane, V in the high one: already interleaved
+    _mm256_storeu_si256((__m256i *)(u + x),
+                        _mm256_or_si256(u0, _mm256_slli_epi16(v0, 8)));
+    _mm256_storeu_si256((__m256i *)(u + x + 32),
+                        _mm256_or_si256(u1, _mm256_slli_epi16(v1, 8)));
+  } else {
+    _mm256_storeu_si256((__m256i *)(u + x / 2), Pack(u0, u1));
+    _mm256_storeu_si256((__m256i *)(v + x / 2), Pack(v0, v1));
+  }
+}
+
+template <PS3EyeYuvFormat Format>
+static void YuvRows(const PS3EyeYuvJob &job, uint32_t rowBegin,
+                    uint32_t rowEnd) {
+  PS3EyeDemosaicYuvBlockRows<BLOCK, LumaBlock, CHROMA_BLOCK, Format,
+                             ChromaBlock<Format>>(job, rowBegin, rowEnd);
+}
+
+// Means of the 16 pixel pairs of 32 bytes, one per 16-bit lane
+static inline __m256i PairMean(__m256i v) {
+  return _mm256_avg_epu16(_mm256_and_si256(v, _mm256_set1_epi16(0x00FF)),
+                          _mm256_srli_epi16(v, 8));
+}
+
+static void Yuy2Block(const PS3EyeBayerJob &job, const uint8_t *a,
+                      const uint8_t *c, const uint8_t *b, bool oddRow,
+                      uint8_t *dst, uint32_t x) {
+  (void)job;
+  __m256i red, green, blue, u, v;
+  Interpolate(a, c, b, x, oddRow, &red, &green, &blue);
+  const __m256i y = Luma(red, green, blue);
+  ChromaOf(PairMean(red), PairMean(green), PairMean(blue), &u, &v);
+
+  // Y0 U and Y1 V per pair as 16-bit lanes, then interleaved; the unpacks
+  // work within lanes, so pairs 0-3 | 8-11 and 4-7 | 12-15
+  const __m256i y0u = _mm256_or_si256(
+      _mm256_and_si256(y, _mm256_set1_epi16(0x00FF)), _mm256_slli_epi16(u, 8));
+  const __m256i y1v =
+      _mm256_or_si256(_mm256_srli_epi16(y, 8), _mm256_slli_epi16(v, 8));
+  const __m256i lo = _mm256_unpacklo_epi16(y0u, y1v);
+  const __m256i hi = _mm256_unpackhi_epi16(y0u, y1v);
+  _mm256_storeu_si256((__m256i *)(dst + x * 2),
+                      _mm256_permute2x128_si256(lo, hi, 0x20));
+  _mm256_storeu_si256((__m256i *)(dst + x * 2 + 32),
+                      _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+void PS3EyeDemosaicYuvRowsAVX2(const PS3EyeYuvJob &job, uint32_t rowBegin,
+                               uint32_t rowEnd) {
+  if (job.format == PS3EyeYuvFormat::NV12)
+    YuvRows<PS3EyeYuvFormat::NV12>(job, rowBegin, rowEnd);
+  else if (job.format == PS3EyeYuvFormat::I420)
+    YuvRows<PS3EyeYuvFormat::I420>(job, rowBegin, rowEnd);
+  else
+    PS3EyeDemosaicYuy2BlockRows<BLOCK, Yuy2Block>(job, rowBegin, rowEnd);
+  _mm256_zeroupper();
+}
+
+//------------------------------------------------------------------------------
+// Grey
+//------------------------------------------------------------------------------
+
+// [1 2 1] down the 32 columns at p in rows a, c, b, in 16 bits (lane-wise
+// halves, as in Avg4)
+static inline void Column(const uint8_t *a, const uint8_t *c, const uint8_t *b,
+                          __m256i *lo, __m256i *hi) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i va = Load(a), vc = Load(c), vb = Load(b);
+  *lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(va, zero),
+                                          _mm256_unpacklo_epi8(vb, zero)),
+                         _mm256_slli_epi16(_mm256_unpacklo_epi8(vc, zero), 1));
+  *hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(va, zero),
+                                          _mm256_unpackhi_epi8(vb, zero)),
+                         _mm256_slli_epi16(_mm256_unpackhi_epi8(vc, zero), 1));
+}
+
+static void GreyBlock(const PS3EyeBayerJob &job, const uint8_t *a,
+                      const uint8_t *c, const uint8_t *b, bool oddRow,
+                      uint8_t *dst, uint32_t x) {
+  (void)job;
+  (void)oddRow;
+  __m256i lLo, lHi, mLo, mHi, rLo, rHi;
+  Column(a + x - 1, c + x - 1, b + x - 1, &lLo, &lHi);
+  Column(a + x, c + x, b + x, &mLo, &mHi);
+  Column(a + x + 1, c + x + 1, b + x + 1, &rLo, &rHi);
+  const __m256i eight = _mm256_set1_epi16(8);
+  const __m256i lo =
+      _mm256_add_epi16(_mm256_add_epi16(lLo, rLo),
+                       _mm256_add_epi16(_mm256_slli_epi16(mLo, 1), eight));
+  const __m256i hi =
+      _mm256_add_epi16(_mm256_add_epi16(lHi, rHi),
+                       _mm256_add_epi16(_mm256_slli_epi16(mHi, 1), eight));
+  _mm256_storeu_si256((__m256i *)(dst + x),
+                      _mm256_packus_epi16(_mm256_srli_epi16(lo, 4),
+                                          _mm256_srli_epi16(hi, 4)));
+}
+
+void PS3EyeBayerToGreyRowsAVX2(const PS3EyeGreyJob &job, uint32_t rowBegin,
+                               uint32_t rowEnd) {
+  PS3EyeRowBlockRows<BLOCK, GreyBlock, PS3EyeGreySpan>(
+      PS3EyeGreyRawJob(job), job.dst, job.dstStride, rowBegin, rowEnd);
+  _mm256_zeroupper();
+}
+
+//------------------------------------------------------------------------------
+// Binning
+//------------------------------------------------------------------------------
+
+// R, G, B of the 32 quads in raw columns [2x, 2x + 64)
+static inline void BinQuads(const uint8_t *even, const uint8_t *odd,
+                            __m256i *red, __m256i *green, __m256i *blue) {
+  const __m256i low = _mm256_set1_epi16(0x00FF);
+  const __m256i gr0 = Load(even), gr1 = Load(even + 32);
+  const __m256i bg0 = Load(odd), bg1 = Load(odd + 32);
+  *red = Pack(_mm256_srli_epi16(gr0, 8), _mm256_srli_epi16(gr1, 8));
+  *green = Pack(
+      _mm256_avg_epu16(_mm256_and_si256(gr0, low), _mm256_srli_epi16(bg0, 8)),
+      _mm256_avg_epu16(_mm256_and_si256(gr1, low), _mm256_srli_epi16(bg1, 8)));
+  *blue = Pack(_mm256_and_si256(bg0, low), _mm256_and_si256(bg1, low));
+}
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void BinBlock(const PS3EyeBayerJob &job, const uint8_t *even,
+                     const uint8_t *odd, uint8_t *dst, uint32_t x) {
+  const uint32_t bpp = PS3EyeBayerLayout<Format>::bytesPerPixel;
+  __m256i red, green, blue;
+  BinQuads(even + 2 * x, odd + 2 * x, &red, &green, &blue);
+  if (Mirror) {
+    Store<Format>(dst + (job.width / 2 - x - BLOCK) * bpp, Reverse(red),
+                  Reverse(green), Reverse(blue));
+  } else {
+    Store<Format>(dst + x * bpp, red, green, blue);
+  }
+}
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void BinRows(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                    uint32_t rowEnd) {
+  PS3EyeBinBlockRows<BLOCK, Format, Mirror, BinBlock<Format, Mirror>>(
+      job, rowBegin, rowEnd);
+}
+
+void PS3EyeBinRowsAVX2(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                       uint32_t rowEnd) {
+  PS3EYE_BAYER_DISPATCH(BinRows, job, rowBegin, rowEnd);
+  _mm256_zeroupper();
+}
+
+// Sums of the 16 quads in 32 raw columns, one per 16-bit lane
+static inline __m256i QuadSums(const uint8_t *even, const uint8_t *odd) {
+  const __m256i low = _mm256_set1_epi16(0x00FF);
+  const __m256i gr = Load(even), bg = Load(odd);
+  return _mm256_add_epi16(
+      _mm256_add_epi16(_mm256_and_si256(gr, low), _mm256_srli_epi16(gr, 8)),
+      _mm256_add_epi16(_mm256_and_si256(bg, low), _mm256_srli_epi16(bg, 8)));
+}
+
+static void BinGreyBlock(const uint8_t *even, const uint8_t *odd,
+                         uint8_t *dst, uint32_t x) {
+  const __m256i two = _mm256_set1_epi16(2);
+  const __m256i lo = QuadSums(even + 2 * x, odd + 2 * x);
+  const __m256i hi = QuadSums(even + 2 * x + 32, odd + 2 * x + 32);
+  _mm256_storeu_si256(
+      (__m256i *)(dst + x),
+      Pack(_mm256_srli_epi16(_mm256_add_epi16(lo, two), 2),
+           _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2)));
+}
+
+void PS3EyeBinGreyRowsAVX2(const PS3EyeGreyJob &job, uint32_t rowBegin,
+                           uint32_t rowEnd) {
+  PS3EyeBinGreyBlockRows<BLOCK, BinGreyBlock>(job, rowBegin, rowEnd);
+  _mm256_zeroupper();
+}
+
+#endif
@@ -0,0 +1,488 @@
+// PS3EyeBayerKernels.h
+// Internal to the Bayer kernels: the per-pixel reference they all share for
+// frame edges, and the entry point of each SIMD translation unit.
+//
+// Every kernel is a template over the output format and mirroring, so the
+// per-pixel work has no branches on either; each translation unit picks the
+// instantiation once per call through a table.
+//
+// The helpers are static rather than plain inline on purpose: the AVX2 unit
+// is compiled with AVX2 code generation, and an inline function emitted there
+// could be the copy the linker keeps for every caller.
+
+#pragma once
+
+#include "PS3EyeBayer.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Both of a row's neighbour rows, with the frame edges mirrored
+static inline void PS3EyeBayerRows(const PS3EyeBayerJob &job, uint32_t y,
+                                   const uint8_t **above, const uint8_t **row,
+                                   const uint8_t **below) {
+  uint32_t yAbove = y == 0 ? 1 : y - 1;
+  uint32_t yBelow = y == job.height - 1 ? job.height - 2 : y + 1;
+  *above = job.bayer + static_cast<size_t>(yAbove) * job.bayerStride;
+  *row = job.bayer + static_cast<size_t>(y) * job.bayerStride;
+  *below = job.bayer + static_cast<size_t>(yBelow) * job.bayerStride;
+}
+
+// Output row that raw row y is written to
+static inline uint8_t *PS3EyeBayerDstRow(const PS3EyeBayerJob &job,
+                                         uint32_t y) {
+  uint32_t row = job.flipVertical ? job.height - 1 - y : y;
+  return job.dst + static_cast<size_t>(row) * job.dstStride;
+}
+
+static inline uint8_t PS3EyeAvg2(uint32_t a, uint32_t b) {
+  return static_cast<uint8_t>((a + b + 1) >> 1);
+}
+
+static inline uint8_t PS3EyeAvg4(uint32_t a, uint32_t b, uint32_t c,
+                                 uint32_t d) {
+  return static_cast<uint8_t>((a + b + c + d + 2) >> 2);
+}
+
+template <PS3EyeBayerFormat Format> struct PS3EyeBayerLayout {
+  static const uint32_t bytesPerPixel =
+      Format == PS3EyeBayerFormat::RGBA || Format == PS3EyeBayerFormat::BGRA
+          ? 4
+          : 3;
+  // Red is byte 0 (else blue is)
+  static const bool redFirst =
+      Format == PS3EyeBayerFormat::RGB || Format == PS3EyeBayerFormat::RGBA;
+};
+
+template <PS3EyeBayerFormat Format>
+static inline void PS3EyeStorePixel(uint8_t *out, uint8_t r, uint8_t g,
+                                    uint8_t b) {
+  typedef PS3EyeBayerLayout<Format> Layout;
+  out[0] = Layout::redFirst ? r : b;
+  out[1] = g;
+  out[2] = Layout::redFirst ? b : r;
+  if (Layout::bytesPerPixel == 4)
+    out[3] = 255;
+}
+
+// Reference interpolation of raw pixel x of one row. Rows alternate between
+// G R (even y) and B G (odd y) sites.
+static inline void PS3EyeInterpolatePixel(const PS3EyeBayerJob &job,
+                                          const uint8_t *a, const uint8_t *c,
+                                          const uint8_t *b, bool oddRow,
+                                          uint32_t x, uint8_t *red,
+                                          uint8_t *green, uint8_t *blue) {
+  uint32_t l = x == 0 ? 1 : x - 1;
+  uint32_t r = x == job.width - 1 ? job.width - 2 : x + 1;
+  if (!oddRow && !(x & 1)) { // G, R to the sides
+    *red = PS3EyeAvg2(c[l], c[r]);
+    *green = c[x];
+    *blue = PS3EyeAvg2(a[x], b[x]);
+  } else if (!oddRow) { // R
+    *red = c[x];
+    *green = PS3EyeAvg4(a[x], b[x], c[l], c[r]);
+    *blue = PS3EyeAvg4(a[l], a[r], b[l], b[r]);
+  } else if (!(x & 1)) { // B
+    *red = PS3EyeAvg4(a[l], a[r], b[l], b[r]);
+    *green = PS3EyeAvg4(a[x], b[x], c[l], c[r]);
+    *blue = c[x];
+  } else { // G, B to the sides
+    *red = PS3EyeAvg2(a[x], b[x]);
+    *green = c[x];
+    *blue = PS3EyeAvg2(c[l], c[r]);
+  }
+}
+
+// Reference for raw pixels [xBegin, xEnd) of one row. dst is the output row.
+template <PS3EyeBayerFormat Format, bool Mirror>
+static inline void PS3EyeDemosaicSpan(const PS3EyeBayerJob &job,
+                                      const uint8_t *a, const uint8_t *c,
+                                      const uint8_t *b, bool oddRow,
+                                      uint8_t *dst, uint32_t xBegin,
+                                      uint32_t xEnd) {
+  const uint32_t bpp = PS3EyeBayerLayout<Format>::bytesPerPixel;
+  for (uint32_t x = xBegin; x < xEnd; x++) {
+    uint8_t red, green, blue;
+    PS3EyeInterpolatePixel(job, a, c, b, oddRow, x, &red, &green, &blue);
+    uint32_t outX = Mirror ? job.width - 1 - x : x;
+    PS3EyeStorePixel<Format>(dst + outX * bpp, red, green, blue);
+  }
+}
+
+typedef void (*PS3EyeBayerBlockFn)(const PS3EyeBayerJob &job,
+                                   const uint8_t *a, const uint8_t *c,
+                                   const uint8_t *b, bool oddRow, uint8_t *dst,
+                                   uint32_t x);
+
+// Rows of one SIMD kernel: Block(job, a, c, b, oddRow, dst, x) converts raw
+// pixels [x, x + N) of a row. Blocks run from x = 2 while
+// x + N + 2 <= width, which keeps every load inside the row and leaves room
+// for stores that run a few bytes past the block; the rest of the row goes
+// through PS3EyeDemosaicSpan.
+//
+// Those overrunning stores always spill into output pixels that are written
+// later: left to right normally, and when mirrored the blocks go right to
+// left through the raw row, so still left to right through the output.
+template <uint32_t N, PS3EyeBayerFormat Format, bool Mirror,
+          PS3EyeBayerBlockFn Block>
+static inline void PS3EyeDemosaicBlockRows(const PS3EyeBayerJob &job,
+                                           uint32_t rowBegin,
+                                           uint32_t rowEnd) {
+  uint32_t blockEnd = 2;
+  while (blockEnd + N + 2 <= job.width)
+    blockEnd += N;
+
+  for (uint32_t y = rowBegin; y < rowEnd; y++) {
+    const uint8_t *a, *c, *b;
+    PS3EyeBayerRows(job, y, &a, &c, &b);
+    const bool oddRow = (y & 1) != 0;
+    uint8_t *dst = PS3EyeBayerDstRow(job, y);
+
+    if (!Mirror) {
+      PS3EyeDemosaicSpan<Format, Mirror>(job, a, c, b, oddRow, dst, 0, 2);
+      for (uint32_t x = 2; x < blockEnd; x += N)
+        Block(job, a, c, b, oddRow, dst, x);
+      PS3EyeDemosaicSpan<Format, Mirror>(job, a, c, b, oddRow, dst, blockEnd,
+                                         job.width);
+    } else {
+      PS3EyeDemosaicSpan<Format, Mirror>(job, a, c, b, oddRow, dst, blockEnd,
+                                         job.width);
+      for (uint32_t x = blockEnd; x > 2; x -= N)
+        Block(job, a, c, b, oddRow, dst, x - N);
+      PS3EyeDemosaicSpan<Format, Mirror>(job, a, c, b, oddRow, dst, 0, 2);
+    }
+  }
+}
+
+typedef void (*PS3EyeBayerRowsFn)(const PS3EyeBayerJob &job,
+                                  uint32_t rowBegin, uint32_t rowEnd);
+
+// Pick Rows<Format, Mirror> for a job
+#define PS3EYE_BAYER_DISPATCH(Rows, job, rowBegin, rowEnd)                     \
+  do {                                                                         \
+    static const PS3EyeBayerRowsFn table[4][2] = {                             \
+        {Rows<PS3EyeBayerFormat::RGB, false>,                                  \
+         Rows<PS3EyeBayerFormat::RGB, true>},                                  \
+        {Rows<PS3EyeBayerFormat::BGR, false>,                                  \
+         Rows<PS3EyeBayerFormat::BGR, true>},                                  \
+        {Rows<PS3EyeBayerFormat::RGBA, false>,                                 \
+         Rows<PS3EyeBayerFormat::RGBA, true>},                                 \
+        {Rows<PS3EyeBayerFormat::BGRA, false>,                                 \
+         Rows<PS3EyeBayerFormat::BGRA, true>}};                                \
+    table[static_cast<uint32_t>((job).format)][(job).mirror ? 1 : 0](          \
+        job, rowBegin, rowEnd);                                                \
+  } while (0)
+
+//------------------------------------------------------------------------------
+// YUV
+//------------------------------------------------------------------------------
+
+// BT.601 limited range in 8.8 fixed point. Every intermediate fits 16 bits
+// unsigned, which the SIMD kernels rely on: luma peaks at 56228, and chroma
+// is offset by 128.5 * 256 so it never goes negative.
+static inline uint8_t PS3EyeLuma(uint32_t r, uint32_t g, uint32_t b) {
+  return static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline uint8_t PS3EyeChromaU(uint32_t r, uint32_t g, uint32_t b) {
+  return static_cast<uint8_t>((32896 + 112 * b - 38 * r - 74 * g) >> 8);
+}
+
+static inline uint8_t PS3EyeChromaV(uint32_t r, uint32_t g, uint32_t b) {
+  return static_cast<uint8_t>((32896 + 112 * r - 94 * g - 18 * b) >> 8);
+}
+
+// The YUV job's raw frame, for the row and pixel helpers above
+static inline PS3EyeBayerJob PS3EyeYuvRawJob(const PS3EyeYuvJob &job) {
+  PS3EyeBayerJob raw = {job.bayer,  job.bayerStride,        nullptr,
+                        0,          job.width,              job.height,
+                        PS3EyeBayerFormat::RGB, false, false};
+  return raw;
+}
+
+// Reference luma for raw pixels [xBegin, xEnd) of one row
+static inline void PS3EyeLumaSpan(const PS3EyeBayerJob &job, const uint8_t *a,
+                                  const uint8_t *c, const uint8_t *b,
+                                  bool oddRow, uint8_t *dst, uint32_t xBegin,
+                                  uint32_t xEnd) {
+  for (uint32_t x = xBegin; x < xEnd; x++) {
+    uint8_t red, green, blue;
+    PS3EyeInterpolatePixel(job, a, c, b, oddRow, x, &red, &green, &blue);
+    dst[x] = PS3EyeLuma(red, green, blue);
+  }
+}
+
+// Reference YUY2 for raw pixels [xBegin, xEnd) of one row, both even. Each
+// pixel pair's chroma is that of its mean colour.
+static inline void PS3EyeYuy2Span(const PS3EyeBayerJob &job, const uint8_t *a,
+                                  const uint8_t *c, const uint8_t *b,
+                                  bool oddRow, uint8_t *dst, uint32_t xBegin,
+                                  uint32_t xEnd) {
+  for (uint32_t x = xBegin; x < xEnd; x += 2) {
+    uint8_t r0, g0, b0, r1, g1, b1;
+    PS3EyeInterpolatePixel(job, a, c, b, oddRow, x, &r0, &g0, &b0);
+    PS3EyeInterpolatePixel(job, a, c, b, oddRow, x + 1, &r1, &g1, &b1);
+    const uint32_t red = PS3EyeAvg2(r0, r1), green = PS3EyeAvg2(g0, g1);
+    const uint32_t blue = PS3EyeAvg2(b0, b1);
+    uint8_t *out = dst + x * 2;
+    out[0] = PS3EyeLuma(r0, g0, b0);
+    out[1] = PS3EyeChromaU(red, green, blue);
+    out[2] = PS3EyeLuma(r1, g1, b1);
+    out[3] = PS3EyeChromaV(red, green, blue);
+  }
+}
+
+// Reference chroma for the quads in raw columns [xBegin, xEnd) of a G R row
+// and the B G row below it. u and v are the chroma rows (NV12: u only).
+template <PS3EyeYuvFormat Format>
+static inline void PS3EyeChromaSpan(const uint8_t *even, const uint8_t *odd,
+                                    uint8_t *u, uint8_t *v, uint32_t xBegin,
+                                    uint32_t xEnd) {
+  for (uint32_t x = xBegin; x < xEnd; x += 2) {
+    const uint32_t red = even[x + 1], blue = odd[x];
+    const uint32_t green = PS3EyeAvg2(even[x], odd[x + 1]);
+    if (Format == PS3EyeYuvFormat::NV12) {
+      u[x] = PS3EyeChromaU(red, green, blue);
+      u[x + 1] = PS3EyeChromaV(red, green, blue);
+    } else {
+      u[x / 2] = PS3EyeChromaU(red, green, blue);
+      v[x / 2] = PS3EyeChromaV(red, green, blue);
+    }
+  }
+}
+
+typedef void (*PS3EyeChromaBlockFn)(const uint8_t *even, const uint8_t *odd,
+                                    uint8_t *u, uint8_t *v, uint32_t x);
+
+typedef void (*PS3EyeBayerSpanFn)(const PS3EyeBayerJob &job,
+                                  const uint8_t *a, const uint8_t *c,
+                                  const uint8_t *b, bool oddRow, uint8_t *dst,
+                                  uint32_t xBegin, uint32_t xEnd);
+
+// Rows of one SIMD kernel with a single output row per raw row at
+// dst + y * dstStride, such as YUY2 and grey. Block converts raw pixels
+// [x, x + N) of a row, laid out like the RGB blocks; Span is the reference
+// for the edges.
+template <uint32_t N, PS3EyeBayerBlockFn Block, PS3EyeBayerSpanFn Span>
+static inline void PS3EyeRowBlockRows(const PS3EyeBayerJob &raw, uint8_t *dst,
+                                      uint32_t dstStride, uint32_t rowBegin,
+                                      uint32_t rowEnd) {
+  uint32_t blockEnd = 2;
+  while (blockEnd + N + 2 <= raw.width)
+    blockEnd += N;
+
+  for (uint32_t y = rowBegin; y < rowEnd; y++) {
+    const uint8_t *a, *c, *b;
+    PS3EyeBayerRows(raw, y, &a, &c, &b);
+    const bool oddRow = (y & 1) != 0;
+    uint8_t *row = dst + static_cast<size_t>(y) * dstStride;
+    Span(raw, a, c, b, oddRow, row, 0, 2);
+    for (uint32_t x = 2; x < blockEnd; x += N)
+      Block(raw, a, c, b, oddRow, row, x);
+    Span(raw, a, c, b, oddRow, row, blockEnd, raw.width);
+  }
+}
+
+template <uint32_t N, PS3EyeBayerBlockFn Block>
+static inline void PS3EyeDemosaicYuy2BlockRows(const PS3EyeYuvJob &job,
+                                               uint32_t rowBegin,
+                                               uint32_t rowEnd) {
+  PS3EyeRowBlockRows<N, Block, PS3EyeYuy2Span>(
+      PS3EyeYuvRawJob(job), job.y, job.yStride, rowBegin, rowEnd);
+}
+
+// Rows of one SIMD 4:2:0 kernel. LumaBlock converts raw pixels
+// [x, x + LumaN) of a row to luma, laid out like the RGB blocks; ChromaBlock
+// converts the quads in raw columns [x, x + ChromaN) of a row pair, which
+// need no neighbours and so run from x = 0 while x + ChromaN <= width.
+template <uint32_t LumaN, PS3EyeBayerBlockFn LumaBlock, uint32_t ChromaN,
+          PS3EyeYuvFormat Format, PS3EyeChromaBlockFn ChromaBlock>
+static inline void PS3EyeDemosaicYuvBlockRows(const PS3EyeYuvJob &job,
+                                              uint32_t rowBegin,
+                                              uint32_t rowEnd) {
+  const PS3EyeBayerJob raw = PS3EyeYuvRawJob(job);
+  uint32_t lumaEnd = 2;
+  while (lumaEnd + LumaN + 2 <= job.width)
+    lumaEnd += LumaN;
+  uint32_t chromaEnd = 0;
+  while (chromaEnd + ChromaN <= job.width)
+    chromaEnd += ChromaN;
+
+  for (uint32_t y = rowBegin; y < rowEnd; y++) {
+    const uint8_t *a, *c, *b;
+    PS3EyeBayerRows(raw, y, &a, &c, &b);
+    const bool oddRow = (y & 1) != 0;
+    uint8_t *luma = job.y + static_cast<size_t>(y) * job.yStride;
+    PS3EyeLumaSpan(raw, a, c, b, oddRow, luma, 0, 2);
+    for (uint32_t x = 2; x < lumaEnd; x += LumaN)
+      LumaBlock(raw, a, c, b, oddRow, luma, x);
+    PS3EyeLumaSpan(raw, a, c, b, oddRow, luma, lumaEnd, job.width);
+
+    if (oddRow)
+      continue;
+    const size_t chromaRow = static_cast<size_t>(y / 2) * job.uvStride;
+    uint8_t *u = job.u + chromaRow;
+    uint8_t *v = Format == PS3EyeYuvFormat::I420 ? job.v + chromaRow : nullptr;
+    for (uint32_t x = 0; x < chromaEnd; x += ChromaN)
+      ChromaBlock(c, b, u, v, x);
+    PS3EyeChromaSpan<Format>(c, b, u, v, chromaEnd, job.width);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Grey
+//------------------------------------------------------------------------------
+
+static inline PS3EyeBayerJob PS3EyeGreyRawJob(const PS3EyeGreyJob &job) {
+  PS3EyeBayerJob raw = {job.bayer,  job.bayerStride,        nullptr,
+                        0,          job.width,              job.height,
+                        PS3EyeBayerFormat::RGB, false, false};
+  return raw;
+}
+
+// Reference grey for raw pixels [xBegin, xEnd) of one row: the [1 2 1]
+// column sums, then [1 2 1] across them, rounded. 16 * 255 fits 16 bits.
+static inline void PS3EyeGreySpan(const PS3EyeBayerJob &job, const uint8_t *a,
+                                  const uint8_t *c, const uint8_t *b,
+                                  bool oddRow, uint8_t *dst, uint32_t xBegin,
+                                  uint32_t xEnd) {
+  (void)oddRow;
+  for (uint32_t x = xBegin; x < xEnd; x++) {
+    uint32_t l = x == 0 ? 1 : x - 1;
+    uint32_t r = x == job.width - 1 ? job.width - 2 : x + 1;
+    uint32_t sum = (a[l] + 2 * c[l] + b[l]) + 2 * (a[x] + 2 * c[x] + b[x]) +
+                   (a[r] + 2 * c[r] + b[r]);
+    dst[x] = static_cast<uint8_t>((sum + 8) >> 4);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Binning
+//------------------------------------------------------------------------------
+
+// Output row that quad row y (raw rows 2y and 2y + 1) is written to
+static inline uint8_t *PS3EyeBinDstRow(const PS3EyeBayerJob &job,
+                                       uint32_t y) {
+  uint32_t row = job.flipVertical ? job.height / 2 - 1 - y : y;
+  return job.dst + static_cast<size_t>(row) * job.dstStride;
+}
+
+// Reference for binned pixels [xBegin, xEnd) of the quad row on raw rows
+// even (G R) and odd (B G). dst is the output row.
+template <PS3EyeBayerFormat Format, bool Mirror>
+static inline void PS3EyeBinSpan(const PS3EyeBayerJob &job,
+                                 const uint8_t *even, const uint8_t *odd,
+                                 uint8_t *dst, uint32_t xBegin,
+                                 uint32_t xEnd) {
+  const uint32_t bpp = PS3EyeBayerLayout<Format>::bytesPerPixel;
+  for (uint32_t x = xBegin; x < xEnd; x++) {
+    uint32_t outX = Mirror ? job.width / 2 - 1 - x : x;
+    PS3EyeStorePixel<Format>(dst + outX * bpp, even[2 * x + 1],
+                             PS3EyeAvg2(even[2 * x], odd[2 * x + 1]),
+                             odd[2 * x]);
+  }
+}
+
+// Reference grey for binned pixels [xBegin, xEnd) of a quad row
+static inline void PS3EyeBinGreySpan(const uint8_t *even, const uint8_t *odd,
+                                     uint8_t *dst, uint32_t xBegin,
+                                     uint32_t xEnd) {
+  for (uint32_t x = xBegin; x < xEnd; x++) {
+    dst[x] = PS3EyeAvg4(even[2 * x], even[2 * x + 1], odd[2 * x],
+                        odd[2 * x + 1]);
+  }
+}
+
+typedef void (*PS3EyeBinBlockFn)(const PS3EyeBayerJob &job,
+                                 const uint8_t *even, const uint8_t *odd,
+                                 uint8_t *dst, uint32_t x);
+
+// Rows of one SIMD binning kernel: Block bins output pixels [x, x + N) of a
+// quad row. Quads need no neighbours, but blocks still run from x = 2 while
+// x + N + 2 <= width / 2, so a store that runs past its block spills into
+// pixels written later, in the same order as PS3EyeDemosaicBlockRows.
+template <uint32_t N, PS3EyeBayerFormat Format, bool Mirror,
+          PS3EyeBinBlockFn Block>
+static inline void PS3EyeBinBlockRows(const PS3EyeBayerJob &job,
+                                      uint32_t rowBegin, uint32_t rowEnd) {
+  const uint32_t width = job.width / 2;
+  const uint32_t head = width < 2 ? width : 2;
+  uint32_t blockEnd = head;
+  while (blockEnd + N + 2 <= width)
+    blockEnd += N;
+
+  for (uint32_t y = rowBegin; y < rowEnd; y++) {
+    const uint8_t *even = job.bayer + static_cast<size_t>(2 * y) *
+                                          job.bayerStride;
+    const uint8_t *odd = even + job.bayerStride;
+    uint8_t *dst = PS3EyeBinDstRow(job, y);
+
+    if (!Mirror) {
+      PS3EyeBinSpan<Format, Mirror>(job, even, odd, dst, 0, head);
+      for (uint32_t x = head; x < blockEnd; x += N)
+        Block(job, even, odd, dst, x);
+      PS3EyeBinSpan<Format, Mirror>(job, even, odd, dst, blockEnd, width);
+    } else {
+      PS3EyeBinSpan<Format, Mirror>(job, even, odd, dst, blockEnd, width);
+      for (uint32_t x = blockEnd; x > head; x -= N)
+        Block(job, even, odd, dst, x - N);
+      PS3EyeBinSpan<Format, Mirror>(job, even, odd, dst, 0, head);
+    }
+  }
+}
+
+typedef void (*PS3EyeBinGreyBlockFn)(const uint8_t *even, const uint8_t *odd,
+                                     uint8_t *dst, uint32_t x);
+
+// Rows of one SIMD grey binning kernel. Block writes exactly its N pixels,
+// so blocks run from x = 0 while x + N <= width / 2.
+template <uint32_t N, PS3EyeBinGreyBlockFn Block>
+static inline void PS3EyeBinGreyBlockRows(const PS3EyeGreyJob &job,
+                                          uint32_t rowBegin, uint32_t rowEnd) {
+  const uint32_t width = job.width / 2;
+  const uint32_t blockEnd = width / N * N;
+  for (uint32_t y = rowBegin; y < rowEnd; y++) {
+    const uint8_t *even = job.bayer + static_cast<size_t>(2 * y) *
+                                          job.bayerStride;
+    const uint8_t *odd = even + job.bayerStride;
+    uint8_t *dst = job.dst + static_cast<size_t>(y) * job.dstStride;
+    for (uint32_t x = 0; x < blockEnd; x += N)
+      Block(even, odd, dst, x);
+    PS3EyeBinGreySpan(even, odd, dst, blockEnd, width);
+  }
+}
+
+void PS3EyeDemosaicRowsSSE2(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                            uint32_t rowEnd);
+void PS3EyeDemosaicRowsAVX2(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                            uint32_t rowEnd);
+void PS3EyeDemosaicRowsNEON(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                            uint32_t rowEnd);
+
+void PS3EyeDemosaicYuvRowsSSE2(const PS3EyeYuvJob &job, uint32_t rowBegin,
+                               uint32_t rowEnd);
+void PS3EyeDemosaicYuvRowsAVX2(const PS3EyeYuvJob &job, uint32_t rowBegin,
+                               uint32_t rowEnd);
+void PS3EyeDemosaicYuvRowsNEON(const PS3EyeYuvJob &job, uint32_t rowBegin,
+                               uint32_t rowEnd);
+
+void PS3EyeBayerToGreyRowsSSE2(const PS3EyeGreyJob &job, uint32_t rowBegin,
+                               uint32_t rowEnd);
+void PS3EyeBayerToGreyRowsAVX2(const PS3EyeGreyJob &job, uint32_t rowBegin,
+                               uint32_t rowEnd);
+void PS3EyeBayerToGreyRowsNEON(const PS3EyeGreyJob &job, uint32_t rowBegin,
+                               uint32_t rowEnd);
+
+void PS3EyeBinRowsSSE2(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                       uint32_t rowEnd);
+void PS3EyeBinRowsAVX2(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                       uint32_t rowEnd);
+void PS3EyeBinRowsNEON(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                       uint32_t rowEnd);
+
+void PS3EyeBinGreyRowsSSE2(const PS3EyeGreyJob &job, uint32_t rowBegin,
+                           uint32_t rowEnd);
+void PS3EyeBinGreyRowsAVX2(const PS3EyeGreyJob &job, uint32_t rowBegin,
+                           uint32_t rowEnd);
+void PS3EyeBinGreyRowsNEON(const PS3EyeGreyJob &job, uint32_t rowBegin,
+                           uint32_t rowEnd);
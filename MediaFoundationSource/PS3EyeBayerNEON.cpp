@@ -0,0 +1,320 @@
+// PS3EyeBayerNEON.cpp
+// NEON Bayer kernel, 16 pixels per step
+
+#include "PS3EyeBayerKernels.h"
+
+#if defined(_M_ARM64) || defined(__aarch64__) || defined(__ARM_NEON)
+
+#include <arm_neon.h>
+
+static const uint32_t BLOCK = 16;
+
+// (a + b + c + d + 2) >> 2 per byte, widened so it rounds exactly like the
+// reference
+static inline uint8x16_t Avg4(uint8x16_t a, uint8x16_t b, uint8x16_t c,
+                              uint8x16_t d) {
+  uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(a), vget_low_u8(b)),
+                            vaddl_u8(vget_low_u8(c), vget_low_u8(d)));
+  uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(a), vget_high_u8(b)),
+                            vaddl_u8(vget_high_u8(c), vget_high_u8(d)));
+  return vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2));
+}
+
+// Even pixels from even, odd pixels from odd
+static inline uint8x16_t Select(uint8x16_t even, uint8x16_t odd) {
+  const uint8x16_t mask = vreinterpretq_u8_u16(vdupq_n_u16(0x00FF));
+  return vbslq_u8(mask, even, odd);
+}
+
+// Bytes in reverse order
+static inline uint8x16_t Reverse(uint8x16_t v) {
+  const uint8x16_t halves = vrev64q_u8(v);
+  return vcombine_u8(vget_high_u8(halves), vget_low_u8(halves));
+}
+
+// R, G, B of pixels [x, x + 16), x even
+static inline void Interpolate(const uint8_t *a, const uint8_t *c,
+                               const uint8_t *b, uint32_t x, bool oddRow,
+                               uint8x16_t *red, uint8x16_t *green,
+                               uint8x16_t *blue) {
+  const uint8x16_t a0 = vld1q_u8(a + x), b0 = vld1q_u8(b + x);
+  const uint8x16_t cl = vld1q_u8(c + x - 1), c0 = vld1q_u8(c + x);
+  const uint8x16_t cr = vld1q_u8(c + x + 1);
+
+  // vrhaddq_u8 is (a + b + 1) >> 1, as in the reference
+  const uint8x16_t sides = vrhaddq_u8(cl, cr);
+  const uint8x16_t vertical = vrhaddq_u8(a0, b0);
+  const uint8x16_t cross = Avg4(a0, b0, cl, cr);
+  const uint8x16_t diagonal =
+      Avg4(vld1q_u8(a + x - 1), vld1q_u8(a + x + 1), vld1q_u8(b + x - 1),
+           vld1q_u8(b + x + 1));
+
+  if (!oddRow) { // G R
+    *red = Select(sides, c0);
+    *green = Select(c0, cross);
+    *blue = Select(vertical, diagonal);
+  } else { // B G
+    *red = Select(diagonal, vertical);
+    *green = Select(cross, c0);
+    *blue = Select(c0, sides);
+  }
+}
+
+template <PS3EyeBayerFormat Format>
+static inline void Store(uint8_t *out, uint8x16_t red, uint8x16_t green,
+                         uint8x16_t blue) {
+  typedef PS3EyeBayerLayout<Format> Layout;
+  if (Layout::bytesPerPixel == 4) {
+    uint8x16x4_t pixels;
+    pixels.val[0] = Layout::redFirst ? red : blue;
+    pixels.val[1] = green;
+    pixels.val[2] = Layout::redFirst ? blue : red;
+    pixels.val[3] = vdupq_n_u8(255);
+    vst4q_u8(out, pixels);
+  } else {
+    uint8x16x3_t pixels;
+    pixels.val[0] = Layout::redFirst ? red : blue;
+    pixels.val[1] = green;
+    pixels.val[2] = Layout::redFirst ? blue : red;
+    vst3q_u8(out, pixels);
+  }
+}
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void Block(const PS3EyeBayerJob &job, const uint8_t *a,
+                  const uint8_t *c, const uint8_t *b, bool oddRow,
+                  uint8_t *dst, uint32_t x) {
+  uint8x16_t red, green, blue;
+  Interpolate(a, c, b, x, oddRow, &red, &green, &blue);
+
+  uint32_t outX = x;
+  if (Mirror) {
+    red = Reverse(red);
+    green = Reverse(green);
+    blue = Reverse(blue);
+    outX = job.width - x - BLOCK;
+  }
+  Store<Format>(dst + outX * PS3EyeBayerLayout<Format>::bytesPerPixel, red,
+                green, blue);
+}
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void Rows(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                 uint32_t rowEnd) {
+  PS3EyeDemosaicBlockRows<BLOCK, Format, Mirror, Block<Format, Mirror>>(
+      job, rowBegin, rowEnd);
+}
+
+void PS3EyeDemosaicRowsNEON(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                            uint32_t rowEnd) {
+  PS3EYE_BAYER_DISPATCH(Rows, job, rowBegin, rowEnd);
+}
+
+//------------------------------------------------------------------------------
+// YUV
+//------------------------------------------------------------------------------
+
+static const uint32_t CHROMA_BLOCK = 32;
+
+// BT.601 luma of 16 pixels, as PS3EyeLuma (vrshrn_n_u16 adds the 128)
+static inline uint8x16_t Luma(uint8x16_t red, uint8x16_t green,
+                              uint8x16_t blue) {
+  uint16x8_t lo = vmull_u8(vget_low_u8(red), vdup_n_u8(66));
+  lo = vmlal_u8(lo, vget_low_u8(green), vdup_n_u8(129));
+  lo = vmlal_u8(lo, vget_low_u8(blue), vdup_n_u8(25));
+  uint16x8_t hi = vmull_u8(vget_high_u8(red), vdup_n_u8(66));
+  hi = vmlal_u8(hi, vget_high_u8(green), vdup_n_u8(129));
+  hi = vmlal_u8(hi, vget_high_u8(blue), vdup_n_u8(25));
+  return vaddq_u8(vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)),
+                  vdupq_n_u8(16));
+}
+
+static void LumaBlock(const PS3EyeBayerJob &job, const uint8_t *a,
+                      const uint8_t *c, const uint8_t *b, bool oddRow,
+                      uint8_t *dst, uint32_t x) {
+  (void)job;
+  uint8x16_t red, green, blue;
+  Interpolate(a, c, b, x, oddRow, &red, &green, &blue);
+  vst1q_u8(dst + x, Luma(red, green, blue));
+}
+
+// bias + p * pos - q * neg - r * neg2 per byte, narrowed by 8 bits. The
+// products wrap, but the sums end up in 0..65535.
+static inline uint8x8_t Chroma(uint8x8_t pos, uint8_t kPos, uint8x8_t neg,
+                               uint8_t kNeg, uint8x8_t neg2, uint8_t kNeg2) {
+  uint16x8_t sum = vdupq_n_u16(32896);
+  sum = vmlal_u8(sum, pos, vdup_n_u8(kPos));
+  sum = vmlsl_u8(sum, neg, vdup_n_u8(kNeg));
+  sum = vmlsl_u8(sum, neg2, vdup_n_u8(kNeg2));
+  return vshrn_n_u16(sum, 8);
+}
+
+template <PS3EyeYuvFormat Format>
+static void ChromaBlock(const uint8_t *even, const uint8_t *odd, uint8_t *u,
+                        uint8_t *v, uint32_t x) {
+  // 16 quads: G R pairs from the even row, B G pairs from the odd one
+  const uint8x16x2_t gr = vld2q_u8(even + x), bg = vld2q_u8(odd + x);
+  const uint8x16_t red = gr.val[1], blue = bg.val[0];
+  const uint8x16_t green = vrhaddq_u8(gr.val[0], bg.val[1]);
+
+  uint8x16x2_t uv;
+  uv.val[0] = vcombine_u8(
+      Chroma(vget_low_u8(blue), 112, vget_low_u8(red), 38, vget_low_u8(green),
+             74),
+      Chroma(vget_high_u8(blue), 112, vget_high_u8(red), 38,
+             vget_high_u8(green), 74));
+  uv.val[1] = vcombine_u8(
+      Chroma(vget_low_u8(red), 112, vget_low_u8(green), 94, vget_low_u8(blue),
+             18),
+      Chroma(vget_high_u8(red), 112, vget_high_u8(green), 94,
+             vget_high_u8(blue), 18));
+  if (Format == PS3EyeYuvFormat::NV12) {
+    vst2q_u8(u + x, uv);
+  } else {
+    vst1q_u8(u + x / 2, uv.val[0]);
+    vst1q_u8(v + x / 2, uv.val[1]);
+  }
+}
+
+template <PS3EyeYuvFormat Format>
+static void YuvRows(const PS3EyeYuvJob &job, uint32_t rowBegin,
+                    uint32_t rowEnd) {
+  PS3EyeDemosaicYuvBlockRows<BLOCK, LumaBlock, CHROMA_BLOCK, Format,
+                             ChromaBlock<Format>>(job, rowBegin, rowEnd);
+}
+
+// Rounded means of the 8 pixel pairs of 16 bytes
+static inline uint16x8_t PairMean(uint8x16_t v) {
+  return vrshrq_n_u16(vpaddlq_u8(v), 1);
+}
+
+// As Chroma, for colours already in 16-bit lanes
+static inline uint8x8_t ChromaWide(uint16x8_t pos, uint16_t kPos,
+                                   uint16x8_t neg, uint16_t kNeg,
+                                   uint16x8_t neg2, uint16_t kNeg2) {
+  uint16x8_t sum = vdupq_n_u16(32896);
+  sum = vmlaq_n_u16(sum, pos, kPos);
+  sum = vmlsq_n_u16(sum, neg, kNeg);
+  sum = vmlsq_n_u16(sum, neg2, kNeg2);
+  return vshrn_n_u16(sum, 8);
+}
+
+static void Yuy2Block(const PS3EyeBayerJob &job, const uint8_t *a,
+                      const uint8_t *c, const uint8_t *b, bool oddRow,
+                      uint8_t *dst, uint32_t x) {
+  (void)job;
+  uint8x16_t red, green, blue;
+  Interpolate(a, c, b, x, oddRow, &red, &green, &blue);
+  const uint8x16x2_t y = vuzpq_u8(Luma(red, green, blue), vdupq_n_u8(0));
+  const uint16x8_t r = PairMean(red), g = PairMean(green);
+  const uint16x8_t bl = PairMean(blue);
+
+  uint8x8x4_t pixels;
+  pixels.val[0] = vget_low_u8(y.val[0]); // Y0 of each pair
+  pixels.val[1] = ChromaWide(bl, 112, r, 38, g, 74);
+  pixels.val[2] = vget_low_u8(y.val[1]); // Y1
+  pixels.val[3] = ChromaWide(r, 112, g, 94, bl, 18);
+  vst4_u8(dst + x * 2, pixels);
+}
+
+void PS3EyeDemosaicYuvRowsNEON(const PS3EyeYuvJob &job, uint32_t rowBegin,
+                               uint32_t rowEnd) {
+  if (job.format == PS3EyeYuvFormat::NV12)
+    YuvRows<PS3EyeYuvFormat::NV12>(job, rowBegin, rowEnd);
+  else if (job.format == PS3EyeYuvFormat::I420)
+    YuvRows<PS3EyeYuvFormat::I420>(job, rowBegin, rowEnd);
+  else
+    PS3EyeDemosaicYuy2BlockRows<BLOCK, Yuy2Block>(job, rowBegin, rowEnd);
+}
+
+//------------------------------------------------------------------------------
+// Grey
+//------------------------------------------------------------------------------
+
+// [1 2 1] down the 8 columns at p in rows a, c, b, in 16 bits
+static inline uint16x8_t Column(uint8x8_t a, uint8x8_t c, uint8x8_t b) {
+  return vaddq_u16(vaddl_u8(a, b), vshll_n_u8(c, 1));
+}
+
+// [1 2 1] across the columns, rounded (vrshrn_n_u16 adds the 8)
+static inline uint8x8_t Grey(uint16x8_t l, uint16x8_t m, uint16x8_t r) {
+  return vrshrn_n_u16(vaddq_u16(vaddq_u16(l, r), vshlq_n_u16(m, 1)), 4);
+}
+
+static void GreyBlock(const PS3EyeBayerJob &job, const uint8_t *a,
+                      const uint8_t *c, const uint8_t *b, bool oddRow,
+                      uint8_t *dst, uint32_t x) {
+  (void)job;
+  (void)oddRow;
+  uint8x8_t out[2];
+  for (int i = 0; i < 2; i++) {
+    const uint32_t p = x + i * 8;
+    out[i] = Grey(Column(vld1_u8(a + p - 1), vld1_u8(c + p - 1),
+                         vld1_u8(b + p - 1)),
+                  Column(vld1_u8(a + p), vld1_u8(c + p), vld1_u8(b + p)),
+                  Column(vld1_u8(a + p + 1), vld1_u8(c + p + 1),
+                         vld1_u8(b + p + 1)));
+  }
+  vst1q_u8(dst + x, vcombine_u8(out[0], out[1]));
+}
+
+void PS3EyeBayerToGreyRowsNEON(const PS3EyeGreyJob &job, uint32_t rowBegin,
+                               uint32_t rowEnd) {
+  PS3EyeRowBlockRows<BLOCK, GreyBlock, PS3EyeGreySpan>(
+      PS3EyeGreyRawJob(job), job.dst, job.dstStride, rowBegin, rowEnd);
+}
+
+//------------------------------------------------------------------------------
+// Binning
+//------------------------------------------------------------------------------
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void BinBlock(const PS3EyeBayerJob &job, const uint8_t *even,
+                     const uint8_t *odd, uint8_t *dst, uint32_t x) {
+  // G R and B G deinterleaved; vrhaddq_u8 rounds like PS3EyeAvg2
+  const uint8x16x2_t gr = vld2q_u8(even + 2 * x);
+  const uint8x16x2_t bg = vld2q_u8(odd + 2 * x);
+  uint8x16_t red = gr.val[1], blue = bg.val[0];
+  uint8x16_t green = vrhaddq_u8(gr.val[0], bg.val[1]);
+  uint32_t outX = x;
+  if (Mirror) {
+    red = Reverse(red);
+    green = Reverse(green);
+    blue = Reverse(blue);
+    outX = job.width / 2 - x - BLOCK;
+  }
+  Store<Format>(dst + outX * PS3EyeBayerLayout<Format>::bytesPerPixel, red,
+                green, blue);
+}
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void BinRows(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                    uint32_t rowEnd) {
+  PS3EyeBinBlockRows<BLOCK, Format, Mirror, BinBlock<Format, Mirror>>(
+      job, rowBegin, rowEnd);
+}
+
+void PS3EyeBinRowsNEON(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                       uint32_t rowEnd) {
+  PS3EYE_BAYER_DISPATCH(BinRows, job, rowBegin, rowEnd);
+}
+
+// Means of the 8 quads in 16 raw columns (vrshrn_n_u16 adds the 2)
+static inline uint8x8_t QuadMeans(const uint8_t *even, const uint8_t *odd) {
+  return vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(vld1q_u8(even)), vld1q_u8(odd)),
+                      2);
+}
+
+static void BinGreyBlock(const uint8_t *even, const uint8_t *odd,
+                         uint8_t *dst, uint32_t x) {
+  vst1q_u8(dst + x, vcombine_u8(QuadMeans(even + 2 * x, odd + 2 * x),
+                                QuadMeans(even + 2 * x + 16,
+                                          odd + 2 * x + 16)));
+}
+
+void PS3EyeBinGreyRowsNEON(const PS3EyeGreyJob &job, uint32_t rowBegin,
+                           uint32_t rowEnd) {
+  PS3EyeBinGreyBlockRows<BLOCK, BinGreyBlock>(job, rowBegin, rowEnd);
+}
+
+#endif
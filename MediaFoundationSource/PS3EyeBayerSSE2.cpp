@@ -0,0 +1,380 @@
+// PS3EyeBayerSSE2.cpp
+// SSE2 Bayer kernel, 16 pixels per step
+
+#include "PS3EyeBayerKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) ||            \
+    defined(__i386__)
+
+#include <cstring>
+#include <emmintrin.h>
+
+static const uint32_t BLOCK = 16;
+
+// (a + b + c + d + 2) >> 2 per byte, in 16 bits so it rounds exactly like
+// the reference
+static inline __m128i Avg4(__m128i a, __m128i b, __m128i c, __m128i d) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i two = _mm_set1_epi16(2);
+  __m128i lo = _mm_add_epi16(
+      _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)),
+      _mm_add_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(d, zero)));
+  __m128i hi = _mm_add_epi16(
+      _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)),
+      _mm_add_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(d, zero)));
+  lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+  hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+  return _mm_packus_epi16(lo, hi);
+}
+
+// Even pixels from even, odd pixels from odd
+static inline __m128i Select(__m128i even, __m128i odd) {
+  const __m128i mask = _mm_set1_epi16(0x00FF);
+  return _mm_or_si128(_mm_and_si128(mask, even), _mm_andnot_si128(mask, odd));
+}
+
+// R, G, B of pixels [x, x + 16), x even
+static inline void Interpolate(const uint8_t *a, const uint8_t *c,
+                               const uint8_t *b, uint32_t x, bool oddRow,
+                               __m128i *red, __m128i *green, __m128i *blue) {
+  const __m128i al = _mm_loadu_si128((const __m128i *)(a + x - 1));
+  const __m128i a0 = _mm_loadu_si128((const __m128i *)(a + x));
+  const __m128i ar = _mm_loadu_si128((const __m128i *)(a + x + 1));
+  const __m128i cl = _mm_loadu_si128((const __m128i *)(c + x - 1));
+  const __m128i c0 = _mm_loadu_si128((const __m128i *)(c + x));
+  const __m128i cr = _mm_loadu_si128((const __m128i *)(c + x + 1));
+  const __m128i bl = _mm_loadu_si128((const __m128i *)(b + x - 1));
+  const __m128i b0 = _mm_loadu_si128((const __m128i *)(b + x));
+  const __m128i br = _mm_loadu_si128((const __m128i *)(b + x + 1));
+
+  // _mm_avg_epu8 is (a + b + 1) >> 1, as in the reference
+  const __m128i sides = _mm_avg_epu8(cl, cr);
+  const __m128i vertical = _mm_avg_epu8(a0, b0);
+  const __m128i cross = Avg4(a0, b0, cl, cr);
+  const __m128i diagonal = Avg4(al, ar, bl, br);
+
+  if (!oddRow) { // G R
+    *red = Select(sides, c0);
+    *green = Select(c0, cross);
+    *blue = Select(vertical, diagonal);
+  } else { // B G
+    *red = Select(diagonal, vertical);
+    *green = Select(cross, c0);
+    *blue = Select(c0, sides);
+  }
+}
+
+// 16 pixels of c0, c1, c2, 255 in memory order
+static inline void Interleave4(__m128i c0, __m128i c1, __m128i c2,
+                               __m128i out[4]) {
+  const __m128i alpha = _mm_set1_epi8(-1);
+  const __m128i lo01 = _mm_unpacklo_epi8(c0, c1);
+  const __m128i hi01 = _mm_unpackhi_epi8(c0, c1);
+  const __m128i lo2a = _mm_unpacklo_epi8(c2, alpha);
+  const __m128i hi2a = _mm_unpackhi_epi8(c2, alpha);
+  out[0] = _mm_unpacklo_epi16(lo01, lo2a);
+  out[1] = _mm_unpackhi_epi16(lo01, lo2a);
+  out[2] = _mm_unpacklo_epi16(hi01, hi2a);
+  out[3] = _mm_unpackhi_epi16(hi01, hi2a);
+}
+
+// Bytes in reverse order
+static inline __m128i Reverse(__m128i v) {
+  v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+  v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+  v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+  return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+template <PS3EyeBayerFormat Format>
+static inline void Store(uint8_t *dst, __m128i red, __m128i green,
+                         __m128i blue) {
+  typedef PS3EyeBayerLayout<Format> Layout;
+  __m128i pixels[4];
+  Interleave4(Layout::redFirst ? red : blue, green,
+              Layout::redFirst ? blue : red, pixels);
+
+  if (Layout::bytesPerPixel == 4) {
+    for (int i = 0; i < 4; i++)
+      _mm_storeu_si128((__m128i *)(dst + i * 16), pixels[i]);
+    return;
+  }
+
+  // No byte shuffle in SSE2: 4-byte stores 3 bytes apart, each overwriting
+  // the spare byte of the one before. The last one spills one byte into the
+  // next pixel, which is written afterwards.
+  for (int i = 0; i < 4; i++) {
+    __m128i p = pixels[i];
+    for (int j = 0; j < 4; j++) {
+      uint32_t value = static_cast<uint32_t>(_mm_cvtsi128_si32(p));
+      memcpy(dst + (i * 4 + j) * 3, &value, 4);
+      p = _mm_srli_si128(p, 4);
+    }
+  }
+}
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void Block(const PS3EyeBayerJob &job, const uint8_t *a,
+                  const uint8_t *c, const uint8_t *b, bool oddRow,
+                  uint8_t *dst, uint32_t x) {
+  const uint32_t bpp = PS3EyeBayerLayout<Format>::bytesPerPixel;
+  __m128i red, green, blue;
+  Interpolate(a, c, b, x, oddRow, &red, &green, &blue);
+  if (Mirror) {
+    Store<Format>(dst + (job.width - x - BLOCK) * bpp, Reverse(red),
+                  Reverse(green), Reverse(blue));
+  } else {
+    Store<Format>(dst + x * bpp, red, green, blue);
+  }
+}
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void Rows(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                 uint32_t rowEnd) {
+  PS3EyeDemosaicBlockRows<BLOCK, Format, Mirror, Block<Format, Mirror>>(
+      job, rowBegin, rowEnd);
+}
+
+void PS3EyeDemosaicRowsSSE2(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                            uint32_t rowEnd) {
+  PS3EYE_BAYER_DISPATCH(Rows, job, rowBegin, rowEnd);
+}
+
+//------------------------------------------------------------------------------
+// YUV
+//------------------------------------------------------------------------------
+
+static const uint32_t CHROMA_BLOCK = 32;
+
+// BT.601 luma of 16 pixels, as PS3EyeLuma
+static inline __m128i Luma(__m128i red, __m128i green, __m128i blue) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i kr = _mm_set1_epi16(66), kg = _mm_set1_epi16(129);
+  const __m128i kb = _mm_set1_epi16(25), half = _mm_set1_epi16(128);
+  __m128i lo = _mm_add_epi16(
+      _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(red, zero), kr),
+                    _mm_mullo_epi16(_mm_unpacklo_epi8(green, zero), kg)),
+      _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(blue, zero), kb), half));
+  __m128i hi = _mm_add_epi16(
+      _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(red, zero), kr),
+                    _mm_mullo_epi16(_mm_unpackhi_epi8(green, zero), kg)),
+      _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(blue, zero), kb), half));
+  const __m128i y = _mm_packus_epi16(_mm_srli_epi16(lo, 8),
+                                     _mm_srli_epi16(hi, 8));
+  return _mm_add_epi8(y, _mm_set1_epi8(16));
+}
+
+static void LumaBlock(const PS3EyeBayerJob &job, const uint8_t *a,
+                      const uint8_t *c, const uint8_t *b, bool oddRow,
+                      uint8_t *dst, uint32_t x) {
+  (void)job;
+  __m128i red, green, blue;
+  Interpolate(a, c, b, x, oddRow, &red, &green, &blue);
+  _mm_storeu_si128((__m128i *)(dst + x), Luma(red, green, blue));
+}
+
+// U and V of 8 colours, one per 16-bit lane, as PS3EyeChromaU/V. The
+// products wrap, but the sums end up in 0..65535.
+static inline void ChromaOf(__m128i red, __m128i green, __m128i blue,
+                            __m128i *u, __m128i *v) {
+  const __m128i bias = _mm_set1_epi16(static_cast<short>(32896));
+  *u = _mm_srli_epi16(
+      _mm_add_epi16(
+          _mm_add_epi16(_mm_mullo_epi16(blue, _mm_set1_epi16(112)), bias),
+          _mm_add_epi16(_mm_mullo_epi16(red, _mm_set1_epi16(-38)),
+                        _mm_mullo_epi16(green, _mm_set1_epi16(-74)))),
+      8);
+  *v = _mm_srli_epi16(
+      _mm_add_epi16(
+          _mm_add_epi16(_mm_mullo_epi16(red, _mm_set1_epi16(112)), bias),
+          _mm_add_epi16(_mm_mullo_epi16(green, _mm_set1_epi16(-94)),
+                        _mm_mullo_epi16(blue, _mm_set1_epi16(-18)))),
+      8);
+}
+
+// U and V of the 8 quads in 16 raw columns
+static inline void Chroma(const uint8_t *even, const uint8_t *odd, __m128i *u,
+                          __m128i *v) {
+  const __m128i low = _mm_set1_epi16(0x00FF);
+  const __m128i gr = _mm_loadu_si128((const __m128i *)even);
+  const __m128i bg = _mm_loadu_si128((const __m128i *)odd);
+  const __m128i green =
+      _mm_avg_epu16(_mm_and_si128(gr, low), _mm_srli_epi16(bg, 8));
+  ChromaOf(_mm_srli_epi16(gr, 8), green, _mm_and_si128(bg, low), u, v);
+}
+
+template <PS3EyeYuvFormat Format>
+static void ChromaBlock(const uint8_t *even, const uint8_t *odd, uint8_t *u,
+                        uint8_t *v, uint32_t x) {
+  __m128i u0, v0, u1, v1;
+  Chroma(even + x, odd + x, &u0, &v0);
+  Chroma(even + x + 16, odd + x + 16, &u1, &v1);
+  if (Format == PS3EyeYuvFormat::NV12) {
+    // U in the low byte of each lane, V in the high one: already interleaved
+    _mm_storeu_si128((__m128i *)(u + x),
+                     _mm_or_si128(u0, _mm_slli_epi16(v0, 8)));
+    _mm_storeu_si128((__m128i *)(u + x + 16),
+                     _mm_or_si128(u1, _mm_slli_epi16(v1, 8)));
+  } else {
+    _mm_storeu_si128((__m128i *)(u + x / 2), _mm_packus_epi16(u0, u1));
+    _mm_storeu_si128((__m128i *)(v + x / 2), _mm_packus_epi16(v0, v1));
+  }
+}
+
+template <PS3EyeYuvFormat Format>
+static void YuvRows(const PS3EyeYuvJob &job, uint32_t rowBegin,
+                    uint32_t rowEnd) {
+  PS3EyeDemosaicYuvBlockRows<BLOCK, LumaBlock, CHROMA_BLOCK, Format,
+                             ChromaBlock<Format>>(job, rowBegin, rowEnd);
+}
+
+// Means of the 8 pixel pairs of 16 bytes, one per 16-bit lane
+static inline __m128i PairMean(__m128i v) {
+  return _mm_avg_epu16(_mm_and_si128(v, _mm_set1_epi16(0x00FF)),
+                       _mm_srli_epi16(v, 8));
+}
+
+static void Yuy2Block(const PS3EyeBayerJob &job, const uint8_t *a,
+                      const uint8_t *c, const uint8_t *b, bool oddRow,
+                      uint8_t *dst, uint32_t x) {
+  (void)job;
+  __m128i red, green, blue, u, v;
+  Interpolate(a, c, b, x, oddRow, &red, &green, &blue);
+  const __m128i y = Luma(red, green, blue);
+  ChromaOf(PairMean(red), PairMean(green), PairMean(blue), &u, &v);
+
+  // Y0 U and Y1 V per pair as 16-bit lanes, then interleaved
+  const __m128i y0u = _mm_or_si128(_mm_and_si128(y, _mm_set1_epi16(0x00FF)),
+                                   _mm_slli_epi16(u, 8));
+  const __m128i y1v = _mm_or_si128(_mm_srli_epi16(y, 8), _mm_slli_epi16(v, 8));
+  _mm_storeu_si128((__m128i *)(dst + x * 2), _mm_unpacklo_epi16(y0u, y1v));
+  _mm_storeu_si128((__m128i *)(dst + x * 2 + 16),
+                   _mm_unpackhi_epi16(y0u, y1v));
+}
+
+void PS3EyeDemosaicYuvRowsSSE2(const PS3EyeYuvJob &job, uint32_t rowBegin,
+                               uint32_t rowEnd) {
+  if (job.format == PS3EyeYuvFormat::NV12)
+    YuvRows<PS3EyeYuvFormat::NV12>(job, rowBegin, rowEnd);
+  else if (job.format == PS3EyeYuvFormat::I420)
+    YuvRows<PS3EyeYuvFormat::I420>(job, rowBegin, rowEnd);
+  else
+    PS3EyeDemosaicYuy2BlockRows<BLOCK, Yuy2Block>(job, rowBegin, rowEnd);
+}
+
+//------------------------------------------------------------------------------
+// Grey
+//------------------------------------------------------------------------------
+
+// [1 2 1] down the 16 columns at p in rows a, c, b, in 16 bits
+static inline void Column(const uint8_t *a, const uint8_t *c, const uint8_t *b,
+                          __m128i *lo, __m128i *hi) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i va = _mm_loadu_si128((const __m128i *)a);
+  const __m128i vc = _mm_loadu_si128((const __m128i *)c);
+  const __m128i vb = _mm_loadu_si128((const __m128i *)b);
+  *lo = _mm_add_epi16(
+      _mm_add_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero)),
+      _mm_slli_epi16(_mm_unpacklo_epi8(vc, zero), 1));
+  *hi = _mm_add_epi16(
+      _mm_add_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero)),
+      _mm_slli_epi16(_mm_unpackhi_epi8(vc, zero), 1));
+}
+
+static void GreyBlock(const PS3EyeBayerJob &job, const uint8_t *a,
+                      const uint8_t *c, const uint8_t *b, bool oddRow,
+                      uint8_t *dst, uint32_t x) {
+  (void)job;
+  (void)oddRow;
+  __m128i lLo, lHi, mLo, mHi, rLo, rHi;
+  Column(a + x - 1, c + x - 1, b + x - 1, &lLo, &lHi);
+  Column(a + x, c + x, b + x, &mLo, &mHi);
+  Column(a + x + 1, c + x + 1, b + x + 1, &rLo, &rHi);
+  const __m128i eight = _mm_set1_epi16(8);
+  const __m128i lo = _mm_add_epi16(
+      _mm_add_epi16(lLo, rLo), _mm_add_epi16(_mm_slli_epi16(mLo, 1), eight));
+  const __m128i hi = _mm_add_epi16(
+      _mm_add_epi16(lHi, rHi), _mm_add_epi16(_mm_slli_epi16(mHi, 1), eight));
+  _mm_storeu_si128((__m128i *)(dst + x),
+                   _mm_packus_epi16(_mm_srli_epi16(lo, 4),
+                                    _mm_srli_epi16(hi, 4)));
+}
+
+void PS3EyeBayerToGreyRowsSSE2(const PS3EyeGreyJob &job, uint32_t rowBegin,
+                               uint32_t rowEnd) {
+  PS3EyeRowBlockRows<BLOCK, GreyBlock, PS3EyeGreySpan>(
+      PS3EyeGreyRawJob(job), job.dst, job.dstStride, rowBegin, rowEnd);
+}
+
+//------------------------------------------------------------------------------
+// Binning
+//------------------------------------------------------------------------------
+
+// R, G, B of the 16 quads in raw columns [2x, 2x + 32)
+static inline void BinQuads(const uint8_t *even, const uint8_t *odd,
+                            __m128i *red, __m128i *green, __m128i *blue) {
+  const __m128i low = _mm_set1_epi16(0x00FF);
+  const __m128i gr0 = _mm_loadu_si128((const __m128i *)even);
+  const __m128i gr1 = _mm_loadu_si128((const __m128i *)(even + 16));
+  const __m128i bg0 = _mm_loadu_si128((const __m128i *)odd);
+  const __m128i bg1 = _mm_loadu_si128((const __m128i *)(odd + 16));
+  *red = _mm_packus_epi16(_mm_srli_epi16(gr0, 8), _mm_srli_epi16(gr1, 8));
+  *green = _mm_packus_epi16(
+      _mm_avg_epu16(_mm_and_si128(gr0, low), _mm_srli_epi16(bg0, 8)),
+      _mm_avg_epu16(_mm_and_si128(gr1, low), _mm_srli_epi16(bg1, 8)));
+  *blue = _mm_packus_epi16(_mm_and_si128(bg0, low), _mm_and_si128(bg1, low));
+}
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void BinBlock(const PS3EyeBayerJob &job, const uint8_t *even,
+                     const uint8_t *odd, uint8_t *dst, uint32_t x) {
+  const uint32_t bpp = PS3EyeBayerLayout<Format>::bytesPerPixel;
+  __m128i red, green, blue;
+  BinQuads(even + 2 * x, odd + 2 * x, &red, &green, &blue);
+  if (Mirror) {
+    Store<Format>(dst + (job.width / 2 - x - BLOCK) * bpp, Reverse(red),
+                  Reverse(green), Reverse(blue));
+  } else {
+    Store<Format>(dst + x * bpp, red, green, blue);
+  }
+}
+
+template <PS3EyeBayerFormat Format, bool Mirror>
+static void BinRows(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                    uint32_t rowEnd) {
+  PS3EyeBinBlockRows<BLOCK, Format, Mirror, BinBlock<Format, Mirror>>(
+      job, rowBegin, rowEnd);
+}
+
+void PS3EyeBinRowsSSE2(const PS3EyeBayerJob &job, uint32_t rowBegin,
+                       uint32_t rowEnd) {
+  PS3EYE_BAYER_DISPATCH(BinRows, job, rowBegin, rowEnd);
+}
+
+// Sums of the 8 quads in 16 raw columns, one per 16-bit lane
+static inline __m128i QuadSums(const uint8_t *even, const uint8_t *odd) {
+  const __m128i low = _mm_set1_epi16(0x00FF);
+  const __m128i gr = _mm_loadu_si128((const __m128i *)even);
+  const __m128i bg = _mm_loadu_si128((const __m128i *)odd);
+  return _mm_add_epi16(
+      _mm_add_epi16(_mm_and_si128(gr, low), _mm_srli_epi16(gr, 8)),
+      _mm_add_epi16(_mm_and_si128(bg, low), _mm_srli_epi16(bg, 8)));
+}
+
+static void BinGreyBlock(const uint8_t *even, const uint8_t *odd,
+                         uint8_t *dst, uint32_t x) {
+  const __m128i two = _mm_set1_epi16(2);
+  const __m128i lo = QuadSums(even + 2 * x, odd + 2 * x);
+  const __m128i hi = QuadSums(even + 2 * x + 16, odd + 2 * x + 16);
+  _mm_storeu_si128(
+      (__m128i *)(dst + x),
+      _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(lo, two), 2),
+                       _mm_srli_epi16(_mm_add_epi16(hi, two), 2)));
+}
+
+void PS3EyeBinGreyRowsSSE2(const PS3EyeGreyJob &job, uint32_t rowBegin,
+                           uint32_t rowEnd) {
+  PS3EyeBinGreyBlockRows<BLOCK, BinGreyBlock>(job, rowBegin, rowEnd);
+}
+
+#endif
@@ -0,0 +1,55 @@
+// PS3EyeCamera.h
+// Camera backend used by the capture service. The capture loop only talks to
+// this interface, so it runs the same against the PS3 Eye driver
+// (PS3EyeHardwareCamera) and against generated frames (PS3EyeSyntheticCamera).
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "PS3EyeFrameRing.h"
+
+class PS3EyeCamera {
+public:
+  virtual ~PS3EyeCamera() {}
+
+  // Stable id of the device (USB port path or serial); names its channel
+  virtual const char *GetDeviceId() const = 0;
+
+  // Open the device and program the sensor for the given mode, delivering
+  // frames in format (PS3EYE_FORMAT_RGB24, PS3EYE_FORMAT_BAYER_GRBG or
+  // PS3EYE_FORMAT_GREY8).
+  // Slow (USB enumeration, register writes); the camera is then idle until
+  // Start.
+  virtual bool Open(uint32_t width, uint32_t height, uint32_t fps,
+                    uint32_t format) = 0;
+  virtual void Close() = 0;
+  virtual bool IsOpen() const = 0;
+
+  // Start / stop streaming on an open camera. Fast; the device stays open
+  // and keeps its sensor settings in between (standby).
+  virtual bool Start() = 0;
+  virtual void Stop() = 0;
+  virtual bool IsStreaming() const = 0;
+
+  // Wait up to timeoutMs for the next frame and copy it to buffer (width *
+  // height * bytes per pixel of the format). Returns when the frame came off
+  // the device (PS3EyeTransportTime), taken before any conversion so that
+  // only the wake-up latency of the caller is left in it; 0 without a frame,
+  // on timeout or Interrupt. *flags gets the PS3EYE_FRAME_FLAG_* the backend
+  // knows of for the frame, 0 for a clean one.
+  virtual uint64_t GetFrame(uint8_t *buffer, uint32_t timeoutMs,
+                            uint32_t *flags) = 0;
+
+  // Return a GetFrame in progress early, or the next one if none is. The
+  // only call that may come from another thread than the one using the
+  // camera.
+  virtual void Interrupt() = 0;
+
+  // Sensor state the last frame was taken with (exposure, gain, balance)
+  virtual void GetSettings(PS3EyeFrameMetadata *metadata) const = 0;
+};
+
+typedef std::vector<std::unique_ptr<PS3EyeCamera>> PS3EyeCameraList;
@@ -0,0 +1,339 @@
+// PS3EyeCaptureChannel.cpp
+// Per-camera capture thread
+
+#include "PS3EyeCaptureChannel.h"
+#include "PS3EyeFrameCadence.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// How long the idle loop sleeps waiting for a client before re-checking the
+// idle timeouts
+static const uint32_t CLIENT_POLL_MS = 250;
+
+// A stream is stalled once no frame has come for STALL_PERIODS frame
+// periods, but never less than STALL_MIN_MS so scheduling hiccups at high
+// rates are not mistaken for a lost camera. A freshly started sensor gets
+// FIRST_FRAME_TIMEOUT_MS for its first frame.
+static const uint32_t STALL_PERIODS = 8;
+static const uint32_t STALL_MIN_MS = 100;
+static const uint32_t FIRST_FRAME_TIMEOUT_MS = 1000;
+static const uint32_t WATCHDOG_POLL_MS = 20;
+
+// Longest the capture thread waits in GetFrame before looking at m_running
+// and the lost state again, should a Stop or Interrupt be missed
+static const uint32_t FRAME_WAIT_MS = 100;
+
+// Reconnect tries at once, then backs off doubling from the first delay up
+// to the cap, so a camera that is back within a few hundred milliseconds
+// streams again within the second while a missing one costs one
+// enumeration a second
+static const uint32_t RECONNECT_FIRST_BACKOFF_MS = 25;
+static const uint32_t RECONNECT_MAX_BACKOFF_MS = 1000;
+
+PS3EyeCaptureChannel::PS3EyeCaptureChannel(
+    std::unique_ptr<PS3EyeCamera> camera, const char *name)
+    : m_camera(std::move(camera)), m_running(false), m_stallDeadline(0),
+      m_lost(false), m_frameCount(0), m_state(PS3EyeCaptureState::Closed),
+      m_coldStarts(0), m_warmStarts(0), m_coldTimeToFirstFrame(0),
+      m_warmTimeToFirstFrame(0), m_recoveries(0), m_lastOutage(0) {
+  snprintf(m_name, sizeof(m_name), "%s", name);
+}
+
+PS3EyeCaptureChannel::~PS3EyeCaptureChannel() { Stop(); }
+
+bool PS3EyeCaptureChannel::Start(const PS3EyeCaptureOptions &options) {
+  if (m_running)
+    return true;
+  if (options.fps == 0 ||
+      !m_sharedMemory.Create(m_name, options.largePages, options.format))
+    return false;
+
+  m_options = options;
+  m_frameCount = 0;
+  m_stallDeadline = 0;
+  m_lost = false;
+  m_running = true;
+  m_thread = std::thread(&PS3EyeCaptureChannel::CaptureLoop, this);
+  m_watchdog = std::thread(&PS3EyeCaptureChannel::WatchdogLoop, this);
+  return true;
+}
+
+void PS3EyeCaptureChannel::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_watchdogMutex);
+    m_running = false;
+  }
+  m_watchdogWake.notify_all();
+  m_camera->Interrupt();
+  if (m_watchdog.joinable())
+    m_watchdog.join();
+  if (m_thread.joinable())
+    m_thread.join();
+  m_sharedMemory.Close();
+}
+
+void PS3EyeCaptureChannel::GetStats(PS3EyeCaptureStats *stats) const {
+  stats->state = m_state.load(std::memory_order_relaxed);
+  stats->frameCount = m_frameCount.load(std::memory_order_relaxed);
+  stats->coldStarts = m_coldStarts.load(std::memory_order_relaxed);
+  stats->warmStarts = m_warmStarts.load(std::memory_order_relaxed);
+  stats->coldTimeToFirstFrame =
+      m_coldTimeToFirstFrame.load(std::memory_order_relaxed);
+  stats->warmTimeToFirstFrame =
+      m_warmTimeToFirstFrame.load(std::memory_order_relaxed);
+  stats->recoveries = m_recoveries.load(std::memory_order_relaxed);
+  stats->lastOutage = m_lastOutage.load(std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+// Stall watchdog and recovery
+//------------------------------------------------------------------------------
+
+void PS3EyeCaptureChannel::WatchdogLoop() {
+  std::unique_lock<std::mutex> lock(m_watchdogMutex);
+  while (m_running) {
+    m_watchdogWake.wait_for(lock, std::chrono::milliseconds(WATCHDOG_POLL_MS));
+    if (!m_running || m_stallDeadline == 0 ||
+        PS3EyeTransportTime() < m_stallDeadline)
+      continue;
+    SetLost("no frames");
+    m_camera->Interrupt();
+  }
+}
+
+void PS3EyeCaptureChannel::ArmWatchdog(uint64_t deadline) {
+  std::lock_guard<std::mutex> lock(m_watchdogMutex);
+  // Once the camera is lost only Reconnect may re-arm
+  if (!m_lost)
+    m_stallDeadline = deadline;
+}
+
+bool PS3EyeCaptureChannel::IsLost() {
+  std::lock_guard<std::mutex> lock(m_watchdogMutex);
+  return m_lost;
+}
+
+// Called with m_watchdogMutex held
+void PS3EyeCaptureChannel::SetLost(const char *reason) {
+  m_stallDeadline = 0;
+  if (m_lost)
+    return;
+  m_lost = true;
+  m_sharedMemory.SetCameraState(PS3EYE_CAMERA_LOST);
+
+  char message[128];
+  snprintf(message, sizeof(message),
+           "PS3EyeCaptureChannel %s: camera lost (%s)", m_name, reason);
+  PS3EyeIpcLog(message);
+}
+
+bool PS3EyeCaptureChannel::Reconnect() {
+  m_camera->Close();
+  {
+    std::lock_guard<std::mutex> lock(m_watchdogMutex);
+    m_lost = false;
+  }
+
+  // Open finds the device again by its port, so a camera replugged into the
+  // same port comes back on the same channel. Only while clients wait for
+  // it: without them the camera stays closed, as after closeDelayMs, and the
+  // next client to connect opens it.
+  uint32_t backoffMs = RECONNECT_FIRST_BACKOFF_MS;
+  while (m_running && m_sharedMemory.GetClientCount() > 0) {
+    if (m_camera->Open(PS3EYE_WIDTH, PS3EYE_HEIGHT, m_options.fps,
+                       m_options.format)) {
+      if (m_camera->Start())
+        return true;
+      m_camera->Close();
+    }
+    std::unique_lock<std::mutex> lock(m_watchdogMutex);
+    m_watchdogWake.wait_for(lock, std::chrono::milliseconds(backoffMs),
+                            [this] { return !m_running; });
+    backoffMs = std::min(backoffMs * 2, RECONNECT_MAX_BACKOFF_MS);
+  }
+  return false;
+}
+
+void PS3EyeCaptureChannel::CaptureLoop() {
+  // Private to this thread; channels never touch each other's buffers
+  const uint32_t frameSize = PS3EyeFrameSize(m_options.format);
+  std::vector<uint8_t> frameBuffer(frameSize);
+
+  // The sensor runs at a fixed rate: the cadence numbers frames by the
+  // camera's own count, so a gap in the numbers is frames lost on the way,
+  // and its fitted line dates each frame without the wake-up jitter
+  const int64_t framePeriod = 10000000 / m_options.fps;
+  const uint64_t standbyDelay = m_options.standbyDelayMs * 10000ULL;
+  const uint64_t closeDelay = m_options.closeDelayMs * 10000ULL;
+  const uint64_t stallTimeout = std::max<uint64_t>(
+      STALL_PERIODS * framePeriod, STALL_MIN_MS * 10000ULL);
+  const uint64_t firstFrameTimeout = FIRST_FRAME_TIMEOUT_MS * 10000ULL;
+  PS3EyeFrameCadence cadence(framePeriod);
+  uint64_t lastFrame = 0;
+
+  // Arrival of the newest frame, and of the last one before the camera was
+  // lost while it is being brought back (0 otherwise)
+  uint64_t lastArrival = 0;
+  uint64_t lostAfter = 0;
+  // Clients are shown the camera lost until the next frame
+  bool lostShown = false;
+
+  // When the last client left (0 while there are clients), and when the
+  // current stream was requested, for time-to-first-frame
+  uint64_t idleSince = PS3EyeTransportTime();
+  uint64_t startRequested = 0;
+  bool warmStart = false;
+
+  auto setState = [&](PS3EyeCaptureState state) {
+    m_state.store(state, std::memory_order_relaxed);
+  };
+
+  while (m_running) {
+    PS3EyeCaptureState state = m_state.load(std::memory_order_relaxed);
+
+    if (state != PS3EyeCaptureState::Streaming) {
+      // On-demand: wait for clients, then open if needed and stream
+      if (m_sharedMemory.WaitForClients(CLIENT_POLL_MS)) {
+        startRequested = PS3EyeTransportTime();
+        warmStart = state == PS3EyeCaptureState::Standby;
+        if (!warmStart) {
+          if (!m_camera->Open(PS3EYE_WIDTH, PS3EYE_HEIGHT, m_options.fps,
+                              m_options.format))
+            continue;
+          setState(PS3EyeCaptureState::Standby);
+        }
+        if (!m_camera->Start()) {
+          if (!m_camera->IsOpen())
+            setState(PS3EyeCaptureState::Closed);
+          continue;
+        }
+        (warmStart ? m_warmStarts : m_coldStarts)
+            .fetch_add(1, std::memory_order_relaxed);
+        cadence.Reset(framePeriod);
+        lastFrame = 0;
+        idleSince = 0;
+        setState(PS3EyeCaptureState::Streaming);
+        ArmWatchdog(PS3EyeTransportTime() + firstFrameTimeout);
+      } else if (state == PS3EyeCaptureState::Standby &&
+                 PS3EyeTransportTime() - idleSince >= closeDelay) {
+        m_camera->Close();
+        setState(PS3EyeCaptureState::Closed);
+      }
+      continue;
+    }
+
+    // Lost: the watchdog saw the frames stop, or the device stopped
+    // streaming on its own. Clients keep the newest frame and see the lost
+    // state until the camera is back.
+    if (!m_camera->IsStreaming()) {
+      std::lock_guard<std::mutex> lock(m_watchdogMutex);
+      SetLost("stopped streaming");
+    }
+    if (IsLost()) {
+      if (lostAfter == 0)
+        lostAfter = lastArrival != 0 ? lastArrival : PS3EyeTransportTime();
+      lostShown = true;
+      if (!Reconnect()) {
+        if (!m_running)
+          break;
+        // No clients left: the stream is not brought back, so there is no
+        // outage to count once the next client opens the camera
+        lostAfter = 0;
+        setState(PS3EyeCaptureState::Closed);
+        continue;
+      }
+      cadence.Reset(framePeriod);
+      lastFrame = 0;
+      ArmWatchdog(PS3EyeTransportTime() + firstFrameTimeout);
+      continue;
+    }
+
+    uint32_t frameFlags;
+    const uint64_t arrival =
+        m_camera->GetFrame(frameBuffer.data(), FRAME_WAIT_MS, &frameFlags);
+    // Nothing yet, or interrupted by the watchdog or Stop. A frame that came
+    // in just as the camera was declared lost is not published either.
+    if (arrival == 0 || IsLost())
+      continue;
+    ArmWatchdog(arrival + stallTimeout);
+    lastArrival = arrival;
+
+    const uint64_t frame = cadence.AddFrame(static_cast<int64_t>(arrival));
+    // The driver hands a frame over a period after the sensor finished it
+    const uint64_t timestamp = static_cast<uint64_t>(
+        cadence.FrameTime(frame) - static_cast<int64_t>(cadence.Period()));
+
+    PS3EyeFrameMetadata metadata = {};
+    metadata.arrivalTime = arrival;
+    metadata.flags = frameFlags;
+    m_camera->GetSettings(&metadata);
+    if (frame > lastFrame + 1)
+      metadata.droppedFrames = static_cast<uint32_t>(frame - lastFrame - 1);
+    lastFrame = frame;
+    // The device stopped streaming on its own as this frame came in
+    if (!m_camera->IsStreaming())
+      metadata.flags |= PS3EYE_FRAME_FLAG_PARTIAL | PS3EYE_FRAME_FLAG_CORRUPT;
+    // First frame after an outage: the frames it cost count as dropped, so
+    // clients mark the discontinuity
+    if (lostAfter != 0) {
+      const uint64_t outage = arrival - lostAfter;
+      metadata.droppedFrames =
+          static_cast<uint32_t>(outage / static_cast<uint64_t>(framePeriod));
+      if (metadata.droppedFrames > 0)
+        metadata.droppedFrames--;
+      m_lastOutage.store(outage, std::memory_order_relaxed);
+      m_recoveries.fetch_add(1, std::memory_order_relaxed);
+      lostAfter = 0;
+
+      char message[128];
+      snprintf(message, sizeof(message),
+               "PS3EyeCaptureChannel %s: camera back after %.1f ms", m_name,
+               outage / 10000.0);
+      PS3EyeIpcLog(message);
+    }
+    if (lostShown) {
+      m_sharedMemory.SetCameraState(PS3EYE_CAMERA_OK);
+      lostShown = false;
+    }
+
+    if (m_sharedMemory.WriteFrame(frameBuffer.data(), frameSize, timestamp,
+                                  &metadata))
+      m_frameCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (startRequested != 0) {
+      uint64_t timeToFirstFrame = PS3EyeTransportTime() - startRequested;
+      (warmStart ? m_warmTimeToFirstFrame : m_coldTimeToFirstFrame)
+          .store(timeToFirstFrame, std::memory_order_relaxed);
+      startRequested = 0;
+
+      char message[128];
+      snprintf(message, sizeof(message),
+               "PS3EyeCaptureChannel %s: first frame after %.1f ms (%s)",
+               m_name, timeToFirstFrame / 10000.0,
+               warmStart ? "warm" : "cold");
+      PS3EyeIpcLog(message);
+    }
+
+    // Check clients. Standby only after a continuous idle period, so clients
+    // that reconnect quickly (a stream restart, an app switching format)
+    // never see the camera stop.
+    if (m_sharedMemory.GetClientCount() > 0) {
+      idleSince = 0;
+    } else if (idleSince == 0) {
+      idleSince = arrival;
+    } else if (arrival - idleSince >= standbyDelay) {
+      ArmWatchdog(0);
+      m_camera->Stop();
+      // A camera that gave no frame to stop on is closed by Stop
+      setState(m_camera->IsOpen() ? PS3EyeCaptureState::Standby
+                                  : PS3EyeCaptureState::Closed);
+    }
+  }
+
+  ArmWatchdog(0);
+  m_camera->Close();
+  setState(PS3EyeCaptureState::Closed);
+}
@@ -0,0 +1,126 @@
+// PS3EyeCaptureChannel.h
+// One camera feeding one shared memory channel from its own capture thread.
+// Channels share nothing but the read-only service options, so cameras never
+// wait on each other.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "PS3EyeCamera.h"
+#include "PS3EyeSharedMemory.h"
+
+// Service options every channel runs with
+struct PS3EyeCaptureOptions {
+  uint32_t fps = PS3EYE_FPS;
+  bool largePages = false;
+
+  // Pixel format published (PS3EYE_FORMAT_RGB24, PS3EYE_FORMAT_BAYER_GRBG or
+  // PS3EYE_FORMAT_GREY8). Raw Bayer leaves demosaicing to the clients that
+  // need colour; grey is computed straight from the mosaic for luma-only
+  // consumers at a third of the RGB bandwidth.
+  uint32_t format = PS3EYE_FORMAT_RGB24;
+
+  // Idle timeouts, both counted from when the last client left and reset
+  // whenever one connects. After standbyDelayMs the camera stops streaming
+  // but stays open with its sensor programmed, so the next client only pays
+  // for a start; after closeDelayMs it is released altogether.
+  uint32_t standbyDelayMs = 2000;
+  uint32_t closeDelayMs = 300000;
+};
+
+enum class PS3EyeCaptureState : uint32_t {
+  Closed,    // Device released
+  Standby,   // Device open and programmed, not streaming
+  Streaming, // Publishing frames
+};
+
+struct PS3EyeCaptureStats {
+  PS3EyeCaptureState state;
+  uint64_t frameCount; // Frames published since Start
+  uint32_t coldStarts; // Streams started from Closed (open + start)
+  uint32_t warmStarts; // Streams resumed from Standby (start only)
+  // Time from a client being seen to its first frame being published, for
+  // the most recent cold and warm start, in 100ns units
+  uint64_t coldTimeToFirstFrame;
+  uint64_t warmTimeToFirstFrame;
+  // Streams brought back after the camera stalled or dropped off the bus,
+  // and how long the most recent outage lasted, from the last frame before
+  // it to the first one after, in 100ns units
+  uint32_t recoveries;
+  uint64_t lastOutage;
+};
+
+class alignas(PS3EYE_CACHE_LINE_SIZE) PS3EyeCaptureChannel {
+public:
+  PS3EyeCaptureChannel(std::unique_ptr<PS3EyeCamera> camera, const char *name);
+  ~PS3EyeCaptureChannel();
+
+  // Create the channel's shared memory and start its capture thread. The
+  // camera only streams while clients are connected.
+  bool Start(const PS3EyeCaptureOptions &options);
+
+  // Stop the thread and the camera, and close the shared memory
+  void Stop();
+
+  const char *GetDeviceId() const { return m_camera->GetDeviceId(); }
+  const char *GetName() const { return m_name; }
+
+  // Frames published since Start
+  uint64_t GetFrameCount() const {
+    return m_frameCount.load(std::memory_order_relaxed);
+  }
+
+  void GetStats(PS3EyeCaptureStats *stats) const;
+
+private:
+  PS3EyeCaptureChannel(const PS3EyeCaptureChannel &) = delete;
+  PS3EyeCaptureChannel &operator=(const PS3EyeCaptureChannel &) = delete;
+
+  void CaptureLoop();
+
+  // Watches the stream for frames that stop coming. Once the deadline passes
+  // it publishes the loss and interrupts the capture thread's GetFrame; the
+  // capture thread then stops and reopens the camera itself, so the camera
+  // is only ever used from that thread.
+  void WatchdogLoop();
+
+  // Capture thread: the deadline for the next frame (0 disarms), and whether
+  // the watchdog has declared the camera lost since the last Reconnect
+  void ArmWatchdog(uint64_t deadline);
+  bool IsLost();
+  void SetLost(const char *reason);
+
+  // Capture thread: reopen the camera, backing off between attempts, until
+  // it streams again (true), or the channel stops or has no clients left
+  // (false, the camera closed)
+  bool Reconnect();
+
+  std::unique_ptr<PS3EyeCamera> m_camera;
+  PS3EyeSharedMemoryServer m_sharedMemory;
+  std::thread m_thread;
+  std::thread m_watchdog;
+  std::atomic<bool> m_running;
+  PS3EyeCaptureOptions m_options;
+  char m_name[PS3EYE_NAME_SIZE];
+
+  std::mutex m_watchdogMutex;
+  std::condition_variable m_watchdogWake; // Stop
+  uint64_t m_stallDeadline;
+  bool m_lost;
+
+  // Written by the capture thread only, kept off the lines read by others
+  alignas(PS3EYE_CACHE_LINE_SIZE) std::atomic<uint64_t> m_frameCount;
+  std::atomic<PS3EyeCaptureState> m_state;
+  std::atomic<uint32_t> m_coldStarts;
+  std::atomic<uint32_t> m_warmStarts;
+  std::atomic<uint64_t> m_coldTimeToFirstFrame;
+  std::atomic<uint64_t> m_warmTimeToFirstFrame;
+  std::atomic<uint32_t> m_recoveries;
+  std::atomic<uint64_t> m_lastOutage;
+};
@@ -2,12 +2,31 @@
 // Windows Service that captures from PS3 Eye and shares via shared memory
 // Install: PS3EyeCaptureService.exe --install
 // Uninstall: PS3EyeCaptureService.exe --uninstall
-
+// Options: --large-pages  Back the shared frames with large pages if allowed
+//          --raw          Publish raw Bayer frames; clients demosaic
+//          --grey         Publish 8-bit grey (Y800) for tracking clients
+//          --synthetic N  Serve N generated cameras instead of real devices
+//          --synthetic-jitter US   Hand generated frames over up to US late
+//          --synthetic-drop N      Lose N frames in a thousand
+//          --synthetic-corrupt N   Tear N frames in a thousand
+//          --synthetic-seed N      Seed of the fault generator (default 1)
+//          --standby-delay MS  Idle time before a camera stops streaming but
+//                              stays open (default 2000)
+//          --close-delay S     Idle time before a camera is released
+//                              (default 300)
+
+#include "PS3EyeCaptureChannel.h"
+#include "PS3EyeChannelDirectory.h"
+#include "PS3EyeHardwareCamera.h"
 #include "PS3EyeSharedMemory.h"
-#include "ps3eye.h"
+#include "PS3EyeSyntheticCamera.h"
+
+#include <windows.h>
 
 #include <atomic>
 #include <chrono>
+#include <cstring>
+#include <memory>
 #include <thread>
 #include <vector>
 
@@ -19,6 +38,9 @@
 static SERVICE_STATUS g_serviceStatus = {0};
 static SERVICE_STATUS_HANDLE g_statusHandle = nullptr;
 static std::atomic<bool> g_running(true);
+static PS3EyeCaptureOptions g_options;
+static uint32_t g_syntheticCameras = 0;
+static PS3EyeSyntheticProfile g_syntheticProfile;
 
 void ReportServiceStatus(DWORD state, DWORD exitCode = 0, DWORD waitHint = 0) {
   static DWORD checkPoint = 1;
@@ -46,82 +68,63 @@ void WINAPI ServiceCtrlHandler(DWORD ctrl) {
   }
 }
 
+// Cameras are enumerated again every few seconds, so cameras plugged in
+// after the service started get a channel too
+static const int DEVICE_SCAN_INTERVAL_MS = 5000;
+
+static PS3EyeCameraList EnumerateCameras() {
+  if (g_syntheticCameras > 0)
+    return PS3EyeEnumerateSyntheticCameras(g_syntheticCameras,
+                                           g_syntheticProfile);
+  return PS3EyeEnumerateHardwareCameras();
+}
+
+// One capture thread and shared memory channel per camera. The first camera
+// found gets the default channel, so single-camera clients keep working; the
+// directory tells clients which channel belongs to which device.
 void CaptureLoop() {
-  PS3EyeSharedMemoryServer sharedMemory;
-  if (!sharedMemory.Create())
+  PS3EyeChannelDirectory directory;
+  if (!directory.Create())
     return;
 
-  ps3eye::PS3EYECam::PS3EYERef camera = nullptr;
-  bool cameraActive = false;
-  std::vector<uint8_t> frameBuffer(PS3EYE_FRAME_SIZE);
-
-  LARGE_INTEGER perfFreq, startTime, currentTime;
-  QueryPerformanceFrequency(&perfFreq);
-  QueryPerformanceCounter(&startTime);
-
-  int noClientFrames = 0;
-
-  auto initCamera = [&]() -> bool {
-    if (cameraActive)
-      return true;
-    const auto &devices = ps3eye::PS3EYECam::getDevices(true);
-    if (devices.empty())
-      return false;
-    camera = devices[0];
-    if (!camera->init(PS3EYE_WIDTH, PS3EYE_HEIGHT, PS3EYE_FPS,
-                      ps3eye::PS3EYECam::EOutputFormat::RGB))
-      return false;
-    camera->setAutogain(true);
-    camera->setAutoWhiteBalance(true);
-    camera->setFlip(false, true);
-    camera->start();
-    cameraActive = true;
-    return true;
-  };
-
-  auto stopCamera = [&]() {
-    if (!cameraActive)
-      return;
-    if (camera && camera->isStreaming())
-      camera->stop();
-    camera.reset();
-    cameraActive = false;
-  };
-
+  std::vector<std::unique_ptr<PS3EyeCaptureChannel>> channels;
   while (g_running) {
-    // On-demand: wait for clients
-    if (!cameraActive) {
-      if (sharedMemory.WaitForClients(1000))
-        initCamera();
-      continue;
+    PS3EyeCameraList cameras = EnumerateCameras();
+    for (auto &camera : cameras) {
+      if (channels.size() >= PS3EYE_MAX_CHANNELS)
+        break;
+
+      bool known = false;
+      for (const auto &channel : channels) {
+        if (strcmp(channel->GetDeviceId(), camera->GetDeviceId()) == 0)
+          known = true;
+      }
+      if (known)
+        continue;
+
+      char name[PS3EYE_NAME_SIZE];
+      PS3EyeChannelName(camera->GetDeviceId(), channels.empty(), name,
+                        sizeof(name));
+      std::unique_ptr<PS3EyeCaptureChannel> channel(
+          new PS3EyeCaptureChannel(std::move(camera), name));
+      if (!channel->Start(g_options))
+        continue;
+
+      directory.SetChannel(static_cast<uint32_t>(channels.size()),
+                           channel->GetDeviceId(), channel->GetName());
+      channels.push_back(std::move(channel));
     }
 
-    if (!camera || !camera->isStreaming()) {
+    for (int waited = 0; waited < DEVICE_SCAN_INTERVAL_MS && g_running;
+         waited += 100)
       std::this_thread::sleep_for(std::chrono::milliseconds(100));
-      continue;
-    }
-
-    camera->getFrame(frameBuffer.data());
-
-    QueryPerformanceCounter(&currentTime);
-    UINT64 timestamp =
-        ((currentTime.QuadPart - startTime.QuadPart) * 10000000) /
-        perfFreq.QuadPart;
-    sharedMemory.WriteFrame(frameBuffer.data(), PS3EYE_FRAME_SIZE, timestamp);
-
-    // Check clients
-    if (sharedMemory.GetClientCount() <= 0) {
-      if (++noClientFrames > 30) {
-        stopCamera();
-        noClientFrames = 0;
-      }
-    } else {
-      noClientFrames = 0;
-    }
   }
 
-  stopCamera();
-  sharedMemory.Close();
+  for (size_t i = 0; i < channels.size(); i++) {
+    directory.ClearChannel(static_cast<uint32_t>(i));
+    channels[i]->Stop();
+  }
+  directory.Close();
 }
 
 void WINAPI ServiceMain(DWORD argc, LPWSTR *argv) {
@@ -142,8 +145,28 @@ void WINAPI ServiceMain(DWORD argc, LPWSTR *argv) {
 }
 
 bool InstallService() {
-  wchar_t path[MAX_PATH];
-  GetModuleFileNameW(nullptr, path, MAX_PATH);
+  wchar_t module[MAX_PATH];
+  GetModuleFileNameW(nullptr, module, MAX_PATH);
+
+  // Options given at install time are passed to every service start
+  wchar_t path[MAX_PATH + 256];
+  swprintf_s(path, L"\"%s\" --standby-delay %u --close-delay %u%s", module,
+             g_options.standbyDelayMs, g_options.closeDelayMs / 1000,
+             g_options.largePages ? L" --large-pages" : L"");
+  if (g_options.format == PS3EYE_FORMAT_BAYER_GRBG)
+    wcscat_s(path, L" --raw");
+  else if (g_options.format == PS3EYE_FORMAT_GREY8)
+    wcscat_s(path, L" --grey");
+  if (g_syntheticCameras > 0) {
+    wchar_t option[160];
+    swprintf_s(option,
+               L" --synthetic %u --synthetic-jitter %u --synthetic-drop %u"
+               L" --synthetic-corrupt %u --synthetic-seed %u",
+               g_syntheticCameras, g_syntheticProfile.jitterUs,
+               g_syntheticProfile.dropPerMille,
+               g_syntheticProfile.corruptPerMille, g_syntheticProfile.seed);
+    wcscat_s(path, option);
+  }
 
   SC_HANDLE scm = OpenSCManagerW(nullptr, nullptr, SC_MANAGER_CREATE_SERVICE);
   if (!scm)
@@ -189,6 +212,31 @@ bool UninstallService() {
 }
 
 int wmain(int argc, wchar_t *argv[]) {
+  for (int i = 1; i < argc; i++) {
+    if (wcscmp(argv[i], L"--large-pages") == 0)
+      g_options.largePages = true;
+    else if (wcscmp(argv[i], L"--raw") == 0)
+      g_options.format = PS3EYE_FORMAT_BAYER_GRBG;
+    else if (wcscmp(argv[i], L"--grey") == 0)
+      g_options.format = PS3EYE_FORMAT_GREY8;
+    else if (wcscmp(argv[i], L"--standby-delay") == 0 && i + 1 < argc)
+      g_options.standbyDelayMs = static_cast<uint32_t>(_wtoi(argv[++i]));
+    else if (wcscmp(argv[i], L"--close-delay") == 0 && i + 1 < argc)
+      g_options.closeDelayMs = static_cast<uint32_t>(_wtoi(argv[++i])) * 1000;
+    else if (wcscmp(argv[i], L"--synthetic") == 0 && i + 1 < argc)
+      g_syntheticCameras = static_cast<uint32_t>(_wtoi(argv[++i]));
+    else if (wcscmp(argv[i], L"--synthetic-jitter") == 0 && i + 1 < argc)
+      g_syntheticProfile.jitterUs = static_cast<uint32_t>(_wtoi(argv[++i]));
+    else if (wcscmp(argv[i], L"--synthetic-drop") == 0 && i + 1 < argc)
+      g_syntheticProfile.dropPerMille =
+          static_cast<uint32_t>(_wtoi(argv[++i]));
+    else if (wcscmp(argv[i], L"--synthetic-corrupt") == 0 && i + 1 < argc)
+      g_syntheticProfile.corruptPerMille =
+          static_cast<uint32_t>(_wtoi(argv[++i]));
+    else if (wcscmp(argv[i], L"--synthetic-seed") == 0 && i + 1 < argc)
+      g_syntheticProfile.seed = static_cast<uint32_t>(_wtoi(argv[++i]));
+  }
+
   if (argc > 1) {
     if (wcscmp(argv[1], L"--install") == 0 || wcscmp(argv[1], L"-i") == 0) {
       if (InstallService()) {
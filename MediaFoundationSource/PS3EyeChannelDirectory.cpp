@@ -0,0 +1,172 @@
+// PS3EyeChannelDirectory.cpp
+// Directory of shared memory channels, one per camera
+
+#include "PS3EyeChannelDirectory.h"
+#include "PS3EyeSharedMemory.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Retries before a reader gives up on an entry that keeps changing
+static const int DIRECTORY_READ_ATTEMPTS = 8;
+
+void PS3EyeChannelName(const char *deviceId, bool defaultChannel, char *name,
+                       uint32_t nameSize) {
+  if (defaultChannel) {
+    snprintf(name, nameSize, "%s", PS3EYE_SHARED_MEMORY_NAME);
+    return;
+  }
+
+  int length = snprintf(name, nameSize, "%s_%s", PS3EYE_SHARED_MEMORY_NAME,
+                        deviceId);
+  if (length < 0)
+    return;
+  // Port paths contain characters neither section nor shm names allow
+  for (char *c = name + sizeof(PS3EYE_SHARED_MEMORY_NAME); *c; c++) {
+    bool allowed = (*c >= 'A' && *c <= 'Z') || (*c >= 'a' && *c <= 'z') ||
+                   (*c >= '0' && *c <= '9') || *c == '_' || *c == '.' ||
+                   *c == '-';
+    if (!allowed)
+      *c = '_';
+  }
+}
+
+PS3EyeChannelDirectory::PS3EyeChannelDirectory() : m_block(nullptr) {}
+
+PS3EyeChannelDirectory::~PS3EyeChannelDirectory() { Close(); }
+
+bool PS3EyeChannelDirectory::Create() {
+  if (!m_region.Create(PS3EYE_DIRECTORY_NAME,
+                       sizeof(PS3EyeChannelDirectoryBlock), false)) {
+    return false;
+  }
+
+  PS3EyeChannelDirectoryBlock *block =
+      reinterpret_cast<PS3EyeChannelDirectoryBlock *>(m_region.Data());
+  memset(static_cast<void *>(block), 0, sizeof(PS3EyeChannelDirectoryBlock));
+  block->magic = PS3EYE_DIRECTORY_MAGIC;
+  block->version = PS3EYE_DIRECTORY_VERSION;
+  block->serverPID = PS3EyeCurrentProcessId();
+  m_block = block;
+  return true;
+}
+
+bool PS3EyeChannelDirectory::Open() {
+  if (!m_region.Open(PS3EYE_DIRECTORY_NAME,
+                     sizeof(PS3EyeChannelDirectoryBlock))) {
+    return false;
+  }
+
+  PS3EyeChannelDirectoryBlock *block =
+      reinterpret_cast<PS3EyeChannelDirectoryBlock *>(m_region.Data());
+  if (block->magic != PS3EYE_DIRECTORY_MAGIC ||
+      block->version != PS3EYE_DIRECTORY_VERSION) {
+    m_region.Close();
+    return false;
+  }
+  m_block = block;
+  return true;
+}
+
+void PS3EyeChannelDirectory::Close() {
+  if (m_block && m_block->serverPID == PS3EyeCurrentProcessId()) {
+    // Mark as closed
+    m_block->serverPID = 0;
+  }
+  m_block = nullptr;
+  m_region.Close();
+}
+
+bool PS3EyeChannelDirectory::SetChannel(uint32_t index, const char *deviceId,
+                                        const char *name) {
+  if (!m_block || index >= PS3EYE_MAX_CHANNELS || !deviceId || !name ||
+      strlen(deviceId) >= PS3EYE_DEVICE_ID_SIZE ||
+      strlen(name) >= PS3EYE_NAME_SIZE) {
+    return false;
+  }
+
+  PS3EyeChannelEntry &entry = m_block->channels[index];
+  uint32_t seq = entry.seq.load(std::memory_order_relaxed);
+  entry.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  strcpy(entry.deviceId, deviceId);
+  strcpy(entry.name, name);
+  entry.active = 1;
+  entry.seq.store(seq + 2, std::memory_order_release);
+
+  m_block->generation.fetch_add(1, std::memory_order_release);
+  return true;
+}
+
+void PS3EyeChannelDirectory::ClearChannel(uint32_t index) {
+  if (!m_block || index >= PS3EYE_MAX_CHANNELS) {
+    return;
+  }
+
+  PS3EyeChannelEntry &entry = m_block->channels[index];
+  uint32_t seq = entry.seq.load(std::memory_order_relaxed);
+  entry.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  entry.active = 0;
+  entry.seq.store(seq + 2, std::memory_order_release);
+
+  m_block->generation.fetch_add(1, std::memory_order_release);
+}
+
+bool PS3EyeChannelDirectory::ReadChannel(uint32_t index,
+                                         PS3EyeChannelInfo *info) {
+  const PS3EyeChannelEntry &entry = m_block->channels[index];
+  for (int attempt = 0; attempt < DIRECTORY_READ_ATTEMPTS; attempt++) {
+    uint32_t seq = entry.seq.load(std::memory_order_acquire);
+    if (seq & 1)
+      continue;
+
+    uint32_t active = entry.active;
+    memcpy(info->deviceId, entry.deviceId, sizeof(info->deviceId));
+    memcpy(info->name, entry.name, sizeof(info->name));
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (entry.seq.load(std::memory_order_relaxed) != seq)
+      continue;
+
+    info->index = index;
+    info->deviceId[PS3EYE_DEVICE_ID_SIZE - 1] = '\0';
+    info->name[PS3EYE_NAME_SIZE - 1] = '\0';
+    return active != 0;
+  }
+  return false;
+}
+
+uint32_t PS3EyeChannelDirectory::GetChannels(PS3EyeChannelInfo *channels,
+                                             uint32_t maxChannels) {
+  if (!m_block || !channels) {
+    return 0;
+  }
+
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < PS3EYE_MAX_CHANNELS && count < maxChannels; i++) {
+    if (ReadChannel(i, &channels[count]))
+      count++;
+  }
+  return count;
+}
+
+bool PS3EyeChannelDirectory::FindDevice(const char *deviceId,
+                                        PS3EyeChannelInfo *info) {
+  if (!m_block || !deviceId || !info) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < PS3EYE_MAX_CHANNELS; i++) {
+    if (ReadChannel(i, info) && strcmp(info->deviceId, deviceId) == 0)
+      return true;
+  }
+  return false;
+}
+
+uint32_t PS3EyeChannelDirectory::GetGeneration() const {
+  if (!m_block) {
+    return 0;
+  }
+  return m_block->generation.load(std::memory_order_acquire);
+}
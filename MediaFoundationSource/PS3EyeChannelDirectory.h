@@ -0,0 +1,87 @@
+// PS3EyeChannelDirectory.h
+// Directory of the shared memory channels published by the capture service.
+// Every camera gets its own channel (one PS3EyeSharedMemoryServer each); this
+// small separate region lists which device each channel belongs to, so that
+// clients can pick a camera by USB port path or serial.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "PS3EyeFrameRing.h"
+#include "PS3EyeIpc.h"
+
+constexpr char PS3EYE_DIRECTORY_NAME[] = "PS3EyeChannelDirectory";
+constexpr uint32_t PS3EYE_DIRECTORY_MAGIC = 0x52494433; // '3DIR'
+constexpr uint32_t PS3EYE_DIRECTORY_VERSION = 1;
+constexpr uint32_t PS3EYE_MAX_CHANNELS = 8;
+constexpr uint32_t PS3EYE_DEVICE_ID_SIZE = 48;
+
+// One channel. Rewritten only by the service, under a sequence count like the
+// frame ring slots: seq is odd while the entry is being changed.
+struct alignas(PS3EYE_CACHE_LINE_SIZE) PS3EyeChannelEntry {
+  std::atomic<uint32_t> seq;
+  uint32_t active;                     // 1 while a camera feeds the channel
+  uint32_t reserved[2];                // Future use
+  char deviceId[PS3EYE_DEVICE_ID_SIZE]; // USB port path or serial
+  char name[PS3EYE_NAME_SIZE];          // Shared memory name of the channel
+};
+
+struct PS3EyeChannelDirectoryBlock {
+  uint32_t magic;                   // '3DIR'
+  uint32_t version;                 // Directory version (1)
+  uint32_t serverPID;               // PID of the capture service
+  std::atomic<uint32_t> generation; // Bumped whenever an entry changes
+  alignas(PS3EYE_CACHE_LINE_SIZE)
+      PS3EyeChannelEntry channels[PS3EYE_MAX_CHANNELS];
+};
+
+// Snapshot of one active channel
+struct PS3EyeChannelInfo {
+  uint32_t index;
+  char deviceId[PS3EYE_DEVICE_ID_SIZE];
+  char name[PS3EYE_NAME_SIZE];
+};
+
+// Shared memory name for a device's channel. The first camera keeps the
+// default name so single-camera clients see no change; the others are named
+// after their device id with everything but [A-Za-z0-9_.-] replaced by '_'.
+void PS3EyeChannelName(const char *deviceId, bool defaultChannel, char *name,
+                       uint32_t nameSize);
+
+//------------------------------------------------------------------------------
+// PS3EyeChannelDirectory
+// Created by the capture service, opened by clients to find a camera
+//------------------------------------------------------------------------------
+class PS3EyeChannelDirectory {
+public:
+  PS3EyeChannelDirectory();
+  ~PS3EyeChannelDirectory();
+
+  // Service side: create the (empty) directory
+  bool Create();
+
+  // Client side: map the directory of a running service
+  bool Open();
+
+  void Close();
+
+  // Service side: list or remove the channel at index
+  bool SetChannel(uint32_t index, const char *deviceId, const char *name);
+  void ClearChannel(uint32_t index);
+
+  // Client side: consistent snapshots of active entries. GetChannels returns
+  // how many were written to channels.
+  uint32_t GetChannels(PS3EyeChannelInfo *channels, uint32_t maxChannels);
+  bool FindDevice(const char *deviceId, PS3EyeChannelInfo *info);
+
+  // Bumped whenever a channel is added or removed
+  uint32_t GetGeneration() const;
+
+private:
+  bool ReadChannel(uint32_t index, PS3EyeChannelInfo *info);
+
+  PS3EyeSharedRegion m_region;
+  PS3EyeChannelDirectoryBlock *m_block;
+};
@@ -0,0 +1,119 @@
+// PS3EyeFrameAssembler.cpp
+// Frame reassembly from bulk payloads
+
+#include "PS3EyeFrameAssembler.h"
+
+#include <cstring>
+
+PS3EyeFrameAssembler::PS3EyeFrameAssembler(uint32_t frameSize,
+                                           PS3EyeFrameMailbox *mailbox)
+    : m_frameSize(frameSize), m_mailbox(mailbox) {
+  Reset();
+}
+
+void PS3EyeFrameAssembler::Reset() {
+  m_frame = nullptr;
+  m_size = 0;
+  // Nothing is kept until a payload starts a frame
+  m_lastType = Packet::Discard;
+  m_lastPts = 0;
+  m_lastFid = 0;
+  m_stats = PS3EyeAssemblerStats();
+}
+
+void PS3EyeFrameAssembler::Feed(const uint8_t *data, uint32_t length,
+                                int64_t time) {
+  m_stats.transfers++;
+  m_stats.bytes += length;
+  while (length > 0) {
+    const uint32_t payload =
+        length < PS3EYE_PAYLOAD_SIZE ? length : PS3EYE_PAYLOAD_SIZE;
+    Scan(data, payload, time);
+    data += payload;
+    length -= payload;
+  }
+}
+
+void PS3EyeFrameAssembler::Scan(const uint8_t *payload, uint32_t length,
+                                int64_t time) {
+  m_stats.payloads++;
+  if (length < PS3EYE_PAYLOAD_HEADER_SIZE ||
+      payload[0] != PS3EYE_PAYLOAD_HEADER_SIZE) {
+    m_stats.badHeaders++;
+    Add(Packet::Discard, nullptr, 0, time);
+    return;
+  }
+  const uint8_t flags = payload[1];
+  if (flags & PS3EYE_PAYLOAD_ERR) {
+    m_stats.errorPayloads++;
+    Add(Packet::Discard, nullptr, 0, time);
+    return;
+  }
+  if (!(flags & PS3EYE_PAYLOAD_PTS)) {
+    m_stats.missingPts++;
+    Add(Packet::Discard, nullptr, 0, time);
+    return;
+  }
+
+  const uint32_t pts = payload[2] | payload[3] << 8 | payload[4] << 16 |
+                       static_cast<uint32_t>(payload[5]) << 24;
+  const uint8_t fid = flags & PS3EYE_PAYLOAD_FID;
+  const uint8_t *data = payload + PS3EYE_PAYLOAD_HEADER_SIZE;
+  const uint32_t size = length - PS3EYE_PAYLOAD_HEADER_SIZE;
+
+  if (pts != m_lastPts || fid != m_lastFid) {
+    // A new frame; one still open lost its EOF payload and goes out short
+    if (m_lastType == Packet::Inter) {
+      m_stats.unterminated++;
+      Add(Packet::Last, nullptr, 0, time);
+    }
+    m_lastPts = pts;
+    m_lastFid = fid;
+    Add(Packet::First, data, size, time);
+  } else if (flags & PS3EYE_PAYLOAD_EOF) {
+    m_lastPts = 0;
+    if (m_size + size != m_frameSize) {
+      if (m_lastType == Packet::First || m_lastType == Packet::Inter)
+        m_stats.shortFrames++;
+      Add(Packet::Discard, nullptr, 0, time);
+      return;
+    }
+    Add(Packet::Last, data, size, time);
+  } else {
+    Add(Packet::Inter, data, size, time);
+  }
+}
+
+void PS3EyeFrameAssembler::Add(Packet type, const uint8_t *data,
+                               uint32_t length, int64_t time) {
+  if (type == Packet::First) {
+    m_frame = m_mailbox->BeginWrite();
+    m_size = 0;
+  } else if (m_lastType == Packet::Discard) {
+    // Skipping to the next frame; its EOF only marks the frame as over
+    if (type == Packet::Last) {
+      m_lastType = type;
+      m_size = 0;
+    }
+    return;
+  } else if (m_lastType == Packet::Last) {
+    return;
+  }
+
+  if (length > 0) {
+    if (m_size + length > m_frameSize) {
+      m_stats.overflows++;
+      type = Packet::Discard;
+    } else {
+      memcpy(m_frame + m_size, data, length);
+      m_size += length;
+    }
+  }
+
+  m_lastType = type;
+  if (type == Packet::Last) {
+    m_stats.frames++;
+    m_mailbox->EndWrite(m_stats.frames, time);
+    m_size = 0;
+  }
+}
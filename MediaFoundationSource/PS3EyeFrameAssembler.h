@@ -0,0 +1,80 @@
+// PS3EyeFrameAssembler.h
+// Reassembles camera frames from the OV534 bridge's bulk stream, the way the
+// driver's transfer callback does (pkt_scan / frame_add, after the gspca
+// ov534 driver). The bridge sends each frame as UVC-style payloads of up to
+// 2048 bytes: a 12-byte header (length, flags, 32-bit PTS, SCR) and up to
+// 2036 bytes of the raw Bayer frame. A change of PTS or frame id starts a
+// frame, and the payload flagged EOF ends it.
+//
+// Faulty payloads (bad header, error flag, no PTS) and frames that end with
+// the wrong size are discarded, along with the rest of their frame. As in
+// the driver, a frame cut off by the next one without its EOF payload is
+// still published, short, with the tail of an older frame in its buffer;
+// Stats() counts those as unterminated.
+//
+// Frames are assembled in place in a PS3EyeFrameMailbox's write buffer and
+// published to it, so replays hand frames over like a live camera does.
+// Only depends on the C++ standard library (see TestFrameAssembler.cpp).
+// Not thread-safe: one transfer thread feeds it.
+
+#pragma once
+
+#include <cstdint>
+
+#include "PS3EyeFrameMailbox.h"
+
+constexpr uint32_t PS3EYE_PAYLOAD_SIZE = 2048;      // Header included
+constexpr uint32_t PS3EYE_PAYLOAD_HEADER_SIZE = 12; // Also its first byte
+// Bulk transfers the driver keeps queued; a short payload ends one early
+constexpr uint32_t PS3EYE_TRANSFER_SIZE = 16384;
+
+// Payload header flags (byte 1)
+constexpr uint8_t PS3EYE_PAYLOAD_FID = 0x01; // Frame id, toggles per frame
+constexpr uint8_t PS3EYE_PAYLOAD_EOF = 0x02; // Last payload of the frame
+constexpr uint8_t PS3EYE_PAYLOAD_PTS = 0x04; // Bytes 2..5 hold the PTS
+constexpr uint8_t PS3EYE_PAYLOAD_SCR = 0x08;
+constexpr uint8_t PS3EYE_PAYLOAD_ERR = 0x40; // Bridge reports an error
+
+struct PS3EyeAssemblerStats {
+  uint64_t transfers;
+  uint64_t payloads;
+  uint64_t bytes;         // Headers included
+  uint64_t frames;        // Published
+  uint64_t unterminated;  // Published short, cut off by the next frame
+  uint64_t shortFrames;   // Ended by EOF at the wrong size; discarded
+  uint64_t overflows;     // Ran past the frame size; discarded
+  uint64_t badHeaders;    // Payloads without a valid header
+  uint64_t errorPayloads; // Payloads flagged ERR
+  uint64_t missingPts;    // Payloads without a PTS
+};
+
+class PS3EyeFrameAssembler {
+public:
+  // Frames are frameSize bytes (width * height of raw Bayer); the mailbox
+  // must be open with buffers at least that large
+  PS3EyeFrameAssembler(uint32_t frameSize, PS3EyeFrameMailbox *mailbox);
+
+  // Forget the frame in progress and the stats, e.g. on stream start
+  void Reset();
+
+  // One completed bulk transfer: payloads back to back, the last possibly
+  // short. Frames completed in it are published with the given time.
+  void Feed(const uint8_t *data, uint32_t length, int64_t time);
+
+  const PS3EyeAssemblerStats &Stats() const { return m_stats; }
+
+private:
+  enum class Packet { Discard, First, Inter, Last };
+
+  void Scan(const uint8_t *payload, uint32_t length, int64_t time);
+  void Add(Packet type, const uint8_t *data, uint32_t length, int64_t time);
+
+  uint32_t m_frameSize;
+  PS3EyeFrameMailbox *m_mailbox;
+  uint8_t *m_frame; // Write buffer of the frame in progress
+  uint32_t m_size;  // Bytes of it so far
+  Packet m_lastType;
+  uint32_t m_lastPts;
+  uint8_t m_lastFid;
+  PS3EyeAssemblerStats m_stats;
+};
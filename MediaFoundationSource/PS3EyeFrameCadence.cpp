@@ -0,0 +1,135 @@
+// PS3EyeFrameCadence.cpp
+// Regression of frame arrival times against frame numbers
+
+#include "PS3EyeFrameCadence.h"
+
+#include <cmath>
+
+PS3EyeFrameCadence::PS3EyeFrameCadence(int64_t nominalPeriod) : m_epoch(0) {
+  Reset(nominalPeriod);
+}
+
+void PS3EyeFrameCadence::Reset(int64_t nominalPeriod) {
+  m_nominal = nominalPeriod > 0 ? nominalPeriod : 1;
+  m_samples.clear();
+  m_samples.reserve(WINDOW);
+  m_nextSample = 0;
+  m_started = false;
+  m_lastFrame = 0;
+  m_lastArrival = 0;
+  m_locked = false;
+  m_offLine = 0;
+  m_offLineSide = 0;
+  m_originFrame = 0;
+  m_originTime = 0;
+  m_period = static_cast<double>(m_nominal);
+}
+
+double PS3EyeFrameCadence::DriftPpm() const {
+  return (m_period - m_nominal) * 1e6 / m_nominal;
+}
+
+double PS3EyeFrameCadence::LineTime(uint64_t frame) const {
+  if (!m_locked) {
+    return m_lastArrival +
+           static_cast<double>(static_cast<int64_t>(frame - m_lastFrame)) *
+               m_period;
+  }
+  return m_originTime +
+         static_cast<double>(static_cast<int64_t>(frame - m_originFrame)) *
+             m_period;
+}
+
+int64_t PS3EyeFrameCadence::FrameTime(uint64_t frame) const {
+  return static_cast<int64_t>(std::llround(LineTime(frame)));
+}
+
+uint64_t PS3EyeFrameCadence::AddFrame(int64_t arrival) {
+  if (!m_started) {
+    m_started = true;
+    m_lastFrame = 0;
+    m_lastArrival = arrival;
+    Add(0, arrival);
+    return 0;
+  }
+
+  // Periods since the last frame (on the line, once there is one); frames
+  // that bunch up behind a late one still get a number each
+  const double periods = (arrival - LineTime(m_lastFrame)) / m_period;
+  const int64_t steps = std::llround(periods);
+  const uint64_t frame = m_lastFrame + (steps > 1 ? steps : 1);
+  m_lastFrame = frame;
+  m_lastArrival = arrival;
+
+  if (m_locked) {
+    const double offset = arrival - LineTime(frame);
+    if (std::fabs(offset) > m_period / 4) {
+      const int side = offset > 0 ? 1 : -1;
+      m_offLine = side == m_offLineSide ? m_offLine + 1 : 1;
+      m_offLineSide = side;
+      if (m_offLine < RELOCK_FRAMES)
+        return frame;
+      // The cadence moved, or frames were miscounted: start a new fit here,
+      // keeping the period as the best guess until it locks again
+      m_samples.clear();
+      m_nextSample = 0;
+      m_locked = false;
+    }
+    m_offLine = 0;
+  }
+
+  Add(frame, arrival);
+  return frame;
+}
+
+void PS3EyeFrameCadence::Add(uint64_t frame, int64_t arrival) {
+  if (m_samples.size() < WINDOW) {
+    m_samples.push_back({frame, arrival});
+  } else {
+    m_samples[m_nextSample] = {frame, arrival};
+    m_nextSample = (m_nextSample + 1) % WINDOW;
+  }
+  if (m_samples.size() >= LOCK_FRAMES)
+    Fit();
+}
+
+void PS3EyeFrameCadence::Fit() {
+  // Relative to one sample, so the sums stay small enough for doubles
+  const Sample &reference = m_samples[0];
+  auto x = [&](const Sample &sample) {
+    return static_cast<double>(
+        static_cast<int64_t>(sample.frame - reference.frame));
+  };
+  auto y = [&](const Sample &sample) {
+    return static_cast<double>(sample.arrival - reference.arrival);
+  };
+  const double n = static_cast<double>(m_samples.size());
+  double sumX = 0, sumY = 0;
+  for (const Sample &sample : m_samples) {
+    sumX += x(sample);
+    sumY += y(sample);
+  }
+  const double meanX = sumX / n, meanY = sumY / n;
+  double sxx = 0, sxy = 0;
+  for (const Sample &sample : m_samples) {
+    const double dx = x(sample) - meanX;
+    sxx += dx * dx;
+    sxy += dx * (y(sample) - meanY);
+  }
+  if (sxx <= 0)
+    return;
+
+  // A real crystal is within a fraction of a percent; anything further off
+  // is a miscount the relock will sort out
+  double period = sxy / sxx;
+  const double low = m_nominal * 0.95, high = m_nominal * 1.05;
+  period = period < low ? low : period > high ? high : period;
+
+  m_period = period;
+  m_originFrame = reference.frame;
+  m_originTime = reference.arrival + meanY - period * meanX;
+  if (!m_locked) {
+    m_locked = true;
+    m_epoch++;
+  }
+}
@@ -0,0 +1,87 @@
+// PS3EyeFrameCadence.h
+// The frame period and phase of a camera, estimated from when its frames
+// arrive. The sensor runs off its own crystal, so its true period differs
+// from the nominal one by up to a few hundred ppm and drifts against the
+// host clock; arrival times add scheduling jitter on top. A least-squares
+// line through the arrival times of the last WINDOW frames, against their
+// frame numbers, recovers both: its slope is the period, and the line itself
+// is where each frame arrived with the jitter taken out.
+//
+// Frames are numbered by the estimated period, so a frame that comes n
+// periods after the previous one is numbered n ahead, counting the frames
+// lost in between. Arrivals more than a quarter period off the line (a
+// thread that was scheduled late) are numbered but kept out of the fit; if
+// frames keep landing off the line on the same side the cadence itself has
+// moved, and the estimate starts over.
+//
+// Times are in 100ns units from any monotonic clock. Not thread-safe.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class PS3EyeFrameCadence {
+public:
+  static constexpr uint32_t WINDOW = 2048;    // Frames in the fit
+  static constexpr uint32_t LOCK_FRAMES = 16; // Frames before it is trusted
+  static constexpr uint32_t RELOCK_FRAMES = 8; // Off the line in a row
+
+  explicit PS3EyeFrameCadence(int64_t nominalPeriod);
+
+  // Forgets every frame, e.g. when the stream restarts
+  void Reset(int64_t nominalPeriod);
+
+  // Adds the frame that arrived at the given time and returns its number
+  // (0 for the first frame after Reset)
+  uint64_t AddFrame(int64_t arrival);
+
+  // Whether the fit covers LOCK_FRAMES frames; until then Period() is the
+  // nominal period and FrameTime() extrapolates from the last arrival
+  bool Locked() const { return m_locked; }
+
+  // Counts the times the estimate locked (again); a new epoch may number
+  // frames with a different offset from the camera's own count
+  uint32_t Epoch() const { return m_epoch; }
+
+  int64_t NominalPeriod() const { return m_nominal; }
+
+  // Estimated period, 100ns
+  double Period() const { return m_period; }
+
+  // Deviation of the estimated period from the nominal one, ppm
+  double DriftPpm() const;
+
+  // Arrival time of a frame on the fitted line
+  int64_t FrameTime(uint64_t frame) const;
+
+  // Number of the last frame added
+  uint64_t LastFrame() const { return m_lastFrame; }
+
+private:
+  struct Sample {
+    uint64_t frame;
+    int64_t arrival;
+  };
+
+  double LineTime(uint64_t frame) const;
+  void Add(uint64_t frame, int64_t arrival);
+  void Fit();
+
+  int64_t m_nominal;
+  std::vector<Sample> m_samples; // Ring of the frames in the fit
+  size_t m_nextSample;           // Oldest sample once the ring is full
+  bool m_started;
+  uint64_t m_lastFrame;
+  int64_t m_lastArrival;
+  bool m_locked;
+  uint32_t m_epoch;
+  uint32_t m_offLine;  // Consecutive arrivals off the line
+  int m_offLineSide;   // +1 late, -1 early
+
+  // The line: frame f arrives at m_originTime + (f - m_originFrame) * period
+  uint64_t m_originFrame;
+  double m_originTime;
+  double m_period;
+};
@@ -0,0 +1,81 @@
+// PS3EyeFrameConvert.cpp
+// Shared frame to RGB conversion
+
+#include "PS3EyeFrameConvert.h"
+
+bool PS3EyeConvertFrame(const PS3EyeFrameView &frame, uint8_t *dst,
+                        uint32_t dstStride, PS3EyeBayerFormat format,
+                        bool bottomUp) {
+  if (!frame.data || !dst)
+    return false;
+
+  if (frame.format == PS3EYE_FORMAT_BAYER_GRBG) {
+    // Stored top-down
+    PS3EyeBayerJob job = {frame.data,  frame.stride, dst,    dstStride,
+                          frame.width, frame.height, format, bottomUp,
+                          false};
+    PS3EyeDemosaic(job);
+    return true;
+  }
+  if (frame.format == PS3EYE_FORMAT_GREY8) {
+    // Stored top-down
+    const uint32_t bpp = PS3EyeBayerBytesPerPixel(format);
+    for (uint32_t y = 0; y < frame.height; y++) {
+      const uint8_t *src = frame.data + static_cast<size_t>(y) * frame.stride;
+      uint32_t outY = bottomUp ? frame.height - 1 - y : y;
+      uint8_t *out = dst + static_cast<size_t>(outY) * dstStride;
+      for (uint32_t x = 0; x < frame.width; x++, out += bpp) {
+        out[0] = out[1] = out[2] = src[x];
+        if (bpp == 4)
+          out[3] = 255;
+      }
+    }
+    return true;
+  }
+  if (frame.format != PS3EYE_FORMAT_RGB24 &&
+      frame.format != PS3EYE_FORMAT_BGR24)
+    return false;
+
+  // Already colour (and stored bottom-up): reorder channels and add alpha as
+  // needed
+  const bool srcRgb = frame.format == PS3EYE_FORMAT_RGB24;
+  const bool dstRgb = format == PS3EyeBayerFormat::RGB ||
+                      format == PS3EyeBayerFormat::RGBA;
+  const uint32_t bpp = PS3EyeBayerBytesPerPixel(format);
+  for (uint32_t y = 0; y < frame.height; y++) {
+    const uint8_t *src = frame.data + static_cast<size_t>(y) * frame.stride;
+    uint32_t outY = bottomUp ? y : frame.height - 1 - y;
+    uint8_t *out = dst + static_cast<size_t>(outY) * dstStride;
+    for (uint32_t x = 0; x < frame.width; x++, src += 3, out += bpp) {
+      out[0] = src[srcRgb == dstRgb ? 0 : 2];
+      out[1] = src[1];
+      out[2] = src[srcRgb == dstRgb ? 2 : 0];
+      if (bpp == 4)
+        out[3] = 255;
+    }
+  }
+  return true;
+}
+
+bool PS3EyeConvertFrameBinned(const PS3EyeFrameView &frame, uint8_t *dst,
+                              uint32_t dstStride, PS3EyeBayerFormat format,
+                              bool bottomUp) {
+  if (!frame.data || !dst || frame.format != PS3EYE_FORMAT_BAYER_GRBG)
+    return false;
+
+  PS3EyeBayerJob job = {frame.data,  frame.stride, dst,    dstStride,
+                        frame.width, frame.height, format, bottomUp,
+                        false};
+  PS3EyeBin(job);
+  return true;
+}
+
+bool PS3EyeConvertFrameYuv(const PS3EyeFrameView &frame, uint8_t *dst,
+                           PS3EyeYuvFormat format) {
+  if (!frame.data || !dst || frame.format != PS3EYE_FORMAT_BAYER_GRBG)
+    return false;
+
+  PS3EyeDemosaicYuv(PS3EyeYuvFrameJob(frame.data, frame.stride, dst,
+                                      frame.width, frame.height, format));
+  return true;
+}
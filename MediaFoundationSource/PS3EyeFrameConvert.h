@@ -0,0 +1,37 @@
+// PS3EyeFrameConvert.h
+// Client-side conversion of shared frames to the pixel layout a consumer
+// needs. Channels may publish raw Bayer (PS3EYE_FORMAT_BAYER_GRBG) to save
+// memory bandwidth; clients that want colour demosaic on demand, straight
+// from the pinned slot into their own buffer, as RGB or as the YUV encoders
+// take. Grey channels (PS3EYE_FORMAT_GREY8) convert to RGB with the luma in
+// every channel.
+
+#pragma once
+
+#include <cstdint>
+
+#include "PS3EyeBayer.h"
+#include "PS3EyeSharedMemory.h"
+
+// Convert a frame from AcquireFrame to format. dst holds frame.height rows
+// of dstStride bytes, written bottom-up (a DIB) or top-down whatever order
+// the frame is stored in; the flip is part of the same pass. Returns false
+// for frames in an unknown format.
+bool PS3EyeConvertFrame(const PS3EyeFrameView &frame, uint8_t *dst,
+                        uint32_t dstStride, PS3EyeBayerFormat format,
+                        bool bottomUp);
+
+// Convert a raw frame from AcquireFrame to format at half its width and
+// height, each 2x2 quad binned into one pixel (PS3EyeBin), so one full-size
+// channel also serves consumers that want the smaller frames. dst holds
+// frame.height / 2 rows of dstStride bytes, bottom-up or top-down. Returns
+// false for any other format.
+bool PS3EyeConvertFrameBinned(const PS3EyeFrameView &frame, uint8_t *dst,
+                              uint32_t dstStride, PS3EyeBayerFormat format,
+                              bool bottomUp);
+
+// Convert a raw frame from AcquireFrame to YUV in dst, tightly packed planes
+// (PS3EyeYuvFrameSize bytes), top-down. Returns false for any other format:
+// colour frames would only move the encoder's RGB to YUV conversion here.
+bool PS3EyeConvertFrameYuv(const PS3EyeFrameView &frame, uint8_t *dst,
+                           PS3EyeYuvFormat format);
@@ -0,0 +1,121 @@
+// PS3EyeFrameMailbox.cpp
+// Latest-frame mailbox and quality-driven frame skipping
+
+#include "PS3EyeFrameMailbox.h"
+
+#include <chrono>
+#include <utility>
+
+PS3EyeFrameMailbox::PS3EyeFrameMailbox()
+    : m_write(0), m_waiting(1), m_read(2), m_fresh(false), m_closed(true),
+      m_number(0), m_time(0), m_skipped(0), m_skippedSinceTake(0) {}
+
+void PS3EyeFrameMailbox::Open(size_t frameSize) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (std::vector<uint8_t> &buffer : m_buffers)
+    buffer.assign(frameSize, 0);
+  m_fresh = false;
+  m_closed = false;
+  m_skipped = 0;
+  m_skippedSinceTake = 0;
+}
+
+void PS3EyeFrameMailbox::Close() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+  }
+  m_ready.notify_all();
+}
+
+bool PS3EyeFrameMailbox::IsClosed() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_closed;
+}
+
+void PS3EyeFrameMailbox::EndWrite(uint64_t number, int64_t time) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_closed)
+      return;
+    if (m_fresh) {
+      m_skipped++;
+      m_skippedSinceTake++;
+    }
+    std::swap(m_write, m_waiting);
+    m_number = number;
+    m_time = time;
+    m_fresh = true;
+  }
+  m_ready.notify_one();
+}
+
+bool PS3EyeFrameMailbox::Take(Frame *frame, uint32_t timeoutMs) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (!m_ready.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                        [this] { return m_fresh || m_closed; }) ||
+      m_closed)
+    return false;
+  std::swap(m_read, m_waiting);
+  m_fresh = false;
+  frame->data = m_buffers[m_read].data();
+  frame->number = m_number;
+  frame->time = m_time;
+  frame->skipped = m_skippedSinceTake;
+  m_skippedSinceTake = 0;
+  return true;
+}
+
+uint64_t PS3EyeFrameMailbox::Skipped() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_skipped;
+}
+
+//------------------------------------------------------------------------------
+// PS3EyeFrameSkipper
+//------------------------------------------------------------------------------
+
+PS3EyeFrameSkipper::PS3EyeFrameSkipper(int64_t period) { Reset(period); }
+
+void PS3EyeFrameSkipper::Reset(int64_t period) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_period = period > 0 ? period : 1;
+  m_skipFrames = 0;
+  m_proportion = 1000;
+  m_credit = 0;
+  m_skipped = 0;
+}
+
+void PS3EyeFrameSkipper::Notify(int64_t late, uint32_t proportion) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // Skip the frames the lateness covers, at most a second's worth; a later
+  // message replaces an earlier one rather than adding to it
+  if (late > 0) {
+    const int64_t frames = (late + m_period - 1) / m_period;
+    const int64_t second = 10000000 / m_period;
+    m_skipFrames = static_cast<uint32_t>(frames < second ? frames : second);
+  }
+  // A consumer with capacity to spare cannot be sent more than every frame
+  m_proportion = proportion == 0 ? 1 : proportion > 1000 ? 1000 : proportion;
+}
+
+bool PS3EyeFrameSkipper::Deliver() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_skipFrames > 0) {
+    m_skipFrames--;
+    m_skipped++;
+    return false;
+  }
+  m_credit += m_proportion;
+  if (m_credit < 1000) {
+    m_skipped++;
+    return false;
+  }
+  m_credit -= 1000;
+  return true;
+}
+
+uint64_t PS3EyeFrameSkipper::Skipped() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_skipped;
+}
@@ -0,0 +1,100 @@
+// PS3EyeFrameMailbox.h
+// Latest-frame hand-off between a capture thread and a consumer that may
+// fall behind. The capture thread keeps draining the camera at its own rate
+// and every frame it completes replaces the one waiting, so the consumer
+// always takes the freshest frame and latency stays within a frame period
+// however long the consumer stalls. Frames replaced before they were taken
+// are counted as skipped instead of piling up in the driver.
+//
+// Three buffers rotate between the writer, the waiting frame and the
+// reader, so neither side copies or waits on the other's buffer.
+//
+// PS3EyeFrameSkipper applies quality messages from downstream: it skips the
+// frames a late consumer asks to be spared and thins the rate to the
+// proportion it can keep up with.
+//
+// Only depends on the C++ standard library (see TestFrameMailbox.cpp).
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class PS3EyeFrameMailbox {
+public:
+  struct Frame {
+    const uint8_t *data; // Valid until the next Take
+    uint64_t number;     // As given to EndWrite
+    int64_t time;        // As given to EndWrite
+    uint64_t skipped;    // Frames replaced unread since the last Take
+  };
+
+  PS3EyeFrameMailbox();
+
+  // Allocate buffers of frameSize bytes and start empty and open
+  void Open(size_t frameSize);
+
+  // Wake and fail any Take; EndWrite is ignored until the next Open
+  void Close();
+  bool IsClosed() const;
+
+  // Writer: buffer to fill with the next frame. Never blocks.
+  uint8_t *BeginWrite() { return m_buffers[m_write].data(); }
+
+  // Writer: publish the buffer from BeginWrite, replacing a frame still
+  // waiting
+  void EndWrite(uint64_t number, int64_t time);
+
+  // Reader: wait up to timeoutMs for a frame newer than the last one taken.
+  // False on timeout or once closed.
+  bool Take(Frame *frame, uint32_t timeoutMs);
+
+  // Frames replaced unread since Open
+  uint64_t Skipped() const;
+
+private:
+  PS3EyeFrameMailbox(const PS3EyeFrameMailbox &) = delete;
+  PS3EyeFrameMailbox &operator=(const PS3EyeFrameMailbox &) = delete;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_ready;
+  std::vector<uint8_t> m_buffers[3];
+  size_t m_write;   // Being filled by the writer
+  size_t m_waiting; // Newest complete frame
+  size_t m_read;    // Handed to the reader
+  bool m_fresh;     // m_waiting holds a frame not taken yet
+  bool m_closed;
+  uint64_t m_number;
+  int64_t m_time;
+  uint64_t m_skipped;
+  uint64_t m_skippedSinceTake;
+};
+
+class PS3EyeFrameSkipper {
+public:
+  explicit PS3EyeFrameSkipper(int64_t period);
+
+  // Forget earlier messages, e.g. when the stream restarts
+  void Reset(int64_t period);
+
+  // A quality message: the consumer's last frame was late by late (100ns,
+  // negative when early) and it keeps up with proportion / 1000 of the rate
+  void Notify(int64_t late, uint32_t proportion);
+
+  // Whether to deliver the next frame; a frame not delivered is skipped
+  bool Deliver();
+
+  // Frames skipped since Reset
+  uint64_t Skipped() const;
+
+private:
+  mutable std::mutex m_mutex;
+  int64_t m_period;
+  uint32_t m_skipFrames; // Still to skip for the last late message
+  uint32_t m_proportion; // Of 1000 frames, how many to deliver
+  uint32_t m_credit;     // Accumulates m_proportion per frame
+  uint64_t m_skipped;
+};
@@ -0,0 +1,70 @@
+// PS3EyeFrameRates.h
+// Frame rates the OV7725 delivers through the PS3EYEDriver, per resolution.
+// These are the driver's own rate tables (rate_0 and rate_1 in ps3eye.cpp,
+// which sets the sensor clock and the bridge's frame rate from them) less
+// the rates above 75 and 187 fps, at which the driver warns the video is
+// partly corrupt. The driver rounds any other rate down to the next entry,
+// so offering exactly these is what lets a consumer get the rate it asked
+// for.
+
+#pragma once
+
+#include <cstdint>
+
+// Fastest first, as in the driver
+constexpr uint32_t PS3EYE_VGA_FRAME_RATES[] = {75, 60, 50, 40, 30, 25, 20,
+                                               15, 10, 8,  5,  3,  2};
+constexpr uint32_t PS3EYE_QVGA_FRAME_RATES[] = {
+    187, 150, 137, 125, 100, 90, 75, 60, 50, 40,
+    37,  30,  17,  15,  12,  10, 7,  5,  3,  2};
+
+constexpr uint32_t PS3EYE_VGA_FRAME_RATE_COUNT =
+    sizeof(PS3EYE_VGA_FRAME_RATES) / sizeof(PS3EYE_VGA_FRAME_RATES[0]);
+constexpr uint32_t PS3EYE_QVGA_FRAME_RATE_COUNT =
+    sizeof(PS3EYE_QVGA_FRAME_RATES) / sizeof(PS3EYE_QVGA_FRAME_RATES[0]);
+
+// Rate every mode is offered at first, as before the table was exposed
+constexpr uint32_t PS3EYE_DEFAULT_FRAME_RATE = 30;
+
+// The sensor's two modes; anything else is not a PS3 Eye size
+inline bool PS3EyeIsSensorSize(uint32_t width, uint32_t height) {
+  return (width == 640 && height == 480) || (width == 320 && height == 240);
+}
+
+// Rates of a sensor size, fastest first (an empty table for other sizes)
+inline const uint32_t *PS3EyeFrameRates(uint32_t width, uint32_t height,
+                                        uint32_t *count) {
+  if (width == 640 && height == 480) {
+    *count = PS3EYE_VGA_FRAME_RATE_COUNT;
+    return PS3EYE_VGA_FRAME_RATES;
+  }
+  if (width == 320 && height == 240) {
+    *count = PS3EYE_QVGA_FRAME_RATE_COUNT;
+    return PS3EYE_QVGA_FRAME_RATES;
+  }
+  *count = 0;
+  return nullptr;
+}
+
+// Frame interval of a rate in 100ns units, as DirectShow and Media
+// Foundation describe it
+inline int64_t PS3EyeFrameInterval(uint32_t fps) { return 10000000 / fps; }
+
+// The table rate a frame interval stands for, or 0 if none is within 2%.
+// Consumers round intervals their own way (333333 or 333334 for 30 fps) and
+// some ask for NTSC-style rates such as 29.97, which the sensor runs at 30.
+inline uint32_t PS3EyeMatchFrameRate(uint32_t width, uint32_t height,
+                                     int64_t interval) {
+  if (interval <= 0)
+    return 0;
+  uint32_t count;
+  const uint32_t *rates = PS3EyeFrameRates(width, height, &count);
+  for (uint32_t i = 0; i < count; i++) {
+    const int64_t nominal = PS3EyeFrameInterval(rates[i]);
+    const int64_t difference =
+        interval > nominal ? interval - nominal : nominal - interval;
+    if (difference * 50 <= nominal)
+      return rates[i];
+  }
+  return 0;
+}
@@ -0,0 +1,129 @@
+// PS3EyeFrameReader.cpp
+// Blocking frame source on a thread of its own
+
+#include "PS3EyeFrameReader.h"
+
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+PS3EyeFrameReader::~PS3EyeFrameReader() {
+  if (!Stop(0))
+    m_thread.detach();
+}
+
+bool PS3EyeFrameReader::Start(ReadFunction read, size_t frameSize) {
+  if (!Stop(0))
+    return false;
+  std::shared_ptr<State> state = std::make_shared<State>();
+  state->read = std::move(read);
+  for (std::vector<uint8_t> &buffer : state->buffers)
+    buffer.assign(frameSize, 0);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_state = state;
+  }
+  m_thread = std::thread(&PS3EyeFrameReader::ReadLoop, state);
+  return true;
+}
+
+bool PS3EyeFrameReader::Stop(uint32_t timeoutMs) {
+  std::shared_ptr<State> state;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    state.swap(m_state);
+  }
+  if (!state)
+    state.swap(m_blocked);
+  if (!state)
+    return true;
+
+  bool finished;
+  {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->stopping = true;
+    state->wake.notify_all();
+    finished = state->wake.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                    [&state] { return state->finished; });
+  }
+  if (!finished) {
+    m_blocked = state;
+    return false;
+  }
+  m_thread.join();
+  return true;
+}
+
+PS3EyeFrameReader::Result PS3EyeFrameReader::Take(uint8_t *buffer,
+                                                  uint32_t timeoutMs,
+                                                  int64_t *time) {
+  std::shared_ptr<State> state;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    state = m_state;
+  }
+  if (!state)
+    return Result::Stopped;
+
+  {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->wake.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                         [&state] {
+                           return state->fresh || state->interrupted ||
+                                  state->stopping || state->finished;
+                         });
+    if (state->interrupted) {
+      state->interrupted = false;
+      return Result::Interrupted;
+    }
+    if (state->stopping || (state->finished && !state->fresh))
+      return Result::Stopped;
+    if (!state->fresh)
+      return Result::Timeout;
+    std::swap(state->taken, state->waiting);
+    state->fresh = false;
+    *time = state->time;
+  }
+  // The thread only ever writes to the other two buffers
+  memcpy(buffer, state->buffers[state->taken].data(),
+         state->buffers[state->taken].size());
+  return Result::Frame;
+}
+
+void PS3EyeFrameReader::Interrupt() {
+  std::shared_ptr<State> state;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    state = m_state;
+  }
+  if (!state)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->interrupted = true;
+  }
+  state->wake.notify_all();
+}
+
+void PS3EyeFrameReader::ReadLoop(std::shared_ptr<State> state) {
+  std::unique_lock<std::mutex> lock(state->mutex);
+  while (!state->stopping) {
+    uint8_t *buffer = state->buffers[state->write].data();
+    lock.unlock();
+    const int64_t time = state->read(buffer);
+    lock.lock();
+    if (state->stopping)
+      break;
+    std::swap(state->write, state->waiting);
+    state->time = time;
+    state->fresh = true;
+    state->wake.notify_all();
+  }
+  lock.unlock();
+  // Drop what read holds (the device) here, the thread that used it, before
+  // the owner learns the thread is done
+  state->read = nullptr;
+  lock.lock();
+  state->finished = true;
+  state->wake.notify_all();
+}
@@ -0,0 +1,98 @@
+// PS3EyeFrameReader.h
+// Bounded, interruptible waits on a frame source that blocks without a
+// timeout. The driver's getFrame waits on its frame queue until a frame
+// comes, and stop() cancels the transfers without waking it, so a thread
+// calling getFrame directly hangs for good once the camera stops
+// delivering (unplugged, stalled, or stopped underneath it), and whoever
+// joins that thread hangs with it.
+//
+// The reader calls the blocking source on a thread of its own and hands
+// frames over through three rotating buffers:
+//   - Take waits with a timeout and returns early on Interrupt or Stop,
+//   - Stop waits a bounded time for the thread to leave the source. The
+//     source is only stopped by its owner once Stop says it is no longer in
+//     use. A thread still blocked keeps what the read function captured
+//     (the device) until the source returns; the reader holds on to it and
+//     will not Start again until a later Stop has joined it, so its owner
+//     never opens the same device twice.
+//
+// Only depends on the C++ standard library (see TestFrameReader.cpp).
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PS3EyeFrameReader {
+public:
+  // Blocks until the next frame is in buffer and returns when it arrived
+  typedef std::function<int64_t(uint8_t *buffer)> ReadFunction;
+
+  enum class Result {
+    Frame,       // A frame newer than the last one taken
+    Timeout,     // None within the timeout
+    Interrupted, // Interrupt was called
+    Stopped,     // Not started, or stopped
+  };
+
+  PS3EyeFrameReader() {}
+  // Stop without waiting; a thread still blocked in read is detached, as
+  // nobody is left to join it
+  ~PS3EyeFrameReader();
+
+  // Start a thread calling read for frames of frameSize bytes, stopping any
+  // earlier one first. False, without starting, while an earlier thread is
+  // still blocked in read.
+  bool Start(ReadFunction read, size_t frameSize);
+
+  // Ask the thread to finish and wait up to timeoutMs for it to return from
+  // read. True once it has, the thread is joined and read will not be called
+  // again; false while read is still blocked. The thread then exits the next
+  // time read returns, and the next Stop or Start joins it.
+  bool Stop(uint32_t timeoutMs);
+
+  // Wait up to timeoutMs for a frame newer than the last one taken and copy
+  // it to buffer, with the time read returned for it
+  Result Take(uint8_t *buffer, uint32_t timeoutMs, int64_t *time);
+
+  // Wake a Take in progress with Interrupted, or the next one if none is.
+  // Any thread.
+  void Interrupt();
+
+private:
+  PS3EyeFrameReader(const PS3EyeFrameReader &) = delete;
+  PS3EyeFrameReader &operator=(const PS3EyeFrameReader &) = delete;
+
+  // Shared with the thread, which may outlive the reader
+  struct State {
+    ReadFunction read;
+    std::mutex mutex;
+    std::condition_variable wake; // A frame, Interrupt, Stop, thread done
+    std::vector<uint8_t> buffers[3];
+    size_t write = 0;   // Being filled by read
+    size_t waiting = 1; // Newest complete frame
+    size_t taken = 2;   // Being copied out by Take
+    int64_t time = 0;
+    bool fresh = false; // waiting holds a frame not taken yet
+    bool interrupted = false;
+    bool stopping = false;
+    bool finished = false; // The thread is out of read for good
+  };
+
+  static void ReadLoop(std::shared_ptr<State> state);
+
+  // Swapped by Start and Stop on the owner's thread; Interrupt may come
+  // from any thread
+  std::mutex m_mutex;
+  std::shared_ptr<State> m_state;
+  // A thread Stop gave up on, until it leaves read and is joined. Owner's
+  // thread only.
+  std::shared_ptr<State> m_blocked;
+  std::thread m_thread;
+};
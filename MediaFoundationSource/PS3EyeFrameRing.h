@@ -0,0 +1,367 @@
+// PS3EyeFrameRing.h
+// Lock-free multi-slot frame ring used by the shared memory transport
+// Only depends on the C++ standard library so the slot protocol can be built
+// and stress tested on any platform (see TestFrameRing.cpp)
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Number of frame slots in the ring. The writer always fills the slot after
+// the newest one, so readers copying the newest frame have (slots - 1) frame
+// periods before their slot can be overwritten.
+constexpr uint32_t PS3EYE_RING_SLOT_COUNT = 4;
+
+// Readers give up after this many torn copies in a row
+constexpr uint32_t PS3EYE_RING_MAX_READ_ATTEMPTS = 8;
+
+// Counters written by different parties (writer vs. pinning readers) are kept
+// on separate cache lines, and slot data starts on page boundaries
+constexpr uint32_t PS3EYE_CACHE_LINE_SIZE = 64;
+constexpr uint32_t PS3EYE_PAGE_SIZE = 4096;
+
+constexpr uint64_t PS3EyeAlignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// The ring lives in memory shared between processes, so every atomic used by
+// the protocol must be lock-free (and therefore address-free).
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "32-bit atomics must be lock-free");
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "64-bit atomics must be lock-free");
+
+// Pixel formats of published frames (PS3EyeFrameHeader::format). Colour
+// frames are stored bottom-up, as a DIB; raw and grey frames top-down, as the
+// sensor reads out (flipping a mosaic would change its pattern) and as Y800
+// consumers take them.
+constexpr uint32_t PS3EYE_FORMAT_RGB24 = 0;      // R, G, B
+constexpr uint32_t PS3EYE_FORMAT_BGR24 = 1;      // B, G, R
+constexpr uint32_t PS3EYE_FORMAT_BAYER_GRBG = 2; // Raw sensor data, 8 bits
+constexpr uint32_t PS3EYE_FORMAT_GREY8 = 3;      // Luma only, 8 bits
+
+// FOURCC of raw GRBG frames, the media subtype the sources offer them as
+constexpr uint32_t PS3EYE_FOURCC_GRBG = 'G' | 'R' << 8 | 'B' << 16 | 'G' << 24;
+
+// FOURCC of grey frames (8-bit luma, full range)
+constexpr uint32_t PS3EYE_FOURCC_Y800 = 'Y' | '8' << 8 | '0' << 16 | '0' << 24;
+
+constexpr uint32_t PS3EyeFormatBytesPerPixel(uint32_t format) {
+  return format == PS3EYE_FORMAT_BAYER_GRBG || format == PS3EYE_FORMAT_GREY8
+             ? 1
+             : 3;
+}
+
+// PS3EyeFrameMetadata::flags. A partial frame is corrupt too: the rows it
+// did not get hold whatever the buffer had before.
+constexpr uint32_t PS3EYE_FRAME_FLAG_CORRUPT = 0x1; // Payload is known bad
+constexpr uint32_t PS3EYE_FRAME_FLAG_PARTIAL = 0x2; // Frame ended early
+
+// Per-frame capture metadata, published atomically with the frame data.
+// Times use the same clock as the frame timestamp.
+struct PS3EyeFrameMetadata {
+  uint64_t arrivalTime;  // Frame fully received from the camera
+  uint64_t publishTime;  // Frame handed to the transport
+  uint32_t exposure;     // Sensor exposure in effect (driver units)
+  uint32_t gain;         // Sensor gain in effect (driver units)
+  uint32_t redBalance;   // White balance gains in effect (driver units)
+  uint32_t greenBalance;
+  uint32_t blueBalance;
+  uint32_t droppedFrames; // Frames lost between the previous published frame
+                          // and this one
+  uint32_t flags;         // PS3EYE_FRAME_FLAG_*
+  uint32_t reserved;
+};
+
+// Per-slot state. sequence is odd while the writer is filling the slot and
+// is bumped to the next even value once the frame is complete. pinCount is
+// the number of readers holding the slot through Acquire(); the writer never
+// reuses a pinned slot. It lives on its own cache line so pinning readers do
+// not invalidate the line other readers validate their copies against.
+struct alignas(PS3EYE_CACHE_LINE_SIZE) PS3EyeRingSlot {
+  std::atomic<uint32_t> sequence;
+  uint32_t dataOffset; // Offset to slot data from the start of the mapping
+  uint64_t frameNumber;
+  uint64_t timestamp;
+  uint32_t dataSize;
+  uint32_t reserved;
+  PS3EyeFrameMetadata metadata;
+  alignas(PS3EYE_CACHE_LINE_SIZE) std::atomic<uint32_t> pinCount;
+};
+
+// Ring control block, placed in shared memory after PS3EyeFrameHeader. The
+// first cache line is only written by the writer, once per frame.
+struct alignas(PS3EYE_CACHE_LINE_SIZE) PS3EyeRingControl {
+  std::atomic<uint64_t> latestFrame; // Frame number of newest frame (0 = none)
+  std::atomic<uint32_t> latestSlot;  // Slot holding latestFrame
+  uint32_t slotCount;
+  uint32_t slotSize; // Capacity of each slot in bytes
+  uint32_t reserved;
+  std::atomic<uint64_t> droppedFrames; // Frames dropped because all slots
+                                       // other than the newest were pinned
+  PS3EyeRingSlot slots[PS3EYE_RING_SLOT_COUNT];
+};
+
+static_assert(offsetof(PS3EyeRingSlot, pinCount) % PS3EYE_CACHE_LINE_SIZE == 0,
+              "pinCount must start its own cache line");
+
+enum class PS3EyeRingReadResult {
+  Ok,         // A new frame was copied
+  NoNewFrame, // Newest frame is the one the caller already has
+  Torn,       // Writer kept overwriting the slot while we copied it
+};
+
+// Read-only view of a pinned slot, returned by Acquire()
+struct PS3EyeRingView {
+  const uint8_t *data;
+  uint32_t dataSize;
+  uint32_t slot;
+  uint64_t frameNumber;
+  uint64_t timestamp;
+  PS3EyeFrameMetadata metadata;
+};
+
+//------------------------------------------------------------------------------
+// PS3EyeFrameRing
+// Seqlock-style slot protocol. There is exactly one writer; it never waits on
+// readers. Readers either copy the newest slot and validate its sequence
+// counter afterwards (ReadLatest), retrying only if the slot was rewritten
+// mid-copy, or pin it and read it in place (Acquire/Release).
+//------------------------------------------------------------------------------
+class PS3EyeFrameRing {
+public:
+  PS3EyeFrameRing()
+      : m_control(nullptr), m_base(nullptr), m_reportedDrops(0) {}
+
+  // Attach to a control block and the mapping it describes
+  void Attach(PS3EyeRingControl *control, uint8_t *base) {
+    m_control = control;
+    m_base = base;
+  }
+
+  void Detach() {
+    m_control = nullptr;
+    m_base = nullptr;
+  }
+
+  bool IsAttached() const { return m_control != nullptr; }
+
+  // Bytes needed for the slot data of a ring
+  static uint64_t DataSize(uint32_t slotSize) {
+    return static_cast<uint64_t>(slotSize) * PS3EYE_RING_SLOT_COUNT;
+  }
+
+  // Writer only: lay out the slots contiguously starting at dataOffset. Pass a
+  // page-aligned dataOffset and slotSize to keep every frame page-aligned.
+  void Initialize(uint32_t dataOffset, uint32_t slotSize) {
+    m_control->latestFrame.store(0, std::memory_order_relaxed);
+    m_control->latestSlot.store(0, std::memory_order_relaxed);
+    m_control->slotCount = PS3EYE_RING_SLOT_COUNT;
+    m_control->slotSize = slotSize;
+    m_control->droppedFrames.store(0, std::memory_order_relaxed);
+    m_reportedDrops = 0;
+    for (uint32_t i = 0; i < PS3EYE_RING_SLOT_COUNT; i++) {
+      PS3EyeRingSlot &slot = m_control->slots[i];
+      slot.sequence.store(0, std::memory_order_relaxed);
+      slot.pinCount.store(0, std::memory_order_relaxed);
+      slot.dataOffset = dataOffset + i * slotSize;
+      slot.frameNumber = 0;
+      slot.timestamp = 0;
+      slot.dataSize = 0;
+      memset(&slot.metadata, 0, sizeof(slot.metadata));
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  // Writer only: copy a frame into the first unpinned slot after the newest
+  // one and publish it. Never blocks. Returns the new frame number, or 0 if
+  // the frame is too large or every other slot is pinned by readers. Frames
+  // dropped here are added to the next published frame's droppedFrames.
+  uint64_t Publish(const uint8_t *data, uint32_t size, uint64_t timestamp,
+                   const PS3EyeFrameMetadata *metadata = nullptr) {
+    if (!m_control || size > m_control->slotSize)
+      return 0;
+
+    const uint64_t frameNumber =
+        m_control->latestFrame.load(std::memory_order_relaxed) + 1;
+    const uint32_t latest =
+        m_control->latestSlot.load(std::memory_order_relaxed);
+
+    // Claim a slot: mark it odd, then make sure no reader pinned it in the
+    // meantime. Pairs with the pin / re-check sequence in Acquire().
+    PS3EyeRingSlot *claimed = nullptr;
+    uint32_t index = 0, seq = 0;
+    for (uint32_t i = 1; i < PS3EYE_RING_SLOT_COUNT && !claimed; i++) {
+      index = (latest + i) % PS3EYE_RING_SLOT_COUNT;
+      PS3EyeRingSlot &slot = m_control->slots[index];
+      if (slot.pinCount.load(std::memory_order_seq_cst) != 0)
+        continue;
+      seq = slot.sequence.load(std::memory_order_relaxed);
+      slot.sequence.store(seq + 1, std::memory_order_seq_cst);
+      if (slot.pinCount.load(std::memory_order_seq_cst) != 0) {
+        // Lost the race to a reader; the data is untouched so just undo
+        slot.sequence.store(seq, std::memory_order_seq_cst);
+        continue;
+      }
+      claimed = &slot;
+    }
+    if (!claimed) {
+      m_control->droppedFrames.fetch_add(1, std::memory_order_relaxed);
+      return 0;
+    }
+    PS3EyeRingSlot &slot = *claimed;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(m_base + slot.dataOffset, data, size);
+    slot.frameNumber = frameNumber;
+    slot.timestamp = timestamp;
+    slot.dataSize = size;
+    if (metadata)
+      slot.metadata = *metadata;
+    else
+      memset(&slot.metadata, 0, sizeof(slot.metadata));
+    const uint64_t drops =
+        m_control->droppedFrames.load(std::memory_order_relaxed);
+    slot.metadata.droppedFrames +=
+        static_cast<uint32_t>(drops - m_reportedDrops);
+    m_reportedDrops = drops;
+
+    slot.sequence.store(seq + 2, std::memory_order_release);
+
+    // Make the slot visible as the newest frame
+    m_control->latestSlot.store(index, std::memory_order_relaxed);
+    m_control->latestFrame.store(frameNumber, std::memory_order_release);
+    return frameNumber;
+  }
+
+  // Reader: copy the newest frame into dest if it is newer than
+  // lastFrameNumber. On success frameNumber/timestamp/metadata describe the
+  // copy.
+  PS3EyeRingReadResult
+  ReadLatest(uint8_t *dest, uint32_t destSize, uint64_t lastFrameNumber,
+             uint64_t *frameNumber, uint64_t *timestamp,
+             PS3EyeFrameMetadata *metadata = nullptr) const {
+    for (uint32_t attempt = 0; attempt < PS3EYE_RING_MAX_READ_ATTEMPTS;
+         attempt++) {
+      const uint64_t latest =
+          m_control->latestFrame.load(std::memory_order_acquire);
+      if (latest == 0 || latest == lastFrameNumber)
+        return PS3EyeRingReadResult::NoNewFrame;
+
+      const uint32_t index =
+          m_control->latestSlot.load(std::memory_order_relaxed) %
+          PS3EYE_RING_SLOT_COUNT;
+      const PS3EyeRingSlot &slot = m_control->slots[index];
+
+      const uint32_t seq1 = slot.sequence.load(std::memory_order_acquire);
+      if (seq1 & 1)
+        continue; // Writer lapped us and is filling this slot right now
+
+      const uint64_t slotFrame = slot.frameNumber;
+      const uint64_t slotTimestamp = slot.timestamp;
+      const PS3EyeFrameMetadata slotMetadata = slot.metadata;
+      uint32_t copySize = slot.dataSize;
+      if (copySize > destSize)
+        copySize = destSize;
+      if (copySize > m_control->slotSize)
+        copySize = m_control->slotSize;
+      memcpy(dest, m_base + slot.dataOffset, copySize);
+
+      // The copy is only valid if nobody started writing the slot meanwhile
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != seq1)
+        continue;
+
+      if (slotFrame == lastFrameNumber)
+        return PS3EyeRingReadResult::NoNewFrame;
+
+      if (frameNumber)
+        *frameNumber = slotFrame;
+      if (timestamp)
+        *timestamp = slotTimestamp;
+      if (metadata)
+        *metadata = slotMetadata;
+      return PS3EyeRingReadResult::Ok;
+    }
+    return PS3EyeRingReadResult::Torn;
+  }
+
+  // Reader: pin the newest frame and return a view of it in place if it is
+  // newer than lastFrameNumber. Every Ok result must be paired with Release().
+  PS3EyeRingReadResult Acquire(uint64_t lastFrameNumber,
+                               PS3EyeRingView *view) const {
+    for (uint32_t attempt = 0; attempt < PS3EYE_RING_MAX_READ_ATTEMPTS;
+         attempt++) {
+      const uint64_t latest =
+          m_control->latestFrame.load(std::memory_order_acquire);
+      if (latest == 0 || latest == lastFrameNumber)
+        return PS3EyeRingReadResult::NoNewFrame;
+
+      const uint32_t index =
+          m_control->latestSlot.load(std::memory_order_relaxed) %
+          PS3EYE_RING_SLOT_COUNT;
+      PS3EyeRingSlot &slot = m_control->slots[index];
+
+      const uint32_t seq1 = slot.sequence.load(std::memory_order_acquire);
+      if (seq1 & 1)
+        continue;
+
+      // Pin, then confirm the writer did not claim the slot before the pin
+      // became visible to it
+      slot.pinCount.fetch_add(1, std::memory_order_seq_cst);
+      if (slot.sequence.load(std::memory_order_seq_cst) != seq1) {
+        slot.pinCount.fetch_sub(1, std::memory_order_release);
+        continue;
+      }
+
+      if (slot.frameNumber == lastFrameNumber) {
+        slot.pinCount.fetch_sub(1, std::memory_order_release);
+        return PS3EyeRingReadResult::NoNewFrame;
+      }
+
+      uint32_t size = slot.dataSize;
+      if (size > m_control->slotSize)
+        size = m_control->slotSize;
+      view->data = m_base + slot.dataOffset;
+      view->dataSize = size;
+      view->slot = index;
+      view->frameNumber = slot.frameNumber;
+      view->timestamp = slot.timestamp;
+      view->metadata = slot.metadata;
+      return PS3EyeRingReadResult::Ok;
+    }
+    return PS3EyeRingReadResult::Torn;
+  }
+
+  // Reader: unpin a slot returned by Acquire()
+  void Release(const PS3EyeRingView &view) const {
+    m_control->slots[view.slot % PS3EYE_RING_SLOT_COUNT].pinCount.fetch_sub(
+        1, std::memory_order_release);
+  }
+
+  uint64_t DroppedFrames() const {
+    return m_control ? m_control->droppedFrames.load(std::memory_order_relaxed)
+                     : 0;
+  }
+
+  uint64_t LatestFrameNumber() const {
+    return m_control ? m_control->latestFrame.load(std::memory_order_acquire)
+                     : 0;
+  }
+
+  // Offset of the newest slot's data, for mirroring into the v1 header
+  uint32_t LatestDataOffset() const {
+    const uint32_t index =
+        m_control->latestSlot.load(std::memory_order_relaxed) %
+        PS3EYE_RING_SLOT_COUNT;
+    return m_control->slots[index].dataOffset;
+  }
+
+private:
+  PS3EyeRingControl *m_control;
+  uint8_t *m_base;
+  uint64_t m_reportedDrops; // Writer only: drops already attributed to a frame
+};
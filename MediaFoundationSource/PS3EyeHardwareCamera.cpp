@@ -0,0 +1,176 @@
+// PS3EyeHardwareCamera.cpp
+// PS3EYEDriver camera backend
+
+#include "PS3EyeHardwareCamera.h"
+#include "PS3EyeBayer.h"
+#include "PS3EyeIpc.h"
+
+#include <cstdio>
+#include <mutex>
+
+// The driver keeps one global device list that getDevices(true) rebuilds,
+// and every channel thread may enumerate
+static std::mutex g_enumerateMutex;
+
+// The port path stays the same across reboots and re-plugs into the same
+// port, unlike the enumeration order
+static void GetPortDeviceId(const ps3eye::PS3EYECam::PS3EYERef &device,
+                            size_t index, char *deviceId, size_t size) {
+  if (!device->getUSBPortPath(deviceId, size))
+    snprintf(deviceId, size, "device-%zu", index);
+}
+
+PS3EyeHardwareCamera::PS3EyeHardwareCamera(
+    ps3eye::PS3EYECam::PS3EYERef device, const char *deviceId)
+    : m_device(device), m_deviceId(deviceId), m_open(false), m_width(0),
+      m_height(0), m_fps(0), m_format(PS3EYE_FORMAT_RGB24) {}
+
+PS3EyeHardwareCamera::~PS3EyeHardwareCamera() { Close(); }
+
+bool PS3EyeHardwareCamera::Open(uint32_t width, uint32_t height,
+                                uint32_t fps, uint32_t format) {
+  if (format != PS3EYE_FORMAT_RGB24 && format != PS3EYE_FORMAT_BAYER_GRBG &&
+      format != PS3EYE_FORMAT_GREY8)
+    return false;
+  // A reader Stop gave up on still holds the device, and with it the USB
+  // interface; the port is only opened again once that thread is out of
+  // getFrame and joined
+  if (!m_reader.Stop(0))
+    return false;
+
+  if (!m_device) {
+    std::lock_guard<std::mutex> lock(g_enumerateMutex);
+    const auto &devices = ps3eye::PS3EYECam::getDevices(true);
+    for (size_t i = 0; i < devices.size() && !m_device; i++) {
+      char deviceId[48];
+      GetPortDeviceId(devices[i], i, deviceId, sizeof(deviceId));
+      if (m_deviceId == deviceId)
+        m_device = devices[i];
+    }
+    if (!m_device)
+      return false;
+  }
+
+  // Raw Bayer: the driver's own conversion is scalar
+  if (!m_device->init(width, height, static_cast<uint16_t>(fps),
+                      ps3eye::PS3EYECam::EOutputFormat::Bayer))
+    return false;
+  m_width = width;
+  m_height = height;
+  m_fps = fps;
+  m_format = format;
+  m_bayer.resize(format == PS3EYE_FORMAT_BAYER_GRBG
+                     ? 0
+                     : static_cast<size_t>(width) * height);
+  m_pool = format == PS3EYE_FORMAT_BAYER_GRBG ? nullptr
+                                              : PS3EyeWorkerPool::Shared();
+  m_device->setAutogain(true);
+  m_device->setAutoWhiteBalance(true);
+  m_open = true;
+  return true;
+}
+
+void PS3EyeHardwareCamera::Close() {
+  Stop();
+  // Dropping the last reference releases the USB handle
+  m_device.reset();
+  m_pool.reset();
+  m_open = false;
+}
+
+bool PS3EyeHardwareCamera::Start() {
+  if (!m_open)
+    return false;
+  m_device->start();
+  if (!m_device->isStreaming())
+    return false;
+  // The reader's own reference keeps the device alive for a thread still in
+  // getFrame after Stop gave up on it
+  ps3eye::PS3EYECam::PS3EYERef device = m_device;
+  if (!m_reader.Start(
+          [device](uint8_t *buffer) {
+            device->getFrame(buffer);
+            return static_cast<int64_t>(PS3EyeTransportTime());
+          },
+          static_cast<size_t>(m_width) * m_height)) {
+    m_device->stop();
+    return false;
+  }
+  return true;
+}
+
+void PS3EyeHardwareCamera::Stop() {
+  if (!m_device || !m_device->isStreaming())
+    return;
+  // getFrame only returns with a frame, and stop() cancels the transfers
+  // without waking it, so the device is only stopped once nothing is in
+  // getFrame. A streaming camera hands a frame over within a period.
+  const uint32_t timeoutMs = 2000 / m_fps + 50;
+  if (m_reader.Stop(timeoutMs)) {
+    m_device->stop();
+    return;
+  }
+  // Stopping now would leave the reader blocked for good. The device stays
+  // with the reader, still streaming, so a stall that clears lets it out of
+  // getFrame; it then drops the device, whose destructor stops it and
+  // releases the interface, and the next Open joins it. Until then Open
+  // fails and the port stays closed.
+  char message[128];
+  snprintf(message, sizeof(message),
+           "PS3EyeHardwareCamera %s: no frame in %u ms, closed until the "
+           "reader returns",
+           m_deviceId.c_str(), timeoutMs);
+  PS3EyeIpcLog(message);
+  m_device.reset();
+  m_pool.reset();
+  m_open = false;
+}
+
+bool PS3EyeHardwareCamera::IsStreaming() const {
+  return m_device && m_device->isStreaming();
+}
+
+uint64_t PS3EyeHardwareCamera::GetFrame(uint8_t *buffer, uint32_t timeoutMs,
+                                        uint32_t *flags) {
+  *flags = 0;
+  // Stamped by the reader as getFrame returned
+  int64_t arrival;
+  uint8_t *raw = m_format == PS3EYE_FORMAT_BAYER_GRBG ? buffer : m_bayer.data();
+  if (m_reader.Take(raw, timeoutMs, &arrival) !=
+      PS3EyeFrameReader::Result::Frame)
+    return 0;
+  if (m_format == PS3EYE_FORMAT_BAYER_GRBG)
+    return static_cast<uint64_t>(arrival);
+  if (m_format == PS3EYE_FORMAT_GREY8) {
+    PS3EyeGreyJob job = {m_bayer.data(), m_width, buffer,
+                         m_width,        m_width, m_height};
+    PS3EyeBayerToGreyParallel(m_pool.get(), job);
+    return static_cast<uint64_t>(arrival);
+  }
+  // Colour frames are published bottom-up; the flip is part of the demosaic
+  PS3EyeBayerJob job = {m_bayer.data(),         m_width,  buffer,
+                        m_width * 3,            m_width,  m_height,
+                        PS3EyeBayerFormat::RGB, true,     false};
+  PS3EyeDemosaicParallel(m_pool.get(), job);
+  return static_cast<uint64_t>(arrival);
+}
+
+void PS3EyeHardwareCamera::GetSettings(PS3EyeFrameMetadata *metadata) const {
+  metadata->exposure = m_device->getExposure();
+  metadata->gain = m_device->getGain();
+  metadata->redBalance = m_device->getRedBalance();
+  metadata->greenBalance = m_device->getGreenBalance();
+  metadata->blueBalance = m_device->getBlueBalance();
+}
+
+PS3EyeCameraList PS3EyeEnumerateHardwareCameras() {
+  std::lock_guard<std::mutex> lock(g_enumerateMutex);
+  PS3EyeCameraList cameras;
+  const auto &devices = ps3eye::PS3EYECam::getDevices(true);
+  for (size_t i = 0; i < devices.size(); i++) {
+    char deviceId[48];
+    GetPortDeviceId(devices[i], i, deviceId, sizeof(deviceId));
+    cameras.emplace_back(new PS3EyeHardwareCamera(devices[i], deviceId));
+  }
+  return cameras;
+}
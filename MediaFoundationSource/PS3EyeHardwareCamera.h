@@ -0,0 +1,60 @@
+// PS3EyeHardwareCamera.h
+// Camera backend on top of the PS3EYEDriver. The driver delivers raw Bayer
+// frames, which are passed through or converted to RGB with the SIMD kernels
+// of PS3EyeBayer.h, in stripes on the worker pool all cameras share.
+// The driver's getFrame has no timeout, so it runs on a PS3EyeFrameReader
+// thread and GetFrame waits on that instead.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "PS3EyeCamera.h"
+#include "PS3EyeFrameReader.h"
+#include "PS3EyeWorkerPool.h"
+#include "ps3eye.h"
+
+class PS3EyeHardwareCamera : public PS3EyeCamera {
+public:
+  PS3EyeHardwareCamera(ps3eye::PS3EYECam::PS3EYERef device,
+                       const char *deviceId);
+  ~PS3EyeHardwareCamera() override;
+
+  const char *GetDeviceId() const override { return m_deviceId.c_str(); }
+
+  // Re-finds the device by port path if it was closed
+  bool Open(uint32_t width, uint32_t height, uint32_t fps,
+            uint32_t format) override;
+  void Close() override;
+  bool IsOpen() const override { return m_open; }
+
+  bool Start() override;
+  // Stops the device once the reader is out of getFrame. A device that sends
+  // nothing for two frame periods is left to the reader instead and the
+  // camera closed; Open fails until the reader has let go of it, then finds
+  // the device again.
+  void Stop() override;
+  bool IsStreaming() const override;
+  // The driver hands over whole frames only; flags are always 0
+  uint64_t GetFrame(uint8_t *buffer, uint32_t timeoutMs,
+                    uint32_t *flags) override;
+  void Interrupt() override { m_reader.Interrupt(); }
+  void GetSettings(PS3EyeFrameMetadata *metadata) const override;
+
+private:
+  ps3eye::PS3EYECam::PS3EYERef m_device;
+  std::string m_deviceId;
+  bool m_open;
+  uint32_t m_width;
+  uint32_t m_height;
+  uint32_t m_fps;
+  uint32_t m_format;
+  PS3EyeFrameReader m_reader; // While streaming
+  std::vector<uint8_t> m_bayer;
+  std::shared_ptr<PS3EyeWorkerPool> m_pool; // While open, unless raw
+};
+
+// Every PS3 Eye on the system, identified by USB port path
+PS3EyeCameraList PS3EyeEnumerateHardwareCameras();
@@ -0,0 +1,148 @@
+// PS3EyeIpc.h
+// Platform layer of the shared memory transport: named mappings, cross-process
+// wake-ups, process liveness and the transport clock. PS3EyeIpcWin32.cpp
+// implements it with file mappings and named events, PS3EyeIpcPosix.cpp with
+// shm_open, mmap and futexes. PS3EyeSharedMemory.cpp only talks to this layer,
+// so the transport builds unchanged on both.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+struct PS3EyeClientTable;
+
+constexpr uint32_t PS3EYE_MAX_CLIENTS = 32;
+
+// Longest shared memory name, including the terminator
+constexpr uint32_t PS3EYE_NAME_SIZE = 64;
+
+// Timeout value that never expires
+constexpr uint32_t PS3EYE_INFINITE = 0xFFFFFFFF;
+
+// Clock used for frame timestamps and metadata times, in 100ns units. It is
+// system-wide (performance counter / CLOCK_MONOTONIC), so clients can compare
+// frame times with their own PS3EyeTransportTime() calls for latency
+// compensation.
+uint64_t PS3EyeTransportTime();
+
+uint32_t PS3EyeCurrentProcessId();
+
+// True only if the process is known to be gone. A process we are not allowed
+// to inspect counts as alive.
+bool PS3EyeProcessExited(uint32_t pid);
+
+// Diagnostics (debugger output on Windows, stderr elsewhere)
+void PS3EyeIpcLog(const char *message);
+
+//------------------------------------------------------------------------------
+// PS3EyeSharedRegion
+// A named, process-shared memory region. The creator sizes it; openers map
+// the whole region and reject it if it is smaller than they need.
+//------------------------------------------------------------------------------
+class PS3EyeSharedRegion {
+public:
+  PS3EyeSharedRegion();
+  ~PS3EyeSharedRegion();
+
+  // Create (or reuse) the region. With largePages it is backed by large pages
+  // where the OS and account allow it, otherwise by normal pages.
+  bool Create(const char *name, uint64_t size, bool largePages);
+
+  // Map an existing region
+  bool Open(const char *name, uint64_t minSize);
+
+  void Close();
+
+  uint8_t *Data() const { return m_data; }
+  uint64_t Size() const { return m_size; }
+  bool IsLargePages() const { return m_largePages; }
+
+private:
+  PS3EyeSharedRegion(const PS3EyeSharedRegion &) = delete;
+  PS3EyeSharedRegion &operator=(const PS3EyeSharedRegion &) = delete;
+
+#ifdef _WIN32
+  void *m_section; // File mapping handle
+#else
+  int m_fd;
+  bool m_owner; // Unlink the name on Close
+  char m_name[PS3EYE_NAME_SIZE + 1];
+#endif
+  uint8_t *m_data;
+  uint64_t m_size;
+  bool m_largePages;
+};
+
+//------------------------------------------------------------------------------
+// PS3EyeServerSignals
+// Server side of the notifications: waking every registered client after a
+// frame, and sleeping until a client connects or disconnects. Named objects
+// are scoped by the region name, so every channel has its own.
+//------------------------------------------------------------------------------
+class PS3EyeServerSignals {
+public:
+  PS3EyeServerSignals();
+  ~PS3EyeServerSignals();
+
+  // legacy also creates the unscoped objects v1 tools look for
+  bool Create(const char *name, PS3EyeClientTable *table, bool legacy);
+  void Close();
+
+  // Wake every client registered in the table. Call after bumping
+  // table->generation.
+  void WakeClients();
+
+  // Sleep until the client set changes from the clientEpoch value seen, or
+  // until the timeout. May return early.
+  void WaitForClientChange(uint32_t seenEpoch, uint32_t timeoutMs);
+
+private:
+  PS3EyeServerSignals(const PS3EyeServerSignals &) = delete;
+  PS3EyeServerSignals &operator=(const PS3EyeServerSignals &) = delete;
+
+  PS3EyeClientTable *m_table;
+#ifdef _WIN32
+  void *m_legacyMutex;       // Kept open for v1 tools that expect it to exist
+  void *m_legacyFrameEvent;  // v1 single-waiter frame event
+  void *m_legacyClientEvent; // Set by v1 tools when they connect/disconnect
+  void *m_clientEvent;       // Set by clients when they connect/disconnect
+  void *m_clientFrameEvents[PS3EYE_MAX_CLIENTS]; // Opened lazily
+  uint32_t m_clientEventIds[PS3EYE_MAX_CLIENTS]; // Id each handle belongs to
+  char m_name[PS3EYE_NAME_SIZE];                 // Region the events belong to
+#endif
+};
+
+//------------------------------------------------------------------------------
+// PS3EyeClientSignals
+// Client side of the notifications: sleeping until the frame generation
+// moves, and telling the server the client set changed.
+//------------------------------------------------------------------------------
+class PS3EyeClientSignals {
+public:
+  PS3EyeClientSignals();
+  ~PS3EyeClientSignals();
+
+  // Set up our wake-up object for client table entry eventId of region name
+  bool Create(const char *name, PS3EyeClientTable *table, uint32_t eventId);
+  void Close();
+
+  bool IsOpen() const { return m_table != nullptr; }
+
+  // Sleep until table->generation differs from seenGeneration, or until the
+  // timeout. May return early; callers re-check the generation.
+  void WaitForFrame(uint32_t seenGeneration, uint32_t timeoutMs);
+
+  // Bump the client epoch and wake the server
+  void NotifyClientChange();
+
+private:
+  PS3EyeClientSignals(const PS3EyeClientSignals &) = delete;
+  PS3EyeClientSignals &operator=(const PS3EyeClientSignals &) = delete;
+
+  PS3EyeClientTable *m_table;
+#ifdef _WIN32
+  void *m_frameEvent;  // Our own auto-reset event, set by the server
+  void *m_clientEvent; // Server's connect/disconnect event
+#endif
+};
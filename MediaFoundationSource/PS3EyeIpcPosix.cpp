@@ -0,0 +1,235 @@
+// PS3EyeIpcPosix.cpp
+// POSIX implementation of the shared memory platform layer: shm_open + mmap
+// regions, futex wake-ups on the counters in the client table (polling where
+// futexes are unavailable) and kill(pid, 0) liveness checks
+// Link with -lrt on older glibc.
+
+#include "PS3EyeIpc.h"
+#include "PS3EyeSharedMemory.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+//------------------------------------------------------------------------------
+// Process and clock helpers
+//------------------------------------------------------------------------------
+
+uint64_t PS3EyeTransportTime() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 10000000 + now.tv_nsec / 100;
+}
+
+uint32_t PS3EyeCurrentProcessId() { return static_cast<uint32_t>(getpid()); }
+
+bool PS3EyeProcessExited(uint32_t pid) {
+  // EPERM means it is alive but not ours to signal
+  return kill(static_cast<pid_t>(pid), 0) != 0 && errno == ESRCH;
+}
+
+void PS3EyeIpcLog(const char *message) { fprintf(stderr, "%s\n", message); }
+
+//------------------------------------------------------------------------------
+// Futex helpers
+// The counters live in memory shared between processes, so the shared (not
+// FUTEX_PRIVATE) operations are used.
+//------------------------------------------------------------------------------
+
+static void FutexWait(const std::atomic<uint32_t> &word, uint32_t seen,
+                      uint32_t timeoutMs) {
+  if (word.load(std::memory_order_acquire) != seen)
+    return;
+#ifdef __linux__
+  timespec timeout = {static_cast<time_t>(timeoutMs / 1000),
+                      static_cast<long>(timeoutMs % 1000) * 1000000};
+  syscall(SYS_futex, reinterpret_cast<const uint32_t *>(&word), FUTEX_WAIT,
+          seen, timeoutMs == PS3EYE_INFINITE ? nullptr : &timeout, nullptr, 0);
+#else
+  // No process-shared wait on an address; poll at 1 ms
+  timespec poll = {0, 1000000};
+  for (uint32_t waited = 0; waited < timeoutMs; waited++) {
+    nanosleep(&poll, nullptr);
+    if (word.load(std::memory_order_acquire) != seen)
+      return;
+  }
+#endif
+}
+
+static void FutexWakeAll(std::atomic<uint32_t> &word) {
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX,
+          nullptr, nullptr, 0);
+#else
+  (void)word;
+#endif
+}
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "Futex words must be plain 32-bit integers");
+
+//------------------------------------------------------------------------------
+// PS3EyeSharedRegion
+//------------------------------------------------------------------------------
+
+PS3EyeSharedRegion::PS3EyeSharedRegion()
+    : m_fd(-1), m_owner(false), m_data(nullptr), m_size(0),
+      m_largePages(false) {
+  m_name[0] = '\0';
+}
+
+PS3EyeSharedRegion::~PS3EyeSharedRegion() { Close(); }
+
+bool PS3EyeSharedRegion::Create(const char *name, uint64_t size,
+                                bool largePages) {
+  snprintf(m_name, sizeof(m_name), "/%s", name);
+  m_fd = shm_open(m_name, O_RDWR | O_CREAT, 0666);
+  if (m_fd < 0)
+    return false;
+  m_owner = true;
+
+  // Let clients of other users open it regardless of our umask
+  fchmod(m_fd, 0666);
+  if (ftruncate(m_fd, static_cast<off_t>(size)) != 0) {
+    Close();
+    return false;
+  }
+
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (data == MAP_FAILED) {
+    Close();
+    return false;
+  }
+  m_data = static_cast<uint8_t *>(data);
+  m_size = size;
+
+  // shm_open memory cannot use MAP_HUGETLB; transparent huge pages for shmem
+  // work when the kernel allows them (shmem_enabled = advise)
+  m_largePages = false;
+#ifdef MADV_HUGEPAGE
+  if (largePages)
+    m_largePages = madvise(m_data, m_size, MADV_HUGEPAGE) == 0;
+#else
+  (void)largePages;
+#endif
+  return true;
+}
+
+bool PS3EyeSharedRegion::Open(const char *name, uint64_t minSize) {
+  snprintf(m_name, sizeof(m_name), "/%s", name);
+  m_fd = shm_open(m_name, O_RDWR, 0);
+  if (m_fd < 0)
+    return false;
+
+  // Reject regions too small for this protocol version
+  struct stat info;
+  if (fstat(m_fd, &info) != 0 ||
+      static_cast<uint64_t>(info.st_size) < minSize) {
+    Close();
+    return false;
+  }
+
+  uint64_t size = static_cast<uint64_t>(info.st_size);
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (data == MAP_FAILED) {
+    Close();
+    return false;
+  }
+  m_data = static_cast<uint8_t *>(data);
+  m_size = size;
+  return true;
+}
+
+void PS3EyeSharedRegion::Close() {
+  if (m_data) {
+    munmap(m_data, m_size);
+    m_data = nullptr;
+  }
+  if (m_fd >= 0) {
+    close(m_fd);
+    m_fd = -1;
+  }
+  // Existing mappings stay valid; new clients fail to connect until the next
+  // server creates the region again
+  if (m_owner) {
+    shm_unlink(m_name);
+    m_owner = false;
+  }
+  m_size = 0;
+  m_largePages = false;
+}
+
+//------------------------------------------------------------------------------
+// PS3EyeServerSignals
+// Every client sleeps on the generation counter itself, so one wake-all per
+// frame reaches all of them.
+//------------------------------------------------------------------------------
+
+PS3EyeServerSignals::PS3EyeServerSignals() : m_table(nullptr) {}
+
+PS3EyeServerSignals::~PS3EyeServerSignals() { Close(); }
+
+bool PS3EyeServerSignals::Create(const char *name, PS3EyeClientTable *table,
+                                 bool legacy) {
+  // Waits are on the table inside the region itself, so nothing is named
+  (void)name;
+  (void)legacy;
+  m_table = table;
+  return true;
+}
+
+void PS3EyeServerSignals::Close() { m_table = nullptr; }
+
+void PS3EyeServerSignals::WakeClients() {
+  if (m_table)
+    FutexWakeAll(m_table->generation);
+}
+
+void PS3EyeServerSignals::WaitForClientChange(uint32_t seenEpoch,
+                                              uint32_t timeoutMs) {
+  if (m_table)
+    FutexWait(m_table->clientEpoch, seenEpoch, timeoutMs);
+}
+
+//------------------------------------------------------------------------------
+// PS3EyeClientSignals
+//------------------------------------------------------------------------------
+
+PS3EyeClientSignals::PS3EyeClientSignals() : m_table(nullptr) {}
+
+PS3EyeClientSignals::~PS3EyeClientSignals() { Close(); }
+
+bool PS3EyeClientSignals::Create(const char *name, PS3EyeClientTable *table,
+                                 uint32_t eventId) {
+  (void)name;
+  (void)eventId; // We wait on the shared generation counter instead
+  m_table = table;
+  return true;
+}
+
+void PS3EyeClientSignals::Close() { m_table = nullptr; }
+
+void PS3EyeClientSignals::WaitForFrame(uint32_t seenGeneration,
+                                       uint32_t timeoutMs) {
+  if (m_table)
+    FutexWait(m_table->generation, seenGeneration, timeoutMs);
+}
+
+void PS3EyeClientSignals::NotifyClientChange() {
+  if (!m_table)
+    return;
+  m_table->clientEpoch.fetch_add(1, std::memory_order_release);
+  FutexWakeAll(m_table->clientEpoch);
+}
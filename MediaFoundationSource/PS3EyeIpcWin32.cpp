@@ -0,0 +1,316 @@
+// PS3EyeIpcWin32.cpp
+// Win32 implementation of the shared memory platform layer: pagefile-backed
+// file mappings, named events and process handles
+
+#include "PS3EyeIpc.h"
+#include "PS3EyeSharedMemory.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <cstdio>
+#include <cstring>
+#include <windows.h>
+
+#ifndef FILE_MAP_LARGE_PAGES
+#define FILE_MAP_LARGE_PAGES 0x20000000 // Windows 10 1703+ SDKs
+#endif
+
+// Named objects. The legacy mutex, frame event and client event only exist
+// for v1 tools.
+static const wchar_t LEGACY_MUTEX_NAME[] = L"PS3EyeFrameMutex";
+static const wchar_t LEGACY_FRAME_EVENT_NAME[] = L"PS3EyeNewFrameEvent";
+static const wchar_t LEGACY_CLIENT_EVENT_NAME[] = L"PS3EyeClientEvent";
+
+// Per-region objects: one auto-reset frame event per client, and one event
+// clients set when they connect/disconnect
+static void ClientFrameEventName(const char *region, uint32_t eventId,
+                                 wchar_t *name, size_t count) {
+  swprintf_s(name, count, L"%hs_NewFrameEvent_%u", region, eventId);
+}
+
+static void ClientEventName(const char *region, wchar_t *name, size_t count) {
+  swprintf_s(name, count, L"%hs_ClientEvent", region);
+}
+
+static void CloseHandleIfSet(void *&handle) {
+  if (handle) {
+    CloseHandle(handle);
+    handle = nullptr;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Process and clock helpers
+//------------------------------------------------------------------------------
+
+uint64_t PS3EyeTransportTime() {
+  static const LONGLONG freq = [] {
+    LARGE_INTEGER f;
+    QueryPerformanceFrequency(&f);
+    return f.QuadPart;
+  }();
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  // Split to avoid overflowing the multiply after a few days of uptime
+  return static_cast<uint64_t>((now.QuadPart / freq) * 10000000 +
+                               (now.QuadPart % freq) * 10000000 / freq);
+}
+
+uint32_t PS3EyeCurrentProcessId() { return GetCurrentProcessId(); }
+
+bool PS3EyeProcessExited(uint32_t pid) {
+  // Access denied means it is alive but not ours to open
+  HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+  if (!process)
+    return GetLastError() == ERROR_INVALID_PARAMETER;
+  bool exited = WaitForSingleObject(process, 0) == WAIT_OBJECT_0;
+  CloseHandle(process);
+  return exited;
+}
+
+void PS3EyeIpcLog(const char *message) {
+  OutputDebugStringA(message);
+  OutputDebugStringA("\n");
+}
+
+//------------------------------------------------------------------------------
+// PS3EyeSharedRegion
+//------------------------------------------------------------------------------
+
+// Large-page sections need SeLockMemoryPrivilege enabled in our token
+static bool EnableLockMemoryPrivilege() {
+  HANDLE token;
+  if (!OpenProcessToken(GetCurrentProcess(),
+                        TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+    return false;
+
+  TOKEN_PRIVILEGES privileges = {};
+  privileges.PrivilegeCount = 1;
+  privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+  bool enabled = LookupPrivilegeValueW(nullptr, SE_LOCK_MEMORY_NAME,
+                                       &privileges.Privileges[0].Luid) &&
+                 AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr,
+                                       nullptr) &&
+                 GetLastError() == ERROR_SUCCESS; // Not ERROR_NOT_ALL_ASSIGNED
+  CloseHandle(token);
+  return enabled;
+}
+
+// Map the whole section. Large-page sections can only be mapped in whole
+// large pages, so the view size is never passed explicitly.
+static uint8_t *MapSection(HANDLE section, DWORD access, uint64_t minSize,
+                           uint64_t *size) {
+  void *view = MapViewOfFile(section, access, 0, 0, 0);
+  if (!view)
+    view = MapViewOfFile(section, access | FILE_MAP_LARGE_PAGES, 0, 0, 0);
+  if (!view)
+    return nullptr;
+
+  // Reject sections too small for this protocol version
+  MEMORY_BASIC_INFORMATION info;
+  if (!VirtualQuery(view, &info, sizeof(info)) || info.RegionSize < minSize) {
+    UnmapViewOfFile(view);
+    return nullptr;
+  }
+  *size = info.RegionSize;
+  return static_cast<uint8_t *>(view);
+}
+
+PS3EyeSharedRegion::PS3EyeSharedRegion()
+    : m_section(nullptr), m_data(nullptr), m_size(0), m_largePages(false) {}
+
+PS3EyeSharedRegion::~PS3EyeSharedRegion() { Close(); }
+
+bool PS3EyeSharedRegion::Create(const char *name, uint64_t size,
+                                bool largePages) {
+  // On large pages if asked and allowed. The section size must be a whole
+  // number of large pages.
+  m_largePages = false;
+  SIZE_T largePageSize = largePages ? GetLargePageMinimum() : 0;
+  if (largePageSize && EnableLockMemoryPrivilege()) {
+    uint64_t largeSize = PS3EyeAlignUp(size, largePageSize);
+    m_section = CreateFileMappingA(
+        INVALID_HANDLE_VALUE, nullptr,
+        PAGE_READWRITE | SEC_COMMIT | SEC_LARGE_PAGES,
+        static_cast<DWORD>(largeSize >> 32), static_cast<DWORD>(largeSize),
+        name);
+    m_largePages = m_section != nullptr;
+  }
+  if (!m_section) {
+    m_section = CreateFileMappingA(
+        INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), name);
+  }
+  if (!m_section)
+    return false;
+
+  m_data = MapSection(m_section, FILE_MAP_ALL_ACCESS, size, &m_size);
+  if (!m_data) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool PS3EyeSharedRegion::Open(const char *name, uint64_t minSize) {
+  m_section = OpenFileMappingA(FILE_MAP_WRITE, FALSE, name);
+  if (!m_section)
+    return false;
+
+  m_data = MapSection(m_section, FILE_MAP_WRITE, minSize, &m_size);
+  if (!m_data) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void PS3EyeSharedRegion::Close() {
+  if (m_data) {
+    UnmapViewOfFile(m_data);
+    m_data = nullptr;
+  }
+  CloseHandleIfSet(m_section);
+  m_size = 0;
+  m_largePages = false;
+}
+
+//------------------------------------------------------------------------------
+// PS3EyeServerSignals
+// Process-shared WaitOnAddress does not exist on Windows, so every client
+// owns a named auto-reset event and the server sets each one per frame.
+//------------------------------------------------------------------------------
+
+PS3EyeServerSignals::PS3EyeServerSignals()
+    : m_table(nullptr), m_legacyMutex(nullptr), m_legacyFrameEvent(nullptr),
+      m_legacyClientEvent(nullptr), m_clientEvent(nullptr) {
+  ZeroMemory(m_clientFrameEvents, sizeof(m_clientFrameEvents));
+  ZeroMemory(m_clientEventIds, sizeof(m_clientEventIds));
+  m_name[0] = '\0';
+}
+
+PS3EyeServerSignals::~PS3EyeServerSignals() { Close(); }
+
+bool PS3EyeServerSignals::Create(const char *name, PS3EyeClientTable *table,
+                                 bool legacy) {
+  if (legacy) {
+    m_legacyMutex = CreateMutexW(nullptr, FALSE, LEGACY_MUTEX_NAME);
+    m_legacyFrameEvent =
+        CreateEventW(nullptr, FALSE, FALSE, LEGACY_FRAME_EVENT_NAME);
+    m_legacyClientEvent =
+        CreateEventW(nullptr, FALSE, FALSE, LEGACY_CLIENT_EVENT_NAME);
+    if (!m_legacyMutex || !m_legacyFrameEvent || !m_legacyClientEvent) {
+      Close();
+      return false;
+    }
+  }
+
+  wchar_t eventName[128];
+  ClientEventName(name, eventName, _countof(eventName));
+  m_clientEvent = CreateEventW(nullptr, FALSE, FALSE, eventName);
+  if (!m_clientEvent) {
+    Close();
+    return false;
+  }
+  strcpy_s(m_name, name);
+  m_table = table;
+  return true;
+}
+
+void PS3EyeServerSignals::Close() {
+  for (uint32_t i = 0; i < PS3EYE_MAX_CLIENTS; i++)
+    CloseHandleIfSet(m_clientFrameEvents[i]);
+  CloseHandleIfSet(m_clientEvent);
+  CloseHandleIfSet(m_legacyClientEvent);
+  CloseHandleIfSet(m_legacyFrameEvent);
+  CloseHandleIfSet(m_legacyMutex);
+  m_table = nullptr;
+}
+
+void PS3EyeServerSignals::WakeClients() {
+  if (!m_table)
+    return;
+
+  for (uint32_t i = 0; i < PS3EYE_MAX_CLIENTS; i++) {
+    PS3EyeClientSlot &slot = m_table->clients[i];
+    uint32_t pid = slot.pid.load(std::memory_order_acquire);
+    if (pid == 0 || pid == PS3EYE_CLIENT_CLAIMING) {
+      CloseHandleIfSet(m_clientFrameEvents[i]);
+      continue;
+    }
+
+    // Open the client's event the first time we see its registration
+    if (!m_clientFrameEvents[i] || m_clientEventIds[i] != slot.eventId) {
+      CloseHandleIfSet(m_clientFrameEvents[i]);
+      wchar_t name[128];
+      ClientFrameEventName(m_name, slot.eventId, name, _countof(name));
+      m_clientFrameEvents[i] = OpenEventW(EVENT_MODIFY_STATE, FALSE, name);
+      m_clientEventIds[i] = slot.eventId;
+    }
+
+    if (m_clientFrameEvents[i])
+      SetEvent(m_clientFrameEvents[i]);
+  }
+
+  // Legacy single-waiter event for v1 tools
+  if (m_legacyFrameEvent)
+    SetEvent(m_legacyFrameEvent);
+}
+
+void PS3EyeServerSignals::WaitForClientChange(uint32_t seenEpoch,
+                                              uint32_t timeoutMs) {
+  // The auto-reset event stays set until we wait, so no epoch check is needed
+  (void)seenEpoch;
+  if (!m_clientEvent)
+    return;
+  // v1 tools set the unscoped event when they change clientCount
+  HANDLE events[] = {m_clientEvent, m_legacyClientEvent};
+  WaitForMultipleObjects(m_legacyClientEvent ? 2 : 1, events, FALSE,
+                         timeoutMs);
+}
+
+//------------------------------------------------------------------------------
+// PS3EyeClientSignals
+//------------------------------------------------------------------------------
+
+PS3EyeClientSignals::PS3EyeClientSignals()
+    : m_table(nullptr), m_frameEvent(nullptr), m_clientEvent(nullptr) {}
+
+PS3EyeClientSignals::~PS3EyeClientSignals() { Close(); }
+
+bool PS3EyeClientSignals::Create(const char *name, PS3EyeClientTable *table,
+                                 uint32_t eventId) {
+  wchar_t eventName[128];
+  ClientFrameEventName(name, eventId, eventName, _countof(eventName));
+  m_frameEvent = CreateEventW(nullptr, FALSE, FALSE, eventName);
+  if (!m_frameEvent)
+    return false;
+
+  // Optional; only used to wake an idle server sooner
+  ClientEventName(name, eventName, _countof(eventName));
+  m_clientEvent = OpenEventW(EVENT_MODIFY_STATE, FALSE, eventName);
+  m_table = table;
+  return true;
+}
+
+void PS3EyeClientSignals::Close() {
+  CloseHandleIfSet(m_frameEvent);
+  CloseHandleIfSet(m_clientEvent);
+  m_table = nullptr;
+}
+
+void PS3EyeClientSignals::WaitForFrame(uint32_t seenGeneration,
+                                       uint32_t timeoutMs) {
+  // The auto-reset event stays set until we wait, so a frame published after
+  // the caller read the generation still ends the wait
+  (void)seenGeneration;
+  if (m_frameEvent)
+    WaitForSingleObject(m_frameEvent, timeoutMs);
+}
+
+void PS3EyeClientSignals::NotifyClientChange() {
+  if (!m_table)
+    return;
+  m_table->clientEpoch.fetch_add(1, std::memory_order_release);
+  if (m_clientEvent)
+    SetEvent(m_clientEvent);
+}
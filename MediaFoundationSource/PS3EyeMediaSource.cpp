@@ -3,6 +3,7 @@
 // Enables Windows Camera Frame Server sharing for multi-app access
 
 #include "PS3EyeMediaSource.h"
+#include "PS3EyeFrameConvert.h"
 #include <initguid.h> // Must come before any DEFINE_GUID usage
 #include <mfapi.h>
 #include <mferror.h>
@@ -21,6 +22,27 @@ extern "C" const GUID CLSID_PS3EyeMediaSource = {
     0x4a2e,
     {0x9f, 0x1d, 0x3b, 0x5c, 0x6d, 0x8e, 0x9a, 0x0b}};
 
+// Raw GRBG frames, offered when the service publishes raw Bayer
+DEFINE_MEDIATYPE_GUID(MFVideoFormat_PS3EyeGRBG, PS3EYE_FOURCC_GRBG);
+
+// Grey frames, offered when the service publishes grey
+DEFINE_MEDIATYPE_GUID(MFVideoFormat_PS3EyeY800, PS3EYE_FOURCC_Y800);
+
+// Stride of the first plane and bytes per frame of a subtype
+static void GetFrameLayout(const GUID &subtype, UINT32 width, UINT32 height,
+                           LONG *stride, UINT32 *imageSize) {
+  if (subtype == MFVideoFormat_NV12 || subtype == MFVideoFormat_I420) {
+    *stride = width;
+    *imageSize = PS3EyeYuvFrameSize(PS3EyeYuvFormat::NV12, width, height);
+    return;
+  }
+  *stride = width * (subtype == MFVideoFormat_PS3EyeGRBG ||
+                             subtype == MFVideoFormat_PS3EyeY800
+                         ? 1
+                         : 3);
+  *imageSize = *stride * height;
+}
+
 // Helper macro for safe release
 #define SAFE_RELEASE(p)                                                        \
   {                                                                            \
@@ -114,7 +136,69 @@ HRESULT PS3EyeMediaSource::Initialize() {
 }
 
 HRESULT PS3EyeMediaSource::CreateStream() {
-  // Create media type for RGB24 video
+  // RGB24 video. When the service publishes raw Bayer, NV12 and I420 come
+  // first, converted straight from the raw frames so encoders need not
+  // convert RGB back to YUV, then the raw frames themselves, then RGB24 at
+  // half size, binned from the raw frames for apps that want the smaller
+  // frames. Grey channels offer their Y800 frames after RGB24, so an app that
+  // asks for nothing in particular still gets colour-layout frames.
+  const GUID rgbSubtypes[] = {MFVideoFormat_RGB24};
+  const GUID rawSubtypes[] = {MFVideoFormat_NV12, MFVideoFormat_I420,
+                              MFVideoFormat_RGB24, MFVideoFormat_PS3EyeGRBG,
+                              MFVideoFormat_RGB24};
+  const GUID greySubtypes[] = {MFVideoFormat_RGB24, MFVideoFormat_PS3EyeY800};
+  const uint32_t format = m_sharedMemClient.GetFormat();
+  const GUID *subtypes = rgbSubtypes;
+  DWORD mediaTypeCount = ARRAYSIZE(rgbSubtypes);
+  if (format == PS3EYE_FORMAT_BAYER_GRBG) {
+    subtypes = rawSubtypes;
+    mediaTypeCount = ARRAYSIZE(rawSubtypes);
+  } else if (format == PS3EYE_FORMAT_GREY8) {
+    subtypes = greySubtypes;
+    mediaTypeCount = ARRAYSIZE(greySubtypes);
+  }
+
+  ComPtr<IMFMediaType> pTypes[ARRAYSIZE(rawSubtypes)];
+  IMFMediaType *mediaTypes[ARRAYSIZE(rawSubtypes)];
+  HRESULT hr = S_OK;
+  for (DWORD i = 0; i < mediaTypeCount; i++) {
+    const bool binned = subtypes == rawSubtypes && i == mediaTypeCount - 1;
+    const UINT32 scale = binned ? 2 : 1;
+    hr = CreateVideoType(subtypes[i], m_width / scale, m_height / scale,
+                         &pTypes[i]);
+    if (FAILED(hr))
+      return hr;
+    mediaTypes[i] = pTypes[i].Get();
+  }
+  IMFMediaType *pMediaType = mediaTypes[0]; // Preferred
+
+  // Create stream descriptor with these media types
+  ComPtr<IMFStreamDescriptor> pSD;
+  hr = MFCreateStreamDescriptor(0, mediaTypeCount, mediaTypes, &pSD);
+  if (FAILED(hr))
+    return hr;
+
+  // Set stream attributes for Frame Server sharing
+  ComPtr<IMFAttributes> pStreamAttrs;
+  hr = pSD->GetMediaTypeHandler(nullptr); // Just validate
+
+  ComPtr<IMFMediaTypeHandler> pHandler;
+  hr = pSD->GetMediaTypeHandler(&pHandler);
+  if (SUCCEEDED(hr)) {
+    hr = pHandler->SetCurrentMediaType(pMediaType);
+  }
+
+  // Create the stream object
+  m_stream = new PS3EyeMediaStream(this, pSD.Get());
+  if (!m_stream)
+    return E_OUTOFMEMORY;
+
+  return S_OK;
+}
+
+HRESULT PS3EyeMediaSource::CreateVideoType(const GUID &subtype, UINT32 width,
+                                           UINT32 height,
+                                           IMFMediaType **ppType) {
   ComPtr<IMFMediaType> pMediaType;
   HRESULT hr = MFCreateMediaType(&pMediaType);
   if (FAILED(hr))
@@ -124,12 +208,11 @@ HRESULT PS3EyeMediaSource::CreateStream() {
   if (FAILED(hr))
     return hr;
 
-  hr = pMediaType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_RGB24);
+  hr = pMediaType->SetGUID(MF_MT_SUBTYPE, subtype);
   if (FAILED(hr))
     return hr;
 
-  hr =
-      MFSetAttributeSize(pMediaType.Get(), MF_MT_FRAME_SIZE, m_width, m_height);
+  hr = MFSetAttributeSize(pMediaType.Get(), MF_MT_FRAME_SIZE, width, height);
   if (FAILED(hr))
     return hr;
 
@@ -147,8 +230,9 @@ HRESULT PS3EyeMediaSource::CreateStream() {
     return hr;
 
   // Calculate stride and image size
-  LONG stride = m_width * 3; // RGB24 = 3 bytes per pixel
-  UINT32 imageSize = stride * m_height;
+  LONG stride;
+  UINT32 imageSize;
+  GetFrameLayout(subtype, width, height, &stride, &imageSize);
 
   hr = pMediaType->SetUINT32(MF_MT_DEFAULT_STRIDE, stride);
   if (FAILED(hr))
@@ -166,29 +250,24 @@ HRESULT PS3EyeMediaSource::CreateStream() {
   if (FAILED(hr))
     return hr;
 
-  // Create stream descriptor with this media type
-  ComPtr<IMFStreamDescriptor> pSD;
-  IMFMediaType *mediaTypes[] = {pMediaType.Get()};
-  hr = MFCreateStreamDescriptor(0, 1, mediaTypes, &pSD);
-  if (FAILED(hr))
-    return hr;
-
-  // Set stream attributes for Frame Server sharing
-  ComPtr<IMFAttributes> pStreamAttrs;
-  hr = pSD->GetMediaTypeHandler(nullptr); // Just validate
+  *ppType = pMediaType.Detach();
+  return S_OK;
+}
 
+void PS3EyeMediaSource::GetCurrentType(GUID *subtype, UINT32 *width,
+                                       UINT32 *height) {
+  *subtype = MFVideoFormat_RGB24;
+  *width = m_width;
+  *height = m_height;
+  ComPtr<IMFStreamDescriptor> pSD;
   ComPtr<IMFMediaTypeHandler> pHandler;
-  hr = pSD->GetMediaTypeHandler(&pHandler);
-  if (SUCCEEDED(hr)) {
-    hr = pHandler->SetCurrentMediaType(pMediaType.Get());
+  ComPtr<IMFMediaType> pType;
+  if (m_stream && SUCCEEDED(m_stream->GetStreamDescriptor(&pSD)) &&
+      SUCCEEDED(pSD->GetMediaTypeHandler(&pHandler)) &&
+      SUCCEEDED(pHandler->GetCurrentMediaType(&pType))) {
+    pType->GetGUID(MF_MT_SUBTYPE, subtype);
+    MFGetAttributeSize(pType.Get(), MF_MT_FRAME_SIZE, width, height);
   }
-
-  // Create the stream object
-  m_stream = new PS3EyeMediaStream(this, pSD.Get());
-  if (!m_stream)
-    return E_OUTOFMEMORY;
-
-  return S_OK;
 }
 
 HRESULT PS3EyeMediaSource::CreatePresentationDescriptorInternal() {
@@ -491,11 +570,26 @@ void PS3EyeMediaSource::StopCaptureThread() {
 }
 
 void PS3EyeMediaSource::CaptureThreadProc() {
-  // Allocate frame buffer
-  const UINT32 frameSize = m_width * m_height * 3; // RGB24
-  std::unique_ptr<uint8_t[]> frameBuffer(new uint8_t[frameSize]);
+  // Raw and grey frames go out as they are when the app picked their type.
+  // Everything else is converted into the media buffer: RGB24 and YUV from
+  // raw or grey channels, and RGB24 from RGB24 channels too, which hold
+  // R,G,B bottom-up where MF wants B,G,R top-down. Half-size RGB24 is binned
+  // from the raw frames.
+  GUID subtype;
+  UINT32 width, height;
+  GetCurrentType(&subtype, &width, &height);
+  const bool binnedOutput = width != m_width;
+  const bool nativeOutput = subtype == MFVideoFormat_PS3EyeGRBG ||
+                            subtype == MFVideoFormat_PS3EyeY800;
+  const bool yuvOutput =
+      subtype == MFVideoFormat_NV12 || subtype == MFVideoFormat_I420;
+  const PS3EyeYuvFormat yuvFormat = subtype == MFVideoFormat_I420
+                                        ? PS3EyeYuvFormat::I420
+                                        : PS3EyeYuvFormat::NV12;
+  LONG stride;
+  UINT32 frameSize;
+  GetFrameLayout(subtype, width, height, &stride, &frameSize);
 
-  LONGLONG timestamp = 0;
   const LONGLONG frameDuration =
       10000000LL / m_frameRate; // 100-nanosecond units
 
@@ -513,33 +607,54 @@ void PS3EyeMediaSource::CaptureThreadProc() {
       continue;
     }
 
-    // Read frame from shared memory (lossless)
-    UINT64 frameNum, frameTimestamp;
-    if (!m_sharedMemClient.ReadFrame(frameBuffer.get(), frameSize, &frameNum,
-                                     &frameTimestamp)) {
+    // Pin the frame in shared memory; it is copied exactly once, straight
+    // into the media buffer
+    PS3EyeFrameView frame;
+    if (!m_sharedMemClient.AcquireFrame(&frame)) {
+      continue;
+    }
+    // Capture time stamped by the service. PS3EyeTransportTime is
+    // QueryPerformanceCounter in 100ns units, the clock MFGetSystemTime and
+    // the presentation clock run on, so it is used as the sample time as is.
+    const LONGLONG timestamp = static_cast<LONGLONG>(frame.timestamp);
+
+    // Don't deliver frames the server knows are bad
+    if (frame.metadata.flags & PS3EYE_FRAME_FLAG_CORRUPT) {
+      m_sharedMemClient.ReleaseFrame(&frame);
       continue;
     }
 
     // Create MF sample
     ComPtr<IMFSample> pSample;
     HRESULT hr = MFCreateSample(&pSample);
-    if (FAILED(hr))
-      continue;
-
     ComPtr<IMFMediaBuffer> pBuffer;
-    hr = MFCreateMemoryBuffer(frameSize, &pBuffer);
-    if (FAILED(hr))
-      continue;
+    if (SUCCEEDED(hr))
+      hr = MFCreateMemoryBuffer(frameSize, &pBuffer);
 
     // Copy frame data to buffer
-    BYTE *pDest = nullptr;
-    hr = pBuffer->Lock(&pDest, nullptr, nullptr);
     if (SUCCEEDED(hr)) {
-      memcpy(pDest, frameBuffer.get(), frameSize);
-      pBuffer->Unlock();
-      pBuffer->SetCurrentLength(frameSize);
+      BYTE *pDest = nullptr;
+      hr = pBuffer->Lock(&pDest, nullptr, nullptr);
+      if (SUCCEEDED(hr)) {
+        if (yuvOutput)
+          PS3EyeConvertFrameYuv(frame, pDest, yuvFormat);
+        else if (binnedOutput)
+          PS3EyeConvertFrameBinned(frame, pDest, width * 3,
+                                   PS3EyeBayerFormat::BGR, false);
+        else if (!nativeOutput)
+          PS3EyeConvertFrame(frame, pDest, m_width * 3,
+                             PS3EyeBayerFormat::BGR, false);
+        else
+          memcpy(pDest, frame.data, min(frameSize, frame.dataSize));
+        pBuffer->Unlock();
+        pBuffer->SetCurrentLength(frameSize);
+      }
     }
 
+    m_sharedMemClient.ReleaseFrame(&frame);
+    if (FAILED(hr))
+      continue;
+
     hr = pSample->AddBuffer(pBuffer.Get());
     if (FAILED(hr))
       continue;
@@ -547,7 +662,6 @@ void PS3EyeMediaSource::CaptureThreadProc() {
     // Set sample time and duration
     pSample->SetSampleTime(timestamp);
     pSample->SetSampleDuration(frameDuration);
-    timestamp += frameDuration;
 
     // Deliver sample to stream
     if (m_stream) {
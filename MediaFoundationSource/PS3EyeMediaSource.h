@@ -91,6 +91,11 @@ private:
   ~PS3EyeMediaSource();
 
   HRESULT CreateStream();
+  HRESULT CreateVideoType(const GUID &subtype, UINT32 width, UINT32 height,
+                          IMFMediaType **ppType);
+  // Subtype and frame size the stream was started with (RGB24, NV12, I420,
+  // raw GRBG or grey Y800, or half-size RGB24 binned from raw frames)
+  void GetCurrentType(GUID *subtype, UINT32 *width, UINT32 *height);
   HRESULT CreatePresentationDescriptorInternal();
   HRESULT ValidatePresentationDescriptor(IMFPresentationDescriptor *pPD);
 
@@ -0,0 +1,206 @@
+// PS3EyePacketCapture.cpp
+// Bulk payload captures, synthesis and replay
+
+#include "PS3EyePacketCapture.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+
+static_assert(sizeof(PS3EyePacketFileHeader) == 32 &&
+                  sizeof(PS3EyePacketRecord) == 16,
+              ".ps3u records have no padding");
+
+void PS3EyePacketCapture::Reset(uint32_t width, uint32_t height,
+                                uint32_t fps) {
+  m_width = width;
+  m_height = height;
+  m_fps = fps;
+  m_transfers.clear();
+  m_data.clear();
+}
+
+void PS3EyePacketCapture::AddTransfer(int64_t time, const uint8_t *data,
+                                      uint32_t length) {
+  m_transfers.push_back({time, m_data.size(), length});
+  m_data.insert(m_data.end(), data, data + length);
+}
+
+void PS3EyePacketCapture::AddPayloads(
+    const std::vector<std::vector<uint8_t>> &payloads, int64_t start,
+    int64_t duration) {
+  // Bytes go straight into m_data; a transfer closes when the next payload
+  // would not fit, or after a short payload, as a short USB packet
+  // completes a bulk transfer
+  const uint64_t base = m_data.size();
+  std::vector<uint64_t> ends;
+  uint64_t transferStart = base;
+  for (const std::vector<uint8_t> &payload : payloads) {
+    m_data.insert(m_data.end(), payload.begin(), payload.end());
+    if (payload.size() < PS3EYE_PAYLOAD_SIZE ||
+        m_data.size() - transferStart + PS3EYE_PAYLOAD_SIZE >
+            PS3EYE_TRANSFER_SIZE) {
+      ends.push_back(m_data.size());
+      transferStart = m_data.size();
+    }
+  }
+  if (m_data.size() > transferStart)
+    ends.push_back(m_data.size());
+
+  uint64_t offset = base;
+  for (size_t i = 0; i < ends.size(); i++) {
+    const int64_t time = start + duration * static_cast<int64_t>(i + 1) /
+                                     static_cast<int64_t>(ends.size());
+    m_transfers.push_back(
+        {time, offset, static_cast<uint32_t>(ends[i] - offset)});
+    offset = ends[i];
+  }
+}
+
+bool PS3EyePacketCapture::Save(const char *path) const {
+  FILE *file = fopen(path, "wb");
+  if (!file)
+    return false;
+  PS3EyePacketFileHeader header = {};
+  header.magic = PS3EYE_PACKET_MAGIC;
+  header.version = PS3EYE_PACKET_VERSION;
+  header.width = m_width;
+  header.height = m_height;
+  header.fps = m_fps;
+  header.transfers = m_transfers.size();
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  for (size_t i = 0; ok && i < m_transfers.size(); i++) {
+    const Transfer &transfer = m_transfers[i];
+    PS3EyePacketRecord record = {};
+    record.time = transfer.time;
+    record.length = transfer.length;
+    ok = fwrite(&record, sizeof(record), 1, file) == 1 &&
+         (transfer.length == 0 ||
+          fwrite(Data(transfer), transfer.length, 1, file) == 1);
+  }
+  return fclose(file) == 0 && ok;
+}
+
+bool PS3EyePacketCapture::Load(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return false;
+  PS3EyePacketFileHeader header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            header.magic == PS3EYE_PACKET_MAGIC &&
+            header.version == PS3EYE_PACKET_VERSION;
+  if (ok)
+    Reset(header.width, header.height, header.fps);
+  std::vector<uint8_t> buffer;
+  for (uint64_t i = 0; ok && i < header.transfers; i++) {
+    PS3EyePacketRecord record;
+    ok = fread(&record, sizeof(record), 1, file) == 1;
+    if (!ok)
+      break;
+    buffer.resize(record.length);
+    ok = record.length == 0 ||
+         fread(buffer.data(), record.length, 1, file) == 1;
+    if (ok)
+      AddTransfer(record.time, buffer.data(), record.length);
+  }
+  fclose(file);
+  if (!ok)
+    Reset(0, 0, 0);
+  return ok;
+}
+
+std::vector<std::vector<uint8_t>> PS3EyePacketizeFrame(const uint8_t *frame,
+                                                       uint32_t size,
+                                                       uint32_t pts,
+                                                       bool fid) {
+  const uint32_t chunk = PS3EYE_PAYLOAD_SIZE - PS3EYE_PAYLOAD_HEADER_SIZE;
+  std::vector<std::vector<uint8_t>> payloads;
+  for (uint32_t offset = 0; offset < size; offset += chunk) {
+    const uint32_t length = size - offset < chunk ? size - offset : chunk;
+    const bool last = offset + length == size;
+    std::vector<uint8_t> payload(PS3EYE_PAYLOAD_HEADER_SIZE + length, 0);
+    payload[0] = PS3EYE_PAYLOAD_HEADER_SIZE;
+    payload[1] = PS3EYE_PAYLOAD_PTS | PS3EYE_PAYLOAD_SCR |
+                 (fid ? PS3EYE_PAYLOAD_FID : 0) |
+                 (last ? PS3EYE_PAYLOAD_EOF : 0);
+    payload[2] = static_cast<uint8_t>(pts);
+    payload[3] = static_cast<uint8_t>(pts >> 8);
+    payload[4] = static_cast<uint8_t>(pts >> 16);
+    payload[5] = static_cast<uint8_t>(pts >> 24);
+    memcpy(payload.data() + PS3EYE_PAYLOAD_HEADER_SIZE, frame + offset,
+           length);
+    payloads.push_back(std::move(payload));
+  }
+  return payloads;
+}
+
+void PS3EyeSynthesizePackets(PS3EyePacketCapture *capture, uint32_t frames,
+                             const PS3EyePacketFaults &faults) {
+  const uint32_t width = capture->Width(), height = capture->Height();
+  const int64_t period = capture->Fps() > 0 ? 10000000 / capture->Fps() : 0;
+  std::mt19937 random(faults.seed);
+  std::uniform_int_distribution<uint32_t> perMille(0, 999);
+  std::vector<uint8_t> frame(capture->FrameSize());
+
+  // Carry on after frames already in the capture: the last transfer of
+  // frame n completes at (n + 1) periods
+  const uint64_t first =
+      capture->Transfers().empty() || period == 0
+          ? 0
+          : static_cast<uint64_t>(capture->Transfers().back().time / period);
+  for (uint64_t n = first; n < first + frames; n++) {
+    for (uint32_t y = 0; y < height; y++) {
+      for (uint32_t x = 0; x < width; x++)
+        frame[y * width + x] = PS3EyeSyntheticPixel(x, y, n);
+    }
+    // The PTS counts the bridge's clock; any value unique per frame will do
+    std::vector<std::vector<uint8_t>> payloads = PS3EyePacketizeFrame(
+        frame.data(), capture->FrameSize(), static_cast<uint32_t>(n + 1),
+        (n & 1) != 0);
+
+    // Draws in payload order, all four per payload, so one kind of fault
+    // does not shift where the others land
+    std::vector<std::vector<uint8_t>> sent;
+    for (std::vector<uint8_t> &payload : payloads) {
+      const bool drop = perMille(random) < faults.dropPerMille;
+      const bool error = perMille(random) < faults.errorPerMille;
+      const bool badHeader = perMille(random) < faults.badHeaderPerMille;
+      const bool noPts = perMille(random) < faults.noPtsPerMille;
+      if (drop)
+        continue;
+      if (error)
+        payload[1] |= PS3EYE_PAYLOAD_ERR;
+      if (badHeader)
+        payload[0] = 0;
+      if (noPts)
+        payload[1] &= ~PS3EYE_PAYLOAD_PTS;
+      sent.push_back(std::move(payload));
+    }
+    capture->AddPayloads(sent, static_cast<int64_t>(n) * period, period);
+  }
+}
+
+int64_t PS3EyeReplayPackets(const PS3EyePacketCapture &capture,
+                            PS3EyeFrameAssembler *assembler, double speed) {
+  typedef std::chrono::steady_clock Clock;
+  const Clock::time_point start = Clock::now();
+  const std::vector<PS3EyePacketCapture::Transfer> &transfers =
+      capture.Transfers();
+  const int64_t origin = transfers.empty() ? 0 : transfers.front().time;
+  for (const PS3EyePacketCapture::Transfer &transfer : transfers) {
+    if (speed > 0) {
+      const double due = (transfer.time - origin) / speed; // 100ns
+      std::this_thread::sleep_until(
+          start + std::chrono::duration_cast<Clock::duration>(
+                      std::chrono::duration<double, std::ratio<1, 10000000>>(
+                          due)));
+    }
+    assembler->Feed(capture.Data(transfer), transfer.length, transfer.time);
+  }
+  return std::chrono::duration_cast<
+             std::chrono::duration<int64_t, std::ratio<1, 10000000>>>(
+             Clock::now() - start)
+      .count();
+}
@@ -0,0 +1,116 @@
+// PS3EyePacketCapture.h
+// Recorded bulk transfers of the camera's payload stream, and what turns
+// them back into frames without a camera:
+//   - PS3EyePacketCapture holds transfers as the driver's transfer callback
+//     received them (time, bytes) and saves and loads them as .ps3u files,
+//   - PS3EyeSynthesizePackets generates the stream the bridge would send
+//     for a run of frames, with seeded faults, so malformed streams can be
+//     reproduced exactly,
+//   - PS3EyeReplayPackets plays a capture into a PS3EyeFrameAssembler in
+//     place of libusb, at the recorded pace or faster.
+//
+// .ps3u layout (little-endian): PS3EyePacketFileHeader, then per transfer a
+// PS3EyePacketRecord followed by its bytes.
+//
+// Only depends on the C++ standard library (see TestFrameAssembler.cpp).
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "PS3EyeFrameAssembler.h"
+
+constexpr uint32_t PS3EYE_PACKET_MAGIC = 0x55335350; // 'PS3U'
+constexpr uint32_t PS3EYE_PACKET_VERSION = 1;
+
+struct PS3EyePacketFileHeader {
+  uint32_t magic;   // PS3EYE_PACKET_MAGIC
+  uint32_t version; // PS3EYE_PACKET_VERSION
+  uint32_t width;   // Frame size the stream was captured at
+  uint32_t height;
+  uint32_t fps;
+  uint32_t reserved;
+  uint64_t transfers; // Records that follow
+};
+
+struct PS3EyePacketRecord {
+  int64_t time;    // Transfer completion, 100ns (any origin)
+  uint32_t length; // Bytes that follow
+  uint32_t reserved;
+};
+
+class PS3EyePacketCapture {
+public:
+  struct Transfer {
+    int64_t time;
+    uint64_t offset; // Into Data()
+    uint32_t length;
+  };
+
+  PS3EyePacketCapture() : m_width(0), m_height(0), m_fps(0) {}
+
+  // Empty capture of a stream of width x height raw Bayer frames
+  void Reset(uint32_t width, uint32_t height, uint32_t fps);
+
+  void AddTransfer(int64_t time, const uint8_t *data, uint32_t length);
+
+  // Pack payloads into bulk transfers the way the host controller completes
+  // them (up to PS3EYE_TRANSFER_SIZE, ended early by a short payload), their
+  // times spread evenly from start over duration
+  void AddPayloads(const std::vector<std::vector<uint8_t>> &payloads,
+                   int64_t start, int64_t duration);
+
+  bool Save(const char *path) const;
+  bool Load(const char *path);
+
+  uint32_t Width() const { return m_width; }
+  uint32_t Height() const { return m_height; }
+  uint32_t Fps() const { return m_fps; }
+  uint32_t FrameSize() const { return m_width * m_height; }
+  const std::vector<Transfer> &Transfers() const { return m_transfers; }
+  const uint8_t *Data(const Transfer &transfer) const {
+    return m_data.data() + transfer.offset;
+  }
+  uint64_t Bytes() const { return m_data.size(); }
+
+private:
+  uint32_t m_width;
+  uint32_t m_height;
+  uint32_t m_fps;
+  std::vector<Transfer> m_transfers;
+  std::vector<uint8_t> m_data;
+};
+
+// The payloads the bridge sends for one frame: a header with the PTS and
+// frame id on each, the frame split across them, the last flagged EOF
+std::vector<std::vector<uint8_t>> PS3EyePacketizeFrame(const uint8_t *frame,
+                                                       uint32_t size,
+                                                       uint32_t pts,
+                                                       bool fid);
+
+// Faults applied per payload, in a thousand, from a generator seeded with
+// seed, so the same faults land on the same payloads every time
+struct PS3EyePacketFaults {
+  uint32_t dropPerMille = 0;      // Lost on the bus
+  uint32_t errorPerMille = 0;     // Flagged ERR by the bridge
+  uint32_t badHeaderPerMille = 0; // Header length byte corrupted
+  uint32_t noPtsPerMille = 0;     // PTS flag cleared
+  uint32_t seed = 1;
+};
+
+// Append frames of the capture's size, frame n holding the byte pattern
+// PS3EyeSyntheticPixel(x, y, n), one frame period apart
+void PS3EyeSynthesizePackets(PS3EyePacketCapture *capture, uint32_t frames,
+                             const PS3EyePacketFaults &faults =
+                                 PS3EyePacketFaults());
+
+inline uint8_t PS3EyeSyntheticPixel(uint32_t x, uint32_t y, uint64_t frame) {
+  return static_cast<uint8_t>(x + 3 * y + 7 * frame);
+}
+
+// Feed every transfer to the assembler as a transfer callback would. speed
+// 1 keeps the recorded pace (wire speed), 2 twice as fast, 0 as fast as
+// the assembler goes. Returns the wall time taken, 100ns.
+int64_t PS3EyeReplayPackets(const PS3EyePacketCapture &capture,
+                            PS3EyeFrameAssembler *assembler, double speed);
@@ -1,189 +1,221 @@
 // PS3EyeSharedMemory.cpp
 // Shared memory implementation for lossless PS3 Eye frame sharing
+// Platform-neutral; mappings and notifications go through PS3EyeIpc.h
 
 #include "PS3EyeSharedMemory.h"
-#include <memoryapi.h>
+#include "PS3EyeChannelDirectory.h"
+#include <cstring>
+
+// How often the server checks for clients that exited without disconnecting
+static const uint64_t CLIENT_REAP_INTERVAL = 10000000; // 1 s in 100ns units
+
+// Registering takes microseconds; an entry claimed for this long belongs to
+// a client that died before it got to write its pid
+static const uint64_t CLIENT_CLAIM_TIMEOUT = 50000000; // 5 s in 100ns units
 
 //------------------------------------------------------------------------------
 // PS3EyeSharedMemoryServer Implementation
 //------------------------------------------------------------------------------
 
 PS3EyeSharedMemoryServer::PS3EyeSharedMemoryServer()
-    : m_fileMapping(nullptr), m_mutex(nullptr), m_newFrameEvent(nullptr),
-      m_clientEvent(nullptr), m_sharedMemory(nullptr), m_frameNumber(0) {}
+    : m_sharedMemory(nullptr), m_clients(nullptr), m_lastReapTime(0),
+      m_frameNumber(0), m_frameSize(0) {
+  memset(m_claimedSince, 0, sizeof(m_claimedSince));
+  memset(m_claimedEventId, 0, sizeof(m_claimedEventId));
+  m_name[0] = '\0';
+}
 
 PS3EyeSharedMemoryServer::~PS3EyeSharedMemoryServer() { Close(); }
 
-bool PS3EyeSharedMemoryServer::Create() {
-  // Create mutex for synchronization
-  m_mutex = CreateMutexW(nullptr, FALSE, PS3EYE_MUTEX_NAME);
-  if (!m_mutex) {
+bool PS3EyeSharedMemoryServer::Create(const char *name, bool largePages,
+                                      uint32_t format) {
+  if (!name || strlen(name) >= PS3EYE_NAME_SIZE) {
     return false;
   }
-
-  // Create event for signaling new frames (auto-reset)
-  m_newFrameEvent = CreateEventW(nullptr, FALSE, FALSE, PS3EYE_EVENT_NAME);
-  if (!m_newFrameEvent) {
-    CloseHandle(m_mutex);
-    m_mutex = nullptr;
+  if (format != PS3EYE_FORMAT_RGB24 && format != PS3EYE_FORMAT_BGR24 &&
+      format != PS3EYE_FORMAT_BAYER_GRBG && format != PS3EYE_FORMAT_GREY8) {
     return false;
   }
 
-  // Create event for client connect/disconnect notifications (auto-reset)
-  m_clientEvent = CreateEventW(nullptr, FALSE, FALSE, PS3EYE_CLIENT_EVENT_NAME);
-  if (!m_clientEvent) {
-    CloseHandle(m_newFrameEvent);
-    CloseHandle(m_mutex);
-    m_newFrameEvent = nullptr;
-    m_mutex = nullptr;
+  // Create the shared region, on large pages if asked and allowed
+  if (!m_region.Create(name, PS3EyeSharedMemorySize(format), largePages)) {
     return false;
   }
-
-  // Create file mapping for shared memory
-  m_fileMapping =
-      CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
-                         PS3EYE_SHARED_MEMORY_SIZE, PS3EYE_SHARED_MEMORY_NAME);
-
-  if (!m_fileMapping) {
-    CloseHandle(m_clientEvent);
-    CloseHandle(m_newFrameEvent);
-    CloseHandle(m_mutex);
-    m_clientEvent = nullptr;
-    m_newFrameEvent = nullptr;
-    m_mutex = nullptr;
-    return false;
+  if (largePages && !m_region.IsLargePages()) {
+    PS3EyeIpcLog("PS3EyeSharedMemoryServer: large pages unavailable");
   }
 
-  // Map view of file
-  m_sharedMemory = MapViewOfFile(m_fileMapping, FILE_MAP_ALL_ACCESS, 0, 0,
-                                 PS3EYE_SHARED_MEMORY_SIZE);
-
-  if (!m_sharedMemory) {
-    CloseHandle(m_fileMapping);
-    CloseHandle(m_clientEvent);
-    CloseHandle(m_newFrameEvent);
-    CloseHandle(m_mutex);
-    m_fileMapping = nullptr;
-    m_clientEvent = nullptr;
-    m_newFrameEvent = nullptr;
-    m_mutex = nullptr;
+  uint8_t *base = m_region.Data();
+  m_clients =
+      reinterpret_cast<PS3EyeClientTable *>(base + PS3EYE_CLIENT_TABLE_OFFSET);
+  memset(static_cast<void *>(m_clients), 0, sizeof(PS3EyeClientTable));
+
+  // Create notification objects. Only the default channel keeps the objects
+  // of protocol v1 alive.
+  bool legacy = strcmp(name, PS3EYE_SHARED_MEMORY_NAME) == 0;
+  if (!m_signals.Create(name, m_clients, legacy)) {
+    m_clients = nullptr;
+    m_region.Close();
     return false;
   }
 
   // Initialize header
-  PS3EyeFrameHeader *header = static_cast<PS3EyeFrameHeader *>(m_sharedMemory);
-  ZeroMemory(header, sizeof(PS3EyeFrameHeader));
+  PS3EyeFrameHeader *header = reinterpret_cast<PS3EyeFrameHeader *>(base);
+  memset(static_cast<void *>(header), 0, sizeof(PS3EyeFrameHeader));
   header->magic = PS3EYE_MAGIC;
   header->version = PS3EYE_PROTOCOL_VERSION;
   header->width = PS3EYE_WIDTH;
   header->height = PS3EYE_HEIGHT;
-  header->stride = PS3EYE_WIDTH * PS3EYE_BYTES_PER_PIXEL;
-  header->format = 0; // RGB24
+  header->stride = PS3EYE_WIDTH * PS3EyeFormatBytesPerPixel(format);
+  header->format = format;
   header->frameNumber = 0;
   header->timestamp = 0;
-  header->dataOffset = sizeof(PS3EyeFrameHeader);
-  header->dataSize = PS3EYE_FRAME_SIZE;
-  header->serverPID = GetCurrentProcessId();
-  header->clientCount = 0;
-
+  header->dataOffset = PS3EYE_RING_DATA_OFFSET;
+  header->dataSize = PS3EyeFrameSize(format);
+  header->serverPID = PS3EyeCurrentProcessId();
+  header->clientCount.store(0);
+  header->cameraState.store(PS3EYE_CAMERA_OK);
+
+  // Initialize frame ring
+  m_ring.Attach(
+      reinterpret_cast<PS3EyeRingControl *>(base + PS3EYE_RING_OFFSET), base);
+  m_ring.Initialize(PS3EYE_RING_DATA_OFFSET, PS3EyeRingSlotSize(format));
+
+  m_sharedMemory = header;
+  m_lastReapTime = PS3EyeTransportTime();
+  memset(m_claimedSince, 0, sizeof(m_claimedSince));
   m_frameNumber = 0;
+  m_frameSize = PS3EyeFrameSize(format);
+  strcpy(m_name, name);
   return true;
 }
 
 void PS3EyeSharedMemoryServer::Close() {
   if (m_sharedMemory) {
     // Mark as closed
-    PS3EyeFrameHeader *header =
-        static_cast<PS3EyeFrameHeader *>(m_sharedMemory);
-    header->serverPID = 0;
+    m_sharedMemory->serverPID = 0;
 
-    UnmapViewOfFile(m_sharedMemory);
+    m_ring.Detach();
+    m_clients = nullptr;
     m_sharedMemory = nullptr;
   }
 
-  if (m_fileMapping) {
-    CloseHandle(m_fileMapping);
-    m_fileMapping = nullptr;
-  }
-
-  if (m_newFrameEvent) {
-    CloseHandle(m_newFrameEvent);
-    m_newFrameEvent = nullptr;
-  }
-
-  if (m_clientEvent) {
-    CloseHandle(m_clientEvent);
-    m_clientEvent = nullptr;
-  }
-
-  if (m_mutex) {
-    CloseHandle(m_mutex);
-    m_mutex = nullptr;
-  }
+  m_signals.Close();
+  m_region.Close();
 }
 
-LONG PS3EyeSharedMemoryServer::GetClientCount() const {
+int32_t PS3EyeSharedMemoryServer::GetClientCount() const {
   if (!m_sharedMemory)
     return 0;
-  const PS3EyeFrameHeader *header =
-      static_cast<const PS3EyeFrameHeader *>(m_sharedMemory);
-  return header->clientCount;
+  return m_sharedMemory->clientCount.load();
 }
 
-bool PS3EyeSharedMemoryServer::WaitForClients(DWORD timeoutMs) {
-  if (!m_clientEvent)
+void PS3EyeSharedMemoryServer::SetCameraState(uint32_t state) {
+  if (m_sharedMemory)
+    m_sharedMemory->cameraState.store(state);
+}
+
+bool PS3EyeSharedMemoryServer::WaitForClients(uint32_t timeoutMs) {
+  if (!m_sharedMemory)
     return false;
 
   // Check if already have clients
+  uint32_t epoch = m_clients->clientEpoch.load(std::memory_order_acquire);
   if (GetClientCount() > 0)
     return true;
 
-  // Wait for client event
-  DWORD result = WaitForSingleObject(m_clientEvent, timeoutMs);
-  return (result == WAIT_OBJECT_0 || GetClientCount() > 0);
+  // Wait for a client to connect
+  m_signals.WaitForClientChange(epoch, timeoutMs);
+  return GetClientCount() > 0;
 }
 
-bool PS3EyeSharedMemoryServer::WriteFrame(const uint8_t *frameData,
-                                          UINT32 frameSize, UINT64 timestamp) {
+bool PS3EyeSharedMemoryServer::WriteFrame(
+    const uint8_t *frameData, uint32_t frameSize, uint64_t timestamp,
+    const PS3EyeFrameMetadata *metadata) {
   if (!m_sharedMemory || !frameData) {
     return false;
   }
 
-  if (frameSize > PS3EYE_FRAME_SIZE) {
+  if (frameSize > m_frameSize) {
     return false;
   }
 
-  // Acquire mutex
-  DWORD waitResult = WaitForSingleObject(m_mutex, 100);
-  if (waitResult != WAIT_OBJECT_0) {
+  PS3EyeFrameMetadata frameMetadata = {};
+  if (metadata)
+    frameMetadata = *metadata;
+  else
+    frameMetadata.arrivalTime = timestamp;
+  frameMetadata.publishTime = PS3EyeTransportTime();
+
+  // Copy frame into the next ring slot (lossless, no lock held)
+  uint64_t frameNumber =
+      m_ring.Publish(frameData, frameSize, timestamp, &frameMetadata);
+  if (frameNumber == 0) {
     return false;
   }
 
-  // Write frame data
-  PS3EyeFrameHeader *header = static_cast<PS3EyeFrameHeader *>(m_sharedMemory);
-  uint8_t *frameBuffer =
-      static_cast<uint8_t *>(m_sharedMemory) + header->dataOffset;
-
-  // Copy frame (this is the lossless part - just a memory copy)
-  memcpy(frameBuffer, frameData, frameSize);
-
-  // Update header
-  m_frameNumber++;
-  header->frameNumber = m_frameNumber;
-  header->timestamp = timestamp;
+  // Mirror the newest slot into the v1 header fields
+  PS3EyeFrameHeader *header = m_sharedMemory;
+  m_frameNumber = frameNumber;
+  header->dataOffset = m_ring.LatestDataOffset();
   header->dataSize = frameSize;
+  header->timestamp = timestamp;
+  header->frameNumber = frameNumber;
 
-  // Signal new frame available
-  SetEvent(m_newFrameEvent);
-
-  // Reset event after brief delay (so clients can catch it)
-  // Actually, use manual reset event and reset after clients read
+  // Bump the generation before waking anyone, so a client that checks it
+  // right before waiting can never miss this frame
+  m_clients->generation.fetch_add(1, std::memory_order_release);
+  m_signals.WakeClients();
 
-  ReleaseMutex(m_mutex);
+  if (frameMetadata.publishTime - m_lastReapTime >= CLIENT_REAP_INTERVAL) {
+    ReapDeadClients();
+    m_lastReapTime = frameMetadata.publishTime;
+  }
   return true;
 }
 
-UINT64 PS3EyeSharedMemoryServer::GetFrameNumber() const {
+void PS3EyeSharedMemoryServer::ReapDeadClients() {
+  const uint64_t now = PS3EyeTransportTime();
+  bool reaped = false;
+  for (uint32_t i = 0; i < PS3EYE_MAX_CLIENTS; i++) {
+    PS3EyeClientSlot &slot = m_clients->clients[i];
+    uint32_t pid = slot.pid.load(std::memory_order_acquire);
+    if (pid == PS3EYE_CLIENT_CLAIMING) {
+      // Nothing to return: a client pins frames and counts itself only
+      // once registered
+      const uint32_t eventId = slot.eventId;
+      if (m_claimedSince[i] == 0 || m_claimedEventId[i] != eventId) {
+        m_claimedSince[i] = now;
+        m_claimedEventId[i] = eventId;
+      } else if (now - m_claimedSince[i] >= CLIENT_CLAIM_TIMEOUT &&
+                 slot.pid.compare_exchange_strong(pid, 0)) {
+        m_claimedSince[i] = 0;
+      }
+      continue;
+    }
+    m_claimedSince[i] = 0;
+    if (pid == 0)
+      continue;
+    if (!PS3EyeProcessExited(pid))
+      continue;
+
+    // Return its pins to the ring, then free the entry
+    for (uint32_t s = 0; s < PS3EYE_RING_SLOT_COUNT; s++) {
+      for (; slot.heldFrames[s] > 0; slot.heldFrames[s]--) {
+        PS3EyeRingView view = {};
+        view.slot = s;
+        m_ring.Release(view);
+      }
+    }
+    m_sharedMemory->clientCount.fetch_sub(1);
+    slot.pid.store(0, std::memory_order_release);
+    reaped = true;
+  }
+  if (reaped)
+    m_clients->clientEpoch.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t PS3EyeSharedMemoryServer::GetFrameNumber() const {
   return m_frameNumber;
 }
 
@@ -192,177 +224,246 @@ UINT64 PS3EyeSharedMemoryServer::GetFrameNumber() const {
 //------------------------------------------------------------------------------
 
 PS3EyeSharedMemoryClient::PS3EyeSharedMemoryClient()
-    : m_fileMapping(nullptr), m_mutex(nullptr), m_newFrameEvent(nullptr),
-      m_clientEvent(nullptr), m_sharedMemory(nullptr), m_lastFrameNumber(0) {}
+    : m_sharedMemory(nullptr), m_clients(nullptr), m_slot(nullptr),
+      m_lastGeneration(0), m_lastFrameNumber(0) {
+  m_name[0] = '\0';
+}
 
 PS3EyeSharedMemoryClient::~PS3EyeSharedMemoryClient() { Disconnect(); }
 
-bool PS3EyeSharedMemoryClient::Connect() {
-  // Open existing mutex
-  m_mutex = OpenMutexW(SYNCHRONIZE, FALSE, PS3EYE_MUTEX_NAME);
-  if (!m_mutex) {
+bool PS3EyeSharedMemoryClient::Connect(const char *name) {
+  if (!name || strlen(name) >= PS3EYE_NAME_SIZE) {
     return false;
   }
 
-  // Open existing event
-  m_newFrameEvent = OpenEventW(SYNCHRONIZE, FALSE, PS3EYE_EVENT_NAME);
-  if (!m_newFrameEvent) {
-    CloseHandle(m_mutex);
-    m_mutex = nullptr;
+  // Map the existing region (write access for clientCount and our pins).
+  // Regions too small for this protocol version are rejected here.
+  if (!m_region.Open(name, PS3EyeSharedMemorySize(PS3EYE_FORMAT_BAYER_GRBG))) {
     return false;
   }
+  strcpy(m_name, name);
 
-  // Open existing file mapping (need write access for clientCount)
-  m_fileMapping =
-      OpenFileMappingW(FILE_MAP_WRITE, FALSE, PS3EYE_SHARED_MEMORY_NAME);
-  if (!m_fileMapping) {
-    CloseHandle(m_newFrameEvent);
-    CloseHandle(m_mutex);
-    m_newFrameEvent = nullptr;
-    m_mutex = nullptr;
+  // Validate header, and that the ring fits for the channel's format
+  uint8_t *base = m_region.Data();
+  PS3EyeFrameHeader *header = reinterpret_cast<PS3EyeFrameHeader *>(base);
+  if (header->magic != PS3EYE_MAGIC ||
+      header->version != PS3EYE_PROTOCOL_VERSION ||
+      m_region.Size() < PS3EyeSharedMemorySize(header->format)) {
+    m_region.Close();
     return false;
   }
 
-  // Map view of file (write access for clientCount updates)
-  m_sharedMemory = MapViewOfFile(m_fileMapping, FILE_MAP_WRITE, 0, 0,
-                                 PS3EYE_SHARED_MEMORY_SIZE);
+  m_sharedMemory = header;
+  m_ring.Attach(
+      reinterpret_cast<PS3EyeRingControl *>(base + PS3EYE_RING_OFFSET), base);
+  m_clients =
+      reinterpret_cast<PS3EyeClientTable *>(base + PS3EYE_CLIENT_TABLE_OFFSET);
 
-  if (!m_sharedMemory) {
-    CloseHandle(m_fileMapping);
-    CloseHandle(m_newFrameEvent);
-    CloseHandle(m_mutex);
-    m_fileMapping = nullptr;
-    m_newFrameEvent = nullptr;
-    m_mutex = nullptr;
+  // Register for frame notifications
+  if (!Register()) {
+    PS3EyeIpcLog("PS3EyeSharedMemoryClient: client table is full");
+    Disconnect();
     return false;
   }
 
-  // Validate header
-  const PS3EyeFrameHeader *header =
-      static_cast<const PS3EyeFrameHeader *>(m_sharedMemory);
-  if (header->magic != PS3EYE_MAGIC ||
-      header->version != PS3EYE_PROTOCOL_VERSION) {
-    Disconnect();
+  // Tell the server (for on-demand mode); Register has counted us
+  m_signals.NotifyClientChange();
+
+  m_lastFrameNumber = 0;
+  return true;
+}
+
+bool PS3EyeSharedMemoryClient::ConnectDevice(const char *deviceId) {
+  PS3EyeChannelDirectory directory;
+  if (!directory.Open()) {
     return false;
   }
 
-  // Open client event to signal server
-  m_clientEvent =
-      OpenEventW(EVENT_MODIFY_STATE, FALSE, PS3EYE_CLIENT_EVENT_NAME);
-  if (m_clientEvent) {
-    // Signal that a client has connected
-    SetEvent(m_clientEvent);
+  PS3EyeChannelInfo info;
+  if (!directory.FindDevice(deviceId, &info)) {
+    return false;
   }
+  return Connect(info.name);
+}
 
-  // Increment client count (for on-demand mode)
-  InterlockedIncrement(&const_cast<PS3EyeFrameHeader *>(header)->clientCount);
+bool PS3EyeSharedMemoryClient::Register() {
+  for (uint32_t i = 0; i < PS3EYE_MAX_CLIENTS; i++) {
+    PS3EyeClientSlot &slot = m_clients->clients[i];
+    uint32_t expected = 0;
+    if (!slot.pid.compare_exchange_strong(expected, PS3EYE_CLIENT_CLAIMING))
+      continue;
 
-  m_lastFrameNumber = 0;
-  return true;
+    slot.eventId = m_clients->nextEventId.fetch_add(1);
+    memset(slot.heldFrames, 0, sizeof(slot.heldFrames));
+
+    if (!m_signals.Create(m_name, m_clients, slot.eventId)) {
+      slot.pid.store(0, std::memory_order_release);
+      return false;
+    }
+
+    // Frames published before this point are not waited for
+    m_lastGeneration = m_clients->generation.load(std::memory_order_acquire);
+    m_slot = &slot;
+    // Counted before the pid shows: once it does, the server may reap the
+    // entry and take the count back
+    m_sharedMemory->clientCount.fetch_add(1);
+    slot.pid.store(PS3EyeCurrentProcessId(), std::memory_order_release);
+    return true;
+  }
+  return false;
 }
 
 void PS3EyeSharedMemoryClient::Disconnect() {
   // Decrement client count first (while we still have access)
   if (m_sharedMemory) {
-    PS3EyeFrameHeader *header =
-        static_cast<PS3EyeFrameHeader *>(m_sharedMemory);
-    InterlockedDecrement(&header->clientCount);
-
-    // Signal server that client count changed
-    if (m_clientEvent) {
-      SetEvent(m_clientEvent);
+    if (m_slot) {
+      // Drop any frames the caller forgot to release
+      for (uint32_t i = 0; i < PS3EYE_RING_SLOT_COUNT; i++) {
+        for (; m_slot->heldFrames[i] > 0; m_slot->heldFrames[i]--) {
+          PS3EyeRingView view = {};
+          view.slot = i;
+          m_ring.Release(view);
+        }
+      }
+
+      // Unregister, the server stops waking us
+      m_slot->pid.store(0, std::memory_order_release);
+      m_slot = nullptr;
+
+      m_sharedMemory->clientCount.fetch_sub(1);
+
+      // Signal server that client count changed
+      m_signals.NotifyClientChange();
     }
 
-    UnmapViewOfFile(m_sharedMemory);
+    m_ring.Detach();
+    m_clients = nullptr;
     m_sharedMemory = nullptr;
   }
 
-  if (m_fileMapping) {
-    CloseHandle(m_fileMapping);
-    m_fileMapping = nullptr;
-  }
+  m_signals.Close();
+  m_region.Close();
+}
 
-  if (m_newFrameEvent) {
-    CloseHandle(m_newFrameEvent);
-    m_newFrameEvent = nullptr;
+bool PS3EyeSharedMemoryClient::WaitForFrame(uint32_t timeoutMs) {
+  if (!m_signals.IsOpen() || !m_clients) {
+    return false;
   }
 
-  if (m_clientEvent) {
-    CloseHandle(m_clientEvent);
-    m_clientEvent = nullptr;
-  }
+  // The generation counter decides whether there is a new frame; the signal
+  // only wakes us up. A stale wake-up for a frame we already saw just loops.
+  const uint64_t start = PS3EyeTransportTime();
+  for (;;) {
+    uint32_t generation =
+        m_clients->generation.load(std::memory_order_acquire);
+    if (generation != m_lastGeneration) {
+      m_lastGeneration = generation;
+      return true;
+    }
+
+    uint32_t remaining = PS3EYE_INFINITE;
+    if (timeoutMs != PS3EYE_INFINITE) {
+      uint64_t elapsed = (PS3EyeTransportTime() - start) / 10000;
+      if (elapsed >= timeoutMs)
+        return false;
+      remaining = timeoutMs - static_cast<uint32_t>(elapsed);
+    }
 
-  if (m_mutex) {
-    CloseHandle(m_mutex);
-    m_mutex = nullptr;
+    m_signals.WaitForFrame(m_lastGeneration, remaining);
   }
 }
 
-bool PS3EyeSharedMemoryClient::WaitForFrame(DWORD timeoutMs) {
-  if (!m_newFrameEvent) {
+bool PS3EyeSharedMemoryClient::ReadFrame(uint8_t *destBuffer,
+                                         uint32_t destSize,
+                                         uint64_t *frameNumber,
+                                         uint64_t *timestamp,
+                                         PS3EyeFrameMetadata *metadata) {
+  if (!m_sharedMemory || !destBuffer) {
     return false;
   }
 
-  // Wait for new frame signal
-  DWORD result = WaitForSingleObject(m_newFrameEvent, timeoutMs);
-  return (result == WAIT_OBJECT_0);
-}
-
-bool PS3EyeSharedMemoryClient::ReadFrame(uint8_t *destBuffer, UINT32 destSize,
-                                         UINT64 *frameNumber,
-                                         UINT64 *timestamp) {
-  if (!m_sharedMemory || !destBuffer) {
+  // Check if server is still running
+  if (m_sharedMemory->serverPID == 0) {
     return false;
   }
 
-  // Acquire mutex for reading
-  DWORD waitResult = WaitForSingleObject(m_mutex, 100);
-  if (waitResult != WAIT_OBJECT_0) {
+  // Copy newest frame out of the ring (lossless, retries if torn)
+  uint64_t readFrameNumber = 0, readTimestamp = 0;
+  if (m_ring.ReadLatest(destBuffer, destSize, m_lastFrameNumber,
+                        &readFrameNumber, &readTimestamp, metadata) !=
+      PS3EyeRingReadResult::Ok) {
+    return false; // No new frame, or writer kept lapping us
+  }
+
+  // Update tracking
+  m_lastFrameNumber = readFrameNumber;
+
+  if (frameNumber)
+    *frameNumber = readFrameNumber;
+  if (timestamp)
+    *timestamp = readTimestamp;
+
+  return true;
+}
+
+bool PS3EyeSharedMemoryClient::AcquireFrame(PS3EyeFrameView *view) {
+  if (!m_sharedMemory || !view) {
     return false;
   }
 
-  const PS3EyeFrameHeader *header =
-      static_cast<const PS3EyeFrameHeader *>(m_sharedMemory);
+  const PS3EyeFrameHeader *header = m_sharedMemory;
 
   // Check if server is still running
   if (header->serverPID == 0) {
-    ReleaseMutex(m_mutex);
     return false;
   }
 
-  // Check if new frame
-  if (header->frameNumber == m_lastFrameNumber) {
-    ReleaseMutex(m_mutex);
-    return false; // No new frame
+  // Pin the newest slot; the server skips it until we release it
+  PS3EyeRingView ringView;
+  if (m_ring.Acquire(m_lastFrameNumber, &ringView) !=
+      PS3EyeRingReadResult::Ok) {
+    return false;
   }
 
-  // Copy frame data (lossless - just memory copy)
-  UINT32 copySize = min(destSize, header->dataSize);
-  const uint8_t *srcBuffer =
-      static_cast<const uint8_t *>(m_sharedMemory) + header->dataOffset;
-  memcpy(destBuffer, srcBuffer, copySize);
-
-  // Update tracking
-  m_lastFrameNumber = header->frameNumber;
+  m_slot->heldFrames[ringView.slot]++;
+  m_lastFrameNumber = ringView.frameNumber;
+
+  view->data = ringView.data;
+  view->dataSize = ringView.dataSize;
+  view->width = header->width;
+  view->height = header->height;
+  view->stride = header->stride;
+  view->format = header->format;
+  view->frameNumber = ringView.frameNumber;
+  view->timestamp = ringView.timestamp;
+  view->metadata = ringView.metadata;
+  view->slot = ringView.slot;
+  return true;
+}
 
-  if (frameNumber)
-    *frameNumber = header->frameNumber;
-  if (timestamp)
-    *timestamp = header->timestamp;
+void PS3EyeSharedMemoryClient::ReleaseFrame(PS3EyeFrameView *view) {
+  if (!m_sharedMemory || !view || !view->data) {
+    return;
+  }
 
-  ReleaseMutex(m_mutex);
-  return true;
+  if (view->slot < PS3EYE_RING_SLOT_COUNT &&
+      m_slot->heldFrames[view->slot] > 0) {
+    PS3EyeRingView ringView = {};
+    ringView.slot = view->slot;
+    m_ring.Release(ringView);
+    m_slot->heldFrames[view->slot]--;
+  }
+  view->data = nullptr;
 }
 
-bool PS3EyeSharedMemoryClient::GetFrameInfo(UINT32 *width, UINT32 *height,
-                                            UINT32 *format,
-                                            UINT64 *frameNumber) {
+bool PS3EyeSharedMemoryClient::GetFrameInfo(uint32_t *width, uint32_t *height,
+                                            uint32_t *format,
+                                            uint64_t *frameNumber) {
   if (!m_sharedMemory) {
     return false;
   }
 
-  const PS3EyeFrameHeader *header =
-      static_cast<const PS3EyeFrameHeader *>(m_sharedMemory);
+  const PS3EyeFrameHeader *header = m_sharedMemory;
 
   if (width)
     *width = header->width;
@@ -371,7 +472,16 @@ bool PS3EyeSharedMemoryClient::GetFrameInfo(UINT32 *width, UINT32 *height,
   if (format)
     *format = header->format;
   if (frameNumber)
-    *frameNumber = header->frameNumber;
+    *frameNumber = m_ring.LatestFrameNumber();
 
   return true;
 }
+
+uint32_t PS3EyeSharedMemoryClient::GetFormat() const {
+  return m_sharedMemory ? m_sharedMemory->format : PS3EYE_FORMAT_RGB24;
+}
+
+uint32_t PS3EyeSharedMemoryClient::GetCameraState() const {
+  return m_sharedMemory ? m_sharedMemory->cameraState.load()
+                        : PS3EYE_CAMERA_OK;
+}
@@ -1,54 +1,138 @@
 // PS3EyeSharedMemory.h
 // Shared memory interface for PS3 Eye camera frame sharing
-// Enables lossless multi-app access on Windows 10+
+// Enables lossless multi-app access on Windows 10+ (and on POSIX systems
+// through the platform layer in PS3EyeIpc.h)
 
 #pragma once
 
-#define WIN32_LEAN_AND_MEAN
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
-#include <string>
-#include <windows.h>
+
+#include "PS3EyeFrameRing.h"
+#include "PS3EyeIpc.h"
 
 // Frame format constants
-constexpr UINT32 PS3EYE_WIDTH = 640;
-constexpr UINT32 PS3EYE_HEIGHT = 480;
-constexpr UINT32 PS3EYE_FPS = 30;
-constexpr UINT32 PS3EYE_BYTES_PER_PIXEL = 3; // RGB24
-constexpr UINT32 PS3EYE_FRAME_SIZE =
+constexpr uint32_t PS3EYE_WIDTH = 640;
+constexpr uint32_t PS3EYE_HEIGHT = 480;
+constexpr uint32_t PS3EYE_FPS = 30;
+constexpr uint32_t PS3EYE_BYTES_PER_PIXEL = 3; // RGB24
+constexpr uint32_t PS3EYE_FRAME_SIZE =
     PS3EYE_WIDTH * PS3EYE_HEIGHT * PS3EYE_BYTES_PER_PIXEL;
 
-// Shared memory names
-constexpr wchar_t PS3EYE_SHARED_MEMORY_NAME[] = L"PS3EyeSharedFrame";
-constexpr wchar_t PS3EYE_MUTEX_NAME[] = L"PS3EyeFrameMutex";
-constexpr wchar_t PS3EYE_EVENT_NAME[] = L"PS3EyeNewFrameEvent";
-constexpr wchar_t PS3EYE_CLIENT_EVENT_NAME[] =
-    L"PS3EyeClientEvent"; // Signals server when clients connect/disconnect
-constexpr wchar_t PS3EYE_CLIENT_SEMAPHORE_NAME[] =
-    L"PS3EyeClientCount"; // Semaphore count = active clients
+// Frame size in a given PS3EYE_FORMAT_* (PS3EYE_FRAME_SIZE is the largest)
+constexpr uint32_t PS3EyeFrameSize(uint32_t format) {
+  return PS3EYE_WIDTH * PS3EYE_HEIGHT * PS3EyeFormatBytesPerPixel(format);
+}
+
+// Shared memory name of the default channel (Win32 section name;
+// "/PS3EyeSharedFrame" under POSIX). Further cameras get their own channel,
+// named after the device (see PS3EyeChannelDirectory.h).
+constexpr char PS3EYE_SHARED_MEMORY_NAME[] = "PS3EyeSharedFrame";
 
 // Header at the start of shared memory
-#pragma pack(push, 1)
+// The layout is identical to protocol v1 so that v1 tools which only poll
+// frameNumber / clientCount keep working. frameNumber, timestamp and
+// dataOffset mirror the newest ring slot for them. Every field is naturally
+// aligned, so no packing is needed to match the v1 byte layout.
 struct PS3EyeFrameHeader {
-  UINT32 magic;              // 'PS3E' = 0x45335350
-  UINT32 version;            // Protocol version (1)
-  UINT32 width;              // Frame width
-  UINT32 height;             // Frame height
-  UINT32 stride;             // Bytes per row
-  UINT32 format;             // 0 = RGB24, 1 = BGR24
-  UINT64 frameNumber;        // Incrementing frame counter
-  UINT64 timestamp;          // Timestamp in 100ns units
-  UINT32 dataOffset;         // Offset to frame data from header start
-  UINT32 dataSize;           // Size of frame data
-  UINT32 serverPID;          // PID of server process
-  volatile LONG clientCount; // Number of active clients
-  UINT32 reserved[4];        // Future use
+  uint32_t magic;                    // 'PS3E' = 0x45335350
+  uint32_t version;                  // Protocol version (10)
+  uint32_t width;                    // Frame width
+  uint32_t height;                   // Frame height
+  uint32_t stride;                   // Bytes per row
+  uint32_t format;                   // PS3EYE_FORMAT_*
+  uint64_t frameNumber;              // Incrementing frame counter
+  uint64_t timestamp;                // Capture time, 100ns units
+                                     // (PS3EyeTransportTime)
+  uint32_t dataOffset;               // Offset to newest frame data
+  uint32_t dataSize;                 // Size of frame data
+  uint32_t serverPID;                // PID of server process
+  std::atomic<int32_t> clientCount;  // Number of active clients
+  std::atomic<uint32_t> cameraState; // PS3EYE_CAMERA_* (v10+)
+  uint32_t reserved[3];              // Future use
 };
-#pragma pack(pop)
 
-constexpr UINT32 PS3EYE_MAGIC = 0x45335350; // 'PS3E'
-constexpr UINT32 PS3EYE_PROTOCOL_VERSION = 1;
-constexpr UINT32 PS3EYE_SHARED_MEMORY_SIZE =
-    sizeof(PS3EyeFrameHeader) + PS3EYE_FRAME_SIZE;
+// PS3EyeFrameHeader::cameraState. While the camera is lost the newest frame
+// stays readable, but no newer one comes until the service has it back.
+constexpr uint32_t PS3EYE_CAMERA_OK = 0;   // Streaming, or idle
+constexpr uint32_t PS3EYE_CAMERA_LOST = 1; // Stalled or unplugged; the
+                                           // service is reconnecting
+
+// v1 tools update clientCount with InterlockedIncrement, which works on the
+// same address only because the atomic is a plain lock-free 32-bit word
+static_assert(std::atomic<int32_t>::is_always_lock_free &&
+                  sizeof(std::atomic<int32_t>) == 4,
+              "clientCount must be a plain 32-bit word");
+static_assert(sizeof(std::atomic<uint32_t>) == 4,
+              "cameraState must be a plain 32-bit word");
+static_assert(sizeof(PS3EyeFrameHeader) == 72 &&
+                  offsetof(PS3EyeFrameHeader, frameNumber) == 24 &&
+                  offsetof(PS3EyeFrameHeader, clientCount) == 52,
+              "Header layout must stay compatible with protocol v1");
+
+// Per-client wake-up registration. Each client registers a wake-up object
+// under eventId (see PS3EyeClientSignals); the server wakes every registered
+// client after each frame, not just one.
+constexpr uint32_t PS3EYE_CLIENT_CLAIMING = 0xFFFFFFFF; // pid while registering
+
+struct alignas(PS3EYE_CACHE_LINE_SIZE) PS3EyeClientSlot {
+  std::atomic<uint32_t> pid; // 0 = free
+  uint32_t eventId;          // Valid once pid is a real process id
+  uint32_t heldFrames[PS3EYE_RING_SLOT_COUNT]; // Pins, reclaimed if the
+                                               // client dies holding them
+};
+
+struct alignas(PS3EYE_CACHE_LINE_SIZE) PS3EyeClientTable {
+  std::atomic<uint32_t> generation;  // Bumped after every published frame
+  std::atomic<uint32_t> nextEventId; // Keeps event names unique over time
+  std::atomic<uint32_t> clientEpoch; // Bumped when clients come and go
+  PS3EyeClientSlot clients[PS3EYE_MAX_CLIENTS];
+};
+
+// v2+ layout: header, ring control block, client table (each starting on a
+// cache line), then the ring slots, each starting on a page. Views are mapped
+// at allocation-granularity addresses, so these offsets are aligned in
+// absolute terms too. Slots are sized for the channel's frame format, so the
+// region size depends on it (v9+). The header carries the camera state
+// (v10+).
+constexpr uint32_t PS3EYE_MAGIC = 0x45335350; // 'PS3E'
+constexpr uint32_t PS3EYE_PROTOCOL_VERSION = 10;
+constexpr uint32_t PS3EYE_RING_OFFSET = static_cast<uint32_t>(
+    PS3EyeAlignUp(sizeof(PS3EyeFrameHeader), PS3EYE_CACHE_LINE_SIZE));
+constexpr uint32_t PS3EYE_CLIENT_TABLE_OFFSET = static_cast<uint32_t>(
+    PS3EyeAlignUp(PS3EYE_RING_OFFSET + sizeof(PS3EyeRingControl),
+                  PS3EYE_CACHE_LINE_SIZE));
+constexpr uint32_t PS3EYE_RING_DATA_OFFSET = static_cast<uint32_t>(
+    PS3EyeAlignUp(PS3EYE_CLIENT_TABLE_OFFSET + sizeof(PS3EyeClientTable),
+                  PS3EYE_PAGE_SIZE));
+constexpr uint32_t PS3EyeRingSlotSize(uint32_t format) {
+  return static_cast<uint32_t>(
+      PS3EyeAlignUp(PS3EyeFrameSize(format), PS3EYE_PAGE_SIZE));
+}
+constexpr uint32_t PS3EyeSharedMemorySize(uint32_t format) {
+  return PS3EYE_RING_DATA_OFFSET +
+         PS3EyeRingSlotSize(format) * PS3EYE_RING_SLOT_COUNT;
+}
+// Sizes of an RGB24 channel, the default and largest
+constexpr uint32_t PS3EYE_RING_SLOT_SIZE =
+    PS3EyeRingSlotSize(PS3EYE_FORMAT_RGB24);
+constexpr uint32_t PS3EYE_SHARED_MEMORY_SIZE =
+    PS3EyeSharedMemorySize(PS3EYE_FORMAT_RGB24);
+
+// Read-only view of a frame held in place in shared memory (see AcquireFrame)
+struct PS3EyeFrameView {
+  const uint8_t *data;  // Top row of the frame
+  uint32_t dataSize;    // Size of frame data
+  uint32_t width;       // Frame width
+  uint32_t height;      // Frame height
+  uint32_t stride;      // Bytes per row
+  uint32_t format;      // PS3EYE_FORMAT_*
+  uint64_t frameNumber; // Incrementing frame counter
+  uint64_t timestamp;   // Capture time in 100ns units
+  uint32_t slot;        // Ring slot pinned by this view
+  PS3EyeFrameMetadata metadata; // Capture metadata (v5+)
+};
 
 //------------------------------------------------------------------------------
 // PS3EyeSharedMemoryServer
@@ -59,34 +143,66 @@ public:
   PS3EyeSharedMemoryServer();
   ~PS3EyeSharedMemoryServer();
 
-  // Initialize shared memory (returns false if already exists)
-  bool Create();
+  // Initialize the shared memory channel called name (returns false if it
+  // already exists). With largePages the mapping is backed by large pages
+  // when the OS and account allow it (SeLockMemoryPrivilege on Windows,
+  // transparent huge pages on Linux), falling back to normal pages otherwise.
+  // Every frame written must be in format (PS3EYE_FORMAT_*); raw Bayer
+  // channels take a third of the memory and bandwidth of RGB24 ones.
+  bool Create(const char *name = PS3EYE_SHARED_MEMORY_NAME,
+              bool largePages = false, uint32_t format = PS3EYE_FORMAT_RGB24);
+
+  // Whether Create() got large-page backing
+  bool IsLargePages() const { return m_region.IsLargePages(); }
 
   // Close shared memory
   void Close();
 
-  // Write a new frame (thread-safe via mutex)
-  bool WriteFrame(const uint8_t *frameData, UINT32 frameSize, UINT64 timestamp);
+  // Publish a new frame into the ring (never blocks on readers). timestamp
+  // is when the sensor captured the frame (PS3EyeTransportTime), which clients
+  // stamp their samples with. metadata is optional; its publishTime is
+  // stamped here.
+  bool WriteFrame(const uint8_t *frameData, uint32_t frameSize,
+                  uint64_t timestamp,
+                  const PS3EyeFrameMetadata *metadata = nullptr);
 
   // Check if created
   bool IsCreated() const { return m_sharedMemory != nullptr; }
 
   // Get current frame number
-  UINT64 GetFrameNumber() const;
+  uint64_t GetFrameNumber() const;
 
   // Get active client count
-  LONG GetClientCount() const;
+  int32_t GetClientCount() const;
+
+  // Frames dropped because readers were holding every free slot
+  uint64_t GetDroppedFrames() const { return m_ring.DroppedFrames(); }
+
+  // Publish whether the camera is delivering (PS3EYE_CAMERA_*)
+  void SetCameraState(uint32_t state);
 
   // Wait for clients to connect (blocks until at least one client)
-  bool WaitForClients(DWORD timeoutMs = INFINITE);
+  bool WaitForClients(uint32_t timeoutMs = PS3EYE_INFINITE);
 
 private:
-  HANDLE m_fileMapping;
-  HANDLE m_mutex;
-  HANDLE m_newFrameEvent;
-  HANDLE m_clientEvent; // Signaled when clients connect/disconnect
-  void *m_sharedMemory;
-  UINT64 m_frameNumber;
+  // Free table entries (and pins) of clients whose process has exited, and
+  // entries left claimed by a client that died while registering
+  void ReapDeadClients();
+
+  PS3EyeSharedRegion m_region;
+  PS3EyeServerSignals m_signals;
+  PS3EyeFrameHeader *m_sharedMemory;
+  PS3EyeFrameRing m_ring;
+  PS3EyeClientTable *m_clients;
+  uint64_t m_lastReapTime;
+  // When each entry was first seen claimed, and under which eventId; 0 while
+  // it is not. A registering client writes a fresh eventId right after
+  // claiming, so a new claim restarts the clock.
+  uint64_t m_claimedSince[PS3EYE_MAX_CLIENTS];
+  uint32_t m_claimedEventId[PS3EYE_MAX_CLIENTS];
+  uint64_t m_frameNumber;
+  uint32_t m_frameSize;
+  char m_name[PS3EYE_NAME_SIZE];
 };
 
 //------------------------------------------------------------------------------
@@ -98,8 +214,12 @@ public:
   PS3EyeSharedMemoryClient();
   ~PS3EyeSharedMemoryClient();
 
-  // Connect to existing shared memory
-  bool Connect();
+  // Connect to an existing shared memory channel
+  bool Connect(const char *name = PS3EYE_SHARED_MEMORY_NAME);
+
+  // Connect to the channel of a camera, by the device id listed in the
+  // channel directory (USB port path or serial)
+  bool ConnectDevice(const char *deviceId);
 
   // Disconnect
   void Disconnect();
@@ -107,22 +227,47 @@ public:
   // Check if connected
   bool IsConnected() const { return m_sharedMemory != nullptr; }
 
-  // Wait for new frame (returns false on timeout or error)
-  bool WaitForFrame(DWORD timeoutMs = 100);
+  // Wait for a frame newer than the last one waited for (returns false on
+  // timeout or error). Every client is woken for every frame.
+  bool WaitForFrame(uint32_t timeoutMs = 100);
 
-  // Read current frame (copies to provided buffer)
-  bool ReadFrame(uint8_t *destBuffer, UINT32 destSize,
-                 UINT64 *frameNumber = nullptr, UINT64 *timestamp = nullptr);
+  // Read newest frame if it is new (copies to provided buffer, lock-free)
+  bool ReadFrame(uint8_t *destBuffer, uint32_t destSize,
+                 uint64_t *frameNumber = nullptr, uint64_t *timestamp = nullptr,
+                 PS3EyeFrameMetadata *metadata = nullptr);
+
+  // Pin the newest frame if it is new and return a read-only view of it in
+  // shared memory (zero-copy). The server will not recycle the slot until
+  // ReleaseFrame() is called, so hold it only as long as needed.
+  bool AcquireFrame(PS3EyeFrameView *view);
+
+  // Unpin a frame returned by AcquireFrame
+  void ReleaseFrame(PS3EyeFrameView *view);
+
+  // Pixel format of the channel's frames (PS3EYE_FORMAT_*). Raw Bayer frames
+  // can be converted with PS3EyeConvertFrame (PS3EyeFrameConvert.h).
+  uint32_t GetFormat() const;
+
+  // PS3EYE_CAMERA_LOST while the service is reconnecting a stalled or
+  // unplugged camera; the newest frame is then older than it looks
+  uint32_t GetCameraState() const;
 
   // Get frame info without copying
-  bool GetFrameInfo(UINT32 *width, UINT32 *height, UINT32 *format,
-                    UINT64 *frameNumber);
+  bool GetFrameInfo(uint32_t *width, uint32_t *height, uint32_t *format,
+                    uint64_t *frameNumber);
 
 private:
-  HANDLE m_fileMapping;
-  HANDLE m_mutex;
-  HANDLE m_newFrameEvent;
-  HANDLE m_clientEvent; // To signal server when connecting/disconnecting
-  void *m_sharedMemory;
-  UINT64 m_lastFrameNumber;
+  // Claim a client table entry, set up our wake-up object, and count
+  // ourselves in clientCount before the entry shows our pid
+  bool Register();
+
+  PS3EyeSharedRegion m_region;
+  PS3EyeClientSignals m_signals;
+  PS3EyeFrameHeader *m_sharedMemory;
+  PS3EyeFrameRing m_ring;
+  PS3EyeClientTable *m_clients;
+  PS3EyeClientSlot *m_slot; // Our entry in the client table
+  uint32_t m_lastGeneration;
+  uint64_t m_lastFrameNumber;
+  char m_name[PS3EYE_NAME_SIZE];
 };
@@ -0,0 +1,200 @@
+// PS3EyeSyntheticCamera.cpp
+// Generated-frame camera backend
+
+#include "PS3EyeSyntheticCamera.h"
+#include "PS3EyeIpc.h"
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+PS3EyeSyntheticCamera::PS3EyeSyntheticCamera(const char *deviceId)
+    : m_deviceId(deviceId), m_width(0), m_height(0),
+      m_format(PS3EYE_FORMAT_RGB24), m_period(0),
+      m_frameCount(0), m_openMs(0), m_startMs(0), m_droppedFrames(0),
+      m_corruptFrames(0), m_open(false), m_streaming(false),
+      m_interrupted(false), m_unplugged(false) {}
+
+void PS3EyeSyntheticCamera::SetLatency(uint32_t openMs, uint32_t startMs) {
+  m_openMs = openMs;
+  m_startMs = startMs;
+}
+
+void PS3EyeSyntheticCamera::SetProfile(const PS3EyeSyntheticProfile &profile) {
+  m_profile = profile;
+  // A camera that never delivers is Unplug's business
+  if (m_profile.dropPerMille > 999)
+    m_profile.dropPerMille = 999;
+}
+
+void PS3EyeSyntheticCamera::Unplug(uint32_t replugMs) {
+  std::lock_guard<std::mutex> lock(m_plugMutex);
+  m_unplugged = true;
+  m_replugTime =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(replugMs);
+}
+
+bool PS3EyeSyntheticCamera::Open(uint32_t width, uint32_t height,
+                                 uint32_t fps, uint32_t format) {
+  if (width == 0 || height == 0 || fps == 0)
+    return false;
+  {
+    std::lock_guard<std::mutex> lock(m_plugMutex);
+    if (m_unplugged) {
+      if (std::chrono::steady_clock::now() < m_replugTime)
+        return false;
+      m_unplugged = false;
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(m_openMs));
+  m_width = width;
+  m_height = height;
+  m_format = format;
+  m_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::nanoseconds(1000000000 / fps));
+  m_open = true;
+  return true;
+}
+
+void PS3EyeSyntheticCamera::Close() {
+  Stop();
+  m_open = false;
+}
+
+bool PS3EyeSyntheticCamera::Start() {
+  if (!m_open)
+    return false;
+  {
+    std::lock_guard<std::mutex> lock(m_plugMutex);
+    if (m_unplugged)
+      return false;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(m_startMs));
+  std::lock_guard<std::mutex> lock(m_plugMutex);
+  m_nextFrame = std::chrono::steady_clock::now() + m_period;
+  m_frameCount = 0;
+  m_droppedFrames = 0;
+  m_corruptFrames = 0;
+  m_random.seed(m_profile.seed);
+  m_interrupted = false;
+  m_streaming = true;
+  return true;
+}
+
+void PS3EyeSyntheticCamera::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(m_plugMutex);
+    m_streaming = false;
+  }
+  m_wake.notify_all();
+}
+
+void PS3EyeSyntheticCamera::Interrupt() {
+  {
+    std::lock_guard<std::mutex> lock(m_plugMutex);
+    m_interrupted = true;
+  }
+  m_wake.notify_all();
+}
+
+uint64_t PS3EyeSyntheticCamera::GetFrame(uint8_t *buffer, uint32_t timeoutMs,
+                                         uint32_t *flags) {
+  *flags = 0;
+  const std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+  // Fixed cadence like the sensor; a late caller does not shift later
+  // frames. Every draw comes from the seeded generator in frame order, so a
+  // profile replays the same faults on the same frames.
+  std::uniform_int_distribution<uint32_t> perMille(0, 999);
+  std::uniform_int_distribution<uint32_t> jitter(0, m_profile.jitterUs);
+  uint32_t frameCount;
+  {
+    std::unique_lock<std::mutex> lock(m_plugMutex);
+    for (;;) {
+      // Unplugged: no more frames on this handle, like a driver waiting on
+      // transfers that never complete, until the timeout
+      const bool due = !m_unplugged && m_nextFrame <= deadline;
+      m_wake.wait_until(lock, due ? m_nextFrame : deadline,
+                        [this] { return m_interrupted || !m_streaming; });
+      if (m_interrupted || !m_streaming) {
+        m_interrupted = false;
+        return 0;
+      }
+      if (!due)
+        return 0;
+      m_nextFrame += m_period;
+      frameCount = m_frameCount++;
+      if (perMille(m_random) >= m_profile.dropPerMille)
+        break;
+      m_droppedFrames++;
+    }
+  }
+  const uint32_t lateUs = m_profile.jitterUs > 0 ? jitter(m_random) : 0;
+  const bool torn = perMille(m_random) < m_profile.corruptPerMille;
+  // A torn frame stops after a random row; the rows below keep the
+  // previous frame
+  const uint32_t rows =
+      torn ? std::uniform_int_distribution<uint32_t>(2, m_height - 1)(m_random)
+           : m_height;
+  if (torn) {
+    m_corruptFrames++;
+    *flags = PS3EYE_FRAME_FLAG_PARTIAL | PS3EYE_FRAME_FLAG_CORRUPT;
+  }
+  if (lateUs > 0)
+    std::this_thread::sleep_for(std::chrono::microseconds(lateUs));
+  const uint64_t arrival = PS3EyeTransportTime();
+
+  // Horizontal gradient scrolling one pixel per frame, rendered once per row
+  // pair and copied down so generating costs little next to publishing
+  if (m_format == PS3EYE_FORMAT_BAYER_GRBG) {
+    // G R on even rows, B G on odd rows
+    const uint32_t stride = m_width;
+    for (uint32_t x = 0; x < m_width; x++) {
+      uint8_t value = static_cast<uint8_t>(x + frameCount);
+      uint8_t green = static_cast<uint8_t>(frameCount);
+      buffer[x] = (x & 1) ? value : green;
+      buffer[stride + x] =
+          (x & 1) ? green : static_cast<uint8_t>(255 - value);
+    }
+    for (uint32_t y = 2; y < rows; y++)
+      memcpy(buffer + y * stride, buffer + (y & 1) * stride, stride);
+  } else if (m_format == PS3EYE_FORMAT_GREY8) {
+    for (uint32_t x = 0; x < m_width; x++)
+      buffer[x] = static_cast<uint8_t>(x + frameCount);
+    for (uint32_t y = 1; y < rows; y++)
+      memcpy(buffer + y * m_width, buffer, m_width);
+  } else {
+    const uint32_t stride = m_width * 3;
+    for (uint32_t x = 0; x < m_width; x++) {
+      uint8_t value = static_cast<uint8_t>(x + frameCount);
+      buffer[x * 3 + 0] = value;
+      buffer[x * 3 + 1] = static_cast<uint8_t>(frameCount);
+      buffer[x * 3 + 2] = static_cast<uint8_t>(255 - value);
+    }
+    for (uint32_t y = 1; y < rows; y++)
+      memcpy(buffer + y * stride, buffer, stride);
+  }
+  return arrival;
+}
+
+void PS3EyeSyntheticCamera::GetSettings(PS3EyeFrameMetadata *metadata) const {
+  metadata->exposure = 120;
+  metadata->gain = 20;
+  metadata->redBalance = 128;
+  metadata->greenBalance = 128;
+  metadata->blueBalance = 128;
+}
+
+PS3EyeCameraList PS3EyeEnumerateSyntheticCameras(
+    uint32_t count, const PS3EyeSyntheticProfile &profile) {
+  PS3EyeCameraList cameras;
+  for (uint32_t i = 0; i < count; i++) {
+    char deviceId[32];
+    snprintf(deviceId, sizeof(deviceId), "synthetic-%u", i);
+    PS3EyeSyntheticCamera *camera = new PS3EyeSyntheticCamera(deviceId);
+    camera->SetProfile(profile);
+    cameras.emplace_back(camera);
+  }
+  return cameras;
+}
@@ -0,0 +1,104 @@
+// PS3EyeSyntheticCamera.h
+// Camera backend that generates frames at the requested rate instead of
+// reading a device. Lets the capture service, its channels and the transport
+// run and be benchmarked without PS3 Eyes attached. A fault profile adds the
+// imperfections of a real bus (late hand-over, lost and torn frames) from a
+// seeded generator, so a run can be repeated exactly.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+
+#include "PS3EyeCamera.h"
+
+// What goes wrong, and how often. The sensor cadence itself stays exact:
+// faults only change when and whether its frames reach the caller.
+struct PS3EyeSyntheticProfile {
+  // Each frame is handed over up to jitterUs late, uniformly, like a driver
+  // thread woken late; later frames keep the sensor's cadence
+  uint32_t jitterUs = 0;
+  // Frames in a thousand lost on the bus: the period passes with no frame
+  uint32_t dropPerMille = 0;
+  // Frames in a thousand torn: delivered with only the rows above a random
+  // cut written, the rest left over from the previous frame
+  uint32_t corruptPerMille = 0;
+  // The generator restarts from the seed at every Start
+  uint32_t seed = 1;
+};
+
+class PS3EyeSyntheticCamera : public PS3EyeCamera {
+public:
+  explicit PS3EyeSyntheticCamera(const char *deviceId);
+
+  // Simulated device costs: Open blocks for openMs, Start for startMs
+  void SetLatency(uint32_t openMs, uint32_t startMs);
+
+  // Simulate the device dropping off the bus, as a yanked cable or a hub
+  // reset does: a stream in progress stalls (GetFrame returns no frames),
+  // and Open fails until the device comes back after replugMs
+  void Unplug(uint32_t replugMs);
+
+  // Faults applied from the next Start
+  void SetProfile(const PS3EyeSyntheticProfile &profile);
+
+  // Frames of the current stream the sensor produced, and of those the ones
+  // dropped and torn by the profile
+  uint32_t GetSensorFrames() const { return m_frameCount.load(); }
+  uint32_t GetDroppedFrames() const { return m_droppedFrames.load(); }
+  uint32_t GetCorruptFrames() const { return m_corruptFrames.load(); }
+
+  const char *GetDeviceId() const override { return m_deviceId.c_str(); }
+
+  bool Open(uint32_t width, uint32_t height, uint32_t fps,
+            uint32_t format) override;
+  void Close() override;
+  bool IsOpen() const override { return m_open; }
+
+  bool Start() override;
+  void Stop() override;
+  bool IsStreaming() const override { return m_streaming.load(); }
+
+  // Paced to the frame rate like the sensor; the frame is a moving gradient,
+  // sampled through a GRBG mosaic for raw Bayer. Torn frames are flagged
+  // partial and corrupt.
+  uint64_t GetFrame(uint8_t *buffer, uint32_t timeoutMs,
+                    uint32_t *flags) override;
+  void Interrupt() override;
+
+  void GetSettings(PS3EyeFrameMetadata *metadata) const override;
+
+private:
+  std::string m_deviceId;
+  uint32_t m_width;
+  uint32_t m_height;
+  uint32_t m_format;
+  std::chrono::steady_clock::duration m_period;
+  std::chrono::steady_clock::time_point m_nextFrame;
+  std::atomic<uint32_t> m_frameCount;
+  uint32_t m_openMs;
+  uint32_t m_startMs;
+  PS3EyeSyntheticProfile m_profile;
+  std::mt19937 m_random;
+  std::atomic<uint32_t> m_droppedFrames;
+  std::atomic<uint32_t> m_corruptFrames;
+  bool m_open;
+  std::atomic<bool> m_streaming;
+
+  // GetFrame waits on m_wake for the next frame, Stop or Interrupt
+  std::mutex m_plugMutex;
+  std::condition_variable m_wake;
+  bool m_interrupted;
+  bool m_unplugged; // Stalls the stream until the next Open succeeds
+  std::chrono::steady_clock::time_point m_replugTime;
+};
+
+// Cameras "synthetic-0" .. "synthetic-<count - 1>", all with profile
+PS3EyeCameraList PS3EyeEnumerateSyntheticCameras(
+    uint32_t count,
+    const PS3EyeSyntheticProfile &profile = PS3EyeSyntheticProfile());
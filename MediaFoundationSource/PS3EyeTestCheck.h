@@ -0,0 +1,23 @@
+// PS3EyeTestCheck.h
+// Pass/fail bookkeeping for the standalone Test*.cpp programs. Check prints
+// only what failed, so it may sit in loops and on worker threads; main ends
+// with return TestResult(), which prints PASS or FAIL and gives the exit code.
+
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+
+static std::atomic<bool> g_ok(true);
+
+static void Check(bool condition, const char *what) {
+  if (!condition) {
+    printf("FAIL: %s\n", what);
+    g_ok = false;
+  }
+}
+
+static int TestResult() {
+  printf("%s\n", g_ok ? "PASS" : "FAIL");
+  return g_ok ? 0 : 1;
+}
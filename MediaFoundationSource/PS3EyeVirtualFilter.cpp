@@ -3,6 +3,7 @@
 // Reads frames from shared memory and provides them as a video source
 
 #include "PS3EyeVirtualFilter.h"
+#include "PS3EyeFrameConvert.h"
 #include <dvdmedia.h>
 #include <wmcodecdsp.h>
 
@@ -120,29 +121,57 @@ PS3EyeVirtualPin::PS3EyeVirtualPin(HRESULT *phr, PS3EyeVirtualCam *pParent,
 
 PS3EyeVirtualPin::~PS3EyeVirtualPin() { m_client.Disconnect(); }
 
+// Raw Bayer and grey have no predefined subtype; use the FOURCC-based one
+static GUID FourccSubtype(uint32_t fourcc) { return FOURCCMap(fourcc); }
+
+uint32_t PS3EyeVirtualPin::NativeFourcc() {
+  CAutoLock cAutoLock(&m_cSharedState);
+  if (!m_client.IsConnected() && !m_client.Connect())
+    return 0;
+  switch (m_client.GetFormat()) {
+  case PS3EYE_FORMAT_BAYER_GRBG:
+    return PS3EYE_FOURCC_GRBG;
+  case PS3EYE_FORMAT_GREY8:
+    return PS3EYE_FOURCC_Y800;
+  default:
+    return 0;
+  }
+}
+
 HRESULT PS3EyeVirtualPin::GetMediaType(int iPosition, CMediaType *pmt) {
   CheckPointer(pmt, E_POINTER);
   CAutoLock cAutoLock(m_pFilter->pStateLock());
 
   if (iPosition < 0)
     return E_INVALIDARG;
-  if (iPosition > 0)
+  // Position 0: RGB24, position 1: the channel's own GRBG or Y800 frames,
+  // position 2: RGB24 binned to half size (raw channels only)
+  const uint32_t native = iPosition > 0 ? NativeFourcc() : 0;
+  if (iPosition > 2 || (iPosition > 0 && native == 0) ||
+      (iPosition == 2 && native != PS3EYE_FOURCC_GRBG))
     return VFW_S_NO_MORE_ITEMS;
+  const uint32_t fourcc = iPosition == 1 ? native : 0;
+  const LONG scale = iPosition == 2 ? 2 : 1;
 
-  // Set up RGB24 video format
   VIDEOINFO *pvi = (VIDEOINFO *)pmt->AllocFormatBuffer(sizeof(VIDEOINFO));
   if (pvi == nullptr)
     return E_OUTOFMEMORY;
 
   ZeroMemory(pvi, sizeof(VIDEOINFO));
 
+  uint32_t format = PS3EYE_FORMAT_RGB24;
+  if (fourcc == PS3EYE_FOURCC_GRBG)
+    format = PS3EYE_FORMAT_BAYER_GRBG;
+  else if (fourcc == PS3EYE_FOURCC_Y800)
+    format = PS3EYE_FORMAT_GREY8;
   pvi->bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-  pvi->bmiHeader.biWidth = PS3EYE_WIDTH;
-  pvi->bmiHeader.biHeight = PS3EYE_HEIGHT; // Positive = bottom-up
+  pvi->bmiHeader.biWidth = PS3EYE_WIDTH / scale;
+  pvi->bmiHeader.biHeight = PS3EYE_HEIGHT / scale; // Positive = bottom-up
   pvi->bmiHeader.biPlanes = 1;
-  pvi->bmiHeader.biBitCount = 24;
-  pvi->bmiHeader.biCompression = BI_RGB;
-  pvi->bmiHeader.biSizeImage = PS3EYE_FRAME_SIZE;
+  pvi->bmiHeader.biBitCount =
+      static_cast<WORD>(PS3EyeFormatBytesPerPixel(format) * 8);
+  pvi->bmiHeader.biCompression = fourcc ? fourcc : BI_RGB;
+  pvi->bmiHeader.biSizeImage = PS3EyeFrameSize(format) / (scale * scale);
 
   // Frame timing
   pvi->AvgTimePerFrame = 10000000 / PS3EYE_FPS; // 100ns units
@@ -150,8 +179,9 @@ HRESULT PS3EyeVirtualPin::GetMediaType(int iPosition, CMediaType *pmt) {
   pmt->SetType(&MEDIATYPE_Video);
   pmt->SetFormatType(&FORMAT_VideoInfo);
   pmt->SetTemporalCompression(FALSE);
-  pmt->SetSubtype(&MEDIASUBTYPE_RGB24);
-  pmt->SetSampleSize(PS3EYE_FRAME_SIZE);
+  const GUID subtype = fourcc ? FourccSubtype(fourcc) : MEDIASUBTYPE_RGB24;
+  pmt->SetSubtype(&subtype);
+  pmt->SetSampleSize(pvi->bmiHeader.biSizeImage);
 
   return S_OK;
 }
@@ -163,7 +193,9 @@ HRESULT PS3EyeVirtualPin::CheckMediaType(const CMediaType *pMediaType) {
     return E_INVALIDARG;
   }
 
-  if (*pMediaType->Subtype() != MEDIASUBTYPE_RGB24) {
+  if (*pMediaType->Subtype() != MEDIASUBTYPE_RGB24 &&
+      (NativeFourcc() == 0 ||
+       *pMediaType->Subtype() != FourccSubtype(NativeFourcc()))) {
     return E_INVALIDARG;
   }
 
@@ -176,8 +208,15 @@ HRESULT PS3EyeVirtualPin::CheckMediaType(const CMediaType *pMediaType) {
     return E_INVALIDARG;
   }
 
-  if (pvi->bmiHeader.biWidth != PS3EYE_WIDTH ||
-      abs(pvi->bmiHeader.biHeight) != PS3EYE_HEIGHT) {
+  // Full size, or RGB24 binned from a raw channel at half size
+  const bool binned = pvi->bmiHeader.biWidth == PS3EYE_WIDTH / 2 &&
+                      abs(pvi->bmiHeader.biHeight) == PS3EYE_HEIGHT / 2;
+  if (binned && (*pMediaType->Subtype() != MEDIASUBTYPE_RGB24 ||
+                 NativeFourcc() != PS3EYE_FOURCC_GRBG)) {
+    return E_INVALIDARG;
+  }
+  if (!binned && (pvi->bmiHeader.biWidth != PS3EYE_WIDTH ||
+                  abs(pvi->bmiHeader.biHeight) != PS3EYE_HEIGHT)) {
     return E_INVALIDARG;
   }
 
@@ -190,8 +229,9 @@ HRESULT PS3EyeVirtualPin::DecideBufferSize(IMemAllocator *pIMemAlloc,
   CheckPointer(pProperties, E_POINTER);
   CAutoLock cAutoLock(m_pFilter->pStateLock());
 
+  VIDEOINFO *pvi = (VIDEOINFO *)m_mt.Format();
   pProperties->cBuffers = 1;
-  pProperties->cbBuffer = PS3EYE_FRAME_SIZE;
+  pProperties->cbBuffer = pvi->bmiHeader.biSizeImage;
 
   ALLOCATOR_PROPERTIES actual;
   HRESULT hr = pIMemAlloc->SetProperties(pProperties, &actual);
@@ -225,13 +265,12 @@ HRESULT PS3EyeVirtualPin::FillBuffer(IMediaSample *pSample) {
     return hr;
 
   // Poll for new frame (with timeout)
-  UINT64 frameNumber = 0, timestamp = 0;
   int attempts = 0;
   const int maxAttempts = 10; // ~100ms max wait
+  uint64_t timestamp = 0;
 
   while (attempts < maxAttempts) {
-    if (m_client.ReadFrame(pData, PS3EYE_FRAME_SIZE, &frameNumber,
-                           &timestamp)) {
+    if (CopyFrame(pData, &timestamp)) {
       // Got a new frame!
       break;
     }
@@ -245,10 +284,17 @@ HRESULT PS3EyeVirtualPin::FillBuffer(IMediaSample *pSample) {
     return S_OK;
   }
 
-  pSample->SetActualDataLength(PS3EYE_FRAME_SIZE);
+  VIDEOINFO *pvi = (VIDEOINFO *)m_mt.Format();
+  pSample->SetActualDataLength(pvi->bmiHeader.biSizeImage);
 
-  // Set timestamps
+  // Stamp the capture time on the graph clock: stream time now, less how
+  // long ago the service says the frame was captured. Without a clock the
+  // samples just follow each other.
   REFERENCE_TIME rtStart = m_rtLastTime;
+  CRefTime streamTime;
+  if (SUCCEEDED(m_pFilter->StreamTime(streamTime)))
+    rtStart = streamTime - static_cast<REFERENCE_TIME>(PS3EyeTransportTime() -
+                                                       timestamp);
   REFERENCE_TIME rtStop = rtStart + (10000000 / PS3EYE_FPS);
   pSample->SetTime(&rtStart, &rtStop);
   m_rtLastTime = rtStop;
@@ -258,6 +304,31 @@ HRESULT PS3EyeVirtualPin::FillBuffer(IMediaSample *pSample) {
   return S_OK;
 }
 
+bool PS3EyeVirtualPin::CopyFrame(BYTE *pData, uint64_t *timestamp) {
+  // Raw or grey channels connected as such: copy as is
+  VIDEOINFO *pvi = (VIDEOINFO *)m_mt.Format();
+  bool binned = pvi->bmiHeader.biWidth != PS3EYE_WIDTH;
+  if (!binned && *m_mt.Subtype() != MEDIASUBTYPE_RGB24)
+    return m_client.ReadFrame(pData, pvi->bmiHeader.biSizeImage, nullptr,
+                              timestamp);
+
+  // Anything connected as RGB24, which DirectShow lays out B,G,R: convert
+  // straight out of the slot. RGB24 channels hold R,G,B, so they need their
+  // channels swapped too.
+  PS3EyeFrameView frame;
+  if (!m_client.AcquireFrame(&frame))
+    return false;
+  const uint32_t stride = pvi->bmiHeader.biWidth * 3;
+  bool converted =
+      binned ? PS3EyeConvertFrameBinned(frame, pData, stride,
+                                        PS3EyeBayerFormat::BGR, true)
+             : PS3EyeConvertFrame(frame, pData, stride,
+                                  PS3EyeBayerFormat::BGR, true);
+  *timestamp = frame.timestamp;
+  m_client.ReleaseFrame(&frame);
+  return converted;
+}
+
 STDMETHODIMP PS3EyeVirtualPin::Notify(IBaseFilter *pSender, Quality q) {
   // Quality control - we ignore it for now
   return E_NOTIMPL;
@@ -1,6 +1,8 @@
 // PS3EyeVirtualFilter.h
 // DirectShow Virtual Camera Filter for PS3 Eye
 // Reads from shared memory - works on Windows 10+
+// Offers RGB24, plus raw GRBG when the service publishes raw Bayer (and RGB24
+// binned to half size from it) or Y800 when it publishes grey
 
 #pragma once
 
@@ -39,8 +41,17 @@ public:
   STDMETHODIMP Notify(IBaseFilter *pSender, Quality q) override;
 
 protected:
+  // FOURCC of the frames the service publishes (connecting if needed) when
+  // they are offered as is as a second media type: raw GRBG or grey Y800.
+  // 0 for RGB24 channels.
+  uint32_t NativeFourcc();
+
+  // Write the newest frame, if new, to pData in the connected media type;
+  // timestamp receives its capture time (PS3EyeTransportTime)
+  bool CopyFrame(BYTE *pData, uint64_t *timestamp);
+
   PS3EyeSharedMemoryClient m_client;
-  REFERENCE_TIME m_rtLastTime;
+  REFERENCE_TIME m_rtLastTime; // End of the last sample, without a clock
   UINT64 m_lastFrameNumber;
   CCritSec m_cSharedState;
 };
@@ -0,0 +1,207 @@
+// PS3EyeWorkerPool.cpp
+// Work-stealing pool and striped Bayer conversions
+
+#include "PS3EyeWorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+struct PS3EyeWorkerPool::Batch {
+  const std::function<void(uint32_t)> *fn;
+  std::atomic<uint32_t> remaining; // Tasks not finished yet
+
+  // Set by the task that finishes last; the submitter waits for it
+  std::mutex mutex;
+  std::condition_variable finished;
+  bool done;
+};
+
+PS3EyeWorkerPool::PS3EyeWorkerPool(uint32_t threads)
+    : m_nextQueue(0), m_queued(0), m_stopping(false) {
+  for (uint32_t i = 0; i < threads; i++)
+    m_queues.emplace_back(new Queue);
+  for (uint32_t i = 0; i < threads; i++)
+    m_threads.emplace_back(&PS3EyeWorkerPool::WorkerLoop, this, i);
+}
+
+PS3EyeWorkerPool::~PS3EyeWorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_wakeMutex);
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+  for (std::thread &thread : m_threads)
+    thread.join();
+}
+
+void PS3EyeWorkerPool::ParallelFor(uint32_t count,
+                                   const std::function<void(uint32_t)> &fn) {
+  if (m_threads.empty() || count < 2) {
+    for (uint32_t i = 0; i < count; i++)
+      fn(i);
+    return;
+  }
+
+  Batch batch;
+  batch.fn = &fn;
+  batch.remaining.store(count, std::memory_order_relaxed);
+  batch.done = false;
+
+  // Counted before they are queued, so a worker never sees a negative count;
+  // one that wakes early just finds the queues empty and waits again
+  const uint32_t queues = static_cast<uint32_t>(m_queues.size());
+  uint32_t first;
+  {
+    std::lock_guard<std::mutex> lock(m_wakeMutex);
+    first = m_nextQueue;
+    m_nextQueue = (m_nextQueue + 1) % queues;
+    m_queued += count;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    Queue &queue = *m_queues[(first + i) % queues];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back({&batch, i});
+  }
+  m_wake.notify_all();
+
+  // Help until nothing is queued; the newest tasks, at the back, are most
+  // likely this batch's own
+  Task task;
+  while (Steal(first, &task))
+    Run(task);
+
+  std::unique_lock<std::mutex> lock(batch.mutex);
+  batch.finished.wait(lock, [&] { return batch.done; });
+}
+
+bool PS3EyeWorkerPool::TakeOwn(uint32_t worker, Task *task) {
+  Queue &queue = *m_queues[worker];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty())
+    return false;
+  *task = queue.tasks.front();
+  queue.tasks.pop_front();
+  m_queued--;
+  return true;
+}
+
+bool PS3EyeWorkerPool::Steal(uint32_t first, Task *task) {
+  const uint32_t queues = static_cast<uint32_t>(m_queues.size());
+  for (uint32_t i = 0; i < queues; i++) {
+    Queue &queue = *m_queues[(first + i) % queues];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      continue;
+    *task = queue.tasks.back();
+    queue.tasks.pop_back();
+    m_queued--;
+    return true;
+  }
+  return false;
+}
+
+void PS3EyeWorkerPool::Run(const Task &task) {
+  Batch *batch = task.batch;
+  (*batch->fn)(task.index);
+  if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    return;
+  // Notify under the lock: the submitter cannot return, and destroy the
+  // batch, before this thread has let go of it
+  std::lock_guard<std::mutex> lock(batch->mutex);
+  batch->done = true;
+  batch->finished.notify_all();
+}
+
+void PS3EyeWorkerPool::WorkerLoop(uint32_t worker) {
+  for (;;) {
+    Task task;
+    if (TakeOwn(worker, &task) || Steal(worker + 1, &task)) {
+      Run(task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(m_wakeMutex);
+    m_wake.wait(lock, [&] { return m_stopping || m_queued > 0; });
+    if (m_stopping)
+      return;
+  }
+}
+
+std::shared_ptr<PS3EyeWorkerPool> PS3EyeWorkerPool::Shared() {
+  static std::mutex mutex;
+  static std::weak_ptr<PS3EyeWorkerPool> shared;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<PS3EyeWorkerPool> pool = shared.lock();
+  if (!pool) {
+    const uint32_t cores = std::thread::hardware_concurrency();
+    pool = std::make_shared<PS3EyeWorkerPool>(cores > 1 ? cores - 1 : 0);
+    shared = pool;
+  }
+  return pool;
+}
+
+//------------------------------------------------------------------------------
+// Striped conversions
+//------------------------------------------------------------------------------
+
+// Calls convert(rowBegin, rowEnd) for stripes covering [0, rows), with every
+// boundary a multiple of align. Two stripes per thread leave the stealing
+// something to even out.
+template <class Convert>
+static void RunStripes(PS3EyeWorkerPool *pool, uint32_t rows, uint32_t align,
+                       Convert convert) {
+  const uint32_t units = rows / align;
+  uint32_t stripes = 1;
+  if (pool) {
+    stripes = std::min((pool->ThreadCount() + 1) * 2,
+                       units * align / PS3EYE_STRIPE_MIN_ROWS);
+  }
+  if (stripes < 2) {
+    convert(0u, rows);
+    return;
+  }
+  pool->ParallelFor(stripes, [&](uint32_t stripe) {
+    const uint32_t begin = units * stripe / stripes * align;
+    const uint32_t end =
+        stripe + 1 == stripes ? rows : units * (stripe + 1) / stripes * align;
+    convert(begin, end);
+  });
+}
+
+void PS3EyeDemosaicParallel(PS3EyeWorkerPool *pool,
+                            const PS3EyeBayerJob &job) {
+  const PS3EyeSimd simd = PS3EyeBestSimd();
+  RunStripes(pool, job.height, 1, [&](uint32_t begin, uint32_t end) {
+    PS3EyeDemosaicRows(simd, job, begin, end);
+  });
+}
+
+void PS3EyeDemosaicYuvParallel(PS3EyeWorkerPool *pool,
+                               const PS3EyeYuvJob &job) {
+  // Each chroma row comes from a pair of raw rows
+  const PS3EyeSimd simd = PS3EyeBestSimd();
+  RunStripes(pool, job.height, 2, [&](uint32_t begin, uint32_t end) {
+    PS3EyeDemosaicYuvRows(simd, job, begin, end);
+  });
+}
+
+void PS3EyeBayerToGreyParallel(PS3EyeWorkerPool *pool,
+                               const PS3EyeGreyJob &job) {
+  const PS3EyeSimd simd = PS3EyeBestSimd();
+  RunStripes(pool, job.height, 1, [&](uint32_t begin, uint32_t end) {
+    PS3EyeBayerToGreyRows(simd, job, begin, end);
+  });
+}
+
+void PS3EyeBinParallel(PS3EyeWorkerPool *pool, const PS3EyeBayerJob &job) {
+  const PS3EyeSimd simd = PS3EyeBestSimd();
+  RunStripes(pool, job.height / 2, 1, [&](uint32_t begin, uint32_t end) {
+    PS3EyeBinRows(simd, job, begin, end);
+  });
+}
+
+void PS3EyeBinGreyParallel(PS3EyeWorkerPool *pool, const PS3EyeGreyJob &job) {
+  const PS3EyeSimd simd = PS3EyeBestSimd();
+  RunStripes(pool, job.height / 2, 1, [&](uint32_t begin, uint32_t end) {
+    PS3EyeBinGreyRows(simd, job, begin, end);
+  });
+}
@@ -0,0 +1,100 @@
+// PS3EyeWorkerPool.h
+// Worker threads shared by every camera in the process, and the Bayer
+// conversions of PS3EyeBayer.h split into row stripes across them.
+//
+// Each worker owns a queue. A batch of stripes is dealt round-robin over the
+// queues; a worker takes from the front of its own queue and, once that is
+// empty, steals from the back of the others. Stripes of two cameras that
+// deliver at the same moment therefore spread over all workers instead of
+// queueing behind each other. The thread that submits a batch runs stripes
+// too until none are left, so a busy pool never leaves it idle, and a pool
+// without workers (single-core machines) runs everything inline.
+//
+// Every stripe reads the rows above and below it (the halo of the 3x3
+// neighbourhood) straight from the raw frame, which nothing writes while it
+// is converted, and writes only its own output rows. Output is therefore
+// identical to converting the whole frame on one thread.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PS3EyeBayer.h"
+
+class PS3EyeWorkerPool {
+public:
+  // threads workers besides the submitting thread (0: run inline)
+  explicit PS3EyeWorkerPool(uint32_t threads);
+  ~PS3EyeWorkerPool();
+
+  PS3EyeWorkerPool(const PS3EyeWorkerPool &) = delete;
+  PS3EyeWorkerPool &operator=(const PS3EyeWorkerPool &) = delete;
+
+  uint32_t ThreadCount() const {
+    return static_cast<uint32_t>(m_threads.size());
+  }
+
+  // Runs fn(0) .. fn(count - 1) on the workers and the calling thread and
+  // returns when all have finished. Safe to call from several threads at
+  // once; fn must not call ParallelFor itself.
+  void ParallelFor(uint32_t count, const std::function<void(uint32_t)> &fn);
+
+  // The pool of the process, one worker per core besides the caller's.
+  // Created by the first user and joined when the last reference goes, so
+  // its threads never outlive the cameras (or the DLL) using them.
+  static std::shared_ptr<PS3EyeWorkerPool> Shared();
+
+private:
+  struct Batch;
+
+  struct Task {
+    Batch *batch;
+    uint32_t index;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  bool TakeOwn(uint32_t worker, Task *task);
+  bool Steal(uint32_t first, Task *task);
+  void Run(const Task &task);
+  void WorkerLoop(uint32_t worker);
+
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  std::vector<std::thread> m_threads;
+  uint32_t m_nextQueue; // First queue of the next batch, under m_wakeMutex
+
+  // Workers sleep while no task is queued
+  std::mutex m_wakeMutex;
+  std::condition_variable m_wake;
+  std::atomic<uint64_t> m_queued; // Tasks in the queues, raised under it
+  bool m_stopping;
+};
+
+//------------------------------------------------------------------------------
+// Striped conversions
+//------------------------------------------------------------------------------
+
+// Rows per stripe below which splitting a frame further costs more than it
+// saves (a 640 pixel stripe of 16 rows takes a few microseconds)
+constexpr uint32_t PS3EYE_STRIPE_MIN_ROWS = 16;
+
+// The PS3EyeBayer.h conversion of a whole frame with the fastest kernel, in
+// stripes on pool (or on the calling thread alone if pool is null)
+void PS3EyeDemosaicParallel(PS3EyeWorkerPool *pool, const PS3EyeBayerJob &job);
+void PS3EyeDemosaicYuvParallel(PS3EyeWorkerPool *pool,
+                               const PS3EyeYuvJob &job);
+void PS3EyeBayerToGreyParallel(PS3EyeWorkerPool *pool,
+                               const PS3EyeGreyJob &job);
+void PS3EyeBinParallel(PS3EyeWorkerPool *pool, const PS3EyeBayerJob &job);
+void PS3EyeBinGreyParallel(PS3EyeWorkerPool *pool, const PS3EyeGreyJob &job);
@@ -0,0 +1,525 @@
+// TestBayerKernels.cpp - Checks every Bayer kernel the CPU supports against
+// the scalar reference, byte for byte, for every output format: random raw
+// frames at the camera sizes, at widths that leave each block size with a
+// tail, at the 2x2 minimum, with padded strides, and for row ranges (a stripe
+// must convert exactly like the same rows of a whole frame). Every case also
+// runs flipped, mirrored and both, and the scalar reference must equal its own
+// unflipped output reordered. The NV12, I420 and YUY2 kernels get the same
+// checks (even sizes only), plus the BT.601 levels of black, white and grey.
+// Grey straight from the mosaic gets the kernel and stripe checks at every
+// size, a flat frame must keep its level and one site is checked by hand.
+// Binning to half size gets the RGB checks (even sizes only) and a quad
+// checked by hand, in colour and grey.
+//   g++ -std=c++14 -O2 -c -mavx2 PS3EyeBayerAVX2.cpp
+//   g++ -std=c++14 -O2 TestBayerKernels.cpp PS3EyeBayer.cpp
+//      PS3EyeBayerSSE2.cpp PS3EyeBayerNEON.cpp PS3EyeBayerAVX2.o
+//      -o TestBayerKernels
+//   cl /EHsc /O2 TestBayerKernels.cpp PS3EyeBayer.cpp PS3EyeBayerSSE2.cpp
+//      PS3EyeBayerNEON.cpp PS3EyeBayerAVX2.cpp
+//   (compile PS3EyeBayerAVX2.cpp with /arch:AVX2, e.g. as a separate /c step)
+
+#include "PS3EyeBayer.h"
+#include "PS3EyeTestCheck.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static const PS3EyeBayerFormat FORMATS[] = {
+    PS3EyeBayerFormat::RGB, PS3EyeBayerFormat::BGR, PS3EyeBayerFormat::RGBA,
+    PS3EyeBayerFormat::BGRA};
+static const char *FORMAT_NAMES[] = {"RGB", "BGR", "RGBA", "BGRA"};
+
+// flipVertical, mirror
+static const bool ORIENTATIONS[][2] = {
+    {false, false}, {true, false}, {false, true}, {true, true}};
+
+static const PS3EyeSimd KERNELS[] = {PS3EyeSimd::SSE2, PS3EyeSimd::AVX2,
+                                     PS3EyeSimd::NEON};
+
+struct Frame {
+  uint32_t width, height, bayerStride, dstStride;
+  std::vector<uint8_t> bayer;
+};
+
+static Frame RandomFrame(std::mt19937 &rng, uint32_t width, uint32_t height,
+                         uint32_t padding) {
+  Frame frame;
+  frame.width = width;
+  frame.height = height;
+  frame.bayerStride = width + padding;
+  frame.dstStride = width * 4 + padding;
+  frame.bayer.resize(static_cast<size_t>(frame.bayerStride) * height);
+  for (uint8_t &byte : frame.bayer)
+    byte = static_cast<uint8_t>(rng());
+  return frame;
+}
+
+// Rows [rowBegin, rowEnd) of a frame into dst
+static void ConvertInto(const Frame &frame, PS3EyeSimd simd,
+                        PS3EyeBayerFormat format, const bool orientation[2],
+                        uint32_t rowBegin, uint32_t rowEnd,
+                        std::vector<uint8_t> *dst) {
+  PS3EyeBayerJob job = {frame.bayer.data(), frame.bayerStride, dst->data(),
+                        frame.dstStride,    frame.width,       frame.height,
+                        format,             orientation[0],    orientation[1]};
+  PS3EyeDemosaicRows(simd, job, rowBegin, rowEnd);
+}
+
+// Output buffer pre-filled with a marker so writes outside the rows or past
+// the end of a row show up as differences too
+static std::vector<uint8_t>
+Convert(const Frame &frame, PS3EyeSimd simd, PS3EyeBayerFormat format,
+        const bool orientation[2] = ORIENTATIONS[0]) {
+  std::vector<uint8_t> dst(static_cast<size_t>(frame.dstStride) *
+                               frame.height,
+                           0xA5);
+  ConvertInto(frame, simd, format, orientation, 0, frame.height, &dst);
+  return dst;
+}
+
+// The plain output with its rows and pixels moved where flip and mirror put
+// them
+static std::vector<uint8_t> Reorient(const Frame &frame,
+                                     const std::vector<uint8_t> &plain,
+                                     uint32_t bpp,
+                                     const bool orientation[2]) {
+  std::vector<uint8_t> out(plain);
+  for (uint32_t y = 0; y < frame.height; y++) {
+    uint32_t outY = orientation[0] ? frame.height - 1 - y : y;
+    for (uint32_t x = 0; x < frame.width; x++) {
+      uint32_t outX = orientation[1] ? frame.width - 1 - x : x;
+      memcpy(&out[static_cast<size_t>(outY) * frame.dstStride + outX * bpp],
+             &plain[static_cast<size_t>(y) * frame.dstStride + x * bpp], bpp);
+    }
+  }
+  return out;
+}
+
+static void CheckFrame(const Frame &frame) {
+  for (size_t f = 0; f < sizeof(FORMATS) / sizeof(FORMATS[0]); f++) {
+    const std::vector<uint8_t> plain =
+        Convert(frame, PS3EyeSimd::Scalar, FORMATS[f]);
+    for (const bool *orientation : ORIENTATIONS) {
+      char what[128];
+      const char *orientationName = orientation[0]
+                                        ? (orientation[1] ? " flip+mirror"
+                                                          : " flip")
+                                        : (orientation[1] ? " mirror" : "");
+      std::vector<uint8_t> reference =
+          Convert(frame, PS3EyeSimd::Scalar, FORMATS[f], orientation);
+      snprintf(what, sizeof(what), "Scalar %s%s %ux%u is the reordered plain "
+               "output", FORMAT_NAMES[f], orientationName, frame.width,
+               frame.height);
+      Check(reference == Reorient(frame, plain,
+                                  PS3EyeBayerBytesPerPixel(FORMATS[f]),
+                                  orientation),
+            what);
+
+      for (PS3EyeSimd simd : KERNELS) {
+        if (!PS3EyeSimdSupported(simd))
+          continue;
+        snprintf(what, sizeof(what), "%s %s%s %ux%u stride %u",
+                 PS3EyeSimdName(simd), FORMAT_NAMES[f], orientationName,
+                 frame.width, frame.height, frame.bayerStride);
+        Check(Convert(frame, simd, FORMATS[f], orientation) == reference,
+              what);
+
+        // Two stripes, split on an odd row, rebuild the frame exactly
+        uint32_t split = (frame.height / 2) | 1;
+        if (split >= frame.height)
+          continue;
+        std::vector<uint8_t> striped(reference.size(), 0xA5);
+        ConvertInto(frame, simd, FORMATS[f], orientation, 0, split, &striped);
+        ConvertInto(frame, simd, FORMATS[f], orientation, split, frame.height,
+                    &striped);
+        snprintf(what, sizeof(what), "%s %s%s %ux%u rows 0-%u-%u",
+                 PS3EyeSimdName(simd), FORMAT_NAMES[f], orientationName,
+                 frame.width, frame.height, split, frame.height);
+        Check(striped == reference, what);
+      }
+    }
+  }
+}
+
+// Y, then the chroma plane(s), each pre-filled with the marker. YUY2 has
+// everything in y.
+struct YuvFrame {
+  std::vector<uint8_t> y, u, v;
+  uint32_t yStride, uvStride;
+};
+
+static void ConvertYuvInto(const Frame &frame, PS3EyeSimd simd,
+                           PS3EyeYuvFormat format, uint32_t rowBegin,
+                           uint32_t rowEnd, YuvFrame *out) {
+  PS3EyeYuvJob job = {frame.bayer.data(), frame.bayerStride, out->y.data(),
+                      out->yStride,       out->u.data(),     out->v.data(),
+                      out->uvStride,      frame.width,       frame.height,
+                      format};
+  PS3EyeDemosaicYuvRows(simd, job, rowBegin, rowEnd);
+}
+
+static YuvFrame EmptyYuv(const Frame &frame, PS3EyeYuvFormat format) {
+  // Padded like the raw frame
+  const uint32_t padding = frame.bayerStride - frame.width;
+  YuvFrame out;
+  out.yStride = frame.width + padding;
+  out.uvStride = (format == PS3EyeYuvFormat::NV12 ? frame.width
+                                                  : frame.width / 2) +
+                 padding;
+  if (format == PS3EyeYuvFormat::YUY2) {
+    out.yStride = frame.width * 2 + padding;
+    out.uvStride = 0;
+  }
+  out.y.assign(static_cast<size_t>(out.yStride) * frame.height, 0xA5);
+  out.u.assign(static_cast<size_t>(out.uvStride) * frame.height / 2, 0xA5);
+  if (format == PS3EyeYuvFormat::I420)
+    out.v = out.u;
+  return out;
+}
+
+static YuvFrame ConvertYuv(const Frame &frame, PS3EyeSimd simd,
+                           PS3EyeYuvFormat format) {
+  YuvFrame out = EmptyYuv(frame, format);
+  ConvertYuvInto(frame, simd, format, 0, frame.height, &out);
+  return out;
+}
+
+static bool operator==(const YuvFrame &a, const YuvFrame &b) {
+  return a.y == b.y && a.u == b.u && a.v == b.v;
+}
+
+static void CheckYuvFrame(const Frame &frame) {
+  const PS3EyeYuvFormat formats[] = {
+      PS3EyeYuvFormat::NV12, PS3EyeYuvFormat::I420, PS3EyeYuvFormat::YUY2};
+  const char *names[] = {"NV12", "I420", "YUY2"};
+
+  // YUY2 luma is the same as the planar formats'
+  const YuvFrame nv12 = ConvertYuv(frame, PS3EyeSimd::Scalar, formats[0]);
+  const YuvFrame yuy2 = ConvertYuv(frame, PS3EyeSimd::Scalar, formats[2]);
+  bool sameLuma = true;
+  for (uint32_t y = 0; y < frame.height; y++) {
+    for (uint32_t x = 0; x < frame.width; x++) {
+      sameLuma = sameLuma && yuy2.y[y * yuy2.yStride + x * 2] ==
+                                 nv12.y[y * nv12.yStride + x];
+    }
+  }
+  Check(sameLuma, "YUY2 luma matches NV12");
+  for (int f = 0; f < 3; f++) {
+    const YuvFrame reference =
+        ConvertYuv(frame, PS3EyeSimd::Scalar, formats[f]);
+    for (PS3EyeSimd simd : KERNELS) {
+      if (!PS3EyeSimdSupported(simd))
+        continue;
+      char what[128];
+      snprintf(what, sizeof(what), "%s %s %ux%u stride %u",
+               PS3EyeSimdName(simd), names[f], frame.width, frame.height,
+               frame.bayerStride);
+      Check(ConvertYuv(frame, simd, formats[f]) == reference, what);
+
+      // Stripes must start on an even row
+      uint32_t split = (frame.height / 2) & ~1u;
+      YuvFrame striped = EmptyYuv(frame, formats[f]);
+      ConvertYuvInto(frame, simd, formats[f], 0, split, &striped);
+      ConvertYuvInto(frame, simd, formats[f], split, frame.height, &striped);
+      snprintf(what, sizeof(what), "%s %s %ux%u rows 0-%u-%u",
+               PS3EyeSimdName(simd), names[f], frame.width, frame.height,
+               split, frame.height);
+      Check(striped == reference, what);
+    }
+  }
+}
+
+// Grey rows [rowBegin, rowEnd) into dst, padded like the raw frame
+static void ConvertGreyInto(const Frame &frame, PS3EyeSimd simd,
+                            uint32_t rowBegin, uint32_t rowEnd,
+                            std::vector<uint8_t> *dst) {
+  PS3EyeGreyJob job = {frame.bayer.data(), frame.bayerStride, dst->data(),
+                       frame.bayerStride,  frame.width,       frame.height};
+  PS3EyeBayerToGreyRows(simd, job, rowBegin, rowEnd);
+}
+
+static std::vector<uint8_t> ConvertGrey(const Frame &frame, PS3EyeSimd simd) {
+  std::vector<uint8_t> dst(frame.bayer.size(), 0xA5);
+  ConvertGreyInto(frame, simd, 0, frame.height, &dst);
+  return dst;
+}
+
+static void CheckGreyFrame(const Frame &frame) {
+  const std::vector<uint8_t> reference =
+      ConvertGrey(frame, PS3EyeSimd::Scalar);
+  for (PS3EyeSimd simd : KERNELS) {
+    if (!PS3EyeSimdSupported(simd))
+      continue;
+    char what[128];
+    snprintf(what, sizeof(what), "%s grey %ux%u stride %u",
+             PS3EyeSimdName(simd), frame.width, frame.height,
+             frame.bayerStride);
+    Check(ConvertGrey(frame, simd) == reference, what);
+
+    uint32_t split = (frame.height / 2) | 1;
+    if (split >= frame.height)
+      continue;
+    std::vector<uint8_t> striped(reference.size(), 0xA5);
+    ConvertGreyInto(frame, simd, 0, split, &striped);
+    ConvertGreyInto(frame, simd, split, frame.height, &striped);
+    snprintf(what, sizeof(what), "%s grey %ux%u rows 0-%u-%u",
+             PS3EyeSimdName(simd), frame.width, frame.height, split,
+             frame.height);
+    Check(striped == reference, what);
+  }
+}
+
+// Grey is full range: a flat frame keeps its level. At the B site of
+// CheckSites, (2, 1): (1 * (20 + 40 + 100 + 120) + 2 * (30 + 60 + 80 + 110)
+// + 4 * 70 + 8) / 16 = 70.
+static void CheckGreyLevels() {
+  for (uint8_t level : {0, 77, 255}) {
+    Frame frame;
+    frame.width = 68;
+    frame.height = 4;
+    frame.bayerStride = 68;
+    frame.dstStride = 68;
+    frame.bayer.assign(68 * 4, level);
+    for (PS3EyeSimd simd : KERNELS) {
+      if (!PS3EyeSimdSupported(simd))
+        continue;
+      bool ok = true;
+      for (uint8_t byte : ConvertGrey(frame, simd))
+        ok = ok && byte == level;
+      char what[64];
+      snprintf(what, sizeof(what), "%s flat grey %u", PS3EyeSimdName(simd),
+               level);
+      Check(ok, what);
+    }
+  }
+
+  Frame frame;
+  frame.width = 4;
+  frame.height = 4;
+  frame.bayerStride = 4;
+  frame.dstStride = 4;
+  for (uint8_t i = 1; i <= 16; i++)
+    frame.bayer.push_back(i * 10);
+  Check(ConvertGrey(frame, PS3EyeSimd::Scalar)[1 * 4 + 2] == 70,
+        "grey at a B site");
+}
+
+// Binned rows [rowBegin, rowEnd) into dst. The output is half the frame in
+// each direction, with the frame's dstStride.
+static void BinInto(const Frame &frame, PS3EyeSimd simd,
+                    PS3EyeBayerFormat format, const bool orientation[2],
+                    uint32_t rowBegin, uint32_t rowEnd,
+                    std::vector<uint8_t> *dst) {
+  PS3EyeBayerJob job = {frame.bayer.data(), frame.bayerStride, dst->data(),
+                        frame.dstStride,    frame.width,       frame.height,
+                        format,             orientation[0],    orientation[1]};
+  PS3EyeBinRows(simd, job, rowBegin, rowEnd);
+}
+
+static std::vector<uint8_t> Bin(const Frame &frame, PS3EyeSimd simd,
+                                PS3EyeBayerFormat format,
+                                const bool orientation[2] = ORIENTATIONS[0]) {
+  std::vector<uint8_t> dst(
+      static_cast<size_t>(frame.dstStride) * (frame.height / 2), 0xA5);
+  BinInto(frame, simd, format, orientation, 0, frame.height / 2, &dst);
+  return dst;
+}
+
+static std::vector<uint8_t> BinGrey(const Frame &frame, PS3EyeSimd simd) {
+  std::vector<uint8_t> dst(
+      static_cast<size_t>(frame.bayerStride) * (frame.height / 2), 0xA5);
+  PS3EyeGreyJob job = {frame.bayer.data(), frame.bayerStride, dst.data(),
+                       frame.bayerStride,  frame.width,       frame.height};
+  PS3EyeBinGreyRows(simd, job, 0, frame.height / 2);
+  return dst;
+}
+
+static void CheckBinFrame(const Frame &frame) {
+  // The binned frame, for Reorient
+  Frame half = frame;
+  half.width /= 2;
+  half.height /= 2;
+  for (size_t f = 0; f < sizeof(FORMATS) / sizeof(FORMATS[0]); f++) {
+    const std::vector<uint8_t> plain =
+        Bin(frame, PS3EyeSimd::Scalar, FORMATS[f]);
+    for (const bool *orientation : ORIENTATIONS) {
+      char what[128];
+      std::vector<uint8_t> reference =
+          Bin(frame, PS3EyeSimd::Scalar, FORMATS[f], orientation);
+      snprintf(what, sizeof(what), "Scalar binned %s %ux%u orientation %d%d "
+               "is the reordered plain output", FORMAT_NAMES[f], frame.width,
+               frame.height, orientation[0], orientation[1]);
+      Check(reference == Reorient(half, plain,
+                                  PS3EyeBayerBytesPerPixel(FORMATS[f]),
+                                  orientation),
+            what);
+
+      for (PS3EyeSimd simd : KERNELS) {
+        if (!PS3EyeSimdSupported(simd))
+          continue;
+        snprintf(what, sizeof(what), "%s binned %s %ux%u orientation %d%d",
+                 PS3EyeSimdName(simd), FORMAT_NAMES[f], frame.width,
+                 frame.height, orientation[0], orientation[1]);
+        Check(Bin(frame, simd, FORMATS[f], orientation) == reference, what);
+
+        uint32_t split = half.height / 2;
+        std::vector<uint8_t> striped(reference.size(), 0xA5);
+        BinInto(frame, simd, FORMATS[f], orientation, 0, split, &striped);
+        BinInto(frame, simd, FORMATS[f], orientation, split, half.height,
+                &striped);
+        snprintf(what, sizeof(what), "%s binned %s %ux%u rows 0-%u-%u",
+                 PS3EyeSimdName(simd), FORMAT_NAMES[f], frame.width,
+                 frame.height, split, half.height);
+        Check(striped == reference, what);
+      }
+    }
+  }
+
+  const std::vector<uint8_t> grey = BinGrey(frame, PS3EyeSimd::Scalar);
+  for (PS3EyeSimd simd : KERNELS) {
+    if (!PS3EyeSimdSupported(simd))
+      continue;
+    char what[128];
+    snprintf(what, sizeof(what), "%s binned grey %ux%u stride %u",
+             PS3EyeSimdName(simd), frame.width, frame.height,
+             frame.bayerStride);
+    Check(BinGrey(frame, simd) == grey, what);
+  }
+}
+
+// The quad G R / B G = 10 20 / 30 41 bins to R 20, G 26 (25.5 rounded up),
+// B 30 and grey 25 (25.25)
+static void CheckBinQuad() {
+  Frame frame;
+  frame.width = 2;
+  frame.height = 2;
+  frame.bayerStride = 2;
+  frame.dstStride = 3;
+  frame.bayer = {10, 20, 30, 41};
+  std::vector<uint8_t> rgb =
+      Bin(frame, PS3EyeSimd::Scalar, PS3EyeBayerFormat::RGB);
+  Check(rgb[0] == 20 && rgb[1] == 26 && rgb[2] == 30, "binned quad");
+  Check(BinGrey(frame, PS3EyeSimd::Scalar)[0] == 25, "binned grey quad");
+}
+
+// Flat frames land on the BT.601 levels, with neutral chroma
+static void CheckYuvLevels() {
+  const uint8_t levels[][2] = {{0, 16}, {255, 235}, {77, 82}};
+  for (const auto &level : levels) {
+    Frame frame;
+    frame.width = 68;
+    frame.height = 4;
+    frame.bayerStride = 68;
+    frame.dstStride = 68;
+    frame.bayer.assign(68 * 4, level[0]);
+    for (PS3EyeSimd simd : KERNELS) {
+      if (!PS3EyeSimdSupported(simd))
+        continue;
+      YuvFrame yuv = ConvertYuv(frame, simd, PS3EyeYuvFormat::NV12);
+      bool ok = true;
+      for (uint8_t byte : yuv.y)
+        ok = ok && byte == level[1];
+      for (uint8_t byte : yuv.u)
+        ok = ok && byte == 128;
+      YuvFrame yuy2 = ConvertYuv(frame, simd, PS3EyeYuvFormat::YUY2);
+      for (size_t i = 0; i < yuy2.y.size(); i++)
+        ok = ok && yuy2.y[i] == (i & 1 ? 128 : level[1]);
+      char what[64];
+      snprintf(what, sizeof(what), "%s grey %u is Y %u, neutral chroma",
+               PS3EyeSimdName(simd), level[0], level[1]);
+      Check(ok, what);
+    }
+  }
+
+  // One red quad (G R / B G = 0 255 / 0 0): U and V of pure red
+  Frame frame;
+  frame.width = 2;
+  frame.height = 2;
+  frame.bayerStride = 2;
+  frame.dstStride = 2;
+  frame.bayer = {0, 255, 0, 0};
+  YuvFrame yuv = ConvertYuv(frame, PS3EyeSimd::Scalar, PS3EyeYuvFormat::I420);
+  Check(yuv.u[0] == 90 && yuv.v[0] == 240, "red chroma");
+}
+
+// A flat grey frame converts to the same grey everywhere, edges included
+static void CheckFlat() {
+  Frame frame;
+  frame.width = 64;
+  frame.height = 8;
+  frame.bayerStride = 64;
+  frame.dstStride = 64 * 3;
+  frame.bayer.assign(64 * 8, 77);
+  std::vector<uint8_t> dst =
+      Convert(frame, PS3EyeBestSimd(), PS3EyeBayerFormat::RGB);
+  bool flat = true;
+  for (uint8_t byte : dst)
+    flat = flat && byte == 77;
+  Check(flat, "flat frame stays flat");
+}
+
+// Hand-checked values at each of the four sites of a 4x4 frame
+static void CheckSites() {
+  const uint8_t raw[16] = {
+      10, 20, 30, 40,  // G R G R
+      50, 60, 70, 80,  // B G B G
+      90, 100, 110, 120, // G R G R
+      130, 140, 150, 160, // B G B G
+  };
+  Frame frame;
+  frame.width = 4;
+  frame.height = 4;
+  frame.bayerStride = 4;
+  frame.dstStride = 12;
+  frame.bayer.assign(raw, raw + 16);
+  std::vector<uint8_t> dst =
+      Convert(frame, PS3EyeSimd::Scalar, PS3EyeBayerFormat::RGB);
+  // (1, 1) G on a B G row: R above/below, B to the sides
+  const uint8_t *g = &dst[1 * 12 + 1 * 3];
+  Check(g[0] == 60 && g[1] == 60 && g[2] == 60, "G site on B row");
+  // (2, 1) B: R diagonal, G cross
+  const uint8_t *b = &dst[1 * 12 + 2 * 3];
+  Check(b[0] == 70 && b[1] == 70 && b[2] == 70, "B site");
+  // (1, 0) R with the row above mirrored: B diagonal from row 1
+  const uint8_t *r = &dst[1 * 3];
+  Check(r[0] == 20 && r[1] == 40 && r[2] == 60, "R site on the top edge");
+  // (0, 0) G with both edges mirrored
+  Check(dst[0] == 20 && dst[1] == 10 && dst[2] == 50, "G site in the corner");
+}
+
+int main() {
+  printf("Kernels:");
+  for (PS3EyeSimd simd : KERNELS) {
+    if (PS3EyeSimdSupported(simd))
+      printf(" %s", PS3EyeSimdName(simd));
+  }
+  printf(" (best %s)\n", PS3EyeSimdName(PS3EyeBestSimd()));
+
+  CheckSites();
+  CheckFlat();
+  CheckYuvLevels();
+  CheckGreyLevels();
+  CheckBinQuad();
+
+  std::mt19937 rng(12345);
+  const uint32_t sizes[][2] = {
+      {640, 480}, {320, 240}, {2, 2},  {4, 2},   {6, 4},  {18, 4},
+      {20, 6},    {34, 4},    {36, 4}, {50, 10}, {66, 8}, {98, 6},
+      {100, 4},   {130, 12},  {17, 5}, {33, 3}};
+  for (const auto &size : sizes) {
+    CheckFrame(RandomFrame(rng, size[0], size[1], 0));
+    CheckFrame(RandomFrame(rng, size[0], size[1], 13));
+    CheckGreyFrame(RandomFrame(rng, size[0], size[1], 0));
+    CheckGreyFrame(RandomFrame(rng, size[0], size[1], 13));
+    if ((size[0] | size[1]) & 1)
+      continue;
+    CheckYuvFrame(RandomFrame(rng, size[0], size[1], 0));
+    CheckYuvFrame(RandomFrame(rng, size[0], size[1], 13));
+    CheckBinFrame(RandomFrame(rng, size[0], size[1], 0));
+    CheckBinFrame(RandomFrame(rng, size[0], size[1], 13));
+  }
+
+  return TestResult();
+}
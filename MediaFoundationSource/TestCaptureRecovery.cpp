@@ -0,0 +1,154 @@
+// TestCaptureRecovery.cpp - Checks that PS3EyeCaptureChannel brings a lost
+// camera back on the same channel. A synthetic camera is unplugged on
+// command while a client reads; the channel must publish the lost state,
+// keep re-enumerating, and resume the stream once the camera is back, with
+// the client still connected and no action on its part:
+//   - a stall that clears on reopen (a hub reset) recovers well within 1 s,
+//   - an unplug for 200 ms recovers within 1 s of the last frame,
+//   - an unplug for 2 s recovers within 1 s of the camera coming back,
+//   - a camera lost after the last client left is not reopened until the
+//     next client connects.
+// Prints the time to detect each loss and the outage clients saw.
+//   g++ -std=c++17 -O2 -pthread TestCaptureRecovery.cpp
+//      PS3EyeCaptureChannel.cpp PS3EyeFrameCadence.cpp
+//      PS3EyeSyntheticCamera.cpp PS3EyeSharedMemory.cpp
+//      PS3EyeChannelDirectory.cpp PS3EyeIpcPosix.cpp -lrt
+//      -o TestCaptureRecovery
+//   cl /EHsc /O2 /std:c++17 TestCaptureRecovery.cpp PS3EyeCaptureChannel.cpp
+//      PS3EyeFrameCadence.cpp PS3EyeSyntheticCamera.cpp PS3EyeSharedMemory.cpp
+//      PS3EyeChannelDirectory.cpp PS3EyeIpcWin32.cpp advapi32.lib
+
+#include "PS3EyeCaptureChannel.h"
+#include "PS3EyeSharedMemory.h"
+#include "PS3EyeSyntheticCamera.h"
+#include "PS3EyeTestCheck.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+static const char CHANNEL_NAME[] = "PS3EyeRecoveryTest";
+static const uint32_t OPEN_MS = 50;
+static const uint64_t SECOND = 10000000; // 100ns
+
+// Wait for the next frame; its drop count in *dropped
+static bool ReadFrame(PS3EyeSharedMemoryClient &client, uint32_t timeoutMs,
+                      uint32_t *dropped) {
+  const uint64_t end = PS3EyeTransportTime() + timeoutMs * 10000ULL;
+  while (PS3EyeTransportTime() < end) {
+    PS3EyeFrameView frame;
+    if (client.WaitForFrame(20) && client.AcquireFrame(&frame)) {
+      *dropped = frame.metadata.droppedFrames;
+      client.ReleaseFrame(&frame);
+      return true;
+    }
+  }
+  return false;
+}
+
+struct Outage {
+  bool detected;  // Lost state published
+  bool recovered; // Frames again with the state back to OK
+  double detectMs;
+  double outageMs;  // Last frame before the unplug to the first after
+  uint32_t dropped; // On the first frame after
+};
+
+// Unplug the camera for replugMs and follow the client through the outage
+static Outage Unplug(PS3EyeSyntheticCamera *camera,
+                     PS3EyeSharedMemoryClient &client, uint32_t replugMs) {
+  Outage result = {};
+  uint32_t dropped;
+  ReadFrame(client, 1000, &dropped);
+  const uint64_t lastFrame = PS3EyeTransportTime();
+  camera->Unplug(replugMs);
+
+  const uint64_t end = lastFrame + 5 * SECOND;
+  while (!result.detected && PS3EyeTransportTime() < end) {
+    result.detected = client.GetCameraState() == PS3EYE_CAMERA_LOST;
+    if (!result.detected)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  result.detectMs = (PS3EyeTransportTime() - lastFrame) / 10000.0;
+
+  // Skip whatever was published before the loss was seen
+  PS3EyeFrameView frame;
+  client.WaitForFrame(0);
+  if (client.AcquireFrame(&frame))
+    client.ReleaseFrame(&frame);
+  result.recovered = ReadFrame(client, 5000, &result.dropped) &&
+                     client.GetCameraState() == PS3EYE_CAMERA_OK;
+  result.outageMs = (PS3EyeTransportTime() - lastFrame) / 10000.0;
+  printf("unplugged %u ms: lost after %.1f ms, frames back after %.1f ms "
+         "(%u dropped)\n",
+         replugMs, result.detectMs, result.outageMs, result.dropped);
+  return result;
+}
+
+int main() {
+  // Keep a handle on the camera to unplug it once the channel owns it
+  std::unique_ptr<PS3EyeSyntheticCamera> owned(
+      new PS3EyeSyntheticCamera("synthetic-recovery"));
+  owned->SetLatency(OPEN_MS, 5);
+  PS3EyeSyntheticCamera *camera = owned.get();
+
+  PS3EyeCaptureChannel channel(std::move(owned), CHANNEL_NAME);
+  PS3EyeCaptureOptions options;
+  options.fps = 60;
+  if (!channel.Start(options)) {
+    printf("Failed to start channel\n");
+    return 1;
+  }
+
+  PS3EyeSharedMemoryClient client;
+  uint32_t dropped;
+  Check(client.Connect(CHANNEL_NAME) && ReadFrame(client, 2000, &dropped),
+        "client gets frames");
+  Check(client.GetCameraState() == PS3EYE_CAMERA_OK, "camera state ok");
+
+  Outage stall = Unplug(camera, client, 0);
+  Check(stall.detected && stall.recovered, "stall recovered");
+  Check(stall.outageMs < 500, "stall recovered within 500 ms");
+
+  Outage brief = Unplug(camera, client, 200);
+  Check(brief.detected && brief.recovered, "brief unplug recovered");
+  Check(brief.outageMs < 1000, "brief unplug recovered within 1 s");
+  Check(brief.dropped > 0, "outage reported as dropped frames");
+
+  Outage lengthy = Unplug(camera, client, 2000);
+  Check(lengthy.detected && lengthy.recovered, "long unplug recovered");
+  Check(lengthy.outageMs < 2000 + 1000,
+        "long unplug recovered within 1 s of replug");
+
+  PS3EyeCaptureStats stats;
+  channel.GetStats(&stats);
+  Check(stats.recoveries == 3, "three recoveries counted");
+  Check(stats.coldStarts == 1, "recoveries are not counted as starts");
+  Check(stats.state == PS3EyeCaptureState::Streaming, "streaming again");
+
+  // Lost with nobody connected, before the standby delay: closed, and left
+  // closed after the camera is back
+  client.Disconnect();
+  camera->Unplug(200);
+  for (int i = 0; i < 200 && stats.state != PS3EyeCaptureState::Closed; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    channel.GetStats(&stats);
+  }
+  Check(stats.state == PS3EyeCaptureState::Closed, "idle loss closes");
+  std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+  channel.GetStats(&stats);
+  Check(stats.state == PS3EyeCaptureState::Closed,
+        "idle loss is not reopened without clients");
+
+  Check(client.Connect(CHANNEL_NAME) && ReadFrame(client, 2000, &dropped),
+        "next client reopens the camera");
+  Check(client.GetCameraState() == PS3EYE_CAMERA_OK, "camera state ok again");
+  channel.GetStats(&stats);
+  Check(stats.coldStarts == 2 && stats.recoveries == 3,
+        "reopened as a cold start, not a recovery");
+
+  client.Disconnect();
+  channel.Stop();
+  return TestResult();
+}
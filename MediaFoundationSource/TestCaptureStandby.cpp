@@ -0,0 +1,113 @@
+// TestCaptureStandby.cpp - Checks the warm-standby state machine of
+// PS3EyeCaptureChannel against a synthetic camera with a slow open (like USB
+// enumeration plus sensor init) and a fast start:
+//   - a client that leaves and comes back within the standby delay never
+//     stops the stream,
+//   - after the standby delay the camera stops but stays open, and the next
+//     client gets a warm start,
+//   - after the close delay the camera is released.
+// Prints cold and warm time-to-first-frame.
+//   g++ -std=c++17 -O2 -pthread TestCaptureStandby.cpp
+//      PS3EyeCaptureChannel.cpp PS3EyeFrameCadence.cpp
+//      PS3EyeSyntheticCamera.cpp PS3EyeSharedMemory.cpp
+//      PS3EyeChannelDirectory.cpp PS3EyeIpcPosix.cpp -lrt -o TestCaptureStandby
+//   cl /EHsc /O2 /std:c++17 TestCaptureStandby.cpp PS3EyeCaptureChannel.cpp
+//      PS3EyeFrameCadence.cpp PS3EyeSyntheticCamera.cpp PS3EyeSharedMemory.cpp
+//      PS3EyeChannelDirectory.cpp PS3EyeIpcWin32.cpp advapi32.lib
+
+#include "PS3EyeCaptureChannel.h"
+#include "PS3EyeSharedMemory.h"
+#include "PS3EyeSyntheticCamera.h"
+#include "PS3EyeTestCheck.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+static const uint32_t OPEN_MS = 300;
+static const uint32_t START_MS = 5;
+static const uint32_t STANDBY_DELAY_MS = 400;
+static const uint32_t CLOSE_DELAY_MS = 1500;
+
+static void SleepMs(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// Connect and wait for the first frame
+static bool ConnectAndRead(PS3EyeSharedMemoryClient &client) {
+  if (!client.Connect())
+    return false;
+  PS3EyeFrameView frame;
+  for (int i = 0; i < 20; i++) {
+    if (client.WaitForFrame(100) && client.AcquireFrame(&frame)) {
+      client.ReleaseFrame(&frame);
+      return true;
+    }
+  }
+  return false;
+}
+
+int main() {
+  std::unique_ptr<PS3EyeSyntheticCamera> camera(
+      new PS3EyeSyntheticCamera("synthetic-0"));
+  camera->SetLatency(OPEN_MS, START_MS);
+
+  PS3EyeCaptureChannel channel(std::move(camera), PS3EYE_SHARED_MEMORY_NAME);
+  PS3EyeCaptureOptions options;
+  options.fps = 60;
+  options.standbyDelayMs = STANDBY_DELAY_MS;
+  options.closeDelayMs = CLOSE_DELAY_MS;
+  if (!channel.Start(options)) {
+    printf("Failed to start channel\n");
+    return 1;
+  }
+
+  PS3EyeCaptureStats stats;
+  channel.GetStats(&stats);
+  Check(stats.state == PS3EyeCaptureState::Closed, "closed until a client");
+
+  // Cold start
+  PS3EyeSharedMemoryClient client;
+  Check(ConnectAndRead(client), "first client gets frames");
+  channel.GetStats(&stats);
+  Check(stats.coldStarts == 1 && stats.warmStarts == 0, "cold start");
+
+  // Quick reconnect stays within the hysteresis window
+  client.Disconnect();
+  SleepMs(STANDBY_DELAY_MS / 4);
+  channel.GetStats(&stats);
+  Check(stats.state == PS3EyeCaptureState::Streaming,
+        "still streaming right after the client left");
+  Check(ConnectAndRead(client), "reconnecting client gets frames");
+  channel.GetStats(&stats);
+  Check(stats.coldStarts == 1 && stats.warmStarts == 0,
+        "quick reconnect did not restart the stream");
+
+  // Standby
+  client.Disconnect();
+  SleepMs(STANDBY_DELAY_MS + 300);
+  channel.GetStats(&stats);
+  Check(stats.state == PS3EyeCaptureState::Standby,
+        "standby after the standby delay");
+
+  // Warm start
+  Check(ConnectAndRead(client), "client after standby gets frames");
+  channel.GetStats(&stats);
+  Check(stats.coldStarts == 1 && stats.warmStarts == 1, "warm start");
+  Check(stats.warmTimeToFirstFrame < stats.coldTimeToFirstFrame,
+        "warm start is faster than cold start");
+  printf("time to first frame: cold %.1f ms, warm %.1f ms\n",
+         stats.coldTimeToFirstFrame / 10000.0,
+         stats.warmTimeToFirstFrame / 10000.0);
+
+  // Released after the close delay
+  client.Disconnect();
+  SleepMs(CLOSE_DELAY_MS + 800);
+  channel.GetStats(&stats);
+  Check(stats.state == PS3EyeCaptureState::Closed,
+        "closed after the close delay");
+
+  channel.Stop();
+  return TestResult();
+}
@@ -0,0 +1,224 @@
+// TestFrameAssembler.cpp - Replays generated bulk payload streams through
+// PS3EyeFrameAssembler and checks what comes out:
+//   - a clean stream yields every frame, whole and stamped with the transfer
+//     that completed it, and survives a round trip through a .ps3u file,
+//   - each kind of malformed payload (lost, flagged ERR, bad header, no PTS,
+//     duplicated, lost EOF, stream joined mid-frame) costs exactly the frame
+//     it hit and is counted, and the frames after it come through whole,
+//   - seeded random faults reproduce the same result on every run,
+//   - replay at wire speed keeps the recorded pace.
+//   g++ -std=c++17 -O2 -pthread TestFrameAssembler.cpp
+//      PS3EyeFrameAssembler.cpp PS3EyePacketCapture.cpp
+//      PS3EyeFrameMailbox.cpp -o TestFrameAssembler
+//   cl /EHsc /O2 /std:c++17 TestFrameAssembler.cpp PS3EyeFrameAssembler.cpp
+//      PS3EyePacketCapture.cpp PS3EyeFrameMailbox.cpp
+
+#include "PS3EyeFrameAssembler.h"
+#include "PS3EyePacketCapture.h"
+#include "PS3EyeTestCheck.h"
+
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+static const uint32_t WIDTH = 320;
+static const uint32_t HEIGHT = 240;
+static const uint32_t FPS = 60;
+static const int64_t PERIOD = 10000000 / FPS;
+
+struct Result {
+  PS3EyeAssemblerStats stats;
+  uint32_t whole;  // Frames matching the pattern of the frame they claim
+  uint32_t broken; // Frames that do not
+};
+
+// The last transfer of frame n completes at (n + 1) periods, which is also
+// the time the frame is published with
+static bool Whole(const PS3EyeFrameMailbox::Frame &frame) {
+  const uint64_t n = static_cast<uint64_t>(frame.time / PERIOD) - 1;
+  for (uint32_t y = 0; y < HEIGHT; y++) {
+    for (uint32_t x = 0; x < WIDTH; x++) {
+      if (frame.data[y * WIDTH + x] != PS3EyeSyntheticPixel(x, y, n))
+        return false;
+    }
+  }
+  return true;
+}
+
+// Replay transfer by transfer, taking each frame as soon as it is published
+static Result Replay(const PS3EyePacketCapture &capture) {
+  PS3EyeFrameMailbox mailbox;
+  mailbox.Open(capture.FrameSize());
+  PS3EyeFrameAssembler assembler(capture.FrameSize(), &mailbox);
+  Result result = {};
+  for (const PS3EyePacketCapture::Transfer &transfer : capture.Transfers()) {
+    assembler.Feed(capture.Data(transfer), transfer.length, transfer.time);
+    PS3EyeFrameMailbox::Frame frame;
+    if (mailbox.Take(&frame, 0)) {
+      if (Whole(frame))
+        result.whole++;
+      else
+        result.broken++;
+    }
+  }
+  result.stats = assembler.Stats();
+  return result;
+}
+
+static PS3EyePacketCapture CleanCapture(uint32_t frames) {
+  PS3EyePacketCapture capture;
+  capture.Reset(WIDTH, HEIGHT, FPS);
+  PS3EyeSynthesizePackets(&capture, frames);
+  return capture;
+}
+
+static void CheckClean() {
+  PS3EyePacketCapture capture = CleanCapture(10);
+  Result result = Replay(capture);
+  const PS3EyeAssemblerStats &stats = result.stats;
+  Check(stats.frames == 10 && result.whole == 10, "clean stream: all whole");
+  Check(stats.unterminated == 0 && stats.shortFrames == 0 &&
+            stats.overflows == 0 && stats.badHeaders == 0 &&
+            stats.errorPayloads == 0 && stats.missingPts == 0,
+        "clean stream: no faults counted");
+  // 37 full payloads and a short EOF one per frame, 8 to a transfer
+  Check(stats.payloads == 10 * 38 && stats.transfers == 10 * 5,
+        "payloads packed into transfers like the host controller does");
+
+  const char *path = "TestFrameAssembler.ps3u";
+  PS3EyePacketCapture loaded;
+  Check(capture.Save(path) && loaded.Load(path) &&
+            loaded.Bytes() == capture.Bytes() &&
+            loaded.Width() == WIDTH && loaded.Fps() == FPS &&
+            Replay(loaded).whole == 10,
+        "capture file round trip");
+  remove(path);
+}
+
+typedef std::vector<std::vector<uint8_t>> Payloads;
+
+// Five frames, the third one mangled
+static Result Malformed(const std::function<void(Payloads &)> &mangle) {
+  PS3EyePacketCapture capture;
+  capture.Reset(WIDTH, HEIGHT, FPS);
+  std::vector<uint8_t> frame(capture.FrameSize());
+  for (uint64_t n = 0; n < 5; n++) {
+    for (uint32_t y = 0; y < HEIGHT; y++) {
+      for (uint32_t x = 0; x < WIDTH; x++)
+        frame[y * WIDTH + x] = PS3EyeSyntheticPixel(x, y, n);
+    }
+    Payloads payloads = PS3EyePacketizeFrame(
+        frame.data(), capture.FrameSize(), static_cast<uint32_t>(n + 1),
+        (n & 1) != 0);
+    if (n == 2)
+      mangle(payloads);
+    capture.AddPayloads(payloads, static_cast<int64_t>(n) * PERIOD, PERIOD);
+  }
+  return Replay(capture);
+}
+
+static void CheckMalformed() {
+  Result lost = Malformed([](Payloads &p) { p.erase(p.begin() + 10); });
+  Check(lost.stats.shortFrames == 1 && lost.whole == 4 && lost.broken == 0,
+        "lost payload: frame discarded as short");
+
+  Result error =
+      Malformed([](Payloads &p) { p[10][1] |= PS3EYE_PAYLOAD_ERR; });
+  Check(error.stats.errorPayloads == 1 && error.whole == 4 &&
+            error.broken == 0,
+        "ERR payload: frame discarded");
+
+  Result header = Malformed([](Payloads &p) { p[10][0] = 0; });
+  Check(header.stats.badHeaders == 1 && header.whole == 4 &&
+            header.broken == 0,
+        "bad header: frame discarded");
+
+  Result noPts = Malformed(
+      [](Payloads &p) { p[10][1] &= ~PS3EYE_PAYLOAD_PTS; });
+  Check(noPts.stats.missingPts == 1 && noPts.whole == 4 &&
+            noPts.broken == 0,
+        "payload without PTS: frame discarded");
+
+  Result duplicate =
+      Malformed([](Payloads &p) { p.insert(p.begin() + 10, p[10]); });
+  Check(duplicate.stats.overflows == 1 && duplicate.whole == 4 &&
+            duplicate.broken == 0,
+        "duplicated payload: frame discarded as overflowing");
+
+  Result joined = Malformed(
+      [](Payloads &p) { p.erase(p.begin(), p.begin() + 10); });
+  Check(joined.stats.shortFrames == 1 && joined.whole == 4,
+        "stream joined mid-frame: partial frame discarded");
+
+  // The driver publishes a frame whose EOF never came once the next one
+  // starts; it is short, so the tail is an older frame's
+  Result eof = Malformed([](Payloads &p) { p.pop_back(); });
+  Check(eof.stats.unterminated == 1 && eof.stats.frames == 5 &&
+            eof.whole == 4 && eof.broken == 1,
+        "lost EOF: frame published short, as the driver does");
+}
+
+static void CheckSeededFaults() {
+  PS3EyePacketFaults faults;
+  faults.dropPerMille = 1;
+  faults.errorPerMille = 1;
+  faults.badHeaderPerMille = 1;
+  faults.noPtsPerMille = 1;
+  faults.seed = 5;
+
+  PS3EyePacketCapture first, second;
+  first.Reset(WIDTH, HEIGHT, FPS);
+  second.Reset(WIDTH, HEIGHT, FPS);
+  PS3EyeSynthesizePackets(&first, 200, faults);
+  PS3EyeSynthesizePackets(&second, 200, faults);
+  Result a = Replay(first), b = Replay(second);
+  Check(memcmp(&a.stats, &b.stats, sizeof(a.stats)) == 0 &&
+            a.whole == b.whole,
+        "same seed reproduces the same faults");
+  printf("200 frames with faults: %u whole, %u broken, %llu short, "
+         "%llu ERR, %llu bad header, %llu without PTS\n",
+         a.whole, a.broken,
+         static_cast<unsigned long long>(a.stats.shortFrames),
+         static_cast<unsigned long long>(a.stats.errorPayloads),
+         static_cast<unsigned long long>(a.stats.badHeaders),
+         static_cast<unsigned long long>(a.stats.missingPts));
+  Check(a.whole < 200 && a.whole > 150, "faults cost some frames");
+  Check(a.broken == a.stats.unterminated,
+        "only frames cut off without EOF come out broken");
+
+  faults.seed = 6;
+  PS3EyePacketCapture third;
+  third.Reset(WIDTH, HEIGHT, FPS);
+  PS3EyeSynthesizePackets(&third, 200, faults);
+  Result c = Replay(third);
+  Check(memcmp(&a.stats, &c.stats, sizeof(a.stats)) != 0,
+        "another seed differs");
+}
+
+static void CheckPacing() {
+  PS3EyePacketCapture capture = CleanCapture(30); // 0.5 s at 60 fps
+  PS3EyeFrameMailbox mailbox;
+  mailbox.Open(capture.FrameSize());
+  PS3EyeFrameAssembler assembler(capture.FrameSize(), &mailbox);
+  const int64_t recorded = capture.Transfers().back().time -
+                           capture.Transfers().front().time;
+  const int64_t wire = PS3EyeReplayPackets(capture, &assembler, 1.0);
+  assembler.Reset();
+  const int64_t fast = PS3EyeReplayPackets(capture, &assembler, 0);
+  printf("replay of %.0f ms: %.1f ms at wire speed, %.2f ms flat out\n",
+         recorded / 10000.0, wire / 10000.0, fast / 10000.0);
+  Check(wire >= recorded && wire < recorded + 500000,
+        "wire speed keeps the recorded pace");
+  Check(fast * 10 < wire, "flat out is much faster than wire speed");
+  Check(assembler.Stats().frames == 30, "every frame assembled");
+}
+
+int main() {
+  CheckClean();
+  CheckMalformed();
+  CheckSeededFaults();
+  CheckPacing();
+
+  return TestResult();
+}
@@ -0,0 +1,128 @@
+// TestFrameCadence.cpp - Checks the frame cadence estimate on simulated
+// arrivals: a camera whose crystal runs off nominal, frames that arrive up to
+// 2 ms late, at 30 and 187 fps. The period must come out within 10 ppm,
+// the fitted line must sit on the arrivals with the jitter averaged out, and
+// frames must be numbered as the camera counted them, across lost frames.
+// A frame late by over a quarter period is kept out of the fit, and a
+// cadence that moves is locked again within RELOCK_FRAMES frames.
+//   g++ -std=c++14 -O2 TestFrameCadence.cpp PS3EyeFrameCadence.cpp
+//      -o TestFrameCadence
+//   cl /EHsc /O2 TestFrameCadence.cpp PS3EyeFrameCadence.cpp
+
+#include "PS3EyeFrameCadence.h"
+#include "PS3EyeTestCheck.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+// Frame n of a camera that starts at start and runs at period, 100ns
+static int64_t CameraTime(int64_t start, double period, uint64_t n) {
+  return start + static_cast<int64_t>(std::llround(n * period));
+}
+
+static void CheckDrift(int64_t nominal, double ppm) {
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int64_t> jitter(0, 20000); // Up to 2 ms late
+  const double period = nominal * (1 + ppm / 1e6);
+  const int64_t start = 123456789;
+  PS3EyeFrameCadence cadence(nominal);
+
+  bool numbered = true;
+  const uint64_t frames = 3000;
+  for (uint64_t n = 0; n < frames; n++) {
+    const uint64_t frame =
+        cadence.AddFrame(CameraTime(start, period, n) + jitter(rng));
+    numbered = numbered && frame == n;
+  }
+
+  char what[96];
+  snprintf(what, sizeof(what), "%.0f fps: frames numbered in order",
+           1e7 / nominal);
+  Check(numbered, what);
+  snprintf(what, sizeof(what), "%.0f fps: %+.0f ppm measured as %+.1f ppm",
+           1e7 / nominal, ppm, cadence.DriftPpm());
+  Check(cadence.Locked() && std::fabs(cadence.DriftPpm() - ppm) < 10, what);
+  // The jitter is 1 ms late on average, which the line keeps
+  const double error = cadence.FrameTime(frames - 1) -
+                       (CameraTime(start, period, frames - 1) + 10000.0);
+  snprintf(what, sizeof(what), "%.0f fps: line %+.0f us off the arrivals",
+           1e7 / nominal, error / 10);
+  Check(std::fabs(error) < 1000, what);
+}
+
+static void CheckLostFrames() {
+  const int64_t nominal = 333333;
+  PS3EyeFrameCadence cadence(nominal);
+  // Frames 40, 80 to 82 and 200 never arrive
+  bool numbered = true;
+  for (uint64_t n = 0; n < 300; n++) {
+    if (n == 40 || (n >= 80 && n <= 82) || n == 200)
+      continue;
+    numbered = numbered && cadence.AddFrame(CameraTime(0, nominal, n)) == n;
+  }
+  Check(numbered, "lost frames are counted");
+  Check(cadence.Locked() && std::fabs(cadence.DriftPpm()) < 1,
+        "lost frames do not bend the line");
+}
+
+static void CheckLateFrame() {
+  const int64_t nominal = 333333;
+  PS3EyeFrameCadence cadence(nominal);
+  for (uint64_t n = 0; n < 100; n++)
+    cadence.AddFrame(CameraTime(0, nominal, n));
+  // Scheduled late by 40% of a period: same number, not in the fit
+  Check(cadence.AddFrame(CameraTime(0, nominal, 100) + nominal * 4 / 10) ==
+            100,
+        "late frame keeps its number");
+  Check(cadence.FrameTime(100) == CameraTime(0, nominal, 100),
+        "late frame stays out of the fit");
+  for (uint64_t n = 101; n < 120; n++)
+    Check(cadence.AddFrame(CameraTime(0, nominal, n)) == n,
+          "frames after a late one keep their numbers");
+}
+
+static void CheckRelock() {
+  const int64_t nominal = 333333;
+  PS3EyeFrameCadence cadence(nominal);
+  for (uint64_t n = 0; n < 100; n++)
+    cadence.AddFrame(CameraTime(0, nominal, n));
+  const uint32_t epoch = cadence.Epoch();
+
+  // The sensor restarts 0.3 periods later, which is off the line for good
+  const int64_t shift = nominal * 3 / 10;
+  uint64_t frame = 0;
+  for (uint64_t n = 100; n < 100 + PS3EyeFrameCadence::RELOCK_FRAMES +
+                                 PS3EyeFrameCadence::LOCK_FRAMES;
+       n++)
+    frame = cadence.AddFrame(CameraTime(shift, nominal, n));
+  Check(cadence.Epoch() == epoch + 1, "moved cadence locks again");
+  Check(frame == 100 + PS3EyeFrameCadence::RELOCK_FRAMES +
+                     PS3EyeFrameCadence::LOCK_FRAMES - 1,
+        "frames numbered on through the relock");
+  Check(std::llabs(cadence.FrameTime(frame) -
+                   CameraTime(shift, nominal, frame)) < 10,
+        "line follows the moved cadence");
+}
+
+static void CheckReset() {
+  PS3EyeFrameCadence cadence(333333);
+  for (uint64_t n = 0; n < 50; n++)
+    cadence.AddFrame(CameraTime(0, 333333, n));
+  cadence.Reset(53475);
+  Check(!cadence.Locked() && cadence.Period() == 53475,
+        "reset forgets the old cadence");
+  Check(cadence.AddFrame(999999999) == 0, "reset numbers from 0");
+}
+
+int main() {
+  CheckDrift(333333, 150);  // 30 fps
+  CheckDrift(333333, -80);
+  CheckDrift(53475, 250);   // 187 fps
+  CheckLostFrames();
+  CheckLateFrame();
+  CheckRelock();
+  CheckReset();
+
+  return TestResult();
+}
@@ -0,0 +1,181 @@
+// TestFrameMailbox.cpp - Checks the latest-frame mailbox against a
+// deliberately slow consumer, standing in for a renderer or encoder that
+// lags: a capture thread publishes frames every 2 ms while the consumer
+// takes one every 10 ms. Every frame taken must be whole and fresh (no
+// older than the newest published when it was taken), and every frame must
+// be either taken or counted as skipped, with the gap reported on the frame
+// after it. A consumer that keeps up must skip nothing, and Close must wake
+// a waiting consumer. Also checks that PS3EyeFrameSkipper skips the frames
+// a late message covers and thins the rate to the proportion asked for.
+//   g++ -std=c++14 -O2 -pthread TestFrameMailbox.cpp PS3EyeFrameMailbox.cpp
+//      -o TestFrameMailbox
+//   cl /EHsc /O2 TestFrameMailbox.cpp PS3EyeFrameMailbox.cpp
+
+#include "PS3EyeFrameMailbox.h"
+#include "PS3EyeTestCheck.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+static const size_t FRAME_SIZE = 640 * 480;
+
+// Publishes frames 1..count, period apart, each filled with its number
+static void Produce(PS3EyeFrameMailbox *mailbox, uint64_t count,
+                    std::chrono::microseconds period,
+                    std::atomic<uint64_t> *published) {
+  auto next = std::chrono::steady_clock::now();
+  for (uint64_t n = 1; n <= count; n++) {
+    std::this_thread::sleep_until(next);
+    next += period;
+    memset(mailbox->BeginWrite(), static_cast<int>(n & 0xFF), FRAME_SIZE);
+    mailbox->EndWrite(n, static_cast<int64_t>(n) * 1000);
+    published->store(n);
+  }
+}
+
+static bool Whole(const PS3EyeFrameMailbox::Frame &frame) {
+  const uint8_t value = static_cast<uint8_t>(frame.number & 0xFF);
+  for (size_t i = 0; i < FRAME_SIZE; i++) {
+    if (frame.data[i] != value)
+      return false;
+  }
+  return true;
+}
+
+// Takes frames, spending consumeTime on each, until the producer is done;
+// returns the frames taken
+static uint64_t Consume(PS3EyeFrameMailbox *mailbox, uint64_t count,
+                        std::chrono::microseconds consumeTime,
+                        const std::atomic<uint64_t> *published,
+                        uint64_t *skippedReported) {
+  uint64_t taken = 0, last = 0;
+  bool whole = true, fresh = true, gapsReported = true;
+  *skippedReported = 0;
+  while (last < count) {
+    PS3EyeFrameMailbox::Frame frame;
+    const uint64_t newest = published->load();
+    if (!mailbox->Take(&frame, 1000))
+      break;
+    taken++;
+    whole = whole && Whole(frame);
+    // The frame taken may only be the newest, or one published since
+    fresh = fresh && frame.number >= newest;
+    gapsReported = gapsReported && frame.skipped == frame.number - last - 1;
+    *skippedReported += frame.skipped;
+    last = frame.number;
+    std::this_thread::sleep_for(consumeTime);
+  }
+  Check(whole, "frames taken are whole");
+  Check(fresh, "frames taken are the freshest");
+  Check(gapsReported, "skipped frames are reported on the next frame");
+  return taken;
+}
+
+static void CheckSlowConsumer() {
+  PS3EyeFrameMailbox mailbox;
+  mailbox.Open(FRAME_SIZE);
+  const uint64_t count = 500;
+  std::atomic<uint64_t> published(0);
+  std::thread producer(Produce, &mailbox, count,
+                       std::chrono::microseconds(2000), &published);
+  uint64_t skippedReported;
+  const uint64_t taken = Consume(&mailbox, count,
+                                 std::chrono::microseconds(10000),
+                                 &published, &skippedReported);
+  producer.join();
+
+  printf("slow consumer: %llu of %llu frames taken, %llu skipped\n",
+         static_cast<unsigned long long>(taken),
+         static_cast<unsigned long long>(count),
+         static_cast<unsigned long long>(mailbox.Skipped()));
+  Check(taken + mailbox.Skipped() == count,
+        "every frame is taken or counted as skipped");
+  Check(skippedReported == mailbox.Skipped(),
+        "skips reported per frame add up to the total");
+  Check(mailbox.Skipped() > count / 2, "a slow consumer skips frames");
+}
+
+static void CheckFastConsumer() {
+  PS3EyeFrameMailbox mailbox;
+  mailbox.Open(FRAME_SIZE);
+  const uint64_t count = 100;
+  std::atomic<uint64_t> published(0);
+  std::thread producer(Produce, &mailbox, count,
+                       std::chrono::microseconds(10000), &published);
+  uint64_t skippedReported;
+  const uint64_t taken = Consume(&mailbox, count, std::chrono::microseconds(0),
+                                 &published, &skippedReported);
+  producer.join();
+  Check(taken == count && mailbox.Skipped() == 0,
+        "a consumer that keeps up skips nothing");
+}
+
+static void CheckClose() {
+  PS3EyeFrameMailbox mailbox;
+  mailbox.Open(FRAME_SIZE);
+  std::thread closer([&mailbox] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    mailbox.Close();
+  });
+  PS3EyeFrameMailbox::Frame frame;
+  const auto start = std::chrono::steady_clock::now();
+  const bool took = mailbox.Take(&frame, 5000);
+  const auto waited = std::chrono::steady_clock::now() - start;
+  closer.join();
+  Check(!took && waited < std::chrono::seconds(1),
+        "close wakes a waiting consumer");
+  Check(mailbox.IsClosed(), "closed");
+}
+
+static void CheckSkipper() {
+  const int64_t period = 166667; // 60 fps
+  PS3EyeFrameSkipper skipper(period);
+  Check(skipper.Deliver() && skipper.Deliver(), "delivers every frame");
+
+  // 2.5 periods late: the next 3 frames go
+  skipper.Notify(period * 5 / 2, 1000);
+  bool skippedLate = !skipper.Deliver() && !skipper.Deliver() &&
+                     !skipper.Deliver();
+  Check(skippedLate && skipper.Deliver(), "late message skips its frames");
+
+  // Early messages skip nothing
+  skipper.Notify(-period, 1000);
+  Check(skipper.Deliver(), "early message skips nothing");
+
+  // Half the rate: every other frame
+  skipper.Notify(0, 500);
+  uint32_t delivered = 0;
+  for (int i = 0; i < 100; i++)
+    delivered += skipper.Deliver() ? 1 : 0;
+  Check(delivered == 50, "proportion thins the rate");
+
+  // Back to full rate, and more than full rate is full rate
+  skipper.Notify(0, 2000);
+  delivered = 0;
+  for (int i = 0; i < 10; i++)
+    delivered += skipper.Deliver() ? 1 : 0;
+  Check(delivered == 10, "full proportion delivers every frame");
+  Check(skipper.Skipped() == 3 + 50, "skips are counted");
+
+  // A huge lateness skips at most a second of frames
+  skipper.Notify(period * 1000, 1000);
+  uint32_t skipped = 0;
+  while (!skipper.Deliver())
+    skipped++;
+  Check(skipped == 10000000 / period, "skips at most a second");
+
+  skipper.Reset(period);
+  Check(skipper.Skipped() == 0 && skipper.Deliver(), "reset");
+}
+
+int main() {
+  CheckSlowConsumer();
+  CheckFastConsumer();
+  CheckClose();
+  CheckSkipper();
+
+  return TestResult();
+}
@@ -0,0 +1,168 @@
+// TestFrameReader.cpp - Checks that PS3EyeFrameReader keeps every wait on a
+// blocking frame source bounded. The source stands in for the driver's
+// getFrame: it either delivers a frame every few milliseconds or, like a
+// camera pulled off the bus, blocks until the test lets it go. Frames must
+// come through whole and in order; against a source that never delivers,
+// Take must time out on time and return at once on Interrupt, and Stop must
+// give up after its timeout instead of hanging. The reader must then refuse
+// to Start again until the blocked thread has returned, released what the
+// source holds and been joined.
+//   g++ -std=c++14 -O2 -pthread TestFrameReader.cpp PS3EyeFrameReader.cpp
+//      -o TestFrameReader
+//   cl /EHsc /O2 TestFrameReader.cpp PS3EyeFrameReader.cpp
+
+#include "PS3EyeFrameReader.h"
+#include "PS3EyeTestCheck.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+static const size_t FRAME_SIZE = 640 * 480;
+
+typedef std::chrono::steady_clock Clock;
+
+static int64_t ElapsedMs(Clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() -
+                                                               since)
+      .count();
+}
+
+// A source that blocks until released, as getFrame does with no transfers
+// completing
+struct Gate {
+  std::mutex mutex;
+  std::condition_variable opened;
+  bool open = false;
+  std::atomic<bool> blocked{false};
+
+  void Open() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      open = true;
+    }
+    opened.notify_all();
+  }
+};
+
+static void CheckDelivering() {
+  PS3EyeFrameReader reader;
+  std::atomic<uint32_t> reads(0);
+  const bool started = reader.Start(
+      [&reads](uint8_t *buffer) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        const uint32_t n = ++reads;
+        memset(buffer, static_cast<uint8_t>(n), FRAME_SIZE);
+        return static_cast<int64_t>(n);
+      },
+      FRAME_SIZE);
+  Check(started, "delivering source: Start");
+
+  std::unique_ptr<uint8_t[]> frame(new uint8_t[FRAME_SIZE]);
+  int64_t last = 0;
+  uint32_t taken = 0;
+  bool whole = true, ordered = true;
+  for (int i = 0; i < 50; i++) {
+    int64_t time;
+    if (reader.Take(frame.get(), 100, &time) !=
+        PS3EyeFrameReader::Result::Frame)
+      continue;
+    taken++;
+    ordered = ordered && time > last;
+    last = time;
+    for (size_t j = 0; j < FRAME_SIZE; j += 4096)
+      whole = whole && frame[j] == static_cast<uint8_t>(time);
+  }
+  Check(taken == 50, "delivering source: every Take gets a frame");
+  Check(ordered, "delivering source: frames in order");
+  Check(whole, "delivering source: frames whole");
+
+  const Clock::time_point start = Clock::now();
+  Check(reader.Stop(1000), "delivering source: Stop waits out the read");
+  Check(ElapsedMs(start) < 100, "delivering source: Stop within a read");
+  const uint32_t afterStop = reads;
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  Check(reads == afterStop, "no reads after Stop returned true");
+  int64_t time;
+  Check(reader.Take(frame.get(), 0, &time) ==
+            PS3EyeFrameReader::Result::Stopped,
+        "Take after Stop");
+}
+
+static void CheckBlocked() {
+  Gate gate;
+  // Stands in for the device the read function keeps alive
+  std::shared_ptr<int> device = std::make_shared<int>(0);
+  std::weak_ptr<int> watch = device;
+
+  PS3EyeFrameReader reader;
+  reader.Start(
+      [&gate, device](uint8_t *) {
+        std::unique_lock<std::mutex> lock(gate.mutex);
+        gate.blocked = true;
+        gate.opened.wait(lock, [&gate] { return gate.open; });
+        return static_cast<int64_t>(0);
+      },
+      FRAME_SIZE);
+  device.reset();
+  while (!gate.blocked)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  std::unique_ptr<uint8_t[]> frame(new uint8_t[FRAME_SIZE]);
+  int64_t time;
+  Clock::time_point start = Clock::now();
+  Check(reader.Take(frame.get(), 50, &time) ==
+            PS3EyeFrameReader::Result::Timeout,
+        "blocked source: Take times out");
+  const int64_t waited = ElapsedMs(start);
+  Check(waited >= 45 && waited < 250, "blocked source: Take waits its timeout");
+
+  std::thread interrupter([&reader] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    reader.Interrupt();
+  });
+  start = Clock::now();
+  Check(reader.Take(frame.get(), 5000, &time) ==
+            PS3EyeFrameReader::Result::Interrupted,
+        "blocked source: Interrupt wakes Take");
+  Check(ElapsedMs(start) < 1000, "blocked source: Take returns on Interrupt");
+  interrupter.join();
+  Check(reader.Take(frame.get(), 10, &time) ==
+            PS3EyeFrameReader::Result::Timeout,
+        "Interrupt wakes one Take only");
+
+  reader.Interrupt();
+  Check(reader.Take(frame.get(), 5000, &time) ==
+            PS3EyeFrameReader::Result::Interrupted,
+        "Interrupt before Take is not lost");
+
+  start = Clock::now();
+  Check(!reader.Stop(50), "blocked source: Stop gives up");
+  Check(ElapsedMs(start) < 250, "blocked source: Stop waits its timeout");
+  Check(!watch.expired(), "blocked thread keeps the device");
+  Check(!reader.Start([](uint8_t *) { return static_cast<int64_t>(1); },
+                      FRAME_SIZE),
+        "no Start while the blocked thread is in read");
+  Check(!reader.Stop(10), "Stop again while still blocked");
+
+  // Once the source returns, the blocked thread exits and lets go
+  gate.Open();
+  Check(reader.Stop(1000), "Stop joins the thread once read returns");
+  Check(watch.expired(), "joined thread has released the device");
+  Check(reader.Start([](uint8_t *) { return static_cast<int64_t>(1); },
+                     FRAME_SIZE),
+        "Start again once the thread is joined");
+  reader.Stop(1000);
+}
+
+int main() {
+  CheckDelivering();
+  CheckBlocked();
+
+  return TestResult();
+}
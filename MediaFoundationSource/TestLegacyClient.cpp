@@ -0,0 +1,73 @@
+// TestLegacyClient.cpp - Checks, on Windows, that a v1 tool still wakes the
+// capture service. A server on the default channel creates the unscoped
+// objects v1 tools look for; a client that connects the way TestClient.cpp
+// does (InterlockedIncrement on clientCount, then SetEvent on
+// PS3EyeClientEvent) must end the server's WaitForClients at once rather
+// than at its timeout. Windows only: the legacy objects are Win32 names.
+//   cl /EHsc /O2 /std:c++17 TestLegacyClient.cpp PS3EyeSharedMemory.cpp
+//      PS3EyeChannelDirectory.cpp PS3EyeIpcWin32.cpp advapi32.lib
+// The capture service must not be running (it owns the shared memory name).
+
+#include "PS3EyeSharedMemory.h"
+#include "PS3EyeTestCheck.h"
+
+#include <windows.h>
+
+#include <cstdio>
+#include <thread>
+
+static const uint32_t WAIT_MS = 5000;
+static const uint32_t CONNECT_AFTER_MS = 100;
+
+// What a v1 tool does on connect: count itself in the header, then set the
+// unscoped client event
+static bool ConnectV1() {
+  HANDLE mapping =
+      OpenFileMappingA(FILE_MAP_WRITE, FALSE, PS3EYE_SHARED_MEMORY_NAME);
+  if (!mapping)
+    return false;
+  PS3EyeFrameHeader *header = static_cast<PS3EyeFrameHeader *>(
+      MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(PS3EyeFrameHeader)));
+  HANDLE event = OpenEventW(EVENT_MODIFY_STATE, FALSE, L"PS3EyeClientEvent");
+  const bool ok = header && event;
+  if (ok) {
+    InterlockedIncrement(
+        reinterpret_cast<volatile LONG *>(&header->clientCount));
+    SetEvent(event);
+  }
+  if (event)
+    CloseHandle(event);
+  if (header)
+    UnmapViewOfFile(header);
+  CloseHandle(mapping);
+  return ok;
+}
+
+int main() {
+  PS3EyeSharedMemoryServer server;
+  if (!server.Create()) {
+    printf("Failed to create the default channel "
+           "(is the capture service running?)\n");
+    return 1;
+  }
+  Check(!server.WaitForClients(0), "no clients before the v1 tool connects");
+
+  bool connected = false;
+  std::thread client([&connected] {
+    Sleep(CONNECT_AFTER_MS);
+    connected = ConnectV1();
+  });
+
+  const ULONGLONG start = GetTickCount64();
+  const bool woken = server.WaitForClients(WAIT_MS);
+  const ULONGLONG waited = GetTickCount64() - start;
+  client.join();
+
+  printf("WaitForClients returned after %llu ms\n", waited);
+  Check(connected, "v1 tool finds the mapping and PS3EyeClientEvent");
+  Check(woken, "v1 tool counted as a client");
+  Check(waited < WAIT_MS / 2, "PS3EyeClientEvent wakes WaitForClients");
+
+  server.Close();
+  return TestResult();
+}
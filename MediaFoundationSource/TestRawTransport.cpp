@@ -0,0 +1,209 @@
+// TestRawTransport.cpp - Checks raw Bayer channels end to end: a capture
+// channel publishing PS3EYE_FORMAT_BAYER_GRBG from a synthetic camera, a
+// client reading it as is and converting it on demand. The region must be a
+// third the size of an RGB24 one, frames must arrive at 1 byte per pixel,
+// and PS3EyeConvertFrame must match the Bayer kernels run directly. Also
+// checks the channel reordering done for RGB24 frames, NV12 and binned RGB
+// from raw frames, and a grey channel (1 byte per pixel, stored top-down,
+// replicated into RGB).
+//   g++ -std=c++17 -O2 -pthread TestRawTransport.cpp PS3EyeFrameConvert.cpp
+//      PS3EyeCaptureChannel.cpp PS3EyeFrameCadence.cpp
+//      PS3EyeSyntheticCamera.cpp
+//      PS3EyeSharedMemory.cpp PS3EyeChannelDirectory.cpp PS3EyeIpcPosix.cpp
+//      PS3EyeBayer.cpp PS3EyeBayerSSE2.cpp PS3EyeBayerNEON.cpp
+//      PS3EyeBayerAVX2.o -lrt -o TestRawTransport
+//   (PS3EyeBayerAVX2.o from g++ -std=c++17 -O2 -c -mavx2 PS3EyeBayerAVX2.cpp)
+//   cl /EHsc /O2 /std:c++17 TestRawTransport.cpp PS3EyeFrameConvert.cpp
+//      PS3EyeCaptureChannel.cpp PS3EyeFrameCadence.cpp
+//      PS3EyeSyntheticCamera.cpp
+//      PS3EyeSharedMemory.cpp PS3EyeChannelDirectory.cpp PS3EyeIpcWin32.cpp
+//      PS3EyeBayer.cpp PS3EyeBayerSSE2.cpp PS3EyeBayerNEON.cpp
+//      PS3EyeBayerAVX2.cpp advapi32.lib
+//   (compile PS3EyeBayerAVX2.cpp with /arch:AVX2, e.g. as a separate /c step)
+
+#include "PS3EyeCaptureChannel.h"
+#include "PS3EyeFrameConvert.h"
+#include "PS3EyeSharedMemory.h"
+#include "PS3EyeSyntheticCamera.h"
+#include "PS3EyeTestCheck.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+static bool WaitAndAcquire(PS3EyeSharedMemoryClient &client,
+                           PS3EyeFrameView *frame) {
+  for (int i = 0; i < 20; i++) {
+    if (client.WaitForFrame(100) && client.AcquireFrame(frame))
+      return true;
+  }
+  return false;
+}
+
+static void CheckRawChannel() {
+  PS3EyeCaptureChannel channel(
+      std::unique_ptr<PS3EyeCamera>(new PS3EyeSyntheticCamera("synthetic-0")),
+      PS3EYE_SHARED_MEMORY_NAME);
+  PS3EyeCaptureOptions options;
+  options.fps = 60;
+  options.format = PS3EYE_FORMAT_BAYER_GRBG;
+  if (!channel.Start(options)) {
+    Check(false, "start raw channel");
+    return;
+  }
+
+  Check(PS3EyeSharedMemorySize(PS3EYE_FORMAT_BAYER_GRBG) * 2 <
+            PS3EYE_SHARED_MEMORY_SIZE,
+        "raw region is much smaller than an RGB24 one");
+
+  PS3EyeSharedMemoryClient client;
+  Check(client.Connect(), "client connects to the raw channel");
+  Check(client.GetFormat() == PS3EYE_FORMAT_BAYER_GRBG,
+        "client sees the raw format");
+
+  PS3EyeFrameView frame;
+  if (!WaitAndAcquire(client, &frame)) {
+    Check(false, "raw frame arrives");
+    channel.Stop();
+    return;
+  }
+  Check(frame.format == PS3EYE_FORMAT_BAYER_GRBG &&
+            frame.dataSize == PS3EYE_WIDTH * PS3EYE_HEIGHT &&
+            frame.stride == PS3EYE_WIDTH,
+        "raw frame is 1 byte per pixel");
+
+  // Converted on demand, exactly like the kernels run on the raw data
+  for (PS3EyeBayerFormat format :
+       {PS3EyeBayerFormat::BGR, PS3EyeBayerFormat::RGBA}) {
+    uint32_t stride = PS3EYE_WIDTH * PS3EyeBayerBytesPerPixel(format);
+    std::vector<uint8_t> converted(stride * PS3EYE_HEIGHT);
+    std::vector<uint8_t> expected(converted.size());
+    bool ok =
+        PS3EyeConvertFrame(frame, converted.data(), stride, format, true);
+    PS3EyeBayerJob job = {frame.data,   frame.stride,  expected.data(),
+                          stride,       PS3EYE_WIDTH,  PS3EYE_HEIGHT,
+                          format,       true,          false};
+    PS3EyeDemosaicRows(PS3EyeSimd::Scalar, job, 0, PS3EYE_HEIGHT);
+    Check(ok && converted == expected, "raw frame converts on demand");
+  }
+  std::vector<uint8_t> nv12(
+      PS3EyeYuvFrameSize(PS3EyeYuvFormat::NV12, PS3EYE_WIDTH, PS3EYE_HEIGHT));
+  std::vector<uint8_t> expectedNv12(nv12.size());
+  bool ok = PS3EyeConvertFrameYuv(frame, nv12.data(), PS3EyeYuvFormat::NV12);
+  PS3EyeDemosaicYuvRows(PS3EyeSimd::Scalar,
+                        PS3EyeYuvFrameJob(frame.data, frame.stride,
+                                          expectedNv12.data(), PS3EYE_WIDTH,
+                                          PS3EYE_HEIGHT, PS3EyeYuvFormat::NV12),
+                        0, PS3EYE_HEIGHT);
+  Check(ok && nv12 == expectedNv12, "raw frame converts to NV12 on demand");
+
+  // And binned to half size, bottom-up, like the kernel run directly
+  const uint32_t binnedStride = PS3EYE_WIDTH / 2 * 3;
+  std::vector<uint8_t> binned(binnedStride * PS3EYE_HEIGHT / 2);
+  std::vector<uint8_t> expectedBinned(binned.size());
+  ok = PS3EyeConvertFrameBinned(frame, binned.data(), binnedStride,
+                                PS3EyeBayerFormat::BGR, true);
+  PS3EyeBayerJob binJob = {frame.data,   frame.stride, expectedBinned.data(),
+                           binnedStride, PS3EYE_WIDTH, PS3EYE_HEIGHT,
+                           PS3EyeBayerFormat::BGR,     true,
+                           false};
+  PS3EyeBinRows(PS3EyeSimd::Scalar, binJob, 0, PS3EYE_HEIGHT / 2);
+  Check(ok && binned == expectedBinned, "raw frame bins to half size");
+  client.ReleaseFrame(&frame);
+
+  client.Disconnect();
+  channel.Stop();
+}
+
+static void CheckGreyChannel() {
+  PS3EyeCaptureChannel channel(
+      std::unique_ptr<PS3EyeCamera>(new PS3EyeSyntheticCamera("synthetic-0")),
+      PS3EYE_SHARED_MEMORY_NAME);
+  PS3EyeCaptureOptions options;
+  options.fps = 60;
+  options.format = PS3EYE_FORMAT_GREY8;
+  if (!channel.Start(options)) {
+    Check(false, "start grey channel");
+    return;
+  }
+
+  PS3EyeSharedMemoryClient client;
+  Check(client.Connect() && client.GetFormat() == PS3EYE_FORMAT_GREY8,
+        "client sees the grey format");
+  PS3EyeFrameView frame;
+  if (!WaitAndAcquire(client, &frame)) {
+    Check(false, "grey frame arrives");
+    channel.Stop();
+    return;
+  }
+  Check(frame.format == PS3EYE_FORMAT_GREY8 &&
+            frame.dataSize == PS3EYE_WIDTH * PS3EYE_HEIGHT &&
+            frame.stride == PS3EYE_WIDTH,
+        "grey frame is 1 byte per pixel");
+  client.ReleaseFrame(&frame);
+  client.Disconnect();
+  channel.Stop();
+
+  // Stored top-down, so a bottom-up copy swaps the rows
+  const uint8_t rows[2] = {10, 20};
+  frame = {};
+  frame.data = rows;
+  frame.dataSize = sizeof(rows);
+  frame.width = 1;
+  frame.height = 2;
+  frame.stride = 1;
+  frame.format = PS3EYE_FORMAT_GREY8;
+  uint8_t bgra[8];
+  const uint8_t expected[8] = {20, 20, 20, 255, 10, 10, 10, 255};
+  Check(PS3EyeConvertFrame(frame, bgra, 4, PS3EyeBayerFormat::BGRA, true) &&
+            std::equal(bgra, bgra + 8, expected),
+        "grey to bottom-up BGRA");
+}
+
+// RGB24 frames only have their channels reordered
+static void CheckRgbConversion() {
+  const uint8_t pixels[2 * 3] = {1, 2, 3, 4, 5, 6};
+  PS3EyeFrameView frame = {};
+  frame.data = pixels;
+  frame.dataSize = sizeof(pixels);
+  frame.width = 2;
+  frame.height = 1;
+  frame.stride = 6;
+  frame.format = PS3EYE_FORMAT_RGB24;
+
+  uint8_t bgra[8];
+  const uint8_t expected[8] = {3, 2, 1, 255, 6, 5, 4, 255};
+  Check(PS3EyeConvertFrame(frame, bgra, 8, PS3EyeBayerFormat::BGRA, true) &&
+            std::equal(bgra, bgra + 8, expected),
+        "RGB24 to BGRA");
+
+  // Stored bottom-up, so a top-down copy swaps the rows
+  const uint8_t rows[2 * 3] = {1, 2, 3, 4, 5, 6};
+  frame.data = rows;
+  frame.width = 1;
+  frame.height = 2;
+  frame.stride = 3;
+  uint8_t rgb[6];
+  const uint8_t flipped[6] = {4, 5, 6, 1, 2, 3};
+  Check(PS3EyeConvertFrame(frame, rgb, 3, PS3EyeBayerFormat::RGB, false) &&
+            std::equal(rgb, rgb + 6, flipped),
+        "RGB24 top-down");
+
+  uint8_t nv12[3];
+  Check(!PS3EyeConvertFrameYuv(frame, nv12, PS3EyeYuvFormat::NV12),
+        "only raw frames convert to YUV");
+  Check(!PS3EyeConvertFrameBinned(frame, rgb, 3, PS3EyeBayerFormat::RGB, true),
+        "only raw frames bin");
+
+  frame.format = 7;
+  Check(!PS3EyeConvertFrame(frame, bgra, 8, PS3EyeBayerFormat::BGRA, true),
+        "unknown formats are rejected");
+}
+
+int main() {
+  CheckRawChannel();
+  CheckGreyChannel();
+  CheckRgbConversion();
+  return TestResult();
+}
@@ -0,0 +1,212 @@
+// TestSyntheticCamera.cpp - Checks the fault profile of
+// PS3EyeSyntheticCamera, the backend benchmarks and CI run against:
+//   - the same seed replays the same drops and torn frames on the same
+//     frames, and another seed does not,
+//   - drops and torn frames come at the rates asked for,
+//   - through a capture channel, every frame a client reads reports exactly
+//     the sensor frames lost before it, even with the hand-over jittered by
+//     a quarter of a period, and is flagged corrupt exactly when torn,
+//   - an unplugged camera's GetFrame gives up after its timeout, and
+//     Interrupt from another thread returns it at once.
+// Frames are grey, so the first pixel of each carries the sensor's frame
+// number and a torn frame shows as a last row unlike the first.
+//   g++ -std=c++17 -O2 -pthread TestSyntheticCamera.cpp
+//      PS3EyeCaptureChannel.cpp PS3EyeFrameCadence.cpp
+//      PS3EyeSyntheticCamera.cpp PS3EyeSharedMemory.cpp
+//      PS3EyeChannelDirectory.cpp PS3EyeIpcPosix.cpp -lrt
+//      -o TestSyntheticCamera
+//   cl /EHsc /O2 /std:c++17 TestSyntheticCamera.cpp PS3EyeCaptureChannel.cpp
+//      PS3EyeFrameCadence.cpp PS3EyeSyntheticCamera.cpp PS3EyeSharedMemory.cpp
+//      PS3EyeChannelDirectory.cpp PS3EyeIpcWin32.cpp advapi32.lib
+
+#include "PS3EyeCaptureChannel.h"
+#include "PS3EyeSharedMemory.h"
+#include "PS3EyeSyntheticCamera.h"
+#include "PS3EyeTestCheck.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static const char CHANNEL_NAME[] = "PS3EyeSyntheticTest";
+static const uint32_t WIDTH = 64;
+static const uint32_t HEIGHT = 48;
+
+static bool Torn(const uint8_t *frame, uint32_t width, uint32_t height) {
+  return memcmp(frame, frame + (height - 1) * width, width) != 0;
+}
+
+// Per frame delivered: sensor frame number (low byte), and 0x100 if torn
+static std::vector<uint32_t> Record(const PS3EyeSyntheticProfile &profile,
+                                    uint32_t frames,
+                                    PS3EyeSyntheticCamera *camera) {
+  camera->SetProfile(profile);
+  std::vector<uint32_t> record;
+  std::vector<uint8_t> buffer(WIDTH * HEIGHT);
+  if (!camera->Open(WIDTH, HEIGHT, 1000, PS3EYE_FORMAT_GREY8) ||
+      !camera->Start())
+    return record;
+  for (uint32_t i = 0; i < frames; i++) {
+    uint32_t flags;
+    camera->GetFrame(buffer.data(), 1000, &flags);
+    const bool torn = Torn(buffer.data(), WIDTH, HEIGHT);
+    // Flagged when torn, and only then
+    const bool flagged = flags == (PS3EYE_FRAME_FLAG_PARTIAL |
+                                   PS3EYE_FRAME_FLAG_CORRUPT);
+    record.push_back(buffer[0] | (torn ? 0x100 : 0) |
+                     (torn != flagged ? 0x200 : 0));
+  }
+  camera->Close();
+  return record;
+}
+
+static void CheckReplay() {
+  PS3EyeSyntheticProfile profile;
+  profile.jitterUs = 200;
+  profile.dropPerMille = 50;
+  profile.corruptPerMille = 50;
+  profile.seed = 7;
+
+  PS3EyeSyntheticCamera first("synthetic-a"), second("synthetic-b");
+  const uint32_t frames = 1000;
+  std::vector<uint32_t> a = Record(profile, frames, &first);
+  std::vector<uint32_t> b = Record(profile, frames, &second);
+  Check(a.size() == frames && a == b, "same seed replays the same faults");
+
+  const uint32_t dropped = first.GetDroppedFrames();
+  const uint32_t corrupt = first.GetCorruptFrames();
+  printf("%u frames: %u dropped, %u torn\n", frames, dropped, corrupt);
+  Check(first.GetSensorFrames() == frames + dropped,
+        "drops use up sensor frames");
+  // 5% of 1000: well inside 20..80 for any fair generator
+  Check(dropped >= 20 && dropped <= 80, "drop rate");
+  Check(corrupt >= 20 && corrupt <= 80, "corrupt rate");
+
+  uint32_t torn = 0, misflagged = 0;
+  for (uint32_t frame : a) {
+    torn += (frame & 0x100) ? 1 : 0;
+    misflagged += (frame & 0x200) ? 1 : 0;
+  }
+  // The rows a tear leaves at the bottom always hold an earlier frame
+  Check(torn == corrupt, "torn frames show in the image");
+  Check(misflagged == 0, "GetFrame flags the torn frames");
+
+  profile.seed = 8;
+  PS3EyeSyntheticCamera third("synthetic-c");
+  Check(Record(profile, frames, &third) != a, "another seed differs");
+
+  PS3EyeSyntheticCamera clean("synthetic-d");
+  std::vector<uint32_t> c = Record(PS3EyeSyntheticProfile(), 200, &clean);
+  bool consecutive = c.size() == 200;
+  for (size_t i = 0; consecutive && i < c.size(); i++)
+    consecutive = c[i] == (i & 0xFF);
+  Check(consecutive && clean.GetDroppedFrames() == 0 &&
+            clean.GetCorruptFrames() == 0,
+        "default profile is fault-free");
+}
+
+static void CheckChannel() {
+  const uint32_t fps = 30;
+  PS3EyeSyntheticProfile profile;
+  profile.jitterUs = 1000000 / fps / 4;
+  profile.dropPerMille = 100;
+  profile.corruptPerMille = 100;
+  profile.seed = 3;
+  std::unique_ptr<PS3EyeSyntheticCamera> camera(
+      new PS3EyeSyntheticCamera("synthetic-faults"));
+  camera->SetProfile(profile);
+
+  PS3EyeCaptureChannel channel(std::move(camera), CHANNEL_NAME);
+  PS3EyeCaptureOptions options;
+  options.fps = fps;
+  options.format = PS3EYE_FORMAT_GREY8;
+  PS3EyeSharedMemoryClient client;
+  if (!channel.Start(options) || !client.Connect(CHANNEL_NAME)) {
+    Check(false, "channel started");
+    return;
+  }
+
+  // Every published frame must be read for the per-frame check to hold
+  uint32_t frames = 0, missed = 0, mismatched = 0, dropped = 0;
+  uint32_t torn = 0, misflagged = 0;
+  uint64_t lastNumber = 0;
+  uint8_t lastSensor = 0;
+  const uint64_t end = PS3EyeTransportTime() + 30000000; // 3 s
+  while (PS3EyeTransportTime() < end) {
+    PS3EyeFrameView frame;
+    if (!client.WaitForFrame(100) || !client.AcquireFrame(&frame))
+      continue;
+    const uint8_t sensor = frame.data[0];
+    // The channel's buffer keeps the previous frame below a tear
+    const bool isTorn = Torn(frame.data, PS3EYE_WIDTH, PS3EYE_HEIGHT);
+    torn += isTorn ? 1 : 0;
+    if (isTorn != ((frame.metadata.flags & PS3EYE_FRAME_FLAG_CORRUPT) != 0))
+      misflagged++;
+    if (frames > 0) {
+      if (frame.frameNumber != lastNumber + 1)
+        missed++;
+      else if (static_cast<uint8_t>(sensor - lastSensor) !=
+               frame.metadata.droppedFrames + 1)
+        mismatched++;
+      dropped += frame.metadata.droppedFrames;
+    }
+    lastNumber = frame.frameNumber;
+    lastSensor = sensor;
+    frames++;
+    client.ReleaseFrame(&frame);
+  }
+  client.Disconnect();
+  channel.Stop();
+
+  printf("channel: %u frames read, %u reported dropped, %u torn, %u missed "
+         "by the reader\n",
+         frames, dropped, torn, missed);
+  Check(frames > 2 * fps, "channel streams");
+  Check(dropped > 0 && mismatched == 0,
+        "each frame reports the sensor frames lost before it");
+  Check(torn > 0 && misflagged == 0,
+        "torn frames reach clients flagged corrupt, and only those");
+}
+
+static void CheckInterrupt() {
+  PS3EyeSyntheticCamera camera("synthetic-unplugged");
+  std::vector<uint8_t> buffer(WIDTH * HEIGHT);
+  if (!camera.Open(WIDTH, HEIGHT, 60, PS3EYE_FORMAT_GREY8) ||
+      !camera.Start()) {
+    Check(false, "unplug camera started");
+    return;
+  }
+  uint32_t flags;
+  Check(camera.GetFrame(buffer.data(), 1000, &flags) != 0,
+        "frame before unplug");
+  camera.Unplug(60000);
+
+  uint64_t start = PS3EyeTransportTime();
+  Check(camera.GetFrame(buffer.data(), 50, &flags) == 0,
+        "unplugged: no frame");
+  uint64_t waited = PS3EyeTransportTime() - start;
+  Check(waited >= 450000 && waited < 2500000,
+        "unplugged: GetFrame waits its timeout");
+
+  std::thread interrupter([&camera] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    camera.Interrupt();
+  });
+  start = PS3EyeTransportTime();
+  Check(camera.GetFrame(buffer.data(), 10000, &flags) == 0 &&
+            PS3EyeTransportTime() - start < 10000000,
+        "unplugged: Interrupt returns GetFrame");
+  interrupter.join();
+  camera.Close();
+}
+
+int main() {
+  CheckReplay();
+  CheckChannel();
+  CheckInterrupt();
+
+  return TestResult();
+}
@@ -0,0 +1,224 @@
+// TestWorkerPool.cpp - Checks the worker pool and the striped conversions.
+// ParallelFor must run every index exactly once, also with several threads
+// submitting at once, and the shared pool must live exactly as long as its
+// users. Every striped conversion must equal the single-threaded one byte for
+// byte (and leave the bytes around the output alone) for pools of 0 to 7
+// workers, at the camera sizes and at sizes that leave uneven stripes or
+// none to split, in every orientation and with padded strides; and so must
+// several cameras converting on one pool at the same time.
+//   g++ -std=c++14 -O2 -c -mavx2 PS3EyeBayerAVX2.cpp
+//   g++ -std=c++14 -O2 -pthread TestWorkerPool.cpp PS3EyeWorkerPool.cpp
+//      PS3EyeBayer.cpp PS3EyeBayerSSE2.cpp PS3EyeBayerNEON.cpp
+//      PS3EyeBayerAVX2.o -o TestWorkerPool
+//   cl /EHsc /O2 TestWorkerPool.cpp PS3EyeWorkerPool.cpp PS3EyeBayer.cpp
+//      PS3EyeBayerSSE2.cpp PS3EyeBayerNEON.cpp PS3EyeBayerAVX2.cpp
+//   (compile PS3EyeBayerAVX2.cpp with /arch:AVX2, e.g. as a separate /c step)
+
+#include "PS3EyeTestCheck.h"
+#include "PS3EyeWorkerPool.h"
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+static const uint32_t POOL_SIZES[] = {0, 1, 2, 3, 7};
+
+// flipVertical, mirror
+static const bool ORIENTATIONS[][2] = {
+    {false, false}, {true, false}, {false, true}, {true, true}};
+
+static const uint8_t MARKER = 0xA5;
+
+//------------------------------------------------------------------------------
+// Pool
+//------------------------------------------------------------------------------
+
+static bool RunsEachOnce(PS3EyeWorkerPool &pool, uint32_t count) {
+  std::vector<std::atomic<uint32_t>> runs(count);
+  for (auto &run : runs)
+    run = 0;
+  pool.ParallelFor(count, [&](uint32_t i) { runs[i]++; });
+  for (auto &run : runs) {
+    if (run != 1)
+      return false;
+  }
+  return true;
+}
+
+static void CheckParallelFor() {
+  for (uint32_t threads : POOL_SIZES) {
+    PS3EyeWorkerPool pool(threads);
+    Check(pool.ThreadCount() == threads, "pool has the threads asked for");
+    for (uint32_t count : {0u, 1u, 2u, 5u, 64u, 1000u})
+      Check(RunsEachOnce(pool, count), "ParallelFor runs each index once");
+  }
+
+  // Submitters racing for the same workers, as cameras do
+  PS3EyeWorkerPool pool(3);
+  std::vector<std::thread> submitters;
+  for (int s = 0; s < 4; s++) {
+    submitters.emplace_back([&pool, s] {
+      for (uint32_t batch = 0; batch < 300; batch++) {
+        if (!RunsEachOnce(pool, 1 + (batch + s) % 17)) {
+          Check(false, "concurrent ParallelFor runs each index once");
+          return;
+        }
+      }
+    });
+  }
+  for (std::thread &submitter : submitters)
+    submitter.join();
+}
+
+static void CheckShared() {
+  std::shared_ptr<PS3EyeWorkerPool> a = PS3EyeWorkerPool::Shared();
+  std::shared_ptr<PS3EyeWorkerPool> b = PS3EyeWorkerPool::Shared();
+  Check(a && a == b, "users share one pool");
+  const unsigned cores = std::thread::hardware_concurrency();
+  Check(a->ThreadCount() == (cores > 1 ? cores - 1 : 0),
+        "shared pool has a worker per core besides the caller");
+  std::weak_ptr<PS3EyeWorkerPool> weak = a;
+  a.reset();
+  b.reset();
+  Check(weak.expired(), "shared pool goes with its last user");
+  Check(PS3EyeWorkerPool::Shared() != nullptr, "shared pool comes back");
+}
+
+//------------------------------------------------------------------------------
+// Conversions
+//------------------------------------------------------------------------------
+
+struct Frame {
+  uint32_t width, height, bayerStride, dstStride;
+  std::vector<uint8_t> bayer;
+};
+
+static Frame RandomFrame(std::mt19937 &rng, uint32_t width, uint32_t height,
+                         uint32_t padding) {
+  Frame frame;
+  frame.width = width;
+  frame.height = height;
+  frame.bayerStride = width + padding;
+  frame.dstStride = width * 4 + padding;
+  frame.bayer.resize(static_cast<size_t>(frame.bayerStride) * height);
+  for (uint8_t &byte : frame.bayer)
+    byte = static_cast<uint8_t>(rng());
+  return frame;
+}
+
+// Output of every conversion of a frame, each in a buffer pre-filled with the
+// marker: with the whole-frame functions if single, else in stripes on pool.
+static std::vector<std::vector<uint8_t>> ConvertAll(const Frame &frame,
+                                                    PS3EyeWorkerPool *pool,
+                                                    bool single) {
+  std::vector<std::vector<uint8_t>> outputs;
+  auto output = [&] {
+    outputs.emplace_back(static_cast<size_t>(frame.dstStride) * frame.height,
+                         MARKER);
+    return outputs.back().data();
+  };
+  const bool even = ((frame.width | frame.height) & 1) == 0;
+
+  for (const auto &orientation : ORIENTATIONS) {
+    const PS3EyeBayerFormat formats[] = {PS3EyeBayerFormat::BGR,
+                                         PS3EyeBayerFormat::RGBA};
+    for (PS3EyeBayerFormat format : formats) {
+      PS3EyeBayerJob job = {frame.bayer.data(), frame.bayerStride,
+                            output(),           frame.dstStride,
+                            frame.width,        frame.height,
+                            format,             orientation[0],
+                            orientation[1]};
+      single ? PS3EyeDemosaic(job) : PS3EyeDemosaicParallel(pool, job);
+      if (!even)
+        continue;
+      job.dst = output();
+      single ? PS3EyeBin(job) : PS3EyeBinParallel(pool, job);
+    }
+  }
+
+  PS3EyeGreyJob grey = {frame.bayer.data(), frame.bayerStride, output(),
+                        frame.dstStride,    frame.width,       frame.height};
+  single ? PS3EyeBayerToGrey(grey) : PS3EyeBayerToGreyParallel(pool, grey);
+  if (!even)
+    return outputs;
+  grey.dst = output();
+  single ? PS3EyeBinGrey(grey) : PS3EyeBinGreyParallel(pool, grey);
+
+  const PS3EyeYuvFormat yuvFormats[] = {
+      PS3EyeYuvFormat::NV12, PS3EyeYuvFormat::I420, PS3EyeYuvFormat::YUY2};
+  for (PS3EyeYuvFormat format : yuvFormats) {
+    // Planes packed behind each other, so a stripe writing the wrong chroma
+    // rows lands in another stripe's bytes
+    outputs.emplace_back(
+        PS3EyeYuvFrameSize(format, frame.width, frame.height) + 64, MARKER);
+    uint8_t *dst = outputs.back().data();
+    const PS3EyeYuvJob job =
+        PS3EyeYuvFrameJob(frame.bayer.data(), frame.bayerStride, dst,
+                          frame.width, frame.height, format);
+    single ? PS3EyeDemosaicYuv(job) : PS3EyeDemosaicYuvParallel(pool, job);
+  }
+  return outputs;
+}
+
+static void CheckFrame(const Frame &frame) {
+  const auto expected = ConvertAll(frame, nullptr, true);
+  Check(ConvertAll(frame, nullptr, false) == expected,
+        "no pool converts like one thread");
+  for (uint32_t threads : POOL_SIZES) {
+    PS3EyeWorkerPool pool(threads);
+    char what[96];
+    snprintf(what, sizeof(what),
+             "%ux%u on %u workers converts like one thread", frame.width,
+             frame.height, threads);
+    Check(ConvertAll(frame, &pool, false) == expected, what);
+  }
+}
+
+// Cameras converting their own frames on one pool at the same time
+static void CheckCameras(std::mt19937 &rng) {
+  const int cameras = 4;
+  std::vector<Frame> frames;
+  std::vector<std::vector<std::vector<uint8_t>>> expected;
+  for (int c = 0; c < cameras; c++) {
+    frames.push_back(RandomFrame(rng, c & 1 ? 320 : 640, c & 1 ? 240 : 480,
+                                 0));
+    expected.push_back(ConvertAll(frames.back(), nullptr, true));
+  }
+
+  PS3EyeWorkerPool pool(3);
+  std::vector<std::thread> threads;
+  for (int c = 0; c < cameras; c++) {
+    threads.emplace_back([&, c] {
+      for (int i = 0; i < 5; i++) {
+        if (ConvertAll(frames[c], &pool, false) != expected[c]) {
+          Check(false, "cameras sharing a pool convert like one thread");
+          return;
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+}
+
+int main() {
+  printf("Best kernel: %s, %u cores\n", PS3EyeSimdName(PS3EyeBestSimd()),
+         std::thread::hardware_concurrency());
+
+  CheckParallelFor();
+  CheckShared();
+
+  std::mt19937 rng(12345);
+  const uint32_t sizes[][2] = {{640, 480}, {320, 240}, {2, 2},  {34, 16},
+                               {66, 34},   {98, 62},   {36, 98}, {17, 33},
+                               {20, 160},  {130, 50}};
+  for (const auto &size : sizes) {
+    CheckFrame(RandomFrame(rng, size[0], size[1], 0));
+    CheckFrame(RandomFrame(rng, size[0], size[1], 13));
+  }
+  CheckCameras(rng);
+
+  return TestResult();
+}